@@ -0,0 +1,169 @@
+/* anel.hpp
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Fila circular de um produtor e um consumidor (SPSC), sem travas e sem
+   espera: cada lado so escreve o seu indice (atomico, em linhas de
+   cache separadas) e le o do outro com acquire. Toda a memoria e'
+   alocada no construtor; a capacidade e' arredondada para potencia de 2.
+
+     push()      produtor: poe n elementos, todos ou nenhum
+     space()     produtor: quantos cabem agora
+     readable()  consumidor: quantos ja foram publicados
+     at()        consumidor: o i-esimo publicado, sem tirar
+     copyOut()   consumidor: copia n publicados a partir do i-esimo
+     pop()       consumidor: libera os n primeiros para o produtor
+     clear()     consumidor: libera tudo o que ja foi publicado
+
+   Cada lado guarda uma copia do indice do outro e so o rele quando a
+   copia nao basta, o que evita trocar a linha de cache a cada chamada.
+   O consumidor pode tirar elementos que soube publicados por outra fila
+   (as amostras de um bloco cujo cabecalho ja chegou) sem passar por
+   readable(); pop() mantem a copia sempre a frente do indice. */
+
+#ifndef ANEL_HPP
+#define ANEL_HPP
+
+/*****************************************************************************/
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+/*****************************************************************************/
+
+namespace aec
+{
+
+template <class T>
+class SpscRing
+{
+
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing: T precisa ser copiavel com memcpy");
+
+public:
+
+    explicit SpscRing(std::size_t lCapacity)
+        : m_lCapacity(roundUp(lCapacity)), m_pData(new T[m_lCapacity]), m_lHead(0), m_lTailCache(0), m_lTail(0), m_lHeadCache(0)
+    {
+    }
+
+    std::size_t capacity() const { return m_lCapacity; }
+
+    /* Produtor */
+
+    std::size_t space()
+    {
+        if (m_lCapacity - (m_lTail.load(std::memory_order_relaxed) - m_lHeadCache) == 0)
+            m_lHeadCache = m_lHead.load(std::memory_order_acquire);
+        return m_lCapacity - (m_lTail.load(std::memory_order_relaxed) - m_lHeadCache);
+    }
+
+    bool push(const T * pIn, std::size_t lCount)
+    {
+
+        std::size_t lTail;
+        std::size_t lStart;
+        std::size_t lFirst;
+
+        lTail = m_lTail.load(std::memory_order_relaxed);
+        if (m_lCapacity - (lTail - m_lHeadCache) < lCount)
+        {
+            m_lHeadCache = m_lHead.load(std::memory_order_acquire);
+            if (m_lCapacity - (lTail - m_lHeadCache) < lCount)
+                return false;
+        }
+        lStart = lTail & (m_lCapacity - 1);
+        lFirst = m_lCapacity - lStart < lCount ? m_lCapacity - lStart : lCount;
+        std::memcpy(m_pData.get() + lStart, pIn, lFirst * sizeof(T));
+        std::memcpy(m_pData.get(), pIn + lFirst, (lCount - lFirst) * sizeof(T));
+        m_lTail.store(lTail + lCount, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumidor */
+
+    std::size_t readable()
+    {
+
+        std::size_t lHead;
+
+        lHead = m_lHead.load(std::memory_order_relaxed);
+        if (m_lTailCache == lHead)
+            m_lTailCache = m_lTail.load(std::memory_order_acquire);
+        return m_lTailCache - lHead;
+    }
+
+    const T & at(std::size_t lIndex) const
+    {
+        return m_pData[(m_lHead.load(std::memory_order_relaxed) + lIndex) & (m_lCapacity - 1)];
+    }
+
+    void copyOut(std::size_t lIndex, T * pOut, std::size_t lCount) const
+    {
+
+        std::size_t lStart;
+        std::size_t lFirst;
+
+        lStart = (m_lHead.load(std::memory_order_relaxed) + lIndex) & (m_lCapacity - 1);
+        lFirst = m_lCapacity - lStart < lCount ? m_lCapacity - lStart : lCount;
+        std::memcpy(pOut, m_pData.get() + lStart, lFirst * sizeof(T));
+        std::memcpy(pOut + lFirst, m_pData.get(), (lCount - lFirst) * sizeof(T));
+    }
+
+    void pop(std::size_t lCount)
+    {
+
+        std::size_t lHead;
+
+        lHead = m_lHead.load(std::memory_order_relaxed) + lCount;
+        if (m_lTailCache - lHead > m_lCapacity)
+            m_lTailCache = lHead;
+        m_lHead.store(lHead, std::memory_order_release);
+    }
+
+    void clear()
+    {
+        m_lTailCache = m_lTail.load(std::memory_order_acquire);
+        m_lHead.store(m_lTailCache, std::memory_order_release);
+    }
+
+private:
+
+    static std::size_t roundUp(std::size_t lCapacity)
+    {
+
+        std::size_t lSize;
+
+        lSize = 1;
+        while (lSize < lCapacity)
+            lSize <<= 1;
+        return lSize;
+    }
+
+    const std::size_t m_lCapacity;
+
+    std::unique_ptr<T[]> m_pData;
+
+    /* Escritos pelo consumidor */
+    alignas(64) std::atomic<std::size_t> m_lHead;
+
+    std::size_t m_lTailCache;
+
+    /* Escritos pelo produtor */
+    alignas(64) std::atomic<std::size_t> m_lTail;
+
+    std::size_t m_lHeadCache;
+
+};
+
+} /* namespace aec */
+
+/*****************************************************************************/
+
+#endif /* ANEL_HPP */
+
+/* EOF */
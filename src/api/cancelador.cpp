@@ -0,0 +1,276 @@
+/* cancelador.cpp
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   libcancelador.so: a ABI em C de cancelador.h sobre as classes de
+   cancelador.hpp e duplex.hpp. Nenhuma excecao passa da fronteira; erros de uso
+   viram 0 ou NULL. */
+
+/*****************************************************************************/
+
+#include <cstring>
+#include <new>
+
+#include "cancelador.hpp"
+#include "duplex.hpp"
+#include "cancelador.h"
+
+#define AEC_EXPORT extern "C" __attribute__((visibility("default")))
+
+/*****************************************************************************/
+
+struct AEC_Canceller
+{
+
+    aec::EchoCanceller m_oCanceller;
+
+    bool m_bOwned; /* Criado por aec_create() (delete) ou aec_init() */
+
+};
+
+struct AEC_Duplex
+{
+
+    aec::DuplexCanceller m_oDuplex;
+
+};
+
+/* Cabeca de aec_init() antes da memoria de trabalho, alinhada em 16 */
+static const size_t TAMANHO_CABECA = (sizeof(AEC_Canceller) + 15) & ~(size_t)15;
+
+/*****************************************************************************/
+
+/* Configuracao de quem chama sobre o padrao, ate o StructSize dele */
+static bool converte(const AEC_Config * psConfig, aec::Config * psSaida)
+{
+
+    AEC_Config sConfig;
+
+    sConfig.StructSize = sizeof(AEC_Config);
+    aec_config_default(&sConfig);
+    if (psConfig != NULL)
+    {
+        if (psConfig->StructSize < offsetof(AEC_Config, EchoMs) || psConfig->StructSize > 4096)
+            return false;
+        std::memcpy(&sConfig, psConfig, psConfig->StructSize < sizeof(AEC_Config) ? psConfig->StructSize : sizeof(AEC_Config));
+    }
+    if (sConfig.Accumulator < AEC_ACC_FLOAT || sConfig.Accumulator > AEC_ACC_KAHAN)
+        return false;
+
+    psSaida->m_fEchoMs = sConfig.EchoMs;
+    psSaida->m_fDtdMs = sConfig.DtdMs;
+    psSaida->m_fDtdThreshold = sConfig.DtdThreshold;
+    psSaida->m_fMu = sConfig.Mu;
+    psSaida->m_fSetThresholdDb = sConfig.SetThresholdDb;
+    psSaida->m_eAccumulator = static_cast<aec::Accumulator>(sConfig.Accumulator);
+    return true;
+}
+
+/* Medidas ate o StructSize de quem chama */
+static bool devolve(const aec::Stats & sStats, AEC_Stats * psSaida)
+{
+
+    AEC_Stats sCompleto;
+
+    if (psSaida->StructSize < sizeof(unsigned int) || psSaida->StructSize > 4096)
+        return false;
+    sCompleto.StructSize = psSaida->StructSize;
+    sCompleto.Frames = sStats.m_ullFrames;
+    sCompleto.Updates = sStats.m_ullUpdates;
+    sCompleto.PowerD = sStats.m_dPowerD;
+    sCompleto.PowerE = sStats.m_dPowerE;
+    sCompleto.Dncr = sStats.m_fDncr;
+    sCompleto.Taps = sStats.m_lTaps;
+    std::memcpy(psSaida, &sCompleto, psSaida->StructSize < sizeof(AEC_Stats) ? psSaida->StructSize : sizeof(AEC_Stats));
+    return true;
+}
+
+/*****************************************************************************/
+
+AEC_EXPORT unsigned int aec_abi_version(void)
+{
+    return AEC_ABI_VERSION;
+}
+
+/* Padrao ate o StructSize de quem chama, como devolve() */
+AEC_EXPORT int aec_config_default(AEC_Config * psConfig)
+{
+
+    aec::Config sPadrao;
+    AEC_Config sCompleto;
+
+    if (psConfig == NULL || psConfig->StructSize < sizeof(unsigned int) || psConfig->StructSize > 4096)
+        return 0;
+    sCompleto.StructSize = psConfig->StructSize;
+    sCompleto.EchoMs = sPadrao.m_fEchoMs;
+    sCompleto.DtdMs = sPadrao.m_fDtdMs;
+    sCompleto.DtdThreshold = sPadrao.m_fDtdThreshold;
+    sCompleto.Mu = sPadrao.m_fMu;
+    sCompleto.SetThresholdDb = sPadrao.m_fSetThresholdDb;
+    sCompleto.Accumulator = static_cast<int>(sPadrao.m_eAccumulator);
+    std::memcpy(psConfig, &sCompleto, psConfig->StructSize < sizeof(AEC_Config) ? psConfig->StructSize : sizeof(AEC_Config));
+    return 1;
+}
+
+AEC_EXPORT AEC_Canceller * aec_create(unsigned long lSampleRate, const AEC_Config * psConfig)
+{
+
+    aec::Config sConfig;
+
+    if (lSampleRate == 0 || !converte(psConfig, &sConfig))
+        return NULL;
+    try
+    {
+        return new AEC_Canceller{aec::EchoCanceller(lSampleRate, sConfig), true};
+    }
+    catch (...)
+    {
+        return NULL;
+    }
+}
+
+AEC_EXPORT size_t aec_memory_size(unsigned long lSampleRate)
+{
+    return TAMANHO_CABECA + aec::EchoCanceller::memorySize(lSampleRate);
+}
+
+AEC_EXPORT AEC_Canceller * aec_init(void * pvMemory, size_t lSize, unsigned long lSampleRate, const AEC_Config * psConfig)
+{
+
+    aec::Config sConfig;
+    unsigned char * pucMemory;
+
+    pucMemory = static_cast<unsigned char *>(pvMemory);
+    if (pucMemory == NULL || lSampleRate == 0 || lSize < aec_memory_size(lSampleRate)
+        || reinterpret_cast<size_t>(pucMemory) % 16 != 0 || !converte(psConfig, &sConfig))
+        return NULL;
+    try
+    {
+        return new (pucMemory) AEC_Canceller{aec::EchoCanceller(lSampleRate, sConfig, pucMemory + TAMANHO_CABECA,
+                                                                lSize - TAMANHO_CABECA), false};
+    }
+    catch (...)
+    {
+        return NULL;
+    }
+}
+
+AEC_EXPORT int aec_configure(AEC_Canceller * psCanceller, const AEC_Config * psConfig)
+{
+
+    aec::Config sConfig;
+
+    if (psCanceller == NULL || psConfig == NULL || !converte(psConfig, &sConfig))
+        return 0;
+    psCanceller->m_oCanceller.configure(sConfig);
+    return 1;
+}
+
+AEC_EXPORT int aec_process(AEC_Canceller * psCanceller, const float * pfMic, const float * pfRef, float * pfOut,
+                           unsigned long lFrames, AEC_Stats * psStats)
+{
+
+    aec::Stats sStats;
+
+    if (psCanceller == NULL || (lFrames > 0 && (pfMic == NULL || pfRef == NULL || pfOut == NULL)))
+        return 0;
+    sStats = psCanceller->m_oCanceller.process(aec::Span<const float>(pfMic, lFrames), aec::Span<const float>(pfRef, lFrames),
+                                               aec::Span<float>(pfOut, lFrames));
+    return psStats == NULL || devolve(sStats, psStats);
+}
+
+AEC_EXPORT int aec_stats(const AEC_Canceller * psCanceller, AEC_Stats * psStats)
+{
+    if (psCanceller == NULL || psStats == NULL)
+        return 0;
+    return devolve(psCanceller->m_oCanceller.stats(), psStats);
+}
+
+AEC_EXPORT void aec_reset(AEC_Canceller * psCanceller)
+{
+    if (psCanceller != NULL)
+        psCanceller->m_oCanceller.reset();
+}
+
+AEC_EXPORT void aec_destroy(AEC_Canceller * psCanceller)
+{
+    if (psCanceller == NULL)
+        return;
+    if (psCanceller->m_bOwned)
+        delete psCanceller;
+    else
+        psCanceller->~AEC_Canceller();
+}
+
+AEC_EXPORT AEC_Duplex * aec_duplex_create(unsigned long lSampleRate, const AEC_Config * psConfig, unsigned long lRingFrames,
+                                          unsigned long lMaxBlock)
+{
+
+    aec::Config sConfig;
+
+    if (lSampleRate == 0 || lRingFrames == 0 || lMaxBlock == 0 || !converte(psConfig, &sConfig))
+        return NULL;
+    try
+    {
+        return new AEC_Duplex{aec::DuplexCanceller(lSampleRate, sConfig, lRingFrames, lMaxBlock)};
+    }
+    catch (...)
+    {
+        return NULL;
+    }
+}
+
+AEC_EXPORT int aec_duplex_render(AEC_Duplex * psDuplex, const float * pfRef, unsigned long lFrames, unsigned long long ullTimestamp)
+{
+    if (psDuplex == NULL || (lFrames > 0 && pfRef == NULL) || lFrames > psDuplex->m_oDuplex.ringFrames())
+        return 0;
+    return psDuplex->m_oDuplex.render(aec::Span<const float>(pfRef, lFrames), ullTimestamp);
+}
+
+AEC_EXPORT int aec_duplex_capture(AEC_Duplex * psDuplex, const float * pfMic, float * pfOut, unsigned long lFrames,
+                                  unsigned long long ullTimestamp, AEC_Stats * psStats)
+{
+
+    aec::Stats sStats;
+
+    if (psDuplex == NULL || (lFrames > 0 && (pfMic == NULL || pfOut == NULL)) || lFrames > psDuplex->m_oDuplex.maxBlock())
+        return 0;
+    sStats = psDuplex->m_oDuplex.capture(aec::Span<const float>(pfMic, lFrames), ullTimestamp, aec::Span<float>(pfOut, lFrames));
+    return psStats == NULL || devolve(sStats, psStats);
+}
+
+AEC_EXPORT int aec_duplex_stats(const AEC_Duplex * psDuplex, AEC_DuplexStats * psStats)
+{
+
+    aec::Alignment sAlignment;
+    AEC_DuplexStats sCompleto;
+
+    if (psDuplex == NULL || psStats == NULL || psStats->StructSize < sizeof(unsigned int) || psStats->StructSize > 4096)
+        return 0;
+    sAlignment = psDuplex->m_oDuplex.alignment();
+    sCompleto.StructSize = psStats->StructSize;
+    sCompleto.Overruns = sAlignment.m_ullOverruns;
+    sCompleto.DroppedFrames = sAlignment.m_ullDroppedFrames;
+    sCompleto.Underruns = sAlignment.m_ullUnderruns;
+    sCompleto.MissingFrames = sAlignment.m_ullMissingFrames;
+    sCompleto.GapFrames = sAlignment.m_ullGapFrames;
+    sCompleto.StaleFrames = sAlignment.m_ullStaleFrames;
+    std::memcpy(psStats, &sCompleto, psStats->StructSize < sizeof(AEC_DuplexStats) ? psStats->StructSize : sizeof(AEC_DuplexStats));
+    return 1;
+}
+
+AEC_EXPORT void aec_duplex_reset(AEC_Duplex * psDuplex)
+{
+    if (psDuplex != NULL)
+        psDuplex->m_oDuplex.reset();
+}
+
+AEC_EXPORT void aec_duplex_destroy(AEC_Duplex * psDuplex)
+{
+    delete psDuplex;
+}
+
+/*****************************************************************************/
+
+/* EOF */
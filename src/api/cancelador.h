@@ -0,0 +1,180 @@
+/* cancelador.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   ABI estavel em C da API de cancelador.hpp, exportada por
+   libcancelador.so (make api). So as funcoes aec_* sao exportadas; o
+   cancelador e' opaco e as estruturas comecam pelo tamanho (StructSize),
+   entao campos novos entram no fim sem quebrar quem foi compilado antes:
+   campos que o chamador nao conhece ficam no padrao, e as medidas so
+   sao escritas ate onde cabe.
+
+     aec_config_default()  configuracao padrao, ate o StructSize dado
+     aec_create()          aloca e inicia um cancelador
+     aec_memory_size()     bytes que aec_init() precisa
+     aec_init()            inicia um cancelador na memoria dada, sem alocar
+     aec_configure()       troca a configuracao
+     aec_process()         processa Frames amostras de uma vez
+     aec_stats()           medidas somadas desde o ultimo aec_reset()
+     aec_reset()           zera o filtro e as medidas
+     aec_destroy()         libera (a memoria de aec_init() e' de quem deu)
+
+   Com a referencia e o microfone em threads diferentes (duplex.hpp):
+
+     aec_duplex_create()   aloca as filas e o cancelador
+     aec_duplex_render()   thread de reproducao: bloco de referencia
+     aec_duplex_capture()  thread de captura: bloco de microfone
+     aec_duplex_stats()    contadores de alinhamento, de qualquer thread
+     aec_duplex_reset()    esvazia as filas, zera filtro e contadores
+     aec_duplex_destroy()  libera
+
+   As funcoes que podem falhar devolvem 0 (ou NULL) em erro de uso:
+   ponteiros nulos, memoria pequena ou desalinhada, StructSize invalido.
+   aec_process(), aec_duplex_render() e aec_duplex_capture() nao alocam
+   nem travam. */
+
+#ifndef CANCELADOR_H
+#define CANCELADOR_H
+
+/*****************************************************************************/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*****************************************************************************/
+
+#define AEC_ABI_VERSION 2
+
+/* Acumulador dos produtos internos */
+#define AEC_ACC_FLOAT  0
+#define AEC_ACC_DOUBLE 1
+#define AEC_ACC_KAHAN  2
+
+typedef struct AEC_Canceller AEC_Canceller;
+
+typedef struct AEC_Duplex AEC_Duplex;
+
+typedef struct _AEC_Config {
+
+  /* sizeof(AEC_Config) de quem chama */
+  unsigned int StructSize;
+
+  /* Tamanho do filtro e comprimento do DTD em ms */
+  float EchoMs;
+  float DtdMs;
+
+  float DtdThreshold;
+  float Mu;
+  float SetThresholdDb;
+
+  /* AEC_ACC_... */
+  int Accumulator;
+
+} AEC_Config;
+
+typedef struct _AEC_Stats {
+
+  /* sizeof(AEC_Stats) de quem chama */
+  unsigned int StructSize;
+
+  unsigned long long Frames;
+
+  /* Amostras em que o filtro adaptou */
+  unsigned long long Updates;
+
+  /* sum d^2 e sum e^2 */
+  double PowerD;
+  double PowerE;
+
+  /* Estatistica do DTD na ultima amostra */
+  float Dncr;
+
+  /* Coeficientes em uso */
+  unsigned long Taps;
+
+} AEC_Stats;
+
+typedef struct _AEC_DuplexStats {
+
+  /* sizeof(AEC_DuplexStats) de quem chama */
+  unsigned int StructSize;
+
+  /* Blocos de aec_duplex_render() descartados com a fila cheia, e as
+     amostras deles */
+  unsigned long long Overruns;
+  unsigned long long DroppedFrames;
+
+  /* Chamadas de aec_duplex_capture() sem a referencia, e as amostras
+     zeradas nelas */
+  unsigned long long Underruns;
+  unsigned long long MissingFrames;
+
+  /* Amostras zeradas por tempo que a reproducao pulou */
+  unsigned long long GapFrames;
+
+  /* Amostras de referencia mais velhas que o microfone */
+  unsigned long long StaleFrames;
+
+} AEC_DuplexStats;
+
+/*****************************************************************************/
+
+unsigned int aec_abi_version(void);
+
+/* Config->StructSize vem de quem chama (sizeof(AEC_Config) do
+   cabecalho com que compilou); so os campos que cabem sao escritos */
+int aec_config_default(AEC_Config * Config);
+
+/* Config pode ser NULL (padrao) */
+AEC_Canceller * aec_create(unsigned long SampleRate, const AEC_Config * Config);
+
+size_t aec_memory_size(unsigned long SampleRate);
+
+/* Memory: Size >= aec_memory_size() bytes, alinhados em 16 */
+AEC_Canceller * aec_init(void * Memory, size_t Size, unsigned long SampleRate, const AEC_Config * Config);
+
+int aec_configure(AEC_Canceller * Canceller, const AEC_Config * Config);
+
+/* Out pode ser Mic; Stats pode ser NULL */
+int aec_process(AEC_Canceller * Canceller, const float * Mic, const float * Ref, float * Out, unsigned long Frames,
+                AEC_Stats * Stats);
+
+int aec_stats(const AEC_Canceller * Canceller, AEC_Stats * Stats);
+
+void aec_reset(AEC_Canceller * Canceller);
+
+void aec_destroy(AEC_Canceller * Canceller);
+
+/* RingFrames: amostras de referencia em transito; MaxBlock: maior bloco
+   de aec_duplex_capture() */
+AEC_Duplex * aec_duplex_create(unsigned long SampleRate, const AEC_Config * Config, unsigned long RingFrames,
+                               unsigned long MaxBlock);
+
+/* Timestamp: tempo da primeira amostra, em amostras de um relogio comum
+   as duas threads. 0 se o bloco foi descartado (overrun) */
+int aec_duplex_render(AEC_Duplex * Duplex, const float * Ref, unsigned long Frames, unsigned long long Timestamp);
+
+/* Out pode ser Mic; Stats pode ser NULL */
+int aec_duplex_capture(AEC_Duplex * Duplex, const float * Mic, float * Out, unsigned long Frames,
+                       unsigned long long Timestamp, AEC_Stats * Stats);
+
+int aec_duplex_stats(const AEC_Duplex * Duplex, AEC_DuplexStats * Stats);
+
+/* So com aec_duplex_render() e aec_duplex_capture() parados */
+void aec_duplex_reset(AEC_Duplex * Duplex);
+
+void aec_duplex_destroy(AEC_Duplex * Duplex);
+
+/*****************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CANCELADOR_H */
+
+/* EOF */
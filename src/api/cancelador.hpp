@@ -0,0 +1,276 @@
+/* cancelador.hpp
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   API em C++ do cancelador NLMS com CheapNCR, para embutir num servidor
+   de midia sem host de audio: sem portas, sem descritores globais e sem
+   o formato de sinal do LADSPA. Usa o mesmo nucleo do plugin (nlms.h),
+   entao a saida e' identica a do adapt_nlmscncr com os mesmos
+   controles.
+
+     aec::EchoCanceller oAec(16000);
+     aec::Stats sStats = oAec.process(mic, ref, out);
+
+   process() recebe spans (ponteiro e tamanho; vetores, arrays e
+   std::span convertem sozinhos) de tamanhos iguais e processa quantas
+   amostras vierem numa chamada so. out pode ser o proprio mic. A
+   configuracao (Config) e' tipada e pode mudar entre chamadas com
+   configure(); Stats traz as medidas da chamada, e stats() as somadas
+   desde o ultimo reset().
+
+   Nada e' alocado fora do construtor. O construtor com memoria recebe
+   memorySize() bytes de quem chama e nao aloca nada. Erros de uso
+   (tamanhos diferentes, memoria pequena) viram std::invalid_argument.
+   A ABI estavel em C fica em cancelador.h. */
+
+#ifndef CANCELADOR_HPP
+#define CANCELADOR_HPP
+
+/*****************************************************************************/
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "nlms.h"
+
+/*****************************************************************************/
+
+namespace aec
+{
+
+/* Ponteiro e tamanho, como o std::span do C++20 */
+template <class T>
+class Span
+{
+
+public:
+
+    Span() : m_pData(nullptr), m_lSize(0) {}
+
+    Span(T * pData, std::size_t lSize) : m_pData(pData), m_lSize(lSize) {}
+
+    template <std::size_t N>
+    Span(T (&aData)[N]) : m_pData(aData), m_lSize(N) {}
+
+    /* Qualquer conteiner contiguo com data() e size() */
+    template <class C, class = typename std::enable_if<
+                           std::is_convertible<decltype(std::declval<C &>().data()), T *>::value>::type>
+    Span(C && oContainer) : m_pData(oContainer.data()), m_lSize(oContainer.size()) {}
+
+    T * data() const { return m_pData; }
+
+    std::size_t size() const { return m_lSize; }
+
+private:
+
+    T * m_pData;
+
+    std::size_t m_lSize;
+
+};
+
+/*****************************************************************************/
+
+enum class Accumulator
+{
+    Float = NLMS_ACC_FLOAT, /* Comportamento original */
+    Double = NLMS_ACC_DOUBLE,
+    Kahan = NLMS_ACC_KAHAN /* float com soma compensada */
+};
+
+/* Os padroes sao os das portas do plugin */
+struct Config
+{
+
+    float m_fEchoMs = 150; /* Tamanho do filtro, ate NLMS_MAX_ECO_MS */
+
+    float m_fDtdMs = 10; /* Comprimento do DTD, ate NLMS_MAX_DTD_MS */
+
+    float m_fDtdThreshold = 0.5f;
+
+    float m_fMu = 0.5f;
+
+    float m_fSetThresholdDb = -90;
+
+    Accumulator m_eAccumulator = Accumulator::Float;
+
+};
+
+struct Stats
+{
+
+    unsigned long long m_ullFrames = 0;
+
+    unsigned long long m_ullUpdates = 0; /* Amostras em que o filtro adaptou */
+
+    double m_dPowerD = 0; /* sum d^2 */
+
+    double m_dPowerE = 0; /* sum e^2 */
+
+    float m_fDncr = 0; /* Estatistica do DTD na ultima amostra */
+
+    unsigned long m_lTaps = 0; /* Coeficientes em uso */
+
+    /* 10 log10(sum d^2 / sum e^2), como a porta de ERLE */
+    double erleDb() const
+    {
+        return m_dPowerE > 0 && m_dPowerD > 0 ? 10 * std::log10(m_dPowerD / m_dPowerE) : 0;
+    }
+
+};
+
+/*****************************************************************************/
+
+class EchoCanceller
+{
+
+public:
+
+    /* Bytes de memoria de trabalho para uma taxa de amostragem */
+    static std::size_t memorySize(unsigned long lSampleRate)
+    {
+        return nlmsMemory(lSampleRate);
+    }
+
+    /* Aloca a memoria de trabalho (so aqui) */
+    explicit EchoCanceller(unsigned long lSampleRate, const Config & sConfig = Config())
+        : m_pvOwned(std::calloc(1, memorySize(lSampleRate)))
+    {
+        if (m_pvOwned == nullptr)
+            throw std::bad_alloc();
+        start(lSampleRate, m_pvOwned, sConfig);
+    }
+
+    /* Usa pvMemory (lSize >= memorySize() bytes, alinhados para float),
+       que tem que viver mais que o cancelador */
+    EchoCanceller(unsigned long lSampleRate, const Config & sConfig, void * pvMemory, std::size_t lSize)
+        : m_pvOwned(nullptr)
+    {
+        if (pvMemory == nullptr || lSize < memorySize(lSampleRate) || reinterpret_cast<std::size_t>(pvMemory) % alignof(float) != 0)
+            throw std::invalid_argument("EchoCanceller: memoria insuficiente ou desalinhada");
+        start(lSampleRate, pvMemory, sConfig);
+    }
+
+    EchoCanceller(const EchoCanceller &) = delete;
+
+    EchoCanceller & operator=(const EchoCanceller &) = delete;
+
+    EchoCanceller(EchoCanceller && oOther) noexcept
+        : m_sState(oOther.m_sState), m_sCore(oOther.m_sCore), m_sConfig(oOther.m_sConfig), m_sTotal(oOther.m_sTotal),
+          m_pvOwned(oOther.m_pvOwned)
+    {
+        oOther.m_pvOwned = nullptr;
+        oOther.m_sState.m_pfBufferX = nullptr;
+    }
+
+    EchoCanceller & operator=(EchoCanceller && oOther) noexcept
+    {
+        if (this != &oOther)
+        {
+            std::free(m_pvOwned);
+            m_sState = oOther.m_sState;
+            m_sCore = oOther.m_sCore;
+            m_sConfig = oOther.m_sConfig;
+            m_sTotal = oOther.m_sTotal;
+            m_pvOwned = oOther.m_pvOwned;
+            oOther.m_pvOwned = nullptr;
+            oOther.m_sState.m_pfBufferX = nullptr;
+        }
+        return *this;
+    }
+
+    ~EchoCanceller()
+    {
+        std::free(m_pvOwned);
+    }
+
+    /* Vale a partir da proxima chamada de process() */
+    void configure(const Config & sConfig)
+    {
+        m_sConfig = sConfig;
+        m_sCore.m_fEchoMs = sConfig.m_fEchoMs;
+        m_sCore.m_fDtdMs = sConfig.m_fDtdMs;
+        m_sCore.m_fDtdThreshold = sConfig.m_fDtdThreshold;
+        m_sCore.m_fMu = sConfig.m_fMu;
+        m_sCore.m_fSetThresholdDb = sConfig.m_fSetThresholdDb;
+        m_sCore.m_iAccumulator = static_cast<int>(sConfig.m_eAccumulator);
+    }
+
+    const Config & config() const { return m_sConfig; }
+
+    unsigned long sampleRate() const { return static_cast<unsigned long>(m_sState.m_fSampleRate); }
+
+    /* Zera o filtro e as medidas somadas */
+    void reset()
+    {
+        nlmsReset(&m_sState);
+        m_sTotal = Stats();
+    }
+
+    /* e(n) = d(n) - w(n)*x(n) sobre mic (d) e ref (x) */
+    Stats process(Span<const float> oMic, Span<const float> oRef, Span<float> oOut)
+    {
+
+        NlmsStats sCore;
+        Stats sStats;
+
+        if (oRef.size() != oMic.size() || oOut.size() != oMic.size())
+            throw std::invalid_argument("EchoCanceller::process: spans de tamanhos diferentes");
+        if (m_sState.m_pfBufferX == nullptr)
+            throw std::logic_error("EchoCanceller::process: cancelador movido");
+
+        nlmsProcess(&m_sState, &m_sCore, oMic.data(), oRef.data(), oOut.data(), oMic.size(), &sCore);
+
+        sStats.m_ullFrames = oMic.size();
+        sStats.m_ullUpdates = sCore.m_lUpdates;
+        sStats.m_dPowerD = sCore.m_fPowerD;
+        sStats.m_dPowerE = sCore.m_fPowerE;
+        sStats.m_fDncr = sCore.m_fDncr;
+        sStats.m_lTaps = sCore.m_lTaps;
+
+        m_sTotal.m_ullFrames += sStats.m_ullFrames;
+        m_sTotal.m_ullUpdates += sStats.m_ullUpdates;
+        m_sTotal.m_dPowerD += sStats.m_dPowerD;
+        m_sTotal.m_dPowerE += sStats.m_dPowerE;
+        m_sTotal.m_fDncr = sStats.m_fDncr;
+        m_sTotal.m_lTaps = sStats.m_lTaps;
+        return sStats;
+    }
+
+    /* Medidas somadas desde o ultimo reset() */
+    const Stats & stats() const { return m_sTotal; }
+
+private:
+
+    void start(unsigned long lSampleRate, void * pvMemory, const Config & sConfig)
+    {
+        nlmsInit(&m_sState, lSampleRate, pvMemory);
+        nlmsReset(&m_sState);
+        configure(sConfig);
+    }
+
+    NlmsState m_sState;
+
+    NlmsConfig m_sCore; /* m_sConfig no formato do nucleo */
+
+    Config m_sConfig;
+
+    Stats m_sTotal;
+
+    void * m_pvOwned; /* Memoria alocada pelo construtor, ou nullptr */
+
+};
+
+} /* namespace aec */
+
+/*****************************************************************************/
+
+#endif /* CANCELADOR_HPP */
+
+/* EOF */
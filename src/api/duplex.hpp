@@ -0,0 +1,292 @@
+/* duplex.hpp
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Cancelador com a referencia e o microfone chegando por threads
+   diferentes, como num servidor de midia: a thread de reproducao chama
+   render() com o que vai tocar, a de captura chama capture() com o que
+   o microfone gravou, e nenhuma das duas trava a outra.
+
+     aec::DuplexCanceller oAec(16000, aec::Config(), 8192, 480);
+     oAec.render(ref, ullPlayPos);                   (reproducao)
+     oAec.capture(mic, ullCapturePos, out);          (captura)
+
+   Os blocos passam por filas SPSC sem espera (anel.hpp) com a marca de
+   tempo de cada bloco, em amostras de um relogio comum as duas threads
+   (o contador de quadros do dispositivo, por exemplo). capture() monta
+   a referencia das mesmas amostras de tempo do microfone e chama
+   EchoCanceller::process(); o atraso acustico fica com o filtro.
+
+   Quando a referencia nao bate com o microfone:
+
+     overrun   render() com a fila cheia (a captura parou): o bloco
+               inteiro e' descartado e render() devolve false
+     underrun  capture() antes da referencia chegar: o que falta vira
+               zero
+     gap       tempo que render() pulou: zero
+     stale     referencia mais velha que o microfone: descartada
+
+   Os contadores (alignment()) sao atomicos e podem ser lidos de
+   qualquer thread. render() e capture() nao alocam nem travam; so o
+   construtor aloca. configure() e' da thread de captura; reset() so com
+   as duas paradas. */
+
+#ifndef DUPLEX_HPP
+#define DUPLEX_HPP
+
+/*****************************************************************************/
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "anel.hpp"
+#include "cancelador.hpp"
+
+/*****************************************************************************/
+
+namespace aec
+{
+
+/* Amostras e blocos de referencia fora de alinhamento */
+struct Alignment
+{
+
+    unsigned long long m_ullOverruns = 0; /* Blocos de render() descartados */
+
+    unsigned long long m_ullDroppedFrames = 0; /* Amostras desses blocos */
+
+    unsigned long long m_ullUnderruns = 0; /* Chamadas de capture() sem referencia */
+
+    unsigned long long m_ullMissingFrames = 0; /* Amostras zeradas nelas */
+
+    unsigned long long m_ullGapFrames = 0; /* Amostras zeradas por tempo pulado */
+
+    unsigned long long m_ullStaleFrames = 0; /* Amostras velhas descartadas */
+
+};
+
+/*****************************************************************************/
+
+class DuplexCanceller
+{
+
+public:
+
+    /* lRingFrames: amostras de referencia em transito (arredondado para
+       potencia de 2); lMaxBlock: maior bloco de capture() */
+    DuplexCanceller(unsigned long lSampleRate, const Config & sConfig, std::size_t lRingFrames, std::size_t lMaxBlock)
+        : m_oCanceller(lSampleRate, sConfig), m_oSamples(check(lRingFrames)), m_oBlocks(lRingFrames),
+          m_pfRef(new float[check(lMaxBlock)]), m_lMaxBlock(lMaxBlock), m_lConsumed(0), m_ullOverruns(0),
+          m_ullDroppedFrames(0), m_ullUnderruns(0), m_ullMissingFrames(0), m_ullGapFrames(0), m_ullStaleFrames(0)
+    {
+    }
+
+    DuplexCanceller(const DuplexCanceller &) = delete;
+
+    DuplexCanceller & operator=(const DuplexCanceller &) = delete;
+
+    /* Thread de reproducao: oRef comeca no tempo ullTimestamp */
+    bool render(Span<const float> oRef, unsigned long long ullTimestamp)
+    {
+
+        Block sBlock;
+
+        if (oRef.size() == 0)
+            return true;
+        if (oRef.size() > m_oSamples.capacity())
+            throw std::invalid_argument("DuplexCanceller::render: bloco maior que a fila");
+
+        /* O cabecalho entra depois das amostras, mas a vaga dele e'
+           conferida antes: so este lado ocupa vagas */
+        sBlock.m_ullTimestamp = ullTimestamp;
+        sBlock.m_lFrames = oRef.size();
+        if (m_oBlocks.space() == 0 || !m_oSamples.push(oRef.data(), oRef.size()))
+        {
+            m_ullOverruns.fetch_add(1, std::memory_order_relaxed);
+            m_ullDroppedFrames.fetch_add(oRef.size(), std::memory_order_relaxed);
+            return false;
+        }
+        m_oBlocks.push(&sBlock, 1);
+        return true;
+    }
+
+    /* Thread de captura: oMic comeca no tempo ullTimestamp; oOut pode
+       ser o proprio mic */
+    Stats capture(Span<const float> oMic, unsigned long long ullTimestamp, Span<float> oOut)
+    {
+
+        unsigned long long ullTime;
+        unsigned long long ullEnd;
+        unsigned long long ullStart;
+        unsigned long long ullStop;
+        std::size_t lPos;
+        std::size_t lCount;
+        std::size_t lFrames;
+
+        if (oMic.size() > m_lMaxBlock)
+            throw std::invalid_argument("DuplexCanceller::capture: bloco maior que lMaxBlock");
+
+        ullTime = ullTimestamp;
+        ullEnd = ullTimestamp + oMic.size();
+        lPos = 0;
+        while (lPos < oMic.size())
+        {
+            if (m_oBlocks.readable() == 0)
+            {
+                /* A referencia ainda nao chegou */
+                lCount = oMic.size() - lPos;
+                std::memset(m_pfRef.get() + lPos, 0, lCount * sizeof(float));
+                m_ullUnderruns.fetch_add(1, std::memory_order_relaxed);
+                m_ullMissingFrames.fetch_add(lCount, std::memory_order_relaxed);
+                break;
+            }
+
+            lFrames = m_oBlocks.at(0).m_lFrames;
+            ullStart = m_oBlocks.at(0).m_ullTimestamp + m_lConsumed;
+            ullStop = m_oBlocks.at(0).m_ullTimestamp + lFrames;
+
+            if (ullStart < ullTime)
+            {
+                /* Referencia mais velha que o microfone */
+                lCount = static_cast<std::size_t>((ullStop < ullTime ? ullStop : ullTime) - ullStart);
+                drop(lCount, lFrames);
+                m_ullStaleFrames.fetch_add(lCount, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (ullStart > ullTime)
+            {
+                /* Tempo sem referencia: render() pulou */
+                lCount = static_cast<std::size_t>((ullStart < ullEnd ? ullStart : ullEnd) - ullTime);
+                std::memset(m_pfRef.get() + lPos, 0, lCount * sizeof(float));
+                m_ullGapFrames.fetch_add(lCount, std::memory_order_relaxed);
+                lPos += lCount;
+                ullTime += lCount;
+                continue;
+            }
+
+            lCount = static_cast<std::size_t>((ullStop < ullEnd ? ullStop : ullEnd) - ullTime);
+            m_oSamples.copyOut(0, m_pfRef.get() + lPos, lCount);
+            drop(lCount, lFrames);
+            lPos += lCount;
+            ullTime += lCount;
+        }
+
+        return m_oCanceller.process(oMic, Span<const float>(m_pfRef.get(), oMic.size()), oOut);
+    }
+
+    /* Contadores de alinhamento, de qualquer thread */
+    Alignment alignment() const
+    {
+
+        Alignment sAlignment;
+
+        sAlignment.m_ullOverruns = m_ullOverruns.load(std::memory_order_relaxed);
+        sAlignment.m_ullDroppedFrames = m_ullDroppedFrames.load(std::memory_order_relaxed);
+        sAlignment.m_ullUnderruns = m_ullUnderruns.load(std::memory_order_relaxed);
+        sAlignment.m_ullMissingFrames = m_ullMissingFrames.load(std::memory_order_relaxed);
+        sAlignment.m_ullGapFrames = m_ullGapFrames.load(std::memory_order_relaxed);
+        sAlignment.m_ullStaleFrames = m_ullStaleFrames.load(std::memory_order_relaxed);
+        return sAlignment;
+    }
+
+    /* Thread de captura */
+    void configure(const Config & sConfig) { m_oCanceller.configure(sConfig); }
+
+    const Config & config() const { return m_oCanceller.config(); }
+
+    unsigned long sampleRate() const { return m_oCanceller.sampleRate(); }
+
+    /* Maior bloco de render() e de capture() */
+    std::size_t ringFrames() const { return m_oSamples.capacity(); }
+
+    std::size_t maxBlock() const { return m_lMaxBlock; }
+
+    /* Medidas do cancelador desde o ultimo reset() (thread de captura) */
+    const Stats & stats() const { return m_oCanceller.stats(); }
+
+    /* Esvazia as filas e zera filtro e contadores; so com render() e
+       capture() parados */
+    void reset()
+    {
+        m_oSamples.clear();
+        m_oBlocks.clear();
+        m_lConsumed = 0;
+        m_oCanceller.reset();
+        m_ullOverruns.store(0, std::memory_order_relaxed);
+        m_ullDroppedFrames.store(0, std::memory_order_relaxed);
+        m_ullUnderruns.store(0, std::memory_order_relaxed);
+        m_ullMissingFrames.store(0, std::memory_order_relaxed);
+        m_ullGapFrames.store(0, std::memory_order_relaxed);
+        m_ullStaleFrames.store(0, std::memory_order_relaxed);
+    }
+
+private:
+
+    struct Block
+    {
+
+        unsigned long long m_ullTimestamp;
+
+        std::size_t m_lFrames;
+
+    };
+
+    static std::size_t check(std::size_t lSize)
+    {
+        if (lSize == 0)
+            throw std::invalid_argument("DuplexCanceller: tamanho zero");
+        return lSize;
+    }
+
+    /* Tira lCount amostras do bloco da frente (lFrames amostras) */
+    void drop(std::size_t lCount, std::size_t lFrames)
+    {
+        m_oSamples.pop(lCount);
+        m_lConsumed += lCount;
+        if (m_lConsumed == lFrames)
+        {
+            m_oBlocks.pop(1);
+            m_lConsumed = 0;
+        }
+    }
+
+    EchoCanceller m_oCanceller;
+
+    SpscRing<float> m_oSamples;
+
+    SpscRing<Block> m_oBlocks;
+
+    std::unique_ptr<float[]> m_pfRef; /* Referencia alinhada de capture() */
+
+    std::size_t m_lMaxBlock;
+
+    std::size_t m_lConsumed; /* Amostras ja lidas do bloco da frente */
+
+    /* Escritos pela reproducao */
+    alignas(64) std::atomic<unsigned long long> m_ullOverruns;
+
+    std::atomic<unsigned long long> m_ullDroppedFrames;
+
+    /* Escritos pela captura */
+    alignas(64) std::atomic<unsigned long long> m_ullUnderruns;
+
+    std::atomic<unsigned long long> m_ullMissingFrames;
+
+    std::atomic<unsigned long long> m_ullGapFrames;
+
+    std::atomic<unsigned long long> m_ullStaleFrames;
+
+};
+
+} /* namespace aec */
+
+/*****************************************************************************/
+
+#endif /* DUPLEX_HPP */
+
+/* EOF */
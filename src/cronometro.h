@@ -0,0 +1,477 @@
+/* cronometro.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Medicao opcional do tempo de cada chamada do run(), pelo contador de
+   ciclos do processador (TSC). So e' compilada com -DAEC_INSTRUMENTAR
+   (make INSTRUMENTAR=1); sem a opcao, TIMING_BEGIN e TIMING_END nao
+   geram codigo e TIMING_CREATE() devolve NULL.
+
+   Por instancia sao guardados:
+     - um histograma com um balde por potencia de dois de ciclos;
+     - o pior caso desde o ultimo reset;
+     - quantas chamadas passaram do prazo, que e' a duracao do bloco
+       (SampleCount / SampleRate) vezes a fracao de orcamento dada pela
+       variavel de ambiente AEC_ORCAMENTO (padrao 1.0).
+
+   Os plugins exportam
+
+       RunTiming * ladspa_timing(LADSPA_Handle Instance);
+
+   (NULL quando compilados sem a opcao). Outra thread le os valores com
+   timingRead() sem travas: os contadores sao atomicos, com um unico
+   escritor (o run()). O reset e' so um pedido; quem zera e' o proprio
+   run() na chamada seguinte.
+
+   Com AEC_PERF=1 no ambiente, o run() tambem le um grupo de contadores
+   de hardware (perf_event_open: ciclos, instrucoes, faltas na L1D e na
+   LLC e ciclos parados no backend) antes e depois do bloco e soma as
+   diferencas numa tabela por tamanho de filtro (PERF_SLOTS entradas; a
+   ultima junta os tamanhos que nao couberem). O grupo e' aberto na
+   thread que chama o run(), na primeira chamada, e reaberto se a
+   thread mudar. Contadores que o processador (ou a maquina virtual)
+   nao tiver ficam em zero e fora de m_iPerfMask. */
+
+#ifndef CRONOMETRO_H
+#define CRONOMETRO_H
+
+/*****************************************************************************/
+
+#define TIMING_BUCKETS 64
+
+#define TIMING_ENV "AEC_ORCAMENTO"
+
+/* Contadores de hardware (indices em m_aullCounts) */
+#define PERF_CYCLES       0
+#define PERF_INSTRUCTIONS 1
+#define PERF_L1D_MISSES   2
+#define PERF_LLC_MISSES   3
+#define PERF_STALLS       4
+#define PERF_COUNTERS     5
+
+#define PERF_SLOTS 8
+
+#define PERF_ENV "AEC_PERF"
+
+/* Soma dos contadores de um tamanho de filtro */
+typedef struct
+{
+
+    unsigned long m_lTaps; /* Coeficientes em uso (0: entrada livre) */
+
+    unsigned long m_lCalls;
+
+    unsigned long m_lSamples;
+
+    unsigned long long m_aullCounts[PERF_COUNTERS];
+
+} PerfSlot;
+
+/* Copia dos valores para o leitor */
+typedef struct
+{
+
+    unsigned long m_alBuckets[TIMING_BUCKETS]; /* Balde k: [2^k, 2^(k+1)) ciclos */
+
+    unsigned long m_lCalls;
+
+    unsigned long m_lMisses; /* Chamadas que passaram do prazo */
+
+    unsigned long long m_ullWorst; /* Pior caso, em ciclos */
+
+    double m_dCyclesPerSecond; /* Frequencia do contador */
+
+    int m_iPerfMask; /* Bit k ligado: contador k foi aberto */
+
+    PerfSlot m_asPerf[PERF_SLOTS];
+
+} TimingSnapshot;
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    atomic_ulong m_alBuckets[TIMING_BUCKETS];
+
+    atomic_ulong m_lCalls;
+
+    atomic_ulong m_lMisses;
+
+    atomic_ullong m_ullWorst;
+
+    atomic_int m_iResetRequest;
+
+    /* So o run() usa */
+    unsigned long long m_ullStart;
+
+    double m_dCyclesPerSample; /* Prazo por amostra, em ciclos */
+
+    double m_dCyclesPerSecond;
+
+    /* Contadores de hardware */
+    struct
+    {
+        atomic_ulong m_lTaps;
+        atomic_ulong m_lCalls;
+        atomic_ulong m_lSamples;
+        atomic_ullong m_aullCounts[PERF_COUNTERS];
+    } m_asPerf[PERF_SLOTS];
+
+    atomic_int m_iPerfMask;
+
+    int m_iPerf; /* AEC_PERF ligado */
+
+    int m_aiPerfFd[PERF_COUNTERS]; /* O primeiro aberto e' o lider do grupo */
+
+    int m_iPerfOpen; /* Quantos abertos, na ordem do read() do grupo */
+
+    int m_iPerfTried; /* perfOpen() ja rodou em m_sPerfThread */
+
+    int m_aiPerfIndex[PERF_COUNTERS]; /* Posicao no read() -> PERF_* */
+
+    pthread_t m_sPerfThread;
+
+    unsigned long long m_aullPerfStart[PERF_COUNTERS + 1];
+
+} RunTiming;
+
+/*****************************************************************************/
+
+static inline unsigned long long timingNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence(); /* Nao deixa o rdtsc passar na frente do codigo anterior */
+    return __rdtsc();
+#else
+    struct timespec sNow;
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return (unsigned long long)sNow.tv_sec * 1000000000ULL + (unsigned long long)sNow.tv_nsec;
+#endif
+}
+
+/*****************************************************************************/
+
+/* Ciclos do contador por segundo. No x86 e' medido uma vez, contra o
+   relogio do sistema, durante 20 ms. */
+static inline double timingFrequency(void)
+{
+
+    static double dFrequency = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    struct timespec sStart;
+    struct timespec sNow;
+    unsigned long long ullStart;
+    double dElapsed;
+
+    if (dFrequency == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &sStart);
+        ullStart = timingNow();
+        do
+        {
+            clock_gettime(CLOCK_MONOTONIC, &sNow);
+            dElapsed = (double)(sNow.tv_sec - sStart.tv_sec) + (double)(sNow.tv_nsec - sStart.tv_nsec) * 1e-9;
+        }
+        while (dElapsed < 0.02);
+        dFrequency = (double)(timingNow() - ullStart) / dElapsed;
+    }
+#else
+    dFrequency = 1e9;
+#endif
+    return dFrequency;
+}
+
+/*****************************************************************************/
+
+static inline void perfClose(RunTiming * psTiming)
+{
+
+    int iCounter;
+
+    for (iCounter = 0; iCounter < PERF_COUNTERS; iCounter++)
+    {
+        if (psTiming->m_aiPerfFd[iCounter] >= 0)
+            close(psTiming->m_aiPerfFd[iCounter]);
+        psTiming->m_aiPerfFd[iCounter] = -1;
+    }
+    psTiming->m_iPerfOpen = 0;
+}
+
+/* Abre o grupo de contadores para a thread atual */
+static inline void perfOpen(RunTiming * psTiming)
+{
+#ifdef __linux__
+    static const unsigned int aiType[PERF_COUNTERS] =
+    {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+    };
+    static const unsigned long long aullConfig[PERF_COUNTERS] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_STALLED_CYCLES_BACKEND
+    };
+    struct perf_event_attr sAttr;
+    int iCounter;
+    int iLeader;
+    int iMask;
+
+    perfClose(psTiming);
+    psTiming->m_sPerfThread = pthread_self();
+    psTiming->m_iPerfTried = 1;
+
+    iLeader = -1;
+    iMask = 0;
+    for (iCounter = 0; iCounter < PERF_COUNTERS; iCounter++)
+    {
+        memset(&sAttr, 0, sizeof(sAttr));
+        sAttr.size = sizeof(sAttr);
+        sAttr.type = aiType[iCounter];
+        sAttr.config = aullConfig[iCounter];
+        sAttr.read_format = PERF_FORMAT_GROUP;
+        sAttr.exclude_kernel = 1; /* Basta perf_event_paranoid <= 2 */
+        sAttr.exclude_hv = 1;
+        sAttr.disabled = iLeader < 0;
+        psTiming->m_aiPerfFd[iCounter] = (int)syscall(SYS_perf_event_open, &sAttr, 0, -1, iLeader, 0);
+        if (psTiming->m_aiPerfFd[iCounter] < 0)
+            continue;
+        if (iLeader < 0)
+            iLeader = psTiming->m_aiPerfFd[iCounter];
+        psTiming->m_aiPerfIndex[psTiming->m_iPerfOpen++] = iCounter;
+        iMask |= 1 << iCounter;
+    }
+
+    if (iLeader >= 0)
+        ioctl(iLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    atomic_store_explicit(&psTiming->m_iPerfMask, iMask, memory_order_relaxed);
+#endif
+}
+
+/* Le o grupo: pullValues[0] e' o numero de contadores, depois os valores */
+static inline int perfRead(RunTiming * psTiming, unsigned long long * pullValues)
+{
+
+    int iLeader;
+
+    iLeader = 0;
+    while (iLeader < PERF_COUNTERS && psTiming->m_aiPerfFd[iLeader] < 0)
+        iLeader++;
+    if (iLeader == PERF_COUNTERS)
+        return 0;
+    return read(psTiming->m_aiPerfFd[iLeader], pullValues, sizeof(unsigned long long) * (PERF_COUNTERS + 1)) > 0;
+}
+
+/* Entrada da tabela para lTaps; a ultima recebe o que nao couber */
+static inline int perfSlot(RunTiming * psTiming, unsigned long lTaps)
+{
+
+    unsigned long lSlotTaps;
+    int iSlot;
+
+    for (iSlot = 0; iSlot < PERF_SLOTS - 1; iSlot++)
+    {
+        lSlotTaps = atomic_load_explicit(&psTiming->m_asPerf[iSlot].m_lTaps, memory_order_relaxed);
+        if (lSlotTaps == lTaps)
+            return iSlot;
+        if (lSlotTaps == 0)
+        {
+            atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_lTaps, lTaps, memory_order_relaxed);
+            return iSlot;
+        }
+    }
+    atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_lTaps, lTaps, memory_order_relaxed);
+    return iSlot;
+}
+
+/*****************************************************************************/
+
+/* Chamado no instantiate(); devolve NULL se faltar memoria */
+static inline RunTiming * timingCreate(unsigned long SampleRate)
+{
+
+    RunTiming * psTiming;
+    const char * pcBudget;
+    double dBudget;
+    int iCounter;
+
+    psTiming = (RunTiming *)calloc(1, sizeof(RunTiming));
+    if (psTiming == NULL)
+        return NULL;
+
+    dBudget = 1.0;
+    pcBudget = getenv(TIMING_ENV);
+    if (pcBudget != NULL && atof(pcBudget) > 0)
+        dBudget = atof(pcBudget);
+
+    psTiming->m_dCyclesPerSecond = timingFrequency();
+    psTiming->m_dCyclesPerSample = psTiming->m_dCyclesPerSecond * dBudget / (double)SampleRate;
+
+    for (iCounter = 0; iCounter < PERF_COUNTERS; iCounter++)
+        psTiming->m_aiPerfFd[iCounter] = -1;
+    psTiming->m_iPerf = getenv(PERF_ENV) != NULL && atoi(getenv(PERF_ENV)) > 0;
+    return psTiming;
+}
+
+/*****************************************************************************/
+
+/* Chamado no cleanup() */
+static inline void timingDestroy(RunTiming * psTiming)
+{
+    if (psTiming == NULL)
+        return;
+    perfClose(psTiming);
+    free(psTiming);
+}
+
+/*****************************************************************************/
+
+static inline void timingBegin(RunTiming * psTiming)
+{
+    if (psTiming->m_iPerf)
+    {
+        if (!psTiming->m_iPerfTried || !pthread_equal(psTiming->m_sPerfThread, pthread_self()))
+            perfOpen(psTiming);
+        if (!perfRead(psTiming, psTiming->m_aullPerfStart))
+            psTiming->m_aullPerfStart[0] = 0;
+    }
+    psTiming->m_ullStart = timingNow();
+}
+
+/* Incremento sem instrucao com lock: o run() e' o unico escritor */
+#define TIMING_BUMP(a) \
+atomic_store_explicit(&(a), atomic_load_explicit(&(a), memory_order_relaxed) + 1, memory_order_relaxed)
+
+static inline void timingEnd(RunTiming * psTiming, unsigned long SampleCount, unsigned long lTaps)
+{
+
+    unsigned long long aullPerfEnd[PERF_COUNTERS + 1];
+    atomic_ullong * pullCount;
+    unsigned long long ullCycles;
+    int iBucket;
+    int iSlot;
+    int iValue;
+
+    ullCycles = timingNow() - psTiming->m_ullStart;
+    if (psTiming->m_iPerf && psTiming->m_aullPerfStart[0] != 0 && !perfRead(psTiming, aullPerfEnd))
+        psTiming->m_aullPerfStart[0] = 0;
+
+    if (atomic_load_explicit(&psTiming->m_iResetRequest, memory_order_acquire))
+    {
+        for (iBucket = 0; iBucket < TIMING_BUCKETS; iBucket++)
+            atomic_store_explicit(&psTiming->m_alBuckets[iBucket], 0, memory_order_relaxed);
+        atomic_store_explicit(&psTiming->m_lCalls, 0, memory_order_relaxed);
+        atomic_store_explicit(&psTiming->m_lMisses, 0, memory_order_relaxed);
+        atomic_store_explicit(&psTiming->m_ullWorst, 0, memory_order_relaxed);
+        for (iSlot = 0; iSlot < PERF_SLOTS; iSlot++)
+        {
+            atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_lTaps, 0, memory_order_relaxed);
+            atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_lCalls, 0, memory_order_relaxed);
+            atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_lSamples, 0, memory_order_relaxed);
+            for (iValue = 0; iValue < PERF_COUNTERS; iValue++)
+                atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_aullCounts[iValue], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&psTiming->m_iResetRequest, 0, memory_order_release);
+    }
+
+    iBucket = ullCycles ? 63 - __builtin_clzll(ullCycles) : 0;
+    TIMING_BUMP(psTiming->m_alBuckets[iBucket]);
+    TIMING_BUMP(psTiming->m_lCalls);
+    if ((double)ullCycles > (double)SampleCount * psTiming->m_dCyclesPerSample)
+        TIMING_BUMP(psTiming->m_lMisses);
+    if (ullCycles > atomic_load_explicit(&psTiming->m_ullWorst, memory_order_relaxed))
+        atomic_store_explicit(&psTiming->m_ullWorst, ullCycles, memory_order_relaxed);
+
+    if (psTiming->m_iPerf && psTiming->m_aullPerfStart[0] != 0)
+    {
+        iSlot = perfSlot(psTiming, lTaps);
+        TIMING_BUMP(psTiming->m_asPerf[iSlot].m_lCalls);
+        atomic_store_explicit(&psTiming->m_asPerf[iSlot].m_lSamples, atomic_load_explicit(&psTiming->m_asPerf[iSlot].m_lSamples, memory_order_relaxed) + SampleCount, memory_order_relaxed);
+        for (iValue = 0; iValue < psTiming->m_iPerfOpen && iValue < (int)psTiming->m_aullPerfStart[0]; iValue++)
+        {
+            pullCount = &psTiming->m_asPerf[iSlot].m_aullCounts[psTiming->m_aiPerfIndex[iValue]];
+            atomic_store_explicit(pullCount, atomic_load_explicit(pullCount, memory_order_relaxed) + aullPerfEnd[iValue + 1] - psTiming->m_aullPerfStart[iValue + 1], memory_order_relaxed);
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/* Lado do leitor: copia os contadores (cada um e' consistente, o conjunto
+   pode estar defasado de uma chamada) */
+static inline void timingRead(RunTiming * psTiming, TimingSnapshot * psSnapshot)
+{
+
+    int iBucket;
+    int iSlot;
+    int iValue;
+
+    for (iBucket = 0; iBucket < TIMING_BUCKETS; iBucket++)
+        psSnapshot->m_alBuckets[iBucket] = atomic_load_explicit(&psTiming->m_alBuckets[iBucket], memory_order_relaxed);
+    psSnapshot->m_lCalls = atomic_load_explicit(&psTiming->m_lCalls, memory_order_relaxed);
+    psSnapshot->m_lMisses = atomic_load_explicit(&psTiming->m_lMisses, memory_order_relaxed);
+    psSnapshot->m_ullWorst = atomic_load_explicit(&psTiming->m_ullWorst, memory_order_relaxed);
+    psSnapshot->m_dCyclesPerSecond = psTiming->m_dCyclesPerSecond;
+    psSnapshot->m_iPerfMask = atomic_load_explicit(&psTiming->m_iPerfMask, memory_order_relaxed);
+    for (iSlot = 0; iSlot < PERF_SLOTS; iSlot++)
+    {
+        psSnapshot->m_asPerf[iSlot].m_lTaps = atomic_load_explicit(&psTiming->m_asPerf[iSlot].m_lTaps, memory_order_relaxed);
+        psSnapshot->m_asPerf[iSlot].m_lCalls = atomic_load_explicit(&psTiming->m_asPerf[iSlot].m_lCalls, memory_order_relaxed);
+        psSnapshot->m_asPerf[iSlot].m_lSamples = atomic_load_explicit(&psTiming->m_asPerf[iSlot].m_lSamples, memory_order_relaxed);
+        for (iValue = 0; iValue < PERF_COUNTERS; iValue++)
+            psSnapshot->m_asPerf[iSlot].m_aullCounts[iValue] = atomic_load_explicit(&psTiming->m_asPerf[iSlot].m_aullCounts[iValue], memory_order_relaxed);
+    }
+}
+
+/* Pede que o run() zere os contadores na proxima chamada */
+static inline void timingReset(RunTiming * psTiming)
+{
+    atomic_store_explicit(&psTiming->m_iResetRequest, 1, memory_order_release);
+}
+
+/*****************************************************************************/
+
+/* Pontos de medicao usados pelos plugins. O leitor (acima) existe sempre,
+   para que um host sem a opcao consiga ler um plugin instrumentado. */
+
+#ifdef AEC_INSTRUMENTAR
+
+#define TIMING_CREATE(SampleRate) timingCreate(SampleRate)
+#define TIMING_DESTROY(psTiming) timingDestroy(psTiming)
+#define TIMING_BEGIN(psTiming) timingBegin(psTiming)
+#define TIMING_END(psTiming, SampleCount, lTaps) timingEnd((psTiming), (SampleCount), (lTaps))
+
+#else
+
+#define TIMING_CREATE(SampleRate) ((RunTiming *)NULL)
+#define TIMING_DESTROY(psTiming) ((void)0)
+#define TIMING_BEGIN(psTiming) ((void)0)
+#define TIMING_END(psTiming, SampleCount, lTaps) ((void)0)
+
+#endif /* AEC_INSTRUMENTAR */
+
+/*****************************************************************************/
+
+#endif /* CRONOMETRO_H */
+
+/* EOF */
@@ -0,0 +1,291 @@
+/* fft.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   FFT real de tamanho potencia de dois, usada pelos plugins que fazem
+   convolucao no dominio da frequencia. O espectro fica em formato
+   separado (partes reais e imaginarias em vetores distintos, N/2+1
+   bins), o que deixa os produtos complexos do filtro particionado
+   facilmente vetorizaveis pelo compilador.
+
+   Todas as alocacoes acontecem em createFFTPlan(); as transformadas nao
+   alocam memoria e podem ser chamadas de dentro do run(). */
+
+#ifndef FFT_H
+#define FFT_H
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    /* Tamanho da transformada real (N) e da complexa interna (N/2) */
+    unsigned long m_lSize;
+    unsigned long m_lHalf;
+
+    /* Tabela de inversao de bits para a FFT complexa de N/2 pontos */
+    unsigned long * m_plBitRev;
+
+    /* Fatores de giro da FFT complexa (meia volta, N/4 + 1 valores) */
+    float * m_pfTwCos;
+    float * m_pfTwSin;
+
+    /* Fatores de giro da separacao par/impar da FFT real (N/2 valores) */
+    float * m_pfSplitCos;
+    float * m_pfSplitSin;
+
+    /* Area de trabalho complexa de N/2 pontos */
+    float * m_pfWorkRe;
+    float * m_pfWorkIm;
+
+} FFTPlan;
+
+/*****************************************************************************/
+
+/* Libera um plano criado por createFFTPlan() */
+static void destroyFFTPlan(FFTPlan * pPlan)
+{
+    if (pPlan == NULL)
+        return;
+
+    free(pPlan->m_plBitRev);
+    free(pPlan->m_pfTwCos);
+    free(pPlan->m_pfTwSin);
+    free(pPlan->m_pfSplitCos);
+    free(pPlan->m_pfSplitSin);
+    free(pPlan->m_pfWorkRe);
+    free(pPlan->m_pfWorkIm);
+    free(pPlan);
+}
+
+/*****************************************************************************/
+
+/* Cria o plano para uma FFT real de lSize pontos (potencia de 2, >= 4).
+   Devolve NULL se faltar memoria. */
+static FFTPlan * createFFTPlan(unsigned long lSize)
+{
+
+    FFTPlan * pPlan;
+    unsigned long lHalf;
+    unsigned long lBits;
+    unsigned long lIndex;
+    unsigned long lRev;
+    unsigned long lBit;
+
+    pPlan = (FFTPlan *)calloc(1, sizeof(FFTPlan));
+    if (pPlan == NULL)
+        return NULL;
+
+    lHalf = lSize / 2;
+    pPlan->m_lSize = lSize;
+    pPlan->m_lHalf = lHalf;
+
+    pPlan->m_plBitRev   = (unsigned long *)calloc(lHalf, sizeof(unsigned long));
+    pPlan->m_pfTwCos    = (float *)calloc(lHalf / 2 + 1, sizeof(float));
+    pPlan->m_pfTwSin    = (float *)calloc(lHalf / 2 + 1, sizeof(float));
+    pPlan->m_pfSplitCos = (float *)calloc(lHalf + 1, sizeof(float));
+    pPlan->m_pfSplitSin = (float *)calloc(lHalf + 1, sizeof(float));
+    pPlan->m_pfWorkRe   = (float *)calloc(lHalf, sizeof(float));
+    pPlan->m_pfWorkIm   = (float *)calloc(lHalf, sizeof(float));
+
+    if (pPlan->m_plBitRev == NULL || pPlan->m_pfTwCos == NULL || pPlan->m_pfTwSin == NULL || pPlan->m_pfSplitCos == NULL || pPlan->m_pfSplitSin == NULL || pPlan->m_pfWorkRe == NULL || pPlan->m_pfWorkIm == NULL)
+    {
+        destroyFFTPlan(pPlan);
+        return NULL;
+    }
+
+    lBits = 0;
+    while ((1UL << lBits) < lHalf)
+        lBits++;
+
+    for (lIndex = 0; lIndex < lHalf; lIndex++)
+    {
+        lRev = 0;
+        for (lBit = 0; lBit < lBits; lBit++)
+            if (lIndex & (1UL << lBit))
+                lRev |= 1UL << (lBits - 1 - lBit);
+        pPlan->m_plBitRev[lIndex] = lRev;
+    }
+
+    /* Os fatores sao calculados em double para nao acumular erro em FFTs longas */
+    for (lIndex = 0; lIndex <= lHalf / 2; lIndex++)
+    {
+        pPlan->m_pfTwCos[lIndex] = (float)cos(2.0 * M_PI * (double)lIndex / (double)lHalf);
+        pPlan->m_pfTwSin[lIndex] = (float)-sin(2.0 * M_PI * (double)lIndex / (double)lHalf);
+    }
+
+    for (lIndex = 0; lIndex <= lHalf; lIndex++)
+    {
+        pPlan->m_pfSplitCos[lIndex] = (float)cos(2.0 * M_PI * (double)lIndex / (double)lSize);
+        pPlan->m_pfSplitSin[lIndex] = (float)-sin(2.0 * M_PI * (double)lIndex / (double)lSize);
+    }
+
+    return pPlan;
+}
+
+/*****************************************************************************/
+
+/* FFT complexa in-place de m_lHalf pontos sobre a area de trabalho.
+   iInverse != 0 calcula a transformada inversa (sem o fator 1/N). */
+static void fftComplexWork(FFTPlan * pPlan, int iInverse)
+{
+
+    float * pfRe;
+    float * pfIm;
+    float fTmp;
+    float fWr;
+    float fWi;
+    float fTr;
+    float fTi;
+    unsigned long lHalf;
+    unsigned long lIndex;
+    unsigned long lRev;
+    unsigned long lSpan;
+    unsigned long lStep;
+    unsigned long lStart;
+    unsigned long lButterfly;
+    unsigned long lA;
+    unsigned long lB;
+
+    pfRe  = pPlan->m_pfWorkRe;
+    pfIm  = pPlan->m_pfWorkIm;
+    lHalf = pPlan->m_lHalf;
+
+    for (lIndex = 0; lIndex < lHalf; lIndex++)
+    {
+        lRev = pPlan->m_plBitRev[lIndex];
+        if (lRev > lIndex)
+        {
+            fTmp = pfRe[lIndex]; pfRe[lIndex] = pfRe[lRev]; pfRe[lRev] = fTmp;
+            fTmp = pfIm[lIndex]; pfIm[lIndex] = pfIm[lRev]; pfIm[lRev] = fTmp;
+        }
+    }
+
+    for (lSpan = 1; lSpan < lHalf; lSpan <<= 1)
+    {
+        lStep = lHalf / (2 * lSpan); /* Passo na tabela de fatores de giro */
+        for (lStart = 0; lStart < lHalf; lStart += 2 * lSpan)
+        {
+            for (lButterfly = 0; lButterfly < lSpan; lButterfly++)
+            {
+                lA  = lStart + lButterfly;
+                lB  = lA + lSpan;
+                fWr = pPlan->m_pfTwCos[lButterfly * lStep];
+                fWi = pPlan->m_pfTwSin[lButterfly * lStep];
+                if (iInverse)
+                    fWi = -fWi;
+                fTr = fWr * pfRe[lB] - fWi * pfIm[lB];
+                fTi = fWr * pfIm[lB] + fWi * pfRe[lB];
+                pfRe[lB] = pfRe[lA] - fTr;
+                pfIm[lB] = pfIm[lA] - fTi;
+                pfRe[lA] += fTr;
+                pfIm[lA] += fTi;
+            }
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/* FFT direta de pfInput (m_lSize amostras reais). O espectro sai em
+   pfOutRe/pfOutIm com m_lSize/2 + 1 bins. */
+static void fftReal(FFTPlan * pPlan, const float * pfInput, float * pfOutRe, float * pfOutIm)
+{
+
+    unsigned long lHalf;
+    unsigned long lIndex;
+    float fZr;
+    float fZi;
+    float fCr;
+    float fCi;
+    float fEr;
+    float fEi;
+    float fOr;
+    float fOi;
+
+    lHalf = pPlan->m_lHalf;
+
+    /* Amostras pares na parte real, impares na imaginaria */
+    for (lIndex = 0; lIndex < lHalf; lIndex++)
+    {
+        pPlan->m_pfWorkRe[lIndex] = pfInput[2 * lIndex];
+        pPlan->m_pfWorkIm[lIndex] = pfInput[2 * lIndex + 1];
+    }
+
+    fftComplexWork(pPlan, 0);
+
+    /* Separa os espectros das amostras pares e impares e combina */
+    for (lIndex = 0; lIndex <= lHalf; lIndex++)
+    {
+        fZr = pPlan->m_pfWorkRe[lIndex % lHalf];
+        fZi = pPlan->m_pfWorkIm[lIndex % lHalf];
+        fCr =  pPlan->m_pfWorkRe[(lHalf - lIndex) % lHalf];
+        fCi = -pPlan->m_pfWorkIm[(lHalf - lIndex) % lHalf];
+        fEr = 0.5f * (fZr + fCr);
+        fEi = 0.5f * (fZi + fCi);
+        /* (Z - conj(Z[M-k])) / 2i */
+        fOr =  0.5f * (fZi - fCi);
+        fOi = -0.5f * (fZr - fCr);
+        pfOutRe[lIndex] = fEr + pPlan->m_pfSplitCos[lIndex] * fOr - pPlan->m_pfSplitSin[lIndex] * fOi;
+        pfOutIm[lIndex] = fEi + pPlan->m_pfSplitCos[lIndex] * fOi + pPlan->m_pfSplitSin[lIndex] * fOr;
+    }
+}
+
+/*****************************************************************************/
+
+/* FFT inversa do espectro pfInRe/pfInIm (m_lSize/2 + 1 bins) para
+   pfOutput (m_lSize amostras reais), ja com o fator 1/N. */
+static void fftRealInverse(FFTPlan * pPlan, const float * pfInRe, const float * pfInIm, float * pfOutput)
+{
+
+    unsigned long lHalf;
+    unsigned long lIndex;
+    float fCr;
+    float fCi;
+    float fEr;
+    float fEi;
+    float fDr;
+    float fDi;
+    float fOr;
+    float fOi;
+    float fScale;
+
+    lHalf  = pPlan->m_lHalf;
+    fScale = 1.0f / (float)lHalf;
+
+    for (lIndex = 0; lIndex < lHalf; lIndex++)
+    {
+        fCr =  pfInRe[lHalf - lIndex];
+        fCi = -pfInIm[lHalf - lIndex];
+        fEr = 0.5f * (pfInRe[lIndex] + fCr);
+        fEi = 0.5f * (pfInIm[lIndex] + fCi);
+        fDr = 0.5f * (pfInRe[lIndex] - fCr);
+        fDi = 0.5f * (pfInIm[lIndex] - fCi);
+        /* Desfaz o fator de giro: O = D * conj(W) */
+        fOr = pPlan->m_pfSplitCos[lIndex] * fDr + pPlan->m_pfSplitSin[lIndex] * fDi;
+        fOi = pPlan->m_pfSplitCos[lIndex] * fDi - pPlan->m_pfSplitSin[lIndex] * fDr;
+        /* Z = E + i O */
+        pPlan->m_pfWorkRe[lIndex] = fEr - fOi;
+        pPlan->m_pfWorkIm[lIndex] = fEi + fOr;
+    }
+
+    fftComplexWork(pPlan, 1);
+
+    for (lIndex = 0; lIndex < lHalf; lIndex++)
+    {
+        pfOutput[2 * lIndex]     = pPlan->m_pfWorkRe[lIndex] * fScale;
+        pfOutput[2 * lIndex + 1] = pPlan->m_pfWorkIm[lIndex] * fScale;
+    }
+}
+
+/*****************************************************************************/
+
+#endif /* FFT_H */
+
+/* EOF */
@@ -0,0 +1,296 @@
+/* fluxo.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   E/S assincrona de arquivos para as ferramentas de src/tools que
+   processam gravacoes em fluxo (lote -s): leituras e escritas sao
+   enfileiradas e terminam fora de ordem, cada uma com uma etiqueta de
+   quem pediu.
+
+     streamInit()   abre um io_uring com lugar para uDepth operacoes
+     streamRead()   enfileira um pread()
+     streamWrite()  enfileira um pwrite()
+     streamSubmit() entrega ao kernel o que foi enfileirado, sem esperar
+     streamWait()   entrega a proxima operacao terminada (etiqueta e
+                    resultado, como o de pread()/pwrite())
+     streamClose()  fecha o anel
+
+   O io_uring e' usado pelas chamadas de sistema direto (sem liburing).
+   Se o kernel nao tiver (ou o recusar: seccomp, io_uring_disabled), ou
+   com AEC_SEM_URING=1 no ambiente, as operacoes viram pread()/pwrite()
+   sincronos na hora do pedido e streamWait() so devolve os resultados;
+   quem usa nao precisa saber qual dos dois esta rodando (m_iRing < 0 no
+   modo sincrono).
+
+   Quem pede e' que cuida de leituras e escritas curtas (resultado menor
+   que o tamanho pedido): basta pedir o resto. */
+
+#ifndef FLUXO_H
+#define FLUXO_H
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*****************************************************************************/
+
+#define STREAM_MAX_DEPTH 256
+
+#define STREAM_ENV "AEC_SEM_URING"
+
+/* Uma operacao terminada */
+typedef struct
+{
+
+    unsigned long m_lTag;
+
+    long m_lResult;
+
+} StreamDone;
+
+typedef struct
+{
+
+    int m_iRing; /* fd do io_uring, -1 no modo sincrono */
+
+    unsigned int m_uToSubmit; /* Enfileiradas e ainda nao entregues ao kernel */
+
+    unsigned int m_uInFlight; /* Pedidas e ainda nao devolvidas por streamWait() */
+
+    /* Anel de submissao */
+    void * m_pvSqMap;
+    size_t m_lSqMapSize;
+    _Atomic unsigned int * m_puSqHead;
+    _Atomic unsigned int * m_puSqTail;
+    unsigned int m_uSqMask;
+    unsigned int * m_puSqArray;
+    struct io_uring_sqe * m_psSqes;
+    size_t m_lSqesSize;
+
+    /* Anel de resultados */
+    void * m_pvCqMap;
+    size_t m_lCqMapSize;
+    _Atomic unsigned int * m_puCqHead;
+    _Atomic unsigned int * m_puCqTail;
+    unsigned int m_uCqMask;
+    struct io_uring_cqe * m_psCqes;
+
+    /* Modo sincrono: resultados prontos, em fila circular */
+    StreamDone m_asDone[STREAM_MAX_DEPTH];
+    unsigned int m_uDoneHead;
+
+} Stream;
+
+/*****************************************************************************/
+
+/* Abre o anel; sem io_uring, cai no modo sincrono (nunca falha) */
+static inline void streamInit(Stream * psStream, unsigned int uDepth)
+{
+
+    struct io_uring_params sParams;
+    const char * pcEnv;
+    unsigned char * pucSq;
+    unsigned char * pucCq;
+    int iRing;
+
+    memset(psStream, 0, sizeof(Stream));
+    psStream->m_iRing = -1;
+
+    pcEnv = getenv(STREAM_ENV);
+    if (pcEnv != NULL && atoi(pcEnv) != 0)
+        return;
+
+    memset(&sParams, 0, sizeof(sParams));
+    iRing = (int)syscall(__NR_io_uring_setup, uDepth > STREAM_MAX_DEPTH ? STREAM_MAX_DEPTH : uDepth, &sParams);
+    if (iRing < 0)
+        return;
+
+    psStream->m_lSqMapSize = sParams.sq_off.array + sParams.sq_entries * sizeof(unsigned int);
+    psStream->m_lCqMapSize = sParams.cq_off.cqes + sParams.cq_entries * sizeof(struct io_uring_cqe);
+    if (sParams.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (psStream->m_lCqMapSize > psStream->m_lSqMapSize)
+            psStream->m_lSqMapSize = psStream->m_lCqMapSize;
+        psStream->m_lCqMapSize = 0;
+    }
+
+    psStream->m_pvSqMap = mmap(NULL, psStream->m_lSqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               iRing, IORING_OFF_SQ_RING);
+    psStream->m_pvCqMap = psStream->m_lCqMapSize == 0 ? psStream->m_pvSqMap
+                        : mmap(NULL, psStream->m_lCqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               iRing, IORING_OFF_CQ_RING);
+    psStream->m_lSqesSize = sParams.sq_entries * sizeof(struct io_uring_sqe);
+    psStream->m_psSqes = (struct io_uring_sqe *)mmap(NULL, psStream->m_lSqesSize, PROT_READ | PROT_WRITE,
+                                                     MAP_SHARED | MAP_POPULATE, iRing, IORING_OFF_SQES);
+    if (psStream->m_pvSqMap == MAP_FAILED || psStream->m_pvCqMap == MAP_FAILED || psStream->m_psSqes == MAP_FAILED)
+    {
+        if (psStream->m_pvSqMap != MAP_FAILED)
+            munmap(psStream->m_pvSqMap, psStream->m_lSqMapSize);
+        if (psStream->m_lCqMapSize != 0 && psStream->m_pvCqMap != MAP_FAILED)
+            munmap(psStream->m_pvCqMap, psStream->m_lCqMapSize);
+        if (psStream->m_psSqes != MAP_FAILED)
+            munmap(psStream->m_psSqes, psStream->m_lSqesSize);
+        close(iRing);
+        memset(psStream, 0, sizeof(Stream));
+        psStream->m_iRing = -1;
+        return;
+    }
+
+    pucSq = (unsigned char *)psStream->m_pvSqMap;
+    psStream->m_puSqHead = (_Atomic unsigned int *)(pucSq + sParams.sq_off.head);
+    psStream->m_puSqTail = (_Atomic unsigned int *)(pucSq + sParams.sq_off.tail);
+    psStream->m_uSqMask = *(unsigned int *)(pucSq + sParams.sq_off.ring_mask);
+    psStream->m_puSqArray = (unsigned int *)(pucSq + sParams.sq_off.array);
+
+    pucCq = (unsigned char *)psStream->m_pvCqMap;
+    psStream->m_puCqHead = (_Atomic unsigned int *)(pucCq + sParams.cq_off.head);
+    psStream->m_puCqTail = (_Atomic unsigned int *)(pucCq + sParams.cq_off.tail);
+    psStream->m_uCqMask = *(unsigned int *)(pucCq + sParams.cq_off.ring_mask);
+    psStream->m_psCqes = (struct io_uring_cqe *)(pucCq + sParams.cq_off.cqes);
+
+    psStream->m_iRing = iRing;
+}
+
+static inline void streamClose(Stream * psStream)
+{
+    if (psStream->m_iRing >= 0)
+    {
+        munmap(psStream->m_psSqes, psStream->m_lSqesSize);
+        if (psStream->m_lCqMapSize != 0)
+            munmap(psStream->m_pvCqMap, psStream->m_lCqMapSize);
+        munmap(psStream->m_pvSqMap, psStream->m_lSqMapSize);
+        close(psStream->m_iRing);
+    }
+    memset(psStream, 0, sizeof(Stream));
+    psStream->m_iRing = -1;
+}
+
+/*****************************************************************************/
+
+/* Entrega ao kernel o que foi enfileirado; com uWait, espera ao menos
+   uma operacao terminar */
+static inline int streamEnter(Stream * psStream, unsigned int uWait)
+{
+
+    long lDone;
+
+    for (;;)
+    {
+        lDone = syscall(__NR_io_uring_enter, psStream->m_iRing, psStream->m_uToSubmit, uWait,
+                        uWait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (lDone >= 0)
+        {
+            psStream->m_uToSubmit -= (unsigned int)lDone;
+            return 1;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            return 0;
+    }
+}
+
+static inline void streamQueue(Stream * psStream, int iOp, int iFd, void * pvBuffer, unsigned int uLength,
+                               unsigned long long ullOffset, unsigned long lTag)
+{
+
+    struct io_uring_sqe * psSqe;
+    unsigned int uTail;
+    unsigned int uIndex;
+    long lResult;
+
+    psStream->m_uInFlight++;
+
+    if (psStream->m_iRing < 0)
+    {
+        lResult = iOp == IORING_OP_READ ? (long)pread(iFd, pvBuffer, uLength, (off_t)ullOffset)
+                                        : (long)pwrite(iFd, pvBuffer, uLength, (off_t)ullOffset);
+        uIndex = (psStream->m_uDoneHead + psStream->m_uInFlight - 1) % STREAM_MAX_DEPTH;
+        psStream->m_asDone[uIndex].m_lTag = lTag;
+        psStream->m_asDone[uIndex].m_lResult = lResult < 0 ? -errno : lResult;
+        return;
+    }
+
+    /* Anel cheio: entrega o que tem antes */
+    uTail = atomic_load_explicit(psStream->m_puSqTail, memory_order_relaxed);
+    while (uTail - atomic_load_explicit(psStream->m_puSqHead, memory_order_acquire) > psStream->m_uSqMask)
+        streamEnter(psStream, 0);
+
+    uIndex = uTail & psStream->m_uSqMask;
+    psSqe = &psStream->m_psSqes[uIndex];
+    memset(psSqe, 0, sizeof(struct io_uring_sqe));
+    psSqe->opcode = (unsigned char)iOp;
+    psSqe->fd = iFd;
+    psSqe->addr = (unsigned long long)(size_t)pvBuffer;
+    psSqe->len = uLength;
+    psSqe->off = ullOffset;
+    psSqe->user_data = lTag;
+    psStream->m_puSqArray[uIndex] = uIndex;
+    atomic_store_explicit(psStream->m_puSqTail, uTail + 1, memory_order_release);
+    psStream->m_uToSubmit++;
+}
+
+/* Ate STREAM_MAX_DEPTH operacoes pendentes de cada vez */
+static inline void streamRead(Stream * psStream, int iFd, void * pvBuffer, unsigned int uLength,
+                              unsigned long long ullOffset, unsigned long lTag)
+{
+    streamQueue(psStream, IORING_OP_READ, iFd, pvBuffer, uLength, ullOffset, lTag);
+}
+
+static inline void streamWrite(Stream * psStream, int iFd, const void * pvBuffer, unsigned int uLength,
+                               unsigned long long ullOffset, unsigned long lTag)
+{
+    streamQueue(psStream, IORING_OP_WRITE, iFd, (void *)pvBuffer, uLength, ullOffset, lTag);
+}
+
+/* Chame depois de enfileirar um lote de pedidos, para que o kernel
+   comece a trabalhar enquanto o chamador processa */
+static inline void streamSubmit(Stream * psStream)
+{
+    if (psStream->m_iRing >= 0 && psStream->m_uToSubmit != 0)
+        streamEnter(psStream, 0);
+}
+
+/* Espera a proxima operacao terminar. Devolve 0 se nao ha nada
+   pendente ou o io_uring_enter() falhou. */
+static inline int streamWait(Stream * psStream, unsigned long * plTag, long * plResult)
+{
+
+    struct io_uring_cqe * psCqe;
+    unsigned int uHead;
+
+    if (psStream->m_uInFlight == 0)
+        return 0;
+
+    if (psStream->m_iRing < 0)
+    {
+        *plTag = psStream->m_asDone[psStream->m_uDoneHead].m_lTag;
+        *plResult = psStream->m_asDone[psStream->m_uDoneHead].m_lResult;
+        psStream->m_uDoneHead = (psStream->m_uDoneHead + 1) % STREAM_MAX_DEPTH;
+        psStream->m_uInFlight--;
+        return 1;
+    }
+
+    uHead = atomic_load_explicit(psStream->m_puCqHead, memory_order_relaxed);
+    while (uHead == atomic_load_explicit(psStream->m_puCqTail, memory_order_acquire))
+        if (!streamEnter(psStream, 1))
+            return 0;
+    psCqe = &psStream->m_psCqes[uHead & psStream->m_uCqMask];
+    *plTag = (unsigned long)psCqe->user_data;
+    *plResult = psCqe->res;
+    atomic_store_explicit(psStream->m_puCqHead, uHead + 1, memory_order_release);
+    psStream->m_uInFlight--;
+    return 1;
+}
+
+/*****************************************************************************/
+
+#endif /* FLUXO_H */
+
+/* EOF */
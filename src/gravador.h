@@ -0,0 +1,441 @@
+/* gravador.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Gravador de sinais ("AEC dump") por instancia: x(n), d(n) e e(n) de
+   cada bloco, os valores das portas de controle de entrada e o estado
+   interno publicado nas portas de medicao, do jeito que o cancelador
+   viu. Serve para reproduzir depois (tools/replay) um eco que so
+   aparece no cliente.
+
+   O run() so copia o bloco para uma fila circular de bytes, sem travas;
+   uma thread de fundo esvazia a fila no arquivo. Se o disco atrasar e a
+   fila encher, o bloco e' descartado e contado no registro seguinte: o
+   run() nunca espera. Com o gravador desligado o custo e' uma leitura
+   atomica por chamada.
+
+   Liga-se de duas formas:
+     - AEC_DUMP=<diretorio> no ambiente grava toda instancia desde o
+       instantiate() em <diretorio>/<label>-<pid>-<n>.aecdump;
+     - o host chama, de qualquer thread que nao seja a de audio,
+
+           int ladspa_dump(LADSPA_Handle Instance, const char * pcPath);
+
+       com um caminho para comecar (fecha a gravacao anterior) ou NULL
+       para parar. Devolve 0, ou -1 se o arquivo nao abriu.
+
+   Formato (ordem de bytes da maquina): um DumpFileHeader e depois, por
+   bloco, um DumpBlockHeader seguido de m_uControls floats com os
+   controles, de m_uSamples floats de x, de d e de e, nessa ordem, e das
+   decisoes do DTD, um bit por amostra em (m_uSamples + 7) / 8 bytes: o
+   bit (n & 7) do byte n / 8 e' 1 se o DTD declarou fala dupla na
+   amostra n do bloco (coeficientes congelados). O run() marca cada
+   decisao com dumpDtd(); plugins sem DTD deixam tudo em zero. A versao 1
+   nao tinha os bits. */
+
+#ifndef GRAVADOR_H
+#define GRAVADOR_H
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ladspa.h"
+
+/*****************************************************************************/
+
+#define DUMP_ENV "AEC_DUMP"
+
+#define DUMP_MAGIC "AECDUMP1"
+#define DUMP_VERSION 2
+#define DUMP_BLOCK_MAGIC 0x42434541u /* "AECB" */
+
+/* Bytes na fila (potencia de 2): uns 3 s de folga para blocos de 48 kHz */
+#define DUMP_RING_BYTES (1UL << 21)
+
+/* Portas de controle guardadas (as primeiras portas de todos os plugins) */
+#define DUMP_MAX_CONTROLS 16
+
+/* Espera da thread de fundo quando a fila esta vazia */
+#define DUMP_IDLE_NS 5000000L
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    char m_acMagic[8]; /* DUMP_MAGIC */
+
+    uint32_t m_uVersion;
+
+    uint32_t m_uSampleRate;
+
+    uint32_t m_uEngine; /* UniqueID do descritor */
+
+    uint32_t m_uControls; /* Controles por bloco */
+
+    char m_acLabel[32]; /* Label do descritor */
+
+} DumpFileHeader;
+
+typedef struct
+{
+
+    uint32_t m_uMagic; /* DUMP_BLOCK_MAGIC */
+
+    uint32_t m_uSamples;
+
+    uint64_t m_ullBlock; /* Numero do bloco desde o inicio da gravacao */
+
+    uint32_t m_uDropped; /* Blocos descartados logo antes deste */
+
+    uint32_t m_uUpdates; /* Amostras em que os coeficientes mudaram */
+
+    float m_fDtd; /* Estatistica do DTD na ultima amostra */
+
+    float m_fAlpha; /* Fator da nao linearidade (1 nos lineares) */
+
+    float m_fPotD; /* Energia de d(n) no bloco */
+
+    float m_fPotE; /* Energia de e(n) no bloco */
+
+} DumpBlockHeader;
+
+/*****************************************************************************/
+
+/* Uma gravacao em andamento: fila e thread de fundo */
+typedef struct
+{
+
+    unsigned char * m_pucRing;
+
+    _Alignas(64) atomic_ulong m_lWrite; /* So o run() escreve */
+
+    _Alignas(64) atomic_ulong m_lRead; /* So a thread de fundo escreve */
+
+    atomic_int m_iRunning;
+
+    FILE * m_psFile;
+
+    pthread_t m_sThread;
+
+} DumpWriter;
+
+/* Estado do gravador na instancia */
+typedef struct
+{
+
+    _Atomic(DumpWriter *) m_psActive; /* NULL: desligado */
+
+    atomic_int m_iBusy; /* O run() esta usando m_psActive */
+
+    LADSPA_Data * m_apfControls[DUMP_MAX_CONTROLS];
+
+    unsigned long m_lControls;
+
+    unsigned long m_lEngine;
+
+    unsigned long m_lSampleRate;
+
+    char m_acLabel[32];
+
+    /* So o run() usa */
+    DumpWriter * m_psCurrent; /* Gravacao do bloco atual, entre dumpBegin e dumpEnd */
+
+    unsigned long m_lRecord; /* Inicio do registro do bloco na fila */
+
+    unsigned long m_lDecisions; /* Inicio dos bits do DTD na fila */
+
+    unsigned long m_lSamples;
+
+    unsigned long m_lBlock;
+
+    unsigned long m_lDropped;
+
+} DumpState;
+
+/*****************************************************************************/
+
+/* Bytes dos bits do DTD de um bloco de lSamples amostras */
+static inline unsigned long dumpDecisionBytes(unsigned long lSamples)
+{
+    return (lSamples + 7) / 8;
+}
+
+/* Copia lBytes para a fila a partir da posicao lPos (ja reservada) */
+static inline void dumpPut(DumpWriter * psWriter, unsigned long lPos, const void * pvData, unsigned long lBytes)
+{
+
+    unsigned long lOffset;
+    unsigned long lFirst;
+
+    lOffset = lPos & (DUMP_RING_BYTES - 1);
+    lFirst = DUMP_RING_BYTES - lOffset < lBytes ? DUMP_RING_BYTES - lOffset : lBytes;
+    memcpy(psWriter->m_pucRing + lOffset, pvData, lFirst);
+    memcpy(psWriter->m_pucRing, (const unsigned char *)pvData + lFirst, lBytes - lFirst);
+}
+
+/*****************************************************************************/
+
+/* Thread de fundo: passa a fila para o arquivo ate pararem a gravacao */
+static inline void * dumpThread(void * pvWriter)
+{
+
+    DumpWriter * psWriter;
+    unsigned long lRead;
+    unsigned long lWrite;
+    unsigned long lOffset;
+    unsigned long lBytes;
+    struct timespec sIdle;
+    int iRunning;
+
+    psWriter = (DumpWriter *)pvWriter;
+    sIdle.tv_sec = 0;
+    sIdle.tv_nsec = DUMP_IDLE_NS;
+
+    do
+    {
+        iRunning = atomic_load_explicit(&psWriter->m_iRunning, memory_order_acquire);
+        lRead = atomic_load_explicit(&psWriter->m_lRead, memory_order_relaxed);
+        lWrite = atomic_load_explicit(&psWriter->m_lWrite, memory_order_acquire);
+        if (lWrite == lRead)
+        {
+            if (iRunning)
+                nanosleep(&sIdle, NULL);
+            continue;
+        }
+
+        /* Ate o fim do vetor; o resto fica para a proxima volta */
+        lOffset = lRead & (DUMP_RING_BYTES - 1);
+        lBytes = lWrite - lRead;
+        if (lBytes > DUMP_RING_BYTES - lOffset)
+            lBytes = DUMP_RING_BYTES - lOffset;
+        fwrite(psWriter->m_pucRing + lOffset, 1, lBytes, psWriter->m_psFile);
+        atomic_store_explicit(&psWriter->m_lRead, lRead + lBytes, memory_order_release);
+        iRunning = 1; /* Volta para conferir se ainda ha dados */
+    }
+    while (iRunning);
+
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/* Para a gravacao atual (se houver), esperando o run() largar a fila e a
+   thread de fundo gravar o que faltava */
+static inline void dumpStop(DumpState * psDump)
+{
+
+    DumpWriter * psWriter;
+    struct timespec sWait;
+
+    psWriter = atomic_exchange(&psDump->m_psActive, NULL);
+    if (psWriter == NULL)
+        return;
+
+    sWait.tv_sec = 0;
+    sWait.tv_nsec = 1000000L;
+    while (atomic_load(&psDump->m_iBusy))
+        nanosleep(&sWait, NULL);
+
+    atomic_store_explicit(&psWriter->m_iRunning, 0, memory_order_release);
+    pthread_join(psWriter->m_sThread, NULL);
+    fclose(psWriter->m_psFile);
+    free(psWriter->m_pucRing);
+    free(psWriter);
+}
+
+/* Comeca a gravar em pcPath (para a gravacao anterior); NULL so para */
+static inline int dumpStart(DumpState * psDump, const char * pcPath)
+{
+
+    DumpWriter * psWriter;
+    DumpFileHeader sHeader;
+
+    dumpStop(psDump);
+    if (pcPath == NULL)
+        return 0;
+
+    psWriter = (DumpWriter *)calloc(1, sizeof(DumpWriter));
+    if (psWriter == NULL)
+        return -1;
+    psWriter->m_pucRing = (unsigned char *)malloc(DUMP_RING_BYTES);
+    psWriter->m_psFile = fopen(pcPath, "wb");
+    if (psWriter->m_pucRing == NULL || psWriter->m_psFile == NULL)
+    {
+        if (psWriter->m_psFile != NULL)
+            fclose(psWriter->m_psFile);
+        free(psWriter->m_pucRing);
+        free(psWriter);
+        return -1;
+    }
+
+    memset(&sHeader, 0, sizeof(sHeader));
+    memcpy(sHeader.m_acMagic, DUMP_MAGIC, 8);
+    sHeader.m_uVersion = DUMP_VERSION;
+    sHeader.m_uSampleRate = (uint32_t)psDump->m_lSampleRate;
+    sHeader.m_uEngine = (uint32_t)psDump->m_lEngine;
+    sHeader.m_uControls = (uint32_t)psDump->m_lControls;
+    memcpy(sHeader.m_acLabel, psDump->m_acLabel, sizeof(sHeader.m_acLabel));
+    fwrite(&sHeader, sizeof(sHeader), 1, psWriter->m_psFile);
+
+    atomic_store_explicit(&psWriter->m_iRunning, 1, memory_order_relaxed);
+    if (pthread_create(&psWriter->m_sThread, NULL, dumpThread, psWriter) != 0)
+    {
+        fclose(psWriter->m_psFile);
+        free(psWriter->m_pucRing);
+        free(psWriter);
+        return -1;
+    }
+
+    psDump->m_lBlock = 0;
+    psDump->m_lDropped = 0;
+    atomic_store_explicit(&psDump->m_psActive, psWriter, memory_order_release);
+    return 0;
+}
+
+/*****************************************************************************/
+
+/* Chamado no instantiate(). lControls e' o numero de portas de controle
+   de entrada (as primeiras portas do plugin). */
+static inline void dumpInit(DumpState * psDump, const LADSPA_Descriptor * Descriptor, unsigned long SampleRate, unsigned long lControls)
+{
+
+    static atomic_int iInstance;
+    const char * pcDir;
+    char acPath[4096];
+
+    memset(psDump, 0, sizeof(DumpState));
+    atomic_init(&psDump->m_psActive, NULL);
+    psDump->m_lControls = lControls < DUMP_MAX_CONTROLS ? lControls : DUMP_MAX_CONTROLS;
+    psDump->m_lEngine = Descriptor->UniqueID;
+    psDump->m_lSampleRate = SampleRate;
+    strncpy(psDump->m_acLabel, Descriptor->Label, sizeof(psDump->m_acLabel) - 1);
+
+    pcDir = getenv(DUMP_ENV);
+    if (pcDir != NULL && *pcDir != '\0')
+    {
+        snprintf(acPath, sizeof(acPath), "%s/%s-%d-%d.aecdump", pcDir, Descriptor->Label, (int)getpid(), atomic_fetch_add(&iInstance, 1));
+        if (dumpStart(psDump, acPath) != 0)
+            fprintf(stderr, "%s: nao foi possivel gravar em %s.\n", Descriptor->Label, acPath);
+    }
+}
+
+/* Chamado no connect_port() */
+static inline void dumpConnect(DumpState * psDump, unsigned long Port, LADSPA_Data * DataLocation)
+{
+    if (Port < psDump->m_lControls)
+        psDump->m_apfControls[Port] = DataLocation;
+}
+
+/*****************************************************************************/
+
+/* Inicio do run(): reserva o registro do bloco e copia controles, x e d
+   (antes do processamento, que pode escrever e(n) por cima de d(n)) */
+static inline void dumpBegin(DumpState * psDump, unsigned long SampleCount, const LADSPA_Data * pfInputX, const LADSPA_Data * pfInputD)
+{
+
+    DumpWriter * psWriter;
+    LADSPA_Data afControls[DUMP_MAX_CONTROLS];
+    unsigned long lBytes;
+    unsigned long lWrite;
+    unsigned long lControl;
+    unsigned long lByte;
+
+    psDump->m_psCurrent = NULL;
+    if (atomic_load_explicit(&psDump->m_psActive, memory_order_relaxed) == NULL)
+        return;
+
+    atomic_store(&psDump->m_iBusy, 1);
+    psWriter = atomic_load(&psDump->m_psActive);
+    if (psWriter == NULL)
+    {
+        atomic_store_explicit(&psDump->m_iBusy, 0, memory_order_release);
+        return;
+    }
+
+    lBytes = sizeof(DumpBlockHeader) + (psDump->m_lControls + 3 * SampleCount) * sizeof(LADSPA_Data) + dumpDecisionBytes(SampleCount);
+    lWrite = atomic_load_explicit(&psWriter->m_lWrite, memory_order_relaxed);
+    if (lWrite + lBytes - atomic_load_explicit(&psWriter->m_lRead, memory_order_acquire) > DUMP_RING_BYTES)
+    {
+        psDump->m_lDropped++; /* Disco atrasado: descarta o bloco */
+        psDump->m_lBlock++;
+        atomic_store_explicit(&psDump->m_iBusy, 0, memory_order_release);
+        return;
+    }
+
+    for (lControl = 0; lControl < psDump->m_lControls; lControl++)
+        afControls[lControl] = psDump->m_apfControls[lControl] != NULL ? *psDump->m_apfControls[lControl] : 0;
+
+    lWrite += sizeof(DumpBlockHeader);
+    dumpPut(psWriter, lWrite, afControls, psDump->m_lControls * sizeof(LADSPA_Data));
+    lWrite += psDump->m_lControls * sizeof(LADSPA_Data);
+    dumpPut(psWriter, lWrite, pfInputX, SampleCount * sizeof(LADSPA_Data));
+    lWrite += SampleCount * sizeof(LADSPA_Data);
+    dumpPut(psWriter, lWrite, pfInputD, SampleCount * sizeof(LADSPA_Data));
+
+    /* Bits do DTD comecam em zero; e(n) fica entre d(n) e eles */
+    lWrite += 2 * SampleCount * sizeof(LADSPA_Data);
+    for (lByte = 0; lByte < dumpDecisionBytes(SampleCount); lByte++)
+        psWriter->m_pucRing[(lWrite + lByte) & (DUMP_RING_BYTES - 1)] = 0;
+
+    psDump->m_psCurrent = psWriter;
+    psDump->m_lRecord = atomic_load_explicit(&psWriter->m_lWrite, memory_order_relaxed);
+    psDump->m_lDecisions = lWrite;
+    psDump->m_lSamples = SampleCount;
+}
+
+/* Durante o run(): o DTD declarou fala dupla (iDoubleTalk != 0) na
+   amostra lSample do bloco. Mesmos argumentos de PROBE_DTD. */
+static inline void dumpDtd(DumpState * psDump, int iDoubleTalk, unsigned long lSample)
+{
+    if (psDump->m_psCurrent == NULL || !iDoubleTalk || lSample >= psDump->m_lSamples)
+        return;
+    psDump->m_psCurrent->m_pucRing[(psDump->m_lDecisions + lSample / 8) & (DUMP_RING_BYTES - 1)] |= (unsigned char)(1u << (lSample & 7));
+}
+
+/* Fim do run(): copia e(n) e o estado, e entrega o registro */
+static inline void dumpEnd(DumpState * psDump, const LADSPA_Data * pfOutput, LADSPA_Data fPotD, LADSPA_Data fPotE, unsigned long lUpdates, LADSPA_Data fDtd, LADSPA_Data fAlpha)
+{
+
+    DumpWriter * psWriter;
+    DumpBlockHeader sHeader;
+    unsigned long lBytes;
+
+    psWriter = psDump->m_psCurrent;
+    if (psWriter == NULL)
+        return;
+
+    lBytes = (psDump->m_lControls + 2 * psDump->m_lSamples) * sizeof(LADSPA_Data);
+    dumpPut(psWriter, psDump->m_lRecord + sizeof(DumpBlockHeader) + lBytes, pfOutput, psDump->m_lSamples * sizeof(LADSPA_Data));
+
+    sHeader.m_uMagic = DUMP_BLOCK_MAGIC;
+    sHeader.m_uSamples = (uint32_t)psDump->m_lSamples;
+    sHeader.m_ullBlock = psDump->m_lBlock++;
+    sHeader.m_uDropped = (uint32_t)psDump->m_lDropped;
+    sHeader.m_uUpdates = (uint32_t)lUpdates;
+    sHeader.m_fDtd = fDtd;
+    sHeader.m_fAlpha = fAlpha;
+    sHeader.m_fPotD = fPotD;
+    sHeader.m_fPotE = fPotE;
+    dumpPut(psWriter, psDump->m_lRecord, &sHeader, sizeof(sHeader));
+    psDump->m_lDropped = 0;
+
+    atomic_store_explicit(&psWriter->m_lWrite, psDump->m_lDecisions + dumpDecisionBytes(psDump->m_lSamples), memory_order_release);
+    psDump->m_psCurrent = NULL;
+    atomic_store_explicit(&psDump->m_iBusy, 0, memory_order_release);
+}
+
+/*****************************************************************************/
+
+#endif /* GRAVADOR_H */
+
+/* EOF */
@@ -0,0 +1,637 @@
+/* hospedeiro.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Um host LADSPA minimo para as ferramentas de src/tools, para testar e
+   medir os plugins sem JACK Rack nem outro host externo:
+
+     hostOpen()         dlopen() da biblioteca e ladspa_descriptor()
+     hostFind()         descritor pelo Label (NULL: o primeiro)
+     hostValidate()     confere o descritor e as dicas das portas
+     hostDefault()      valor padrao de uma porta de controle
+     hostExercise()     valor de controle que poe o filtro para trabalhar
+                        nas ferramentas de teste
+     hostFindPort()     porta de controle de entrada pelo nome
+     hostInstantiate()  instancia, aloca um buffer por porta de audio e
+                        conecta todas as portas
+     hostActivate()     activate(), se houver
+     hostReset()        deactivate() e activate(), para reusar a
+                        instancia num sinal novo
+     hostRun()          run(), medindo o tempo se m_iTiming estiver ligado
+     hostCleanup()      deactivate() e cleanup(), e libera os buffers
+     hostBlockSize()    tamanho de bloco aleatorio para exercitar o run()
+     hostNoise()        ruido uniforme em [-0.5, 0.5), sem depender da libc
+     hostSignals()      x(n) e d(n) sinteticos de uma das cenas HOST_SCENE_*
+     hostWriteRir()     grava o caminho de eco das cenas para o rirconv
+
+   Os buffers de hostInstantiate() tem m_lMaxBlock amostras; quem quiser
+   apontar as portas para outro lugar chama connect_port() direto, como
+   um host faria. Erros vao para stderr e as funcoes devolvem 0/NULL. */
+
+#ifndef HOSPEDEIRO_H
+#define HOSPEDEIRO_H
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <dlfcn.h>
+
+#include "ladspa.h"
+
+/*****************************************************************************/
+
+/* Cenas de hostSignals() */
+#define HOST_SCENE_ECHO        0 /* Ruido colorido em x(n), d(n) = eco de 20 ms + ruido */
+#define HOST_SCENE_DOUBLE_TALK 1 /* O mesmo, com um sinal local em d(n) na segunda metade */
+#define HOST_SCENE_SWAP        2 /* O caminho de eco muda (e inverte) na metade do sinal */
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    const LADSPA_Descriptor * m_psDescriptor;
+
+    LADSPA_Handle m_hHandle;
+
+    unsigned long m_lSampleRate;
+
+    unsigned long m_lMaxBlock; /* Tamanho dos buffers de audio */
+
+    LADSPA_Data * m_pfControls; /* Um valor por porta (so as de controle usam) */
+
+    LADSPA_Data ** m_ppfBuffers; /* Um buffer por porta de audio, NULL nas de controle */
+
+    int m_iActive;
+
+    int m_iTiming; /* Mede cada run() em m_dSeconds e m_dWorst */
+
+    unsigned long m_lCalls;
+
+    unsigned long m_lSamples;
+
+    double m_dSeconds;
+
+    double m_dWorst; /* Pior run(), em segundos */
+
+} HostInstance;
+
+/*****************************************************************************/
+
+static inline double hostSeconds(void)
+{
+
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return (double)sNow.tv_sec + (double)sNow.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+
+/* Abre a biblioteca; as bibliotecas nunca sao fechadas, ja que os
+   descritores vivem ate o _fini() */
+static inline LADSPA_Descriptor_Function hostOpen(const char * pcPath)
+{
+
+    void * pvLibrary;
+    LADSPA_Descriptor_Function fDescriptor;
+
+    pvLibrary = dlopen(pcPath, RTLD_NOW);
+    if (pvLibrary == NULL)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        return NULL;
+    }
+
+    fDescriptor = (LADSPA_Descriptor_Function)dlsym(pvLibrary, "ladspa_descriptor");
+    if (fDescriptor == NULL || fDescriptor(0) == NULL)
+    {
+        fprintf(stderr, "%s: nao e' um plugin LADSPA.\n", pcPath);
+        return NULL;
+    }
+
+    return fDescriptor;
+}
+
+static inline const LADSPA_Descriptor * hostFind(LADSPA_Descriptor_Function fDescriptor, const char * pcLabel)
+{
+
+    const LADSPA_Descriptor * psDescriptor;
+    unsigned long lIndex;
+
+    if (pcLabel == NULL)
+        return fDescriptor(0);
+
+    for (lIndex = 0; (psDescriptor = fDescriptor(lIndex)) != NULL; lIndex++)
+        if (strcmp(psDescriptor->Label, pcLabel) == 0)
+            return psDescriptor;
+
+    fprintf(stderr, "nao ha descritor \"%s\".\n", pcLabel);
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/* Confere o descritor contra a especificacao do LADSPA. Imprime cada
+   problema em pfOut (se nao for NULL) e devolve o numero de erros; os
+   avisos (coisas que os hosts toleram) nao contam. */
+static inline int hostValidate(const LADSPA_Descriptor * psDescriptor, FILE * pfOut)
+{
+
+    const char * pcLabel;
+    const LADSPA_PortRangeHint * psHint;
+    LADSPA_PortDescriptor iPort;
+    LADSPA_PortRangeHintDescriptor iHint;
+    LADSPA_Data fDefault;
+    unsigned long lPort;
+    int iErrors;
+
+#define HOST_PROBLEM(bError, ...) \
+    do { \
+        if (bError) \
+            iErrors++; \
+        if (pfOut != NULL) \
+        { \
+            fprintf(pfOut, "%s: %s", pcLabel, (bError) ? "erro: " : "aviso: "); \
+            fprintf(pfOut, __VA_ARGS__); \
+            fputc('\n', pfOut); \
+        } \
+    } while (0)
+
+    iErrors = 0;
+    pcLabel = psDescriptor->Label != NULL ? psDescriptor->Label : "(sem label)";
+
+    if (psDescriptor->Label == NULL || psDescriptor->Label[0] == '\0')
+        HOST_PROBLEM(1, "Label vazio");
+    else if (strpbrk(psDescriptor->Label, " \t\n") != NULL)
+        HOST_PROBLEM(1, "Label com espacos");
+    if (psDescriptor->Name == NULL)
+        HOST_PROBLEM(1, "Name nulo");
+    if (psDescriptor->instantiate == NULL || psDescriptor->connect_port == NULL
+        || psDescriptor->run == NULL || psDescriptor->cleanup == NULL)
+        HOST_PROBLEM(1, "falta instantiate, connect_port, run ou cleanup");
+    if (psDescriptor->run_adding != NULL && psDescriptor->set_run_adding_gain == NULL)
+        HOST_PROBLEM(1, "run_adding sem set_run_adding_gain");
+    if (psDescriptor->PortCount == 0)
+        HOST_PROBLEM(0, "nenhuma porta");
+    if (psDescriptor->PortCount > 0
+        && (psDescriptor->PortDescriptors == NULL || psDescriptor->PortNames == NULL || psDescriptor->PortRangeHints == NULL))
+    {
+        HOST_PROBLEM(1, "PortDescriptors, PortNames ou PortRangeHints nulo");
+        return iErrors;
+    }
+
+    for (lPort = 0; lPort < psDescriptor->PortCount; lPort++)
+    {
+        iPort = psDescriptor->PortDescriptors[lPort];
+        if (psDescriptor->PortNames[lPort] == NULL)
+            HOST_PROBLEM(1, "porta %lu sem nome", lPort);
+        if (LADSPA_IS_PORT_INPUT(iPort) == LADSPA_IS_PORT_OUTPUT(iPort))
+            HOST_PROBLEM(1, "porta %lu nao e' so entrada ou so saida", lPort);
+        if (LADSPA_IS_PORT_CONTROL(iPort) == LADSPA_IS_PORT_AUDIO(iPort))
+            HOST_PROBLEM(1, "porta %lu nao e' so controle ou so audio", lPort);
+        if (!LADSPA_IS_PORT_CONTROL(iPort) || !LADSPA_IS_PORT_INPUT(iPort))
+            continue;
+
+        psHint = &psDescriptor->PortRangeHints[lPort];
+        iHint = psHint->HintDescriptor;
+        if (LADSPA_IS_HINT_BOUNDED_BELOW(iHint) && LADSPA_IS_HINT_BOUNDED_ABOVE(iHint)
+            && psHint->LowerBound > psHint->UpperBound)
+            HOST_PROBLEM(1, "porta %lu: limite inferior %g acima do superior %g", lPort, psHint->LowerBound, psHint->UpperBound);
+        if (LADSPA_IS_HINT_LOGARITHMIC(iHint)
+            && ((LADSPA_IS_HINT_BOUNDED_BELOW(iHint) && psHint->LowerBound <= 0)
+                || (LADSPA_IS_HINT_BOUNDED_ABOVE(iHint) && psHint->UpperBound <= 0)))
+            HOST_PROBLEM(0, "porta %lu: escala logaritmica com limite <= 0", lPort);
+
+        switch (iHint & LADSPA_HINT_DEFAULT_MASK)
+        {
+        case LADSPA_HINT_DEFAULT_NONE:
+        case LADSPA_HINT_DEFAULT_0:
+        case LADSPA_HINT_DEFAULT_1:
+        case LADSPA_HINT_DEFAULT_100:
+        case LADSPA_HINT_DEFAULT_440:
+            break;
+        case LADSPA_HINT_DEFAULT_MINIMUM:
+            if (!LADSPA_IS_HINT_BOUNDED_BELOW(iHint))
+                HOST_PROBLEM(1, "porta %lu: padrao minimo sem limite inferior", lPort);
+            break;
+        case LADSPA_HINT_DEFAULT_MAXIMUM:
+            if (!LADSPA_IS_HINT_BOUNDED_ABOVE(iHint))
+                HOST_PROBLEM(1, "porta %lu: padrao maximo sem limite superior", lPort);
+            break;
+        case LADSPA_HINT_DEFAULT_LOW:
+        case LADSPA_HINT_DEFAULT_MIDDLE:
+        case LADSPA_HINT_DEFAULT_HIGH:
+            if (!LADSPA_IS_HINT_BOUNDED_BELOW(iHint) || !LADSPA_IS_HINT_BOUNDED_ABOVE(iHint))
+                HOST_PROBLEM(1, "porta %lu: padrao relativo sem os dois limites", lPort);
+            break;
+        default:
+            HOST_PROBLEM(1, "porta %lu: dica de padrao desconhecida", lPort);
+            break;
+        }
+
+        /* O padrao tem de respeitar os limites (sem SAMPLE_RATE, taxa 1) */
+        fDefault = 0;
+        switch (iHint & LADSPA_HINT_DEFAULT_MASK)
+        {
+        case LADSPA_HINT_DEFAULT_1:
+            fDefault = 1;
+            break;
+        case LADSPA_HINT_DEFAULT_100:
+            fDefault = 100;
+            break;
+        case LADSPA_HINT_DEFAULT_440:
+            fDefault = 440;
+            break;
+        case LADSPA_HINT_DEFAULT_0:
+            break;
+        default:
+            continue;
+        }
+        if (!LADSPA_IS_HINT_SAMPLE_RATE(iHint)
+            && ((LADSPA_IS_HINT_BOUNDED_BELOW(iHint) && fDefault < psHint->LowerBound)
+                || (LADSPA_IS_HINT_BOUNDED_ABOVE(iHint) && fDefault > psHint->UpperBound)))
+            HOST_PROBLEM(1, "porta %lu: padrao %g fora dos limites", lPort, fDefault);
+    }
+
+#undef HOST_PROBLEM
+
+    return iErrors;
+}
+
+/*****************************************************************************/
+
+/* Valor padrao de uma porta de controle segundo as dicas do descritor.
+   Na escala logaritmica com limite <= 0 a interpolacao e' linear. */
+static inline LADSPA_Data hostDefault(const LADSPA_PortRangeHint * psHint, unsigned long lSampleRate)
+{
+
+    LADSPA_PortRangeHintDescriptor iHint;
+    LADSPA_Data fLower;
+    LADSPA_Data fUpper;
+    LADSPA_Data fValue;
+    float fWeight;
+
+    iHint = psHint->HintDescriptor;
+    fLower = psHint->LowerBound;
+    fUpper = psHint->UpperBound;
+    if (LADSPA_IS_HINT_SAMPLE_RATE(iHint))
+    {
+        fLower *= lSampleRate;
+        fUpper *= lSampleRate;
+    }
+
+    fWeight = 0;
+    switch (iHint & LADSPA_HINT_DEFAULT_MASK)
+    {
+    case LADSPA_HINT_DEFAULT_MINIMUM:
+        return fLower;
+    case LADSPA_HINT_DEFAULT_LOW:
+        fWeight = 0.25f;
+        break;
+    case LADSPA_HINT_DEFAULT_MIDDLE:
+        fWeight = 0.5f;
+        break;
+    case LADSPA_HINT_DEFAULT_HIGH:
+        fWeight = 0.75f;
+        break;
+    case LADSPA_HINT_DEFAULT_MAXIMUM:
+        return fUpper;
+    case LADSPA_HINT_DEFAULT_0:
+        return 0;
+    case LADSPA_HINT_DEFAULT_1:
+        return 1;
+    case LADSPA_HINT_DEFAULT_100:
+        return 100;
+    case LADSPA_HINT_DEFAULT_440:
+        return 440;
+    default:
+        return LADSPA_IS_HINT_BOUNDED_BELOW(iHint) ? fLower : 0;
+    }
+
+    if (LADSPA_IS_HINT_LOGARITHMIC(iHint) && fLower > 0 && fUpper > 0)
+        fValue = expf((1 - fWeight) * logf(fLower) + fWeight * logf(fUpper));
+    else
+        fValue = (1 - fWeight) * fLower + fWeight * fUpper;
+    if (LADSPA_IS_HINT_INTEGER(iHint))
+        fValue = floorf(fValue + 0.5f);
+    return fValue;
+}
+
+/* Porta de controle de entrada com o nome dado, ou -1 */
+static inline long hostFindPort(const LADSPA_Descriptor * psDescriptor, const char * pcName)
+{
+
+    unsigned long lPort;
+
+    for (lPort = 0; lPort < psDescriptor->PortCount; lPort++)
+        if (LADSPA_IS_PORT_CONTROL(psDescriptor->PortDescriptors[lPort]) && LADSPA_IS_PORT_INPUT(psDescriptor->PortDescriptors[lPort])
+            && strcmp(psDescriptor->PortNames[lPort], pcName) == 0)
+            return (long)lPort;
+    return -1;
+}
+
+/* Valor da porta de controle lPort que faz o filtro trabalhar nos testes,
+   em vez de ficar parado no padrao: o filtro adaptativo com fMs ms e os
+   limiares do DTD e do Set-Membership abertos, e os filtros fixos com
+   coeficientes nao nulos. As demais portas ficam no padrao. O CheapNCR
+   adapta com o DNCR acima do limiar e comeca com w = 0 (DNCR = 0), entao
+   precisa do limite inferior; o Geigel adapta com |d|/max|x| abaixo do
+   limiar e precisa do superior. */
+static inline LADSPA_Data hostExercise(const LADSPA_Descriptor * psDescriptor, unsigned long lPort, unsigned long lSampleRate, LADSPA_Data fMs)
+{
+
+    static const char * apcGeigel[] = { "adapt_lmsgeigel", "adapt_nlmsgeigel", "adapt_fdnlms", NULL };
+    const LADSPA_PortRangeHint * psHint;
+    const char * pcName;
+    unsigned long lIndex;
+    int iCoef;
+
+    psHint = &psDescriptor->PortRangeHints[lPort];
+    pcName = psDescriptor->PortNames[lPort];
+
+    if (strcmp(pcName, "Tamanho do filtro (ms)") == 0)
+        return fMs;
+    if (strcmp(pcName, "Tamanho do filtro (s)") == 0) /* O adapt.c mede em amostras */
+        return floorf(fMs * lSampleRate * 0.001f);
+    if (strncmp(pcName, "Limiar do Set Membership", 24) == 0)
+        return psHint->LowerBound;
+    if (strcmp(pcName, "Limiar do DTD") == 0)
+    {
+        for (lIndex = 0; apcGeigel[lIndex] != NULL; lIndex++)
+            if (strcmp(psDescriptor->Label, apcGeigel[lIndex]) == 0)
+                return psHint->UpperBound;
+        return psHint->LowerBound;
+    }
+    if (sscanf(pcName, "Coeficiente %d", &iCoef) == 1 && iCoef > 0) /* 0.5, -0.25, 0.167... */
+        return (iCoef & 1 ? 0.5f : -0.5f) / iCoef;
+
+    return hostDefault(psHint, lSampleRate);
+}
+
+/* Numero de portas com todos os bits de iMask (ex.: entrada e audio) */
+static inline unsigned long hostCountPorts(const LADSPA_Descriptor * psDescriptor, LADSPA_PortDescriptor iMask)
+{
+
+    unsigned long lPort;
+    unsigned long lCount;
+
+    lCount = 0;
+    for (lPort = 0; lPort < psDescriptor->PortCount; lPort++)
+        if ((psDescriptor->PortDescriptors[lPort] & iMask) == iMask)
+            lCount++;
+    return lCount;
+}
+
+/*****************************************************************************/
+
+/* Instancia o descritor, poe os controles no padrao e conecta cada porta
+   de audio a um buffer zerado de lMaxBlock amostras */
+static inline int hostInstantiate(HostInstance * psInstance, const LADSPA_Descriptor * psDescriptor,
+                           unsigned long lSampleRate, unsigned long lMaxBlock)
+{
+
+    unsigned long lPort;
+
+    memset(psInstance, 0, sizeof(HostInstance));
+    psInstance->m_psDescriptor = psDescriptor;
+    psInstance->m_lSampleRate = lSampleRate;
+    psInstance->m_lMaxBlock = lMaxBlock;
+
+    psInstance->m_pfControls = (LADSPA_Data *)calloc(psDescriptor->PortCount + 1, sizeof(LADSPA_Data));
+    psInstance->m_ppfBuffers = (LADSPA_Data **)calloc(psDescriptor->PortCount + 1, sizeof(LADSPA_Data *));
+    if (psInstance->m_pfControls == NULL || psInstance->m_ppfBuffers == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    psInstance->m_hHandle = psDescriptor->instantiate(psDescriptor, lSampleRate);
+    if (psInstance->m_hHandle == NULL)
+    {
+        fprintf(stderr, "%s: instantiate() falhou.\n", psDescriptor->Label);
+        free(psInstance->m_pfControls);
+        free(psInstance->m_ppfBuffers);
+        return 0;
+    }
+
+    for (lPort = 0; lPort < psDescriptor->PortCount; lPort++)
+    {
+        if (LADSPA_IS_PORT_CONTROL(psDescriptor->PortDescriptors[lPort]))
+        {
+            if (LADSPA_IS_PORT_INPUT(psDescriptor->PortDescriptors[lPort]))
+                psInstance->m_pfControls[lPort] = hostDefault(&psDescriptor->PortRangeHints[lPort], lSampleRate);
+            psDescriptor->connect_port(psInstance->m_hHandle, lPort, psInstance->m_pfControls + lPort);
+        }
+        else
+        {
+            psInstance->m_ppfBuffers[lPort] = (LADSPA_Data *)calloc(lMaxBlock + 1, sizeof(LADSPA_Data));
+            if (psInstance->m_ppfBuffers[lPort] == NULL)
+            {
+                fputs("Out of memory.\n", stderr);
+                exit(EXIT_FAILURE);
+            }
+            psDescriptor->connect_port(psInstance->m_hHandle, lPort, psInstance->m_ppfBuffers[lPort]);
+        }
+    }
+
+    return 1;
+}
+
+static inline void hostActivate(HostInstance * psInstance)
+{
+    if (psInstance->m_psDescriptor->activate != NULL)
+        psInstance->m_psDescriptor->activate(psInstance->m_hHandle);
+    psInstance->m_iActive = 1;
+}
+
+/* Volta a instancia ao estado de logo apos o activate(), como um host
+   faz entre duas musicas: deactivate() (se ativa) e activate() */
+static inline void hostReset(HostInstance * psInstance)
+{
+    if (psInstance->m_iActive && psInstance->m_psDescriptor->deactivate != NULL)
+        psInstance->m_psDescriptor->deactivate(psInstance->m_hHandle);
+    hostActivate(psInstance);
+}
+
+static inline void hostRun(HostInstance * psInstance, unsigned long SampleCount)
+{
+
+    double dStart;
+    double dElapsed;
+
+    if (!psInstance->m_iTiming)
+    {
+        psInstance->m_psDescriptor->run(psInstance->m_hHandle, SampleCount);
+        return;
+    }
+
+    dStart = hostSeconds();
+    psInstance->m_psDescriptor->run(psInstance->m_hHandle, SampleCount);
+    dElapsed = hostSeconds() - dStart;
+
+    psInstance->m_lCalls++;
+    psInstance->m_lSamples += SampleCount;
+    psInstance->m_dSeconds += dElapsed;
+    if (dElapsed > psInstance->m_dWorst)
+        psInstance->m_dWorst = dElapsed;
+}
+
+static inline void hostCleanup(HostInstance * psInstance)
+{
+
+    unsigned long lPort;
+
+    if (psInstance->m_iActive && psInstance->m_psDescriptor->deactivate != NULL)
+        psInstance->m_psDescriptor->deactivate(psInstance->m_hHandle);
+    psInstance->m_psDescriptor->cleanup(psInstance->m_hHandle);
+
+    for (lPort = 0; lPort < psInstance->m_psDescriptor->PortCount; lPort++)
+        free(psInstance->m_ppfBuffers[lPort]);
+    free(psInstance->m_ppfBuffers);
+    free(psInstance->m_pfControls);
+    memset(psInstance, 0, sizeof(HostInstance));
+}
+
+/*****************************************************************************/
+
+/* Proximo tamanho de bloco de uma sequencia aleatoria em [1, lMax]: um
+   oitavo das vezes 1, um oitavo lMax e o resto uniforme, para pegar os
+   restos dos nucleos vetoriais e os blocos cheios */
+static inline unsigned long hostBlockSize(unsigned long * plSeed, unsigned long lMax)
+{
+
+    unsigned long lDraw;
+
+    *plSeed = *plSeed * 1103515245UL + 12345UL;
+    lDraw = (*plSeed >> 16) & 0x7fff;
+    if ((lDraw & 7) == 0 || lMax <= 1)
+        return 1;
+    if ((lDraw & 7) == 1)
+        return lMax;
+    return 1 + (lDraw >> 3) * lMax / 4096;
+}
+
+/*****************************************************************************/
+
+/* Gerador proprio para que o sinal nao dependa da libc */
+static inline float hostNoise(unsigned long * plSeed)
+{
+    *plSeed = *plSeed * 1103515245UL + 12345UL;
+    return (float)((*plSeed >> 16) & 0x7fff) / 32768.0f - 0.5f;
+}
+
+/* Caminho de eco das cenas: lTaps amostras de ruido com decaimento
+   exponencial, tiradas de *plSeed */
+static inline void hostEchoPath(float * pfPath, unsigned long lTaps, unsigned long * plSeed)
+{
+
+    unsigned long lTap;
+
+    for (lTap = 0; lTap < lTaps; lTap++)
+        pfPath[lTap] = 0.5f * hostNoise(plSeed) * expf(-(float)lTap / (lTaps / 6.0f));
+}
+
+/* Grava em pcPath o caminho de eco de hostSignals() (20 ms na taxa
+   lSampleRate) como floats crus, no formato do RIRCONV_ARQUIVO */
+static inline int hostWriteRir(const char * pcPath, unsigned long lSampleRate)
+{
+
+    float * pfPath;
+    FILE * pfFile;
+    unsigned long lSeed;
+    unsigned long lTaps;
+    int iOk;
+
+    lTaps = lSampleRate / 50;
+    pfPath = (float *)malloc((lTaps + 1) * sizeof(float));
+    if (pfPath == NULL)
+    {
+        fprintf(stderr, "hostWriteRir: sem memoria\n");
+        return 0;
+    }
+    lSeed = 12345;
+    hostEchoPath(pfPath, lTaps, &lSeed);
+
+    pfFile = fopen(pcPath, "wb");
+    if (pfFile == NULL)
+    {
+        perror(pcPath);
+        free(pfPath);
+        return 0;
+    }
+    iOk = fwrite(pfPath, sizeof(float), lTaps, pfFile) == lTaps;
+    if (fclose(pfFile) != 0 || !iOk)
+    {
+        perror(pcPath);
+        iOk = 0;
+    }
+    free(pfPath);
+    return iOk;
+}
+
+/* Preenche x(n) e d(n) com lSamples amostras da cena iScene, sempre com
+   a mesma semente: x(n) e' ruido passa-baixas e o caminho de eco e' o de
+   hostEchoPath(), com 20 ms */
+static inline int hostSignals(float * pfX, float * pfD, unsigned long lSamples, unsigned long lSampleRate, int iScene)
+{
+
+    float * pfPath;
+    unsigned long lSeed;
+    unsigned long lTaps;
+    unsigned long lIndex;
+    unsigned long lTap;
+    float fColorX;
+    float fColorL;
+    double dAcc;
+
+    lTaps = lSampleRate / 50;
+    pfPath = (float *)malloc((lTaps + 1) * sizeof(float));
+    if (pfPath == NULL)
+    {
+        fprintf(stderr, "hostSignals: sem memoria\n");
+        return 0;
+    }
+
+    lSeed = 12345;
+    hostEchoPath(pfPath, lTaps, &lSeed);
+
+    fColorX = 0;
+    for (lIndex = 0; lIndex < lSamples; lIndex++)
+    {
+        fColorX = 0.9f * fColorX + hostNoise(&lSeed);
+        pfX[lIndex] = 0.3f * fColorX;
+    }
+
+    fColorL = 0;
+    for (lIndex = 0; lIndex < lSamples; lIndex++)
+    {
+        if (iScene == HOST_SCENE_SWAP && lIndex == lSamples / 2)
+            for (lTap = 0; lTap < lTaps; lTap++)
+                pfPath[lTap] = -pfPath[(lTap + lTaps / 4) % lTaps];
+        dAcc = 0;
+        for (lTap = 0; lTap < lTaps && lTap <= lIndex; lTap++)
+            dAcc += pfPath[lTap] * pfX[lIndex - lTap];
+        pfD[lIndex] = (float)dAcc + 1e-4f * hostNoise(&lSeed);
+        if (iScene == HOST_SCENE_DOUBLE_TALK && lIndex >= lSamples / 2)
+        {
+            fColorL = 0.8f * fColorL + hostNoise(&lSeed);
+            pfD[lIndex] += 0.2f * fColorL;
+        }
+    }
+
+    free(pfPath);
+    return 1;
+}
+
+/*****************************************************************************/
+
+#endif /* HOSPEDEIRO_H */
+
+/* EOF */
@@ -0,0 +1,132 @@
+/* medidores.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Portas de saida de controle (LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL)
+   comuns aos canceladores, para o host acompanhar cada instancia:
+
+     ERLE               10 log10(sum d^2 / sum e^2) no ultimo bloco, em dB
+     Taxa de adaptacao  fracao das amostras do bloco em que o DTD e o
+                        Set-Membership deixaram os coeficientes mudar
+     DTD                estatistica do detector de fala dupla na ultima
+                        amostra (DNCR nos filtros CheapNCR, |d|/max|x| nos
+                        filtros de Geigel)
+     Alfa               fator da nao linearidade (so nos filtros NL)
+
+   O run() acumula as energias e o contador de atualizacoes amostra a
+   amostra (custo constante) e chama meterPublish() uma vez no fim do
+   bloco. Portas nao conectadas (NULL) sao ignoradas. */
+
+#ifndef MEDIDORES_H
+#define MEDIDORES_H
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ladspa.h"
+
+/*****************************************************************************/
+
+/* Ordem das portas de medicao, a partir da primeira porta de medicao do
+   plugin. Os filtros lineares usam as tres primeiras. */
+
+#define METER_ERLE        0
+#define METER_UPDATE_RATE 1
+#define METER_DTD         2
+#define METER_ALPHA       3
+
+#define METER_PORTS_LINEAR 3
+#define METER_PORTS_NL     4
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    LADSPA_Data * m_pfERLE;
+
+    LADSPA_Data * m_pfUpdateRate;
+
+    LADSPA_Data * m_pfDtd;
+
+    LADSPA_Data * m_pfAlpha;
+
+} MeterPorts;
+
+/*****************************************************************************/
+
+/* Conecta a porta de medicao lMeter (METER_*) */
+static inline void meterConnect(MeterPorts * psMeters, unsigned long lMeter, LADSPA_Data * DataLocation)
+{
+    switch (lMeter)
+    {
+    case METER_ERLE:
+        psMeters->m_pfERLE = DataLocation;
+        break;
+    case METER_UPDATE_RATE:
+        psMeters->m_pfUpdateRate = DataLocation;
+        break;
+    case METER_DTD:
+        psMeters->m_pfDtd = DataLocation;
+        break;
+    case METER_ALPHA:
+        psMeters->m_pfAlpha = DataLocation;
+        break;
+    }
+}
+
+/*****************************************************************************/
+
+/* Escreve os valores do bloco nas portas conectadas */
+static inline void meterPublish(MeterPorts * psMeters, unsigned long SampleCount, LADSPA_Data fPotD, LADSPA_Data fPotE, unsigned long lUpdates, LADSPA_Data fDtd, LADSPA_Data fAlpha)
+{
+    if (SampleCount == 0)
+        return;
+
+    if (psMeters->m_pfERLE != NULL)
+        *psMeters->m_pfERLE = 10.0f * log10f((fPotD + 1e-20f) / (fPotE + 1e-20f));
+    if (psMeters->m_pfUpdateRate != NULL)
+        *psMeters->m_pfUpdateRate = (LADSPA_Data)lUpdates / (LADSPA_Data)SampleCount;
+    if (psMeters->m_pfDtd != NULL)
+        *psMeters->m_pfDtd = fDtd;
+    if (psMeters->m_pfAlpha != NULL)
+        *psMeters->m_pfAlpha = fAlpha;
+}
+
+/*****************************************************************************/
+
+/* Preenche, no _init(), os descritores, nomes e limites de lCount portas
+   de medicao a partir da porta lFirst */
+static inline void meterDescribePorts(LADSPA_PortDescriptor * piPortDescriptors, char ** pcPortNames, LADSPA_PortRangeHint * psPortRangeHints, unsigned long lFirst, unsigned long lCount)
+{
+
+    static const char * apcNames[METER_PORTS_NL] = { "ERLE (dB)", "Taxa de adaptacao", "Estatistica do DTD", "Alfa" };
+    static const LADSPA_Data afLower[METER_PORTS_NL] = { -60, 0, 0, 0 };
+    static const LADSPA_Data afUpper[METER_PORTS_NL] = { 120, 1, 2, 10 };
+    unsigned long lMeter;
+
+    for (lMeter = 0; lMeter < lCount; lMeter++)
+    {
+        piPortDescriptors[lFirst + lMeter]
+        = LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL;
+        pcPortNames[lFirst + lMeter]
+        = strdup(apcNames[lMeter]);
+        psPortRangeHints[lFirst + lMeter].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE);
+        psPortRangeHints[lFirst + lMeter].LowerBound
+        = afLower[lMeter];
+        psPortRangeHints[lFirst + lMeter].UpperBound
+        = afUpper[lMeter];
+    }
+}
+
+/*****************************************************************************/
+
+#endif /* MEDIDORES_H */
+
+/* EOF */
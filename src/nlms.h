@@ -0,0 +1,498 @@
+/* nlms.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Nucleo do cancelador NLMS com CheapNCR (o de plugins/nlmscncr.c), sem
+   nada de LADSPA: a configuracao e' uma estrutura passada a cada
+   chamada, em vez de portas lidas por ponteiro, e a memoria dos buffers
+   e' dada por quem usa. Serve ao plugin e a API de api/cancelador.hpp.
+
+     nlmsDefaults()  configuracao padrao (os padroes das portas do plugin)
+     nlmsMemory()    bytes de memoria que uma taxa de amostragem precisa
+     nlmsInit()      prepara o estado sobre a memoria dada, sem alocar
+     nlmsReset()     zera o filtro (o activate() do plugin)
+     nlmsTaps()      coeficientes em uso com uma configuracao
+     nlmsProcess()   processa um bloco: e(n) = d(n) - w(n)*x(n), com o
+                     DTD e o Set-Membership decidindo a adaptacao
+
+   O acumulador dos produtos internos (m_iAccumulator) e' escolhido uma
+   vez por chamada; cada um tem o seu laco especializado.
+
+   Quem quiser a sonda do DTD (veja sondas.h) define NLMS_PROBE_DTD antes
+   de incluir este arquivo. Compila como C e como C++. */
+
+#ifndef NLMS_H
+#define NLMS_H
+
+/*****************************************************************************/
+
+#include <string.h>
+#include <math.h>
+
+/*****************************************************************************/
+
+#define NLMS_MAX_ECO_MS 2000 /* Maximo tempo de eco (cuidado com a memoria): 96000 coeficientes a 48 kHz */
+#define NLMS_MAX_DTD_MS 20 /* Valores em milissegundos */
+#define NLMS_EPSILON 0.001 /* Valor do epsilon do e-NLMS */
+
+/* Tipos de acumulador */
+#define NLMS_ACC_FLOAT  0
+#define NLMS_ACC_DOUBLE 1
+#define NLMS_ACC_KAHAN  2
+
+/* Acumuladores independentes nos produtos internos (uma via por elemento
+   de um registrador AVX de floats) */
+#define NLMS_VIAS 8
+
+/* a * b + c como o laco original compilado: com FMA no processador o
+   compilador fundia essas contas, e a escolha de qual produto fundir
+   mudava com o formato do codigo. O modo float fixa a mesma escolha para
+   dar a mesma saida do plugin original, amostra por amostra. */
+#ifdef __FP_FAST_FMAF
+#define NLMS_MAC(fA, fB, fC) fmaf(fA, fB, fC)
+#else
+#define NLMS_MAC(fA, fB, fC) ((fA) * (fB) + (fC))
+#endif
+
+#ifndef NLMS_PROBE_DTD
+#define NLMS_PROBE_DTD(psState, iDoubleTalk, lSample) ((void)0)
+#endif
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    float m_fEchoMs; /* Tamanho do filtro em ms, ate NLMS_MAX_ECO_MS */
+
+    float m_fDtdMs; /* Comprimento do DTD em ms, ate NLMS_MAX_DTD_MS */
+
+    float m_fDtdThreshold; /* Limiar do DTD */
+
+    float m_fMu; /* Fator de convergencia */
+
+    float m_fSetThresholdDb; /* Limiar do Set Membership em dB */
+
+    int m_iAccumulator; /* NLMS_ACC_... */
+
+} NlmsConfig;
+
+/* O que um bloco mediu (o que o plugin publica nas portas de medicao) */
+typedef struct
+{
+
+    float m_fPowerD; /* sum d^2 */
+
+    float m_fPowerE; /* sum e^2 */
+
+    unsigned long m_lUpdates; /* Amostras em que o filtro foi atualizado */
+
+    float m_fDncr; /* Estatistica do DTD na ultima amostra */
+
+    unsigned long m_lTaps; /* Coeficientes em uso */
+
+} NlmsStats;
+
+typedef struct
+{
+
+    float m_fSampleRate;
+
+    float * m_pfBufferX; /* Valores anteriores de X, em duas copias seguidas */
+
+    float * m_pfCoefs; /* coeficientes do filtro */
+
+    float * m_pfPdx; /* Correlacao cruzada de D e X */
+
+    /* Guardados em double para servir a todos os acumuladores; no modo
+       float os valores sao arredondados para float a cada passo */
+    double m_dDVar;
+
+    double m_dXVar;
+
+    double m_dXVarComp; /* Compensacao da soma de Kahan de var(X) */
+
+    /* Potencias de 2: a circularizacao vira um E bit a bit */
+    unsigned long m_lFilterSize;
+
+    unsigned long m_lDtdSize;
+
+    unsigned long m_lWritePointerX; /* Indice do ponteiro do buffer de X */
+
+    float m_fEchoTimeant; /* m_fEchoMs do bloco anterior */
+
+} NlmsState;
+
+/*****************************************************************************/
+
+/* Produtos internos sum(pfA[i] * pfB[i]) com cada acumulador */
+
+/* Soma sequencial em float, igual ao laco original */
+static inline float nlmsDotFloat(const float * pfA, const float * pfB, unsigned long lCount)
+{
+
+    float fSum;
+    unsigned long lIndex;
+
+    fSum = 0;
+    for (lIndex = 0; lIndex < lCount; lIndex++)
+        fSum = NLMS_MAC(pfA[lIndex], pfB[lIndex], fSum);
+    return fSum;
+}
+
+/* Produtos e somas em double; as vias sao somadas aos pares no final */
+static inline double nlmsDotDouble(const float * pfA, const float * pfB, unsigned long lCount)
+{
+
+    double adSum[NLMS_VIAS];
+    unsigned long lIndex;
+    unsigned long lVia;
+
+    for (lVia = 0; lVia < NLMS_VIAS; lVia++)
+        adSum[lVia] = 0;
+
+    for (lIndex = 0; lIndex + NLMS_VIAS <= lCount; lIndex += NLMS_VIAS)
+    {
+#pragma GCC unroll 8
+        for (lVia = 0; lVia < NLMS_VIAS; lVia++)
+            adSum[lVia] += (double)pfA[lIndex + lVia] * (double)pfB[lIndex + lVia];
+    }
+    for (; lIndex < lCount; lIndex++)
+        adSum[0] += (double)pfA[lIndex] * (double)pfB[lIndex];
+
+    for (lVia = NLMS_VIAS / 2; lVia > 0; lVia >>= 1)
+        for (lIndex = 0; lIndex < lVia; lIndex++)
+            adSum[lIndex] += adSum[lIndex + lVia];
+    return adSum[0];
+}
+
+/* Soma compensada de Kahan em float, uma compensacao por via */
+static inline double nlmsDotKahan(const float * pfA, const float * pfB, unsigned long lCount)
+{
+
+    float afSum[NLMS_VIAS];
+    float afComp[NLMS_VIAS];
+    float fY;
+    float fT;
+    double dSum;
+    unsigned long lIndex;
+    unsigned long lVia;
+
+    for (lVia = 0; lVia < NLMS_VIAS; lVia++)
+    {
+        afSum[lVia] = 0;
+        afComp[lVia] = 0;
+    }
+
+    for (lIndex = 0; lIndex + NLMS_VIAS <= lCount; lIndex += NLMS_VIAS)
+    {
+#pragma GCC unroll 8
+        for (lVia = 0; lVia < NLMS_VIAS; lVia++)
+        {
+            fY = pfA[lIndex + lVia] * pfB[lIndex + lVia] - afComp[lVia];
+            fT = afSum[lVia] + fY;
+            afComp[lVia] = (fT - afSum[lVia]) - fY;
+            afSum[lVia] = fT;
+        }
+    }
+    for (; lIndex < lCount; lIndex++)
+    {
+        fY = pfA[lIndex] * pfB[lIndex] - afComp[0];
+        fT = afSum[0] + fY;
+        afComp[0] = (fT - afSum[0]) - fY;
+        afSum[0] = fT;
+    }
+
+    dSum = 0;
+    for (lVia = 0; lVia < NLMS_VIAS; lVia++)
+        dSum += (double)afSum[lVia] - (double)afComp[lVia];
+    return dSum;
+}
+
+/* Escolhe o produto interno; iAccumulator e' constante em cada chamada */
+static inline __attribute__((always_inline)) double nlmsDot(int iAccumulator, const float * pfA, const float * pfB, unsigned long lCount)
+{
+    if (iAccumulator == NLMS_ACC_DOUBLE)
+        return nlmsDotDouble(pfA, pfB, lCount);
+    if (iAccumulator == NLMS_ACC_KAHAN)
+        return nlmsDotKahan(pfA, pfB, lCount);
+    return nlmsDotFloat(pfA, pfB, lCount);
+}
+
+/*****************************************************************************/
+
+static inline void nlmsDefaults(NlmsConfig * psConfig)
+{
+    psConfig->m_fEchoMs = 150;
+    psConfig->m_fDtdMs = 10;
+    psConfig->m_fDtdThreshold = 0.5f;
+    psConfig->m_fMu = 0.5f;
+    psConfig->m_fSetThresholdDb = -90;
+    psConfig->m_iAccumulator = NLMS_ACC_FLOAT;
+}
+
+/* Menor potencia de dois maior que o tempo dado (mais uma amostra) */
+static inline unsigned long nlmsSize(unsigned long lSampleRate, unsigned long lMs)
+{
+
+    unsigned long lMinimum;
+    unsigned long lSize;
+
+    lMinimum = (unsigned long)((float)lSampleRate * lMs * 0.001) + 1;
+    lSize = 1;
+    while (lSize < lMinimum)
+        lSize <<= 1;
+    return lSize;
+}
+
+static inline size_t nlmsMemory(unsigned long lSampleRate)
+{
+    return (3 * nlmsSize(lSampleRate, NLMS_MAX_ECO_MS) + nlmsSize(lSampleRate, NLMS_MAX_DTD_MS)) * sizeof(float);
+}
+
+/* pvMemory: nlmsMemory() bytes alinhados para float, de quem chama e
+   vivos enquanto o estado for usado */
+static inline void nlmsInit(NlmsState * psState, unsigned long lSampleRate, void * pvMemory)
+{
+    psState->m_fSampleRate = (float)lSampleRate;
+    psState->m_lFilterSize = nlmsSize(lSampleRate, NLMS_MAX_ECO_MS);
+    psState->m_lDtdSize = nlmsSize(lSampleRate, NLMS_MAX_DTD_MS);
+
+    /* O buffer de x(n) tem duas copias para que a janela do filtro seja sempre contigua */
+    psState->m_pfBufferX = (float *)pvMemory;
+    psState->m_pfCoefs = psState->m_pfBufferX + 2 * psState->m_lFilterSize;
+    psState->m_pfPdx = psState->m_pfCoefs + psState->m_lFilterSize;
+    psState->m_lWritePointerX = 0;
+}
+
+static inline void nlmsReset(NlmsState * psState)
+{
+    memset(psState->m_pfBufferX, 0, 2 * sizeof(float) * psState->m_lFilterSize);
+    memset(psState->m_pfCoefs, 0, sizeof(float) * psState->m_lFilterSize);
+    memset(psState->m_pfPdx, 0, sizeof(float) * psState->m_lDtdSize);
+    psState->m_fEchoTimeant = 0;
+    *psState->m_pfCoefs = 1;
+    psState->m_dXVar = 0;
+    psState->m_dXVarComp = 0;
+    psState->m_dDVar = 0;
+}
+
+static inline unsigned long nlmsTaps(const NlmsState * psState, const NlmsConfig * psConfig)
+{
+
+    float fMs;
+
+    fMs = psConfig->m_fEchoMs < 0 ? 0 : psConfig->m_fEchoMs > NLMS_MAX_ECO_MS ? NLMS_MAX_ECO_MS : psConfig->m_fEchoMs;
+    return (unsigned long)(fMs * psState->m_fSampleRate * 0.001);
+}
+
+/*****************************************************************************/
+
+/* Corpo comum de nlmsProcess(). E' sempre expandido com iAccumulator
+   constante, entao cada acumulador recebe uma copia especializada, sem
+   desvios por amostra. pfOutput pode ser pfInputD. */
+static inline __attribute__((always_inline)) void nlmsRun(NlmsState * psState, const NlmsConfig * psConfig, const float * pfInputD,
+                                                           const float * pfInputX, float * pfOutput, unsigned long lSampleCount,
+                                                           NlmsStats * psStats, int iAccumulator)
+{
+
+    float * pfBufferX; /* Vetor que armazena os valores antigos de x(n) */
+    float * pfCoefs;  /* Vetor que armazena os valores dos coeficientes do filtro */
+    float * pfWindowX; /* Janela contigua de x(n) usada nesta amostra */
+    float * pfPdx; /* A correlacao cruzada de D e X */
+    float fMu; /* Fator do passo */
+    float fStep; /* Valor do passo */
+    float fDtdThreshold; /* Limiar do Double-Talk detector */
+    float fErrSample; /* Valor atual do e(n) */
+    float fSetThreshold; /* Limiar do Set-Membership */
+    float fgammaD;
+    float fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
+    float fNewX; /* x(n) que entra na janela */
+    float fOldX; /* x(n - L) que sai da janela */
+    float fXVar; /* var(X) nos modos float e Kahan */
+    float fXVarComp; /* Compensacao de var(X) no modo Kahan */
+    float fDVar; /* var(D) nos modos float e Kahan */
+    float fDtdMs;
+    float fY;
+    float fT;
+    double dConvSample; /* Variavel auxiliar da convolucao */
+    double dDNCR;
+    float fDNCR; /* DNCR no modo float */
+    double dXVar; /* var(X) no modo double */
+    double dDVar; /* var(D) no modo double */
+    double dgammaD;
+    float fPotD; /* Energia de d(n) no bloco */
+    float fPotE; /* Energia de e(n) no bloco */
+    unsigned long lUpdates; /* Amostras em que o filtro foi atualizado */
+    unsigned long lBufferXSizeMinusOne;
+    unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */
+    unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */
+    unsigned long lIndexW; /* Indice usado para gravar no buffer */
+    unsigned long lSampleIndex;
+    unsigned long lConv; /* Contador da convolucao */
+
+    dDNCR = 0;
+    fPotD = 0;
+    fPotE = 0;
+    lUpdates = 0;
+
+    lBufferXSizeMinusOne = psState->m_lFilterSize - 1;
+    lXCoefs = nlmsTaps(psState, psConfig);
+    fDtdMs = psConfig->m_fDtdMs < 0 ? 0 : psConfig->m_fDtdMs > NLMS_MAX_DTD_MS ? NLMS_MAX_DTD_MS : psConfig->m_fDtdMs;
+    lDCoefs = (unsigned long)(fDtdMs * psState->m_fSampleRate * 0.001);
+    if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */
+    fgammaD = ((float)lDCoefs - 1.0f)/ (float)lDCoefs;
+    dgammaD = ((double)lDCoefs - 1.0)/ (double)lDCoefs;
+
+    pfCoefs       =  psState->m_pfCoefs;
+    pfBufferX     =  psState->m_pfBufferX;
+    pfPdx         =  psState->m_pfPdx;
+    fMu           =  psConfig->m_fMu;
+    lIndexW       =  psState->m_lWritePointerX;
+
+    /* Estado das variancias no tipo do acumulador */
+    dXVar         =  psState->m_dXVar;
+    dDVar         =  psState->m_dDVar;
+    fXVar         =  (float)psState->m_dXVar;
+    fXVarComp     =  (float)psState->m_dXVarComp;
+    fDVar         =  (float)psState->m_dDVar;
+
+    fDtdThreshold = psConfig->m_fDtdThreshold;
+    fSetThreshold = powf(10.0f, psConfig->m_fSetThresholdDb * 0.05f); /* Limiar em dB para coeficiente */
+
+    for (lSampleIndex = 0; lSampleIndex < lSampleCount; lSampleIndex++)
+    {
+
+        fD = *pfInputD;
+        fNewX = *pfInputX;
+        pfBufferX[lIndexW] = fNewX; /* O buffer recebe a mais recente amostra de x(n) */
+        pfBufferX[lIndexW + psState->m_lFilterSize] = fNewX;
+        pfWindowX = pfBufferX + lIndexW;
+
+        dConvSample = nlmsDot(iAccumulator, pfCoefs, pfWindowX, lXCoefs); /* Executa a convolucao */
+
+        fErrSample = (float)((double)fD - dConvSample); /* e(n) = d(n) - w(n)*x(n) */
+        *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
+
+        if (psState->m_fEchoTimeant == psConfig->m_fEchoMs) /* Se o tamanho do filtro nao mudar calcula tr[Rx] pelo metodo incremental */
+        {
+            fOldX = pfWindowX[lXCoefs];
+            if (iAccumulator == NLMS_ACC_DOUBLE)
+            {
+                dXVar += (double)fNewX * fNewX - (double)fOldX * fOldX;
+            }
+            else if (iAccumulator == NLMS_ACC_KAHAN)
+            {
+                fY = (fNewX * fNewX - fOldX * fOldX) - fXVarComp;
+                fT = fXVar + fY;
+                fXVarComp = (fT - fXVar) - fY;
+                fXVar = fT;
+            }
+            else
+            {
+                fXVar += NLMS_MAC(fNewX, fNewX, -(fOldX * fOldX));
+            }
+        }
+        else /* Se o tempo mudou, recalcula o valor e atualiza o valor do EchoTime anterior */
+        {
+            psState->m_fEchoTimeant = psConfig->m_fEchoMs;
+            dXVar = nlmsDot(iAccumulator, pfWindowX, pfWindowX, lXCoefs);
+            fXVar = (float)dXVar;
+            fXVarComp = 0;
+        }
+
+        /* Utiliza o metodo IIR para estimar var(D) */
+        if (iAccumulator == NLMS_ACC_DOUBLE)
+        {
+            dDVar = dgammaD * dDVar + (1 - dgammaD) * (double)fD * fD;
+        }
+        else
+        {
+            fDVar = NLMS_MAC((1 - fgammaD) * fD, fD, fDVar * fgammaD);
+            dDVar = fDVar;
+        }
+
+        if (iAccumulator == NLMS_ACC_FLOAT)
+        {
+            /* O laco original: a soma em float acompanha a atualizacao */
+            fDNCR = 0;
+            for(lConv = 0; lConv < lDCoefs; lConv++)
+            {
+                /*Obtemos uma estimativa da correlacao cruzada de D e X pelo metodo IIR */
+                pfPdx[lConv] = NLMS_MAC((1 - fgammaD) * pfWindowX[lConv], fD, pfPdx[lConv] * fgammaD);
+                fDNCR = NLMS_MAC(pfPdx[lConv], pfCoefs[lConv], fDNCR); /*Depois incrementamos o fator DNCR */
+            }
+            dDNCR = fDNCR / fDVar; /* Falta dividir por var(D): fDNCR = (r_dx * w) / *pfDVar */
+        }
+        else
+        {
+            for(lConv = 0; lConv < lDCoefs; lConv++)
+            {
+                pfPdx[lConv] *= fgammaD;
+                pfPdx[lConv] += (1 - fgammaD) * pfWindowX[lConv] * fD;
+            }
+            dDNCR = nlmsDot(iAccumulator, pfPdx, pfCoefs, lDCoefs) / dDVar;
+        }
+
+        NLMS_PROBE_DTD(psState, !(dDNCR > fDtdThreshold), lSampleIndex);
+        if (dDNCR > fDtdThreshold && (fErrSample > 0 ? fErrSample : -fErrSample) > fSetThreshold)
+        {
+            if (iAccumulator == NLMS_ACC_DOUBLE)
+                fStep = (float)(fMu * fErrSample / (dXVar + NLMS_EPSILON)); /* Aplica a regra do e-NLMS */
+            else
+                fStep = fMu * fErrSample / (fXVar + NLMS_EPSILON);
+            lUpdates++;
+
+            for(lConv = 0; lConv < lXCoefs; lConv++) /* w(n+1) = w(n) + 2 * mu * e(n) * X(n) */
+            {
+                pfCoefs[lConv] += fStep * pfWindowX[lConv];
+            }
+        }
+
+        lIndexW = (lIndexW - 1) & lBufferXSizeMinusOne; /* Atualiza o indice dos buffers */
+        pfInputX++; /* Recebe proxima amostra de X */
+        pfInputD++; /* Recebe proxima amostra de D */
+    }
+
+    psState->m_lWritePointerX = lIndexW; /* Atualiza o indice do ponteiro dos vetores circulares*/
+
+    if (iAccumulator == NLMS_ACC_DOUBLE)
+    {
+        psState->m_dXVar = dXVar;
+        psState->m_dDVar = dDVar;
+    }
+    else
+    {
+        psState->m_dXVar = fXVar;
+        psState->m_dXVarComp = fXVarComp;
+        psState->m_dDVar = fDVar;
+    }
+
+    psStats->m_fPowerD = fPotD;
+    psStats->m_fPowerE = fPotE;
+    psStats->m_lUpdates = lUpdates;
+    psStats->m_fDncr = (float)dDNCR;
+    psStats->m_lTaps = lXCoefs;
+}
+
+/* Processa lSampleCount amostras de d(n) (microfone) e x(n) (remoto)
+   em e(n); psStats recebe as medidas do bloco */
+static inline void nlmsProcess(NlmsState * psState, const NlmsConfig * psConfig, const float * pfInputD, const float * pfInputX,
+                               float * pfOutput, unsigned long lSampleCount, NlmsStats * psStats)
+{
+    if (psConfig->m_iAccumulator == NLMS_ACC_DOUBLE)
+        nlmsRun(psState, psConfig, pfInputD, pfInputX, pfOutput, lSampleCount, psStats, NLMS_ACC_DOUBLE);
+    else if (psConfig->m_iAccumulator == NLMS_ACC_KAHAN)
+        nlmsRun(psState, psConfig, pfInputD, pfInputX, pfOutput, lSampleCount, psStats, NLMS_ACC_KAHAN);
+    else
+        nlmsRun(psState, psConfig, pfInputD, pfInputX, pfOutput, lSampleCount, psStats, NLMS_ACC_FLOAT);
+}
+
+/*****************************************************************************/
+
+#endif /* NLMS_H */
+
+/* EOF */
@@ -14,10 +14,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "telemetria.h"
 
 /*****************************************************************************/
 
@@ -69,6 +71,9 @@ typedef struct {
   /* Write pointer in buffer. */
   unsigned long m_lWritePointer;
 
+  /* Registros de cada bloco para o host (veja telemetria.h) */
+  TelemetryRing * m_psTelemetry;
+
   /* Ports:
      ------ */
 
@@ -119,13 +124,12 @@ instantiateSimpleAdaptiveFilter(const LADSPA_Descriptor * Descriptor, unsigned l
 
   psAdaptiveFilter->m_pfBuffer  = (LADSPA_Data *)calloc(psAdaptiveFilter->m_lFilterSize, sizeof(LADSPA_Data)); /* cria um buffer "zerado" com o tamanho achado acima de LADSPA_Datas (ou seja floats, ver em ladspa.h) */
   psAdaptiveFilter->m_pfCoefs  = (LADSPA_Data *)calloc(psAdaptiveFilter->m_lFilterSize, sizeof(LADSPA_Data));
+  psAdaptiveFilter->m_psTelemetry = (TelemetryRing *)aligned_alloc(64, sizeof(TelemetryRing));
 
-  if (psAdaptiveFilter->m_pfBuffer == NULL) {
-    free(psAdaptiveFilter);
-    return NULL;  /* Melhorar este return */
-  }
-
-  if (psAdaptiveFilter->m_pfCoefs == NULL) {
+  if (psAdaptiveFilter->m_pfBuffer == NULL || psAdaptiveFilter->m_pfCoefs == NULL || psAdaptiveFilter->m_psTelemetry == NULL) {
+    free(psAdaptiveFilter->m_pfBuffer); /* free(NULL) nao faz nada */
+    free(psAdaptiveFilter->m_pfCoefs);
+    free(psAdaptiveFilter->m_psTelemetry);
     free(psAdaptiveFilter);
     return NULL;  /* Melhorar este return */
   }
@@ -149,6 +153,7 @@ activateSimpleAdaptiveFilter(LADSPA_Handle Instance) {
      been called to reinitialise a delay line. */
   memset(psSimpleAdaptiveFilter->m_pfBuffer, 0, sizeof(LADSPA_Data) * psSimpleAdaptiveFilter->m_lFilterSize);
   memset(psSimpleAdaptiveFilter->m_pfCoefs, 0, sizeof(LADSPA_Data) * psSimpleAdaptiveFilter->m_lFilterSize);
+  telemetryReset(psSimpleAdaptiveFilter->m_psTelemetry);
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/
 
 /*****************************************************************************/
@@ -197,9 +202,14 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
   LADSPA_Data * pfInputX; /* Aponta para o bloco de amostras da entrada x(n) */
   LADSPA_Data * pfOutput; /* Aponta para o bloco de amostras da saida */
   LADSPA_Data fConvSample;
+  LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
   LADSPA_Data fErrSample;
   LADSPA_Data fMu;
   LADSPA_Data fThreshold;
+  LADSPA_Data fPotD = 0; /* Energia de d(n) no bloco */
+  LADSPA_Data fPotE = 0; /* Energia de e(n) no bloco */
+  LADSPA_Data fPotX = 0; /* Energia de x(n) no bloco */
+  TelemetryRecord * psRecord;
   SimpleAdaptiveFilter * psSimpleAdaptiveFilter;
   unsigned long lBufferSizeMinusOne;
   unsigned long lBufferWriteOffset;
@@ -208,6 +218,7 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
   unsigned short lSampleIndex;
   unsigned short lConv; /* Contador da convolucao */
   unsigned short lNcount = 0; /* Contador da convolucao */
+  unsigned long lUpdates = 0; /* Amostras em que o filtro foi atualizado */
 
   psSimpleAdaptiveFilter = (SimpleAdaptiveFilter *)Instance;
   lBufferSizeMinusOne = psSimpleAdaptiveFilter->m_lFilterSize - 1;
@@ -227,7 +238,9 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
   {
       lIndex = lSampleIndex + lBufferWriteOffset;
 
-      pfBuffer[(lIndex & lBufferSizeMinusOne)] = *(pfInputX++); /* O buffer recebe a mais recente amostra de x(n) */
+      pfBuffer[(lIndex & lBufferSizeMinusOne)] = *pfInputX; /* O buffer recebe a mais recente amostra de x(n) */
+      fPotX += (*pfInputX) * (*pfInputX);
+      pfInputX++;
 
       fConvSample = 0; /* zera a convolucao */
       for(lConv = 0; lConv < lCoefs; lConv++)
@@ -235,28 +248,49 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
           fConvSample+=pfCoefs[lConv]*pfBuffer[((lIndex - lConv) & lBufferSizeMinusOne)];
       }
 
-    fErrSample = *(pfInputD++) - fConvSample;
+    fD = *pfInputD;
+    fErrSample = fD - fConvSample;
     *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+    fPotD += fD * fD;
+    fPotE += fErrSample * fErrSample;
+    pfInputD++;
 
     if (lNcount == 0)
     {
         if (fErrSample > fThreshold)
         {
+            lUpdates++;
             for(lConv = 0; lConv < lCoefs; lConv++) /* w(n+1) = w(n) + 2 * mu * e(n) * X(n) */
                 pfCoefs[lConv]+=fMu*pfBuffer[((lIndex - lConv) & lBufferSizeMinusOne)];
         }
         else if (fErrSample < -fThreshold)
         {
+            lUpdates++;
             for(lConv = 0; lConv < lCoefs; lConv++) /* w(n+1) = w(n) + 2 * mu * e(n) * X(n) */
                 pfCoefs[lConv]-=fMu*pfBuffer[((lIndex - lConv) & lBufferSizeMinusOne)];
         }
     }
 
     lNcount = (lNcount+1)&N;
-    printf("%g\n", fErrSample);
 
   }
 
+  /* O erro nao e' mais impresso amostra a amostra: o resumo do bloco vai
+     para a fila de telemetria. Este filtro nao estima var(X), var(D) nem
+     DNCR; os campos levam a potencia media de x(n) e d(n) no bloco. */
+  psRecord = telemetryReserve(psSimpleAdaptiveFilter->m_psTelemetry);
+  if (psRecord != NULL)
+  {
+    psRecord->m_lSamples = SampleCount;
+    psRecord->m_lUpdates = lUpdates;
+    psRecord->m_fAlpha = 1;
+    psRecord->m_fDNCR = 0;
+    psRecord->m_fXVar = SampleCount ? fPotX / SampleCount : 0;
+    psRecord->m_fDVar = SampleCount ? fPotD / SampleCount : 0;
+    psRecord->m_fERLE = 10.0f * log10f((fPotD + 1e-20f) / (fPotE + 1e-20f));
+    telemetryCommit(psSimpleAdaptiveFilter->m_psTelemetry);
+  }
+
   psSimpleAdaptiveFilter->m_lWritePointer = ((psSimpleAdaptiveFilter->m_lWritePointer + SampleCount) & lBufferSizeMinusOne); /* Atualiza o indice do ponteiro dos vetores circulares*/
 }
 
@@ -272,11 +306,20 @@ cleanupSimpleAdaptiveFilter(LADSPA_Handle Instance) {
 
   free(psSimpleAdaptiveFilter->m_pfBuffer);
   free(psSimpleAdaptiveFilter->m_pfCoefs);
+  free(psSimpleAdaptiveFilter->m_psTelemetry);
   free(psSimpleAdaptiveFilter);
 }
 
 /*****************************************************************************/
 
+/* Fila de telemetria da instancia, para o host esvaziar fora da thread de audio */
+TelemetryRing *
+ladspa_telemetry(LADSPA_Handle Instance) {
+  return ((SimpleAdaptiveFilter *)Instance)->m_psTelemetry;
+}
+
+/*****************************************************************************/
+
 LADSPA_Descriptor * g_psDescriptor = NULL;
 
 /*****************************************************************************/
@@ -0,0 +1,305 @@
+/* pcm.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Conversao entre amostras PCM intercaladas (inteiros de 16, 24 ou 32
+   bits, ou float de 32 bits, little-endian) e os buffers float de um
+   canal que os plugins usam:
+
+     pcmRead()    tira um canal de um bloco intercalado e o escala para
+                  float em [-1, 1), numa passada so
+     pcmWrite()   grava um buffer float como PCM mono, arredondando e
+                  saturando
+
+   Os dois recebem o nivel de simd.h (escolhido uma vez por quem chama)
+   e tem nucleos AVX2: int16 mono e' lido direto e convertido de 8 em 8;
+   os outros casos de leitura usam gather com o endereco recuado, para
+   que a amostra caia nos bits altos de uma palavra de 32 bits e o
+   deslocamento aritmetico faca a extensao de sinal. A escrita limita em
+   float e arredonda com cvtps; em 16 bits empacota com packs, em 24 bits
+   junta os 3 bytes de cada amostra com shuffle. As versoes escalares tratam o resto dos
+   blocos e os outros niveis. */
+
+#ifndef PCM_H
+#define PCM_H
+
+/*****************************************************************************/
+
+#include <string.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "simd.h"
+
+/*****************************************************************************/
+
+/* Formatos (os mesmos codigos do bloco fmt de um WAV) */
+#define PCM_INT 1
+#define PCM_FLOAT 3
+
+/*****************************************************************************/
+
+/* Nucleos escalares; lStart e' o primeiro quadro a converter */
+
+static inline void pcmReadScalar(const unsigned char * pucIn, unsigned int uFormat, unsigned int uBits,
+                                 unsigned int uChannels, unsigned int uChannel, unsigned long lStart,
+                                 unsigned long lFrames, float * pfOut)
+{
+
+    const unsigned char * pucSample;
+    unsigned long lFrame;
+    unsigned int uStride;
+    int iSample;
+    float fSample;
+
+    uStride = uChannels * (uBits / 8);
+    pucSample = pucIn + lStart * uStride + uChannel * (uBits / 8);
+
+    if (uFormat == PCM_FLOAT)
+    {
+        for (lFrame = lStart; lFrame < lFrames; lFrame++, pucSample += uStride)
+        {
+            memcpy(&fSample, pucSample, sizeof(float));
+            pfOut[lFrame] = fSample;
+        }
+    }
+    else if (uBits == 16)
+    {
+        for (lFrame = lStart; lFrame < lFrames; lFrame++, pucSample += uStride)
+            pfOut[lFrame] = (float)(short)(pucSample[0] | (pucSample[1] << 8)) * (1.0f / 32768.0f);
+    }
+    else if (uBits == 24)
+    {
+        for (lFrame = lStart; lFrame < lFrames; lFrame++, pucSample += uStride)
+        {
+            iSample = (int)(((unsigned int)pucSample[0] << 8) | ((unsigned int)pucSample[1] << 16)
+                            | ((unsigned int)pucSample[2] << 24)) >> 8;
+            pfOut[lFrame] = (float)iSample * (1.0f / 8388608.0f);
+        }
+    }
+    else
+    {
+        for (lFrame = lStart; lFrame < lFrames; lFrame++, pucSample += uStride)
+        {
+            iSample = (int)((unsigned int)pucSample[0] | ((unsigned int)pucSample[1] << 8)
+                            | ((unsigned int)pucSample[2] << 16) | ((unsigned int)pucSample[3] << 24));
+            pfOut[lFrame] = (float)((double)iSample * (1.0 / 2147483648.0));
+        }
+    }
+}
+
+static inline void pcmWriteScalar(const float * pfIn, unsigned long lStart, unsigned long lFrames,
+                                  unsigned int uFormat, unsigned int uBits, unsigned char * pucOut)
+{
+
+    unsigned long lFrame;
+    float fSample;
+    long lSample;
+
+    if (uFormat == PCM_FLOAT)
+    {
+        memcpy(pucOut + lStart * sizeof(float), pfIn + lStart, (lFrames - lStart) * sizeof(float));
+        return;
+    }
+
+    for (lFrame = lStart; lFrame < lFrames; lFrame++)
+    {
+        fSample = pfIn[lFrame];
+        if (uBits == 16)
+        {
+            lSample = lrintf(fSample * 32768.0f);
+            lSample = lSample > 32767 ? 32767 : lSample < -32768 ? -32768 : lSample;
+            pucOut[2 * lFrame] = (unsigned char)lSample;
+            pucOut[2 * lFrame + 1] = (unsigned char)(lSample >> 8);
+        }
+        else if (uBits == 24)
+        {
+            fSample = fSample > 8388607.0f / 8388608.0f ? 8388607.0f / 8388608.0f : fSample < -1.0f ? -1.0f : fSample;
+            lSample = lrintf(fSample * 8388608.0f);
+            pucOut[3 * lFrame] = (unsigned char)lSample;
+            pucOut[3 * lFrame + 1] = (unsigned char)(lSample >> 8);
+            pucOut[3 * lFrame + 2] = (unsigned char)(lSample >> 16);
+        }
+        else
+        {
+            lSample = (long)llrint((double)fSample * 2147483648.0);
+            lSample = lSample > 2147483647L ? 2147483647L : lSample < -2147483647L - 1 ? -2147483647L - 1 : lSample;
+            pucOut[4 * lFrame] = (unsigned char)lSample;
+            pucOut[4 * lFrame + 1] = (unsigned char)(lSample >> 8);
+            pucOut[4 * lFrame + 2] = (unsigned char)(lSample >> 16);
+            pucOut[4 * lFrame + 3] = (unsigned char)(lSample >> 24);
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/* Nucleos AVX2; devolvem ate onde converteram, e o escalar faz o resto */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define PCM_TARGET_AVX2 __attribute__((target("avx2")))
+
+static PCM_TARGET_AVX2 unsigned long pcmReadAvx2(const unsigned char * pucIn, unsigned int uFormat, unsigned int uBits,
+                                                 unsigned int uChannels, unsigned int uChannel, unsigned long lFrames,
+                                                 float * pfOut)
+{
+
+    const unsigned char * pucBase;
+    __m256i yOffsets;
+    __m256i yWords;
+    __m256 yScale;
+    unsigned long lFrame;
+    unsigned long lFirst;
+    unsigned int uBytes;
+    unsigned int uStride;
+    int iBack;
+
+    uBytes = uBits / 8;
+    uStride = uChannels * uBytes;
+
+    /* int16 mono: carga direta */
+    if (uFormat == PCM_INT && uBits == 16 && uChannels == 1)
+    {
+        yScale = _mm256_set1_ps(1.0f / 32768.0f);
+        for (lFrame = 0; lFrame + 8 <= lFrames; lFrame += 8)
+            _mm256_storeu_ps(pfOut + lFrame, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+                                 _mm_loadu_si128((const __m128i *)(pucIn + 2 * lFrame)))), yScale));
+        return lFrame;
+    }
+
+    /* Os outros casos: gather de 32 bits terminando no ultimo byte da
+       amostra. Os quadros do comeco em que o recuo sairia do buffer
+       ficam para o escalar, que os faz depois. */
+    if (uStride > 0x7fffffff / 8)
+        return 0;
+    iBack = 4 - (int)uBytes;
+    lFirst = 0;
+    while (lFirst < lFrames && (long)(lFirst * uStride + uChannel * uBytes) < iBack)
+        lFirst++;
+    pucBase = pucIn + uChannel * uBytes - iBack;
+    yOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)uStride));
+
+    if (uFormat == PCM_FLOAT)
+    {
+        for (lFrame = lFirst; lFrame + 8 <= lFrames; lFrame += 8)
+            _mm256_storeu_ps(pfOut + lFrame, _mm256_i32gather_ps((const float *)(pucBase + lFrame * uStride), yOffsets, 1));
+        return lFrame;
+    }
+
+    yScale = _mm256_set1_ps(uBits == 16 ? 1.0f / 32768.0f : uBits == 24 ? 1.0f / 8388608.0f : 1.0f / 2147483648.0f);
+    for (lFrame = lFirst; lFrame + 8 <= lFrames; lFrame += 8)
+    {
+        yWords = _mm256_i32gather_epi32((const int *)(pucBase + lFrame * uStride), yOffsets, 1);
+        if (uBits == 16)
+            yWords = _mm256_srai_epi32(yWords, 16);
+        else if (uBits == 24)
+            yWords = _mm256_srai_epi32(yWords, 8);
+        _mm256_storeu_ps(pfOut + lFrame, _mm256_mul_ps(_mm256_cvtepi32_ps(yWords), yScale));
+    }
+    return lFrame;
+}
+
+static PCM_TARGET_AVX2 unsigned long pcmWriteAvx2(const float * pfIn, unsigned long lFrames, unsigned int uBits,
+                                                  unsigned char * pucOut)
+{
+
+    __m256i yPacked;
+    __m256i yShuffle;
+    __m256 yScale;
+    __m256 yMax;
+    __m256 yMin;
+    unsigned long lFrame;
+
+    if (uBits == 16)
+    {
+        /* cvtps arredonda para o par mais proximo, como o lrintf(); o
+           limite em float evita que valores enormes virem INT_MIN antes
+           da saturacao do packs */
+        yScale = _mm256_set1_ps(32768.0f);
+        yMax = _mm256_set1_ps(32767.0f);
+        yMin = _mm256_set1_ps(-32768.0f);
+        for (lFrame = 0; lFrame + 16 <= lFrames; lFrame += 16)
+        {
+            yPacked = _mm256_packs_epi32(
+                _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(pfIn + lFrame), yScale), yMin), yMax)),
+                _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(pfIn + lFrame + 8), yScale), yMin), yMax)));
+            _mm256_storeu_si256((__m256i *)(pucOut + 2 * lFrame), _mm256_permute4x64_epi64(yPacked, 0xd8));
+        }
+        return lFrame;
+    }
+
+    if (uBits != 24)
+        return 0;
+
+    /* 24 bits: 4 amostras de 3 bytes por metade; cada store de 16 bytes
+       passa 4 do fim, que o proximo sobrescreve, dai a folga no laco */
+    yScale = _mm256_set1_ps(8388608.0f);
+    yMax = _mm256_set1_ps(8388607.0f);
+    yMin = _mm256_set1_ps(-8388608.0f);
+    yShuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (lFrame = 0; lFrame + 10 <= lFrames; lFrame += 8)
+    {
+        yPacked = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(pfIn + lFrame), yScale), yMin), yMax));
+        yPacked = _mm256_shuffle_epi8(yPacked, yShuffle);
+        _mm_storeu_si128((__m128i *)(pucOut + 3 * lFrame), _mm256_castsi256_si128(yPacked));
+        _mm_storeu_si128((__m128i *)(pucOut + 3 * lFrame + 12), _mm256_extracti128_si256(yPacked, 1));
+    }
+    return lFrame;
+}
+
+#endif
+
+/*****************************************************************************/
+
+/* Converte lFrames quadros do canal uChannel de um bloco intercalado de
+   uChannels canais para float */
+static inline void pcmRead(const void * pvIn, unsigned int uFormat, unsigned int uBits, unsigned int uChannels,
+                           unsigned int uChannel, unsigned long lFrames, float * pfOut, int iSimd)
+{
+
+    unsigned long lDone;
+    unsigned long lFirst;
+
+    lDone = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (iSimd >= SIMD_AVX2)
+        lDone = pcmReadAvx2((const unsigned char *)pvIn, uFormat, uBits, uChannels, uChannel, lFrames, pfOut);
+#endif
+    if (lDone == 0)
+    {
+        pcmReadScalar((const unsigned char *)pvIn, uFormat, uBits, uChannels, uChannel, 0, lFrames, pfOut);
+        return;
+    }
+
+    /* Os primeiros quadros que o gather pulou, e o resto */
+    for (lFirst = 0; lFirst < lFrames && lFirst * uChannels * (uBits / 8) + uChannel * (uBits / 8) < 4 - uBits / 8; lFirst++)
+        ;
+    pcmReadScalar((const unsigned char *)pvIn, uFormat, uBits, uChannels, uChannel, 0, lFirst, pfOut);
+    pcmReadScalar((const unsigned char *)pvIn, uFormat, uBits, uChannels, uChannel, lDone, lFrames, pfOut);
+}
+
+/* Grava lFrames amostras como PCM mono (uFormat, uBits) em pvOut */
+static inline void pcmWrite(const float * pfIn, unsigned long lFrames, unsigned int uFormat, unsigned int uBits,
+                            void * pvOut, int iSimd)
+{
+
+    unsigned long lDone;
+
+    lDone = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (iSimd >= SIMD_AVX2 && uFormat == PCM_INT)
+        lDone = pcmWriteAvx2(pfIn, lFrames, uBits, (unsigned char *)pvOut);
+#endif
+    pcmWriteScalar(pfIn, lDone, lFrames, uFormat, uBits, (unsigned char *)pvOut);
+}
+
+/*****************************************************************************/
+
+#endif /* PCM_H */
+
+/* EOF */
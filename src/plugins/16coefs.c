@@ -16,6 +16,7 @@
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "sondas.h"
 
 /*****************************************************************************/
 
@@ -110,6 +111,8 @@ typedef struct
 
     unsigned long m_lBufferOffset;
 
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
 } Filter;
 
 /*****************************************************************************/
@@ -138,6 +141,8 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
 
     pFilter->m_lBufferOffset = 0;
 
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
+
     return pFilter;
 }
 
@@ -154,6 +159,8 @@ void activateFilter(LADSPA_Handle Instance)
 
     pFilter->m_lBufferOffset = 0;
 
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
+
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoef*/
 
 /*****************************************************************************/
@@ -280,6 +287,9 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
     lBufferOffset = pFilter->m_lBufferOffset;
 
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, TAM_FILTRO);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
     {
         /* O buffer recebe a mais recente amostra de x(n) */
@@ -310,6 +320,9 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
     pFilter->m_lBufferOffset = (pFilter->m_lBufferOffset + SampleCount) & TAM_FILTRO_1; /* Atualiza o indice do ponteiro dos vetores circulares*/
 
+    /* Coeficientes fixos, vindos das portas: nada se adapta */
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, 0);
+
 }
 
 /*****************************************************************************/
@@ -322,6 +335,7 @@ cleanupFilter(LADSPA_Handle Instance)
     Filter * pFilter;
 
     pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
 
     free(pFilter->m_pfBuffer);
 
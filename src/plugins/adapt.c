@@ -18,6 +18,8 @@
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "sondas.h"
+#include "medidores.h"
 
 /*****************************************************************************/
 
@@ -34,9 +36,15 @@
 #define SDL_INPUTX        3
 #define SDL_OUTPUT        4
 
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define SDL_ERLE          5
+#define SDL_UPDATE_RATE   6
+#define SDL_DTD           7
+
 /* Quantidade de portas */
 
-#define NOPORTS 5
+#define NOPORTS 8
 
 /*****************************************************************************/
 
@@ -80,6 +88,11 @@ typedef struct {
   /* Output audio port data location. */
   LADSPA_Data * m_pfOutput;
 
+  /* Portas de medicao (veja medidores.h) */
+  MeterPorts m_sMeters;
+
+  ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
 } SimpleAdaptiveFilter;
 
 /*****************************************************************************/
@@ -122,6 +135,9 @@ instantiateSimpleAdaptiveFilter(const LADSPA_Descriptor * Descriptor, unsigned l
 
 
   psAdaptiveFilter->m_lWritePointer = 0; /* Inicializa o vetor de escrita */
+  memset(&psAdaptiveFilter->m_sMeters, 0, sizeof(MeterPorts));
+
+  PROBE_INSTANTIATE(&psAdaptiveFilter->m_sProbes, psAdaptiveFilter, Descriptor->UniqueID, SampleRate);
 
   return psAdaptiveFilter;
 }
@@ -140,6 +156,7 @@ activateSimpleAdaptiveFilter(LADSPA_Handle Instance) {
      been called to reinitialise a delay line. */
   memset(psSimpleAdaptiveFilter->m_pfBuffer, 0, sizeof(LADSPA_Data) * psSimpleAdaptiveFilter->m_lFilterSize);
   memset(psSimpleAdaptiveFilter->m_pfCoefs, 0, sizeof(LADSPA_Data) * psSimpleAdaptiveFilter->m_lFilterSize);
+  PROBE_ACTIVATE(&psSimpleAdaptiveFilter->m_sProbes, psSimpleAdaptiveFilter);
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/
 
 /*****************************************************************************/
@@ -169,6 +186,11 @@ connectPortToSimpleAdaptiveFilter(LADSPA_Handle Instance,
   case SDL_OUTPUT:
     psSimpleAdaptiveFilter->m_pfOutput = DataLocation;
     break;
+  case SDL_ERLE:
+  case SDL_UPDATE_RATE:
+  case SDL_DTD:
+    meterConnect(&psSimpleAdaptiveFilter->m_sMeters, Port - SDL_ERLE, DataLocation);
+    break;
   }
 }
 
@@ -185,7 +207,10 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
   LADSPA_Data * pfInputX; /* Aponta para o bloco de amostras da entrada x(n) */
   LADSPA_Data * pfOutput; /* Aponta para o bloco de amostras da saida */
   LADSPA_Data fConvSample;
+  LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
   LADSPA_Data fErrSample;
+  LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+  LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
   LADSPA_Data fMu;
   SimpleAdaptiveFilter * psSimpleAdaptiveFilter;
   unsigned long lBufferSizeMinusOne;
@@ -207,6 +232,9 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
   fMu      = *psSimpleAdaptiveFilter->m_pfMu;
   lBufferWriteOffset = psSimpleAdaptiveFilter->m_lWritePointer;
 
+  PROBE_RUN_ENTRY(&psSimpleAdaptiveFilter->m_sProbes, psSimpleAdaptiveFilter, SampleCount);
+  PROBE_LENGTH(&psSimpleAdaptiveFilter->m_sProbes, psSimpleAdaptiveFilter, lCoefs);
+
   for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
   {
       lIndex = lSampleIndex + lBufferWriteOffset;
@@ -219,8 +247,11 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
           fConvSample+=pfCoefs[lConv]*pfBuffer[((lIndex - lConv) & lBufferSizeMinusOne)];
       }
 
-    fErrSample = *(pfInputD++) - fConvSample;
+    fD = *(pfInputD++);
+    fErrSample = fD - fConvSample;
     *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+    fPotD += fD * fD;
+    fPotE += fErrSample * fErrSample;
 
 	for(lConv = 0; lConv < lCoefs; lConv++) /* w(n+1) = w(n) + 2 * mu * e(n) * X(n) */
           pfCoefs[lConv]+=fMu*fErrSample*pfBuffer[((lIndex - lConv) & lBufferSizeMinusOne)];
@@ -228,6 +259,10 @@ runSimpleAdaptiveFilter(LADSPA_Handle Instance,
   }
 
   psSimpleAdaptiveFilter->m_lWritePointer = ((psSimpleAdaptiveFilter->m_lWritePointer + SampleCount) & lBufferSizeMinusOne); /* Atualiza o indice do ponteiro dos vetores circulares*/
+
+  /* Sem DTD: o LMS atualiza em toda amostra e a estatistica do DTD fica em 0 */
+  meterPublish(&psSimpleAdaptiveFilter->m_sMeters, SampleCount, fPotD, fPotE, SampleCount, 0, 1);
+  PROBE_RUN_EXIT(&psSimpleAdaptiveFilter->m_sProbes, psSimpleAdaptiveFilter, SampleCount, SampleCount);
 }
 
 /*****************************************************************************/
@@ -239,6 +274,7 @@ cleanupSimpleAdaptiveFilter(LADSPA_Handle Instance) {
   SimpleAdaptiveFilter * psSimpleAdaptiveFilter;
 
   psSimpleAdaptiveFilter = (SimpleAdaptiveFilter *)Instance;
+  PROBE_CLEANUP(&psSimpleAdaptiveFilter->m_sProbes, psSimpleAdaptiveFilter);
 
   free(psSimpleAdaptiveFilter->m_pfBuffer);
   free(psSimpleAdaptiveFilter->m_pfCoefs);
@@ -331,6 +367,7 @@ _init() {
       = 0;
     psPortRangeHints[SDL_OUTPUT].HintDescriptor
       = 0;
+    meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, SDL_ERLE, METER_PORTS_LINEAR);
     g_psDescriptor->instantiate
       = instantiateSimpleAdaptiveFilter;
     g_psDescriptor->connect_port
@@ -0,0 +1,833 @@
+/* Software livre por Pedro Nariyoshi. Sem garantias.
+
+   Este plugin LADSPA executa um algoritmo de cancelamento de eco acu'stico
+   em blocos, no dominio da frequencia: NLMS particionado (PBFDAF), com o
+   filtro dividido em particoes de TAM_QUADRO coeficientes, overlap-save,
+   passo normalizado por bin e gradiente restrito (a metade nao causal de
+   cada particao e' zerada a cada quadro).
+
+   O motor so funciona com quadros inteiros de TAM_QUADRO amostras; o
+   enquadramento fica em quadros.h, entao o run() aceita qualquer
+   SampleCount e a saida nao depende dos blocos do host. Em troca, e(n)
+   sai com TAM_QUADRO amostras de atraso, declaradas na porta "latency".
+
+   O detector de fala dupla e' o de Geigel, como no nlmsgeigel: ha fala
+   dupla na amostra n se |d(n)| >= limiar * max|x| nas ultimas amostras
+   da janela do DTD. O maximo da janela sai de uma fila monotona, a custo
+   constante por amostra. A fala dupla se mantem (hangover) por mais uma
+   janela do DTD depois da ultima amostra que disparou o detector, e o
+   motor, que atualiza os coeficientes uma vez por quadro, congela o
+   quadro inteiro se mais de FRACAO_DT das amostras dele tiverem fala
+   dupla (por padrao, qualquer uma): a fala local nas bordas do disparo,
+   abaixo do limiar, nao entra no gradiente. Com ERL perto de 6 dB,
+   |d|/max|x| chega a 0,5 sem fala local, entao o limiar padrao fica em
+   0,4 (o meio da faixa). No qualidade -q (8 kHz, 32 ms), isso da 11 dB
+   de ERLE depois da fala dupla, contra 7 dB do mascaramento por amostra
+   sem hangover, e o filtro sai dela mais alinhado; o preco e' o regime,
+   com mais quadros congelados nas pausas. A 16 kHz um limiar de 0,5
+   rende mais, mas a 8 kHz deixa o filtro divergir na fala dupla.
+   Decisoes de amostras que chegaram em blocos anteriores do host nao vao
+   para as sondas nem para a gravacao.
+
+   O ERLE do medidor compara e(n) com o d(n) do mesmo quadro, guardado
+   junto com a saida, e nao com o d(n) do bloco do host, que esta
+   TAM_QUADRO amostras adiante.
+
+   Possui pouca protecao de memoria. Falhas no malloc nao se recuperam bem.
+*/
+
+/*****************************************************************************/
+
+#include "ladspa.h"
+#include "fft.h"
+#include "quadros.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*****************************************************************************/
+
+/* Parametros do filtro */
+
+#define TAM_QUADRO 256 /* Quadro e particao (potencia de 2); e' a latencia */
+#define TAM_FFT (2 * TAM_QUADRO)
+#define NO_BINS (TAM_QUADRO + 1)
+#define MAX_ECO_MS 1000 /* Maximo tempo de eco (cuidado com a memoria) */
+#define MAX_DTD_MS 20 /* Janela maxima do Geigel */
+#define MAX_LIMIAR 0.8f /* Limite superior do limiar do DTD */
+#define FRACAO_DT 0 /* Fracao do quadro com fala dupla que o congela (0: qualquer amostra) */
+#define EPSILON 0.001 /* Regularizacao do passo, por amostra da janela */
+#define ESQUECIMENTO 0.9f /* Media da potencia de X por bin */
+
+/* Canais do enquadramento */
+
+#define QUADRO_D 0
+#define QUADRO_X 1
+#define QUADRO_E 0
+
+/*****************************************************************************/
+
+/* A numeracao das portas do filtro */
+
+#define FD_FILTER_LENGTH 0
+#define FD_DTD_LENGTH    1
+#define FD_DTD_THRESHOLD 2
+#define FD_MU            3
+#define FD_INPUTD        4
+#define FD_INPUTX        5
+#define FD_OUTPUT        6
+#define FD_LATENCY       7
+
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define FD_ERLE          8
+#define FD_UPDATE_RATE   9
+#define FD_GEIGEL        10
+
+/* Quantidade de portas */
+
+#define NOPORTS 11
+
+/*****************************************************************************/
+
+/* Estrutura do filtro */
+typedef struct
+{
+
+    Framer m_sFramer;
+
+    FFTPlan * m_pPlan;
+
+    LADSPA_Data m_fSampleRate;
+
+    /* Particoes alocadas e em uso no ultimo quadro */
+    unsigned long m_lMaxPartitions;
+    unsigned long m_lPartitions;
+
+    /* Espectros dos coeficientes (m_lMaxPartitions * NO_BINS cada) */
+    LADSPA_Data * m_pfCoefRe;
+    LADSPA_Data * m_pfCoefIm;
+
+    /* Linha de atraso no dominio da frequencia: espectros dos ultimos quadros de x(n) */
+    LADSPA_Data * m_pfDelayRe;
+    LADSPA_Data * m_pfDelayIm;
+    unsigned long m_lDelayPos;
+
+    /* Potencia media de X por bin, para o passo normalizado */
+    LADSPA_Data * m_pfPower;
+
+    /* Janela do overlap-save: [quadro anterior, quadro atual] de x(n) */
+    LADSPA_Data * m_pfWindow;
+
+    /* DTD: |x(n)| das ultimas amostras e fila monotona (decrescente) com
+       os numeros das amostras candidatas a maximo da janela */
+    LADSPA_Data * m_pfDtdX;
+    unsigned long * m_plDtdQueue;
+    unsigned long m_lDtdSize; /* Potencia de 2 */
+    unsigned long m_lDtdHead;
+    unsigned long m_lDtdTail;
+    unsigned long m_lSample; /* Amostras de x(n) desde o activate() */
+    unsigned long m_lHangover; /* Amostras que ainda ficam com fala dupla depois do ultimo disparo */
+    char m_acDoubleTalk[TAM_QUADRO]; /* Decisao de cada amostra do quadro */
+
+    /* d(n) do quadro que esta saindo (o da fila de saida do enquadramento)
+       e a primeira posicao dele que sai no bloco atual do host */
+    LADSPA_Data m_afDelayedD[TAM_QUADRO];
+    unsigned long m_lEmitStart;
+
+    /* Areas de trabalho */
+    LADSPA_Data * m_pfAccRe;
+    LADSPA_Data * m_pfAccIm;
+    LADSPA_Data * m_pfErrRe;
+    LADSPA_Data * m_pfErrIm;
+    LADSPA_Data * m_pfTime;
+
+    /* Controles lidos no inicio do run(), usados pelos quadros dele */
+    LADSPA_Data m_fEchoTime;
+    LADSPA_Data m_fMu;
+    unsigned long m_lDCoefs;
+    LADSPA_Data m_fDtdThreshold;
+
+    /* Estado do run() atual, atualizado por quadro */
+    long m_lFrameStart; /* Primeira amostra do proximo quadro, no bloco do host (negativa: veio de blocos anteriores) */
+    unsigned long m_lUpdates;
+    LADSPA_Data m_fPotD; /* Energia do d(n) alinhado com o e(n) que saiu no bloco */
+    LADSPA_Data m_fGeigel; /* Maior |d|/max|x| do ultimo quadro */
+
+    /* Ports:
+     ------ */
+
+    /* Tamanho do eco maximo em ms */
+    LADSPA_Data * m_pfEchoTime;
+
+    /* Janela do DTD em ms */
+    LADSPA_Data * m_pfDtdTime;
+
+    /* Limiar do DTD */
+    LADSPA_Data * m_pfDtdThreshold;
+
+    /* Valor do fator de convergencia */
+    LADSPA_Data * m_pfMu;
+
+    /* Input audio port data location. */
+    LADSPA_Data * m_pfInputD;
+
+    /* Input audio port data location. */
+    LADSPA_Data * m_pfInputX;
+
+    /* Output audio port data location. */
+    LADSPA_Data * m_pfOutput;
+
+    /* Atraso da saida em amostras (saida de controle) */
+    LADSPA_Data * m_pfLatency;
+
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
+} Filter;
+
+/*****************************************************************************/
+
+LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned long SampleRate)
+{
+
+    Filter * pFilter;
+    unsigned long lBins;
+
+    pFilter = (Filter *)calloc(1, sizeof(Filter));
+
+    if (pFilter == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    pFilter->m_fSampleRate = (LADSPA_Data)SampleRate;
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
+    pFilter->m_lDtdSize = 1;
+    while (pFilter->m_lDtdSize < (unsigned long)(MAX_DTD_MS * SampleRate * 0.001) + 1)
+        pFilter->m_lDtdSize <<= 1;
+    pFilter->m_lMaxPartitions = ((unsigned long)(MAX_ECO_MS * SampleRate * 0.001) + TAM_QUADRO - 1) / TAM_QUADRO;
+    if (pFilter->m_lMaxPartitions == 0)
+        pFilter->m_lMaxPartitions = 1;
+    lBins = pFilter->m_lMaxPartitions * NO_BINS;
+
+    pFilter->m_pPlan     = createFFTPlan(TAM_FFT);
+    pFilter->m_pfCoefRe  = (LADSPA_Data *)calloc(lBins, sizeof(LADSPA_Data));
+    pFilter->m_pfCoefIm  = (LADSPA_Data *)calloc(lBins, sizeof(LADSPA_Data));
+    pFilter->m_pfDelayRe = (LADSPA_Data *)calloc(lBins, sizeof(LADSPA_Data));
+    pFilter->m_pfDelayIm = (LADSPA_Data *)calloc(lBins, sizeof(LADSPA_Data));
+    pFilter->m_pfPower   = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfWindow  = (LADSPA_Data *)calloc(TAM_FFT, sizeof(LADSPA_Data));
+    pFilter->m_pfAccRe   = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfAccIm   = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfErrRe   = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfErrIm   = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfTime    = (LADSPA_Data *)calloc(TAM_FFT, sizeof(LADSPA_Data));
+    pFilter->m_pfDtdX    = (LADSPA_Data *)calloc(pFilter->m_lDtdSize, sizeof(LADSPA_Data));
+    pFilter->m_plDtdQueue = (unsigned long *)calloc(pFilter->m_lDtdSize, sizeof(unsigned long));
+
+    if (pFilter->m_pfDtdX == NULL || pFilter->m_plDtdQueue == NULL || pFilter->m_pPlan == NULL || pFilter->m_pfCoefRe == NULL || pFilter->m_pfCoefIm == NULL || pFilter->m_pfDelayRe == NULL || pFilter->m_pfDelayIm == NULL || pFilter->m_pfPower == NULL || pFilter->m_pfWindow == NULL || pFilter->m_pfAccRe == NULL || pFilter->m_pfAccIm == NULL || pFilter->m_pfErrRe == NULL || pFilter->m_pfErrIm == NULL || pFilter->m_pfTime == NULL
+        || !framerInit(&pFilter->m_sFramer, TAM_QUADRO, 2, 1))
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, FD_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
+
+    return pFilter;
+}
+
+/*****************************************************************************/
+
+/* Inicializa os valores do filtro no caso desativa/ativa */
+void activateFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+    unsigned long lBins;
+
+    pFilter = (Filter *)Instance;
+    lBins = pFilter->m_lMaxPartitions * NO_BINS;
+
+    memset(pFilter->m_pfCoefRe, 0, sizeof(LADSPA_Data) * lBins);
+    memset(pFilter->m_pfCoefIm, 0, sizeof(LADSPA_Data) * lBins);
+    memset(pFilter->m_pfDelayRe, 0, sizeof(LADSPA_Data) * lBins);
+    memset(pFilter->m_pfDelayIm, 0, sizeof(LADSPA_Data) * lBins);
+    memset(pFilter->m_pfPower, 0, sizeof(LADSPA_Data) * NO_BINS);
+    memset(pFilter->m_pfWindow, 0, sizeof(LADSPA_Data) * TAM_FFT);
+    memset(pFilter->m_pfDtdX, 0, sizeof(LADSPA_Data) * pFilter->m_lDtdSize);
+    pFilter->m_lDtdHead = 0;
+    pFilter->m_lDtdTail = 0;
+    pFilter->m_lSample = 0;
+    pFilter->m_lHangover = 0;
+    memset(pFilter->m_afDelayedD, 0, sizeof(pFilter->m_afDelayedD));
+    pFilter->m_fGeigel = 0;
+    pFilter->m_lDelayPos = 0;
+    pFilter->m_lPartitions = 0;
+    framerReset(&pFilter->m_sFramer);
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
+
+}
+
+/*****************************************************************************/
+
+/* Conecta os ponteiros 'as portas do filtro */
+void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data * DataLocation)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+    switch (Port)
+    {
+    case FD_FILTER_LENGTH:
+        pFilter->m_pfEchoTime = DataLocation;
+        break;
+    case FD_DTD_LENGTH:
+        pFilter->m_pfDtdTime = DataLocation;
+        break;
+    case FD_DTD_THRESHOLD:
+        pFilter->m_pfDtdThreshold = DataLocation;
+        break;
+    case FD_MU:
+        pFilter->m_pfMu = DataLocation;
+        break;
+    case FD_INPUTD:
+        pFilter->m_pfInputD = DataLocation;
+        break;
+    case FD_INPUTX:
+        pFilter->m_pfInputX = DataLocation;
+        break;
+    case FD_OUTPUT:
+        pFilter->m_pfOutput = DataLocation;
+        break;
+    case FD_LATENCY:
+        pFilter->m_pfLatency = DataLocation;
+        break;
+    case FD_ERLE:
+    case FD_UPDATE_RATE:
+    case FD_GEIGEL:
+        meterConnect(&pFilter->m_sMeters, Port - FD_ERLE, DataLocation);
+        break;
+    }
+}
+
+/*****************************************************************************/
+
+/* Geigel nas TAM_QUADRO amostras de um quadro. Marca as que tem fala
+   dupla (ou estao no hangover de um disparo) em m_acDoubleTalk, devolve
+   quantas sao e guarda a maior estatistica em m_fGeigel. */
+static unsigned long detectDoubleTalk(Filter * pFilter, const LADSPA_Data * pfInputD, const LADSPA_Data * pfInputX)
+{
+
+    LADSPA_Data * pfDtdX;
+    unsigned long * plQueue;
+    LADSPA_Data fAbsX;
+    LADSPA_Data fGeigel;
+    LADSPA_Data fMaxGeigel;
+    unsigned long lMask;
+    unsigned long lHead;
+    unsigned long lTail;
+    unsigned long lSample;
+    unsigned long lIndex;
+    unsigned long lDoubleTalk;
+    unsigned long lHangover;
+
+    pfDtdX = pFilter->m_pfDtdX;
+    plQueue = pFilter->m_plDtdQueue;
+    lMask = pFilter->m_lDtdSize - 1;
+    lHead = pFilter->m_lDtdHead;
+    lTail = pFilter->m_lDtdTail;
+    lSample = pFilter->m_lSample;
+    lHangover = pFilter->m_lHangover;
+    fMaxGeigel = 0;
+    lDoubleTalk = 0;
+
+    for (lIndex = 0; lIndex < TAM_QUADRO; lIndex++, lSample++)
+    {
+        /* Sai da fila quem ja tem m_lDCoefs amostras ou mais */
+        while (lHead != lTail && plQueue[lHead & lMask] + pFilter->m_lDCoefs <= lSample)
+            lHead++;
+
+        /* Entra |x(n)|, tirando do fim quem nao pode mais ser o maximo */
+        fAbsX = fabsf(pfInputX[lIndex]);
+        while (lTail != lHead && pfDtdX[plQueue[(lTail - 1) & lMask] & lMask] <= fAbsX)
+            lTail--;
+        plQueue[lTail++ & lMask] = lSample;
+        pfDtdX[lSample & lMask] = fAbsX;
+
+        /* O inicio da fila e' o maximo da janela */
+        fGeigel = fabsf(pfInputD[lIndex]) / pfDtdX[plQueue[lHead & lMask] & lMask];
+        if (!(fGeigel < pFilter->m_fDtdThreshold))
+        {
+            pFilter->m_acDoubleTalk[lIndex] = 1;
+            lHangover = pFilter->m_lDCoefs;
+        }
+        else
+        {
+            pFilter->m_acDoubleTalk[lIndex] = lHangover > 0;
+            if (lHangover > 0)
+                lHangover--;
+        }
+        lDoubleTalk += pFilter->m_acDoubleTalk[lIndex];
+        if (fGeigel > fMaxGeigel)
+            fMaxGeigel = fGeigel;
+    }
+
+    pFilter->m_lDtdHead = lHead;
+    pFilter->m_lDtdTail = lTail;
+    pFilter->m_lSample = lSample;
+    pFilter->m_lHangover = lHangover;
+    pFilter->m_fGeigel = fMaxGeigel;
+    return lDoubleTalk;
+}
+
+/*****************************************************************************/
+
+/* Um quadro do motor (FramerProcess): d(n) e x(n) de TAM_QUADRO amostras
+   entram, e(n) sai */
+static void processFrame(void * pvFilter, const float * const * ppfIn, float * const * ppfOut)
+{
+
+    Filter * pFilter;
+    const LADSPA_Data * pfInputD;
+    LADSPA_Data * pfOutput;
+    LADSPA_Data * pfCoefRe;
+    LADSPA_Data * pfCoefIm;
+    const LADSPA_Data * pfXRe;
+    const LADSPA_Data * pfXIm;
+    LADSPA_Data * pfAccRe;
+    LADSPA_Data * pfAccIm;
+    LADSPA_Data * pfErrRe;
+    LADSPA_Data * pfErrIm;
+    LADSPA_Data * pfPower;
+    LADSPA_Data * pfTime;
+    LADSPA_Data fMs;
+    LADSPA_Data fStep;
+    LADSPA_Data fGain;
+    LADSPA_Data fRe;
+    unsigned long lPartitions;
+    unsigned long lPartition;
+    unsigned long lSlot;
+    unsigned long lBin;
+    unsigned long lIndex;
+    unsigned long lFirst;
+    unsigned long lSample;
+    unsigned long lDoubleTalk;
+
+    pFilter = (Filter *)pvFilter;
+    pfInputD = ppfIn[QUADRO_D];
+    pfOutput = ppfOut[QUADRO_E];
+    pfAccRe = pFilter->m_pfAccRe;
+    pfAccIm = pFilter->m_pfAccIm;
+    pfErrRe = pFilter->m_pfErrRe;
+    pfErrIm = pFilter->m_pfErrIm;
+    pfPower = pFilter->m_pfPower;
+    pfTime = pFilter->m_pfTime;
+
+    /* Particoes em uso; as que saem do filtro voltam a zero */
+    fMs = pFilter->m_fEchoTime < 0 ? 0 : pFilter->m_fEchoTime > MAX_ECO_MS ? MAX_ECO_MS : pFilter->m_fEchoTime;
+    lPartitions = ((unsigned long)(fMs * pFilter->m_fSampleRate * 0.001) + TAM_QUADRO - 1) / TAM_QUADRO;
+    if (lPartitions == 0)
+        lPartitions = 1;
+    if (lPartitions > pFilter->m_lMaxPartitions)
+        lPartitions = pFilter->m_lMaxPartitions;
+    if (lPartitions < pFilter->m_lPartitions)
+    {
+        memset(pFilter->m_pfCoefRe + lPartitions * NO_BINS, 0, sizeof(LADSPA_Data) * (pFilter->m_lPartitions - lPartitions) * NO_BINS);
+        memset(pFilter->m_pfCoefIm + lPartitions * NO_BINS, 0, sizeof(LADSPA_Data) * (pFilter->m_lPartitions - lPartitions) * NO_BINS);
+    }
+    pFilter->m_lPartitions = lPartitions;
+
+    lDoubleTalk = detectDoubleTalk(pFilter, pfInputD, ppfIn[QUADRO_X]);
+
+    /* X_k entra na posicao mais recente da linha de atraso circular */
+    memcpy(pFilter->m_pfWindow + TAM_QUADRO, ppfIn[QUADRO_X], sizeof(LADSPA_Data) * TAM_QUADRO);
+    pFilter->m_lDelayPos = (pFilter->m_lDelayPos + 1) % pFilter->m_lMaxPartitions;
+    fftReal(pFilter->m_pPlan, pFilter->m_pfWindow, pFilter->m_pfDelayRe + pFilter->m_lDelayPos * NO_BINS, pFilter->m_pfDelayIm + pFilter->m_lDelayPos * NO_BINS);
+    pfXRe = pFilter->m_pfDelayRe + pFilter->m_lDelayPos * NO_BINS;
+    pfXIm = pFilter->m_pfDelayIm + pFilter->m_lDelayPos * NO_BINS;
+    memcpy(pFilter->m_pfWindow, pFilter->m_pfWindow + TAM_QUADRO, sizeof(LADSPA_Data) * TAM_QUADRO);
+
+    for (lBin = 0; lBin < NO_BINS; lBin++)
+        pfPower[lBin] = ESQUECIMENTO * pfPower[lBin] + (1 - ESQUECIMENTO) * (pfXRe[lBin] * pfXRe[lBin] + pfXIm[lBin] * pfXIm[lBin]);
+
+    /* Y = soma_p W_p * X_(k-p); so a segunda metade da convolucao circular vale */
+    memset(pfAccRe, 0, sizeof(LADSPA_Data) * NO_BINS);
+    memset(pfAccIm, 0, sizeof(LADSPA_Data) * NO_BINS);
+    lSlot = pFilter->m_lDelayPos;
+    for (lPartition = 0; lPartition < lPartitions; lPartition++)
+    {
+        pfCoefRe = pFilter->m_pfCoefRe + lPartition * NO_BINS;
+        pfCoefIm = pFilter->m_pfCoefIm + lPartition * NO_BINS;
+        pfXRe = pFilter->m_pfDelayRe + lSlot * NO_BINS;
+        pfXIm = pFilter->m_pfDelayIm + lSlot * NO_BINS;
+        for (lBin = 0; lBin < NO_BINS; lBin++)
+        {
+            pfAccRe[lBin] += pfCoefRe[lBin] * pfXRe[lBin] - pfCoefIm[lBin] * pfXIm[lBin];
+            pfAccIm[lBin] += pfCoefRe[lBin] * pfXIm[lBin] + pfCoefIm[lBin] * pfXRe[lBin];
+        }
+        lSlot = (lSlot == 0) ? pFilter->m_lMaxPartitions - 1 : lSlot - 1;
+    }
+    fftRealInverse(pFilter->m_pPlan, pfAccRe, pfAccIm, pfTime);
+
+    /* O quadro anterior acabou de sair: o resto dele conta no ERLE do bloco */
+    for (lIndex = pFilter->m_lEmitStart; lIndex < TAM_QUADRO; lIndex++)
+        pFilter->m_fPotD += pFilter->m_afDelayedD[lIndex] * pFilter->m_afDelayedD[lIndex];
+    pFilter->m_lEmitStart = 0;
+    memcpy(pFilter->m_afDelayedD, pfInputD, sizeof(LADSPA_Data) * TAM_QUADRO);
+
+    /* e(n) = d(n) - y(n), e E = FFT([0, e]) */
+    for (lIndex = 0; lIndex < TAM_QUADRO; lIndex++)
+        pfOutput[lIndex] = pfInputD[lIndex] - pfTime[TAM_QUADRO + lIndex];
+    memset(pfTime, 0, sizeof(LADSPA_Data) * TAM_QUADRO);
+    memcpy(pfTime + TAM_QUADRO, pfOutput, sizeof(LADSPA_Data) * TAM_QUADRO);
+
+    /* Decisoes das amostras do quadro que estao neste bloco do host */
+    lFirst = pFilter->m_lFrameStart < 0 ? (unsigned long)(-pFilter->m_lFrameStart) : 0;
+    for (lIndex = lFirst; lIndex < TAM_QUADRO; lIndex++)
+    {
+        lSample = (unsigned long)(pFilter->m_lFrameStart + (long)lIndex);
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, pFilter->m_acDoubleTalk[lIndex], lSample);
+        dumpDtd(&pFilter->m_sDump, pFilter->m_acDoubleTalk[lIndex], lSample);
+    }
+    pFilter->m_lFrameStart += TAM_QUADRO;
+
+    /* Fala dupla em mais de FRACAO_DT do quadro congela o quadro inteiro */
+    if (lDoubleTalk > (unsigned long)(FRACAO_DT * TAM_QUADRO))
+        return;
+    pFilter->m_lUpdates += TAM_QUADRO - lFirst;
+
+    fftReal(pFilter->m_pPlan, pfTime, pfErrRe, pfErrIm);
+
+    /* Passo normalizado por bin: mu / (P * potencia de X) */
+    fStep = pFilter->m_fMu / (LADSPA_Data)lPartitions;
+    for (lBin = 0; lBin < NO_BINS; lBin++)
+    {
+        fGain = fStep / (pfPower[lBin] + (LADSPA_Data)(TAM_FFT * EPSILON));
+        pfErrRe[lBin] *= fGain;
+        pfErrIm[lBin] *= fGain;
+    }
+
+    /* W_p += restricao(conj(X_(k-p)) * E) */
+    lSlot = pFilter->m_lDelayPos;
+    for (lPartition = 0; lPartition < lPartitions; lPartition++)
+    {
+        pfXRe = pFilter->m_pfDelayRe + lSlot * NO_BINS;
+        pfXIm = pFilter->m_pfDelayIm + lSlot * NO_BINS;
+        for (lBin = 0; lBin < NO_BINS; lBin++)
+        {
+            fRe           = pfXRe[lBin] * pfErrRe[lBin] + pfXIm[lBin] * pfErrIm[lBin];
+            pfAccIm[lBin] = pfXRe[lBin] * pfErrIm[lBin] - pfXIm[lBin] * pfErrRe[lBin];
+            pfAccRe[lBin] = fRe;
+        }
+
+        /* So os TAM_QUADRO primeiros atrasos pertencem 'a particao */
+        fftRealInverse(pFilter->m_pPlan, pfAccRe, pfAccIm, pfTime);
+        memset(pfTime + TAM_QUADRO, 0, sizeof(LADSPA_Data) * TAM_QUADRO);
+        fftReal(pFilter->m_pPlan, pfTime, pfAccRe, pfAccIm);
+
+        pfCoefRe = pFilter->m_pfCoefRe + lPartition * NO_BINS;
+        pfCoefIm = pFilter->m_pfCoefIm + lPartition * NO_BINS;
+        for (lBin = 0; lBin < NO_BINS; lBin++)
+        {
+            pfCoefRe[lBin] += pfAccRe[lBin];
+            pfCoefIm[lBin] += pfAccIm[lBin];
+        }
+        lSlot = (lSlot == 0) ? pFilter->m_lMaxPartitions - 1 : lSlot - 1;
+    }
+}
+
+/*****************************************************************************/
+
+/* Roda a instancia do filtro adaptativo */
+void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
+{
+
+    Filter * pFilter;
+    const float * apfIn[2];
+    float * apfOut[1];
+    LADSPA_Data fDtdMs;
+    LADSPA_Data fPotD; /* Energia de d(n), alinhado com e(n), no bloco */
+    LADSPA_Data fPotE; /* Energia de e(n) no bloco */
+    unsigned long lSampleIndex;
+
+    pFilter = (Filter *)Instance;
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
+
+    pFilter->m_fEchoTime = *pFilter->m_pfEchoTime;
+    pFilter->m_fMu = *pFilter->m_pfMu;
+    fDtdMs = *pFilter->m_pfDtdTime < 0 ? 0 : *pFilter->m_pfDtdTime > MAX_DTD_MS ? MAX_DTD_MS : *pFilter->m_pfDtdTime;
+    pFilter->m_lDCoefs = (unsigned long)(fDtdMs * pFilter->m_fSampleRate * 0.001);
+    if (pFilter->m_lDCoefs == 0)
+        pFilter->m_lDCoefs = 1;
+    pFilter->m_fDtdThreshold = *pFilter->m_pfDtdThreshold;
+    pFilter->m_lFrameStart = -(long)pFilter->m_sFramer.m_lFill;
+    pFilter->m_lUpdates = 0;
+    pFilter->m_lEmitStart = pFilter->m_sFramer.m_lFill;
+    pFilter->m_fPotD = 0;
+
+    apfIn[QUADRO_D] = pFilter->m_pfInputD;
+    apfIn[QUADRO_X] = pFilter->m_pfInputX;
+    apfOut[QUADRO_E] = pFilter->m_pfOutput;
+    framerRun(&pFilter->m_sFramer, apfIn, apfOut, SampleCount, processFrame, pFilter);
+
+    /* O comeco do quadro que continua saindo no proximo bloco */
+    for (lSampleIndex = pFilter->m_lEmitStart; lSampleIndex < pFilter->m_sFramer.m_lFill; lSampleIndex++)
+        pFilter->m_fPotD += pFilter->m_afDelayedD[lSampleIndex] * pFilter->m_afDelayedD[lSampleIndex];
+    fPotD = pFilter->m_fPotD;
+
+    if (pFilter->m_pfLatency != NULL)
+        *pFilter->m_pfLatency = (LADSPA_Data)framerLatency(&pFilter->m_sFramer);
+
+    fPotE = 0;
+    for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
+        fPotE += pFilter->m_pfOutput[lSampleIndex] * pFilter->m_pfOutput[lSampleIndex];
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, pFilter->m_lUpdates, pFilter->m_fGeigel, 1);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, pFilter->m_lUpdates, pFilter->m_fGeigel, 1);
+
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, pFilter->m_lPartitions * TAM_QUADRO);
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, pFilter->m_lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, pFilter->m_lPartitions * TAM_QUADRO);
+
+}
+
+/*****************************************************************************/
+
+/* Este e' o destrutor do filtro */
+void cleanupFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    dumpStop(&pFilter->m_sDump);
+    framerFree(&pFilter->m_sFramer);
+    destroyFFTPlan(pFilter->m_pPlan);
+    free(pFilter->m_pfCoefRe);
+    free(pFilter->m_pfCoefIm);
+    free(pFilter->m_pfDelayRe);
+    free(pFilter->m_pfDelayIm);
+    free(pFilter->m_pfPower);
+    free(pFilter->m_pfWindow);
+    free(pFilter->m_pfAccRe);
+    free(pFilter->m_pfAccIm);
+    free(pFilter->m_pfErrRe);
+    free(pFilter->m_pfErrIm);
+    free(pFilter->m_pfTime);
+    free(pFilter->m_pfDtdX);
+    free(pFilter->m_plDtdQueue);
+    TIMING_DESTROY(pFilter->m_psTiming);
+    free(pFilter);
+}
+
+/*****************************************************************************/
+
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
+
+/*****************************************************************************/
+
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
+/*****************************************************************************/
+
+LADSPA_Descriptor * g_psDescriptor = NULL;
+
+/*****************************************************************************/
+
+/* _init() e' o construtor do descritor do filtro */
+void _init()
+{
+
+    char ** pcPortNames;
+    LADSPA_PortDescriptor * piPortDescriptors;
+    LADSPA_PortRangeHint * psPortRangeHints;
+
+    g_psDescriptor
+    = (LADSPA_Descriptor *)malloc(sizeof(LADSPA_Descriptor));
+    if (g_psDescriptor)
+    {
+        g_psDescriptor->UniqueID
+        = 12;
+        g_psDescriptor->Label
+        = strdup("adapt_fdnlms");
+        g_psDescriptor->Properties
+        = LADSPA_PROPERTY_HARD_RT_CAPABLE;
+        g_psDescriptor->Name
+        = strdup("NLMS em blocos no dominio da frequencia");
+        g_psDescriptor->Maker
+        = strdup("Pedro Nariyoshi");
+        g_psDescriptor->Copyright
+        = strdup("None");
+        g_psDescriptor->PortCount
+        = NOPORTS;
+        piPortDescriptors
+        = (LADSPA_PortDescriptor *)calloc(NOPORTS, sizeof(LADSPA_PortDescriptor));
+        g_psDescriptor->PortDescriptors
+        = (const LADSPA_PortDescriptor *)piPortDescriptors;
+        piPortDescriptors[FD_FILTER_LENGTH]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[FD_DTD_LENGTH]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[FD_DTD_THRESHOLD]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[FD_MU]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[FD_INPUTD]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+        piPortDescriptors[FD_INPUTX]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+        piPortDescriptors[FD_OUTPUT]
+        = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
+        piPortDescriptors[FD_LATENCY]
+        = LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL;
+        pcPortNames
+        = (char **)calloc(NOPORTS, sizeof(char *));
+        g_psDescriptor->PortNames
+        = (const char **)pcPortNames;
+        pcPortNames[FD_FILTER_LENGTH]
+        = strdup("Tamanho do filtro (ms)");
+        pcPortNames[FD_DTD_LENGTH]
+        = strdup("Comprimento do DTD (ms)");
+        pcPortNames[FD_DTD_THRESHOLD]
+        = strdup("Limiar do DTD");
+        pcPortNames[FD_MU]
+        = strdup("µ - Fator de convergencia");
+        pcPortNames[FD_INPUTD]
+        = strdup("Input D");
+        pcPortNames[FD_INPUTX]
+        = strdup("Input X");
+        pcPortNames[FD_OUTPUT]
+        = strdup("Output");
+        /* Nome que os hosts procuram para compensar o atraso */
+        pcPortNames[FD_LATENCY]
+        = strdup("latency");
+        psPortRangeHints = ((LADSPA_PortRangeHint *)
+                            calloc(NOPORTS, sizeof(LADSPA_PortRangeHint)));
+        g_psDescriptor->PortRangeHints
+        = (const LADSPA_PortRangeHint *)psPortRangeHints;
+        psPortRangeHints[FD_FILTER_LENGTH].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_LOW);
+        psPortRangeHints[FD_FILTER_LENGTH].LowerBound
+        = 0;
+        psPortRangeHints[FD_FILTER_LENGTH].UpperBound
+        = (LADSPA_Data)MAX_ECO_MS;
+        psPortRangeHints[FD_DTD_LENGTH].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_MAXIMUM);
+        psPortRangeHints[FD_DTD_LENGTH].LowerBound
+        = 0;
+        psPortRangeHints[FD_DTD_LENGTH].UpperBound
+        = (LADSPA_Data)MAX_DTD_MS;
+        psPortRangeHints[FD_DTD_THRESHOLD].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_MIDDLE);
+        psPortRangeHints[FD_DTD_THRESHOLD].LowerBound
+        = 0;
+        psPortRangeHints[FD_DTD_THRESHOLD].UpperBound
+        = MAX_LIMIAR;
+        psPortRangeHints[FD_MU].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_LOW);
+        psPortRangeHints[FD_MU].LowerBound
+        = 0;
+        psPortRangeHints[FD_MU].UpperBound
+        = 2;
+        psPortRangeHints[FD_INPUTD].HintDescriptor
+        = 0;
+        psPortRangeHints[FD_INPUTX].HintDescriptor
+        = 0;
+        psPortRangeHints[FD_OUTPUT].HintDescriptor
+        = 0;
+        psPortRangeHints[FD_LATENCY].HintDescriptor
+        = LADSPA_HINT_INTEGER;
+        meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, FD_ERLE, METER_PORTS_LINEAR);
+        g_psDescriptor->instantiate
+        = instantiateFilter;
+        g_psDescriptor->connect_port
+        = connectPortToFilter;
+        g_psDescriptor->activate
+        = activateFilter;
+        g_psDescriptor->run
+        = runFilter;
+        g_psDescriptor->run_adding
+        = NULL;
+        g_psDescriptor->set_run_adding_gain
+        = NULL;
+        g_psDescriptor->deactivate
+        = NULL;
+        g_psDescriptor->cleanup
+        = cleanupFilter;
+    }
+}
+
+/*****************************************************************************/
+
+/* _fini() e' o destrutor do descritor do filtro */
+void _fini()
+{
+    long lIndex;
+    if (g_psDescriptor)
+    {
+        free((char *)g_psDescriptor->Label);
+        free((char *)g_psDescriptor->Name);
+        free((char *)g_psDescriptor->Maker);
+        free((char *)g_psDescriptor->Copyright);
+        free((LADSPA_PortDescriptor *)g_psDescriptor->PortDescriptors);
+        for (lIndex = 0; lIndex < g_psDescriptor->PortCount; lIndex++)
+            free((char *)(g_psDescriptor->PortNames[lIndex]));
+        free((char **)g_psDescriptor->PortNames);
+        free((LADSPA_PortRangeHint *)g_psDescriptor->PortRangeHints);
+        free(g_psDescriptor);
+    }
+}
+
+/*****************************************************************************/
+
+/* Devolve o descritor desejado */
+const LADSPA_Descriptor * ladspa_descriptor(unsigned long Index)
+{
+    if (Index == 0)
+        return g_psDescriptor;
+    else
+        return NULL;
+}
+
+/*****************************************************************************/
+
+/* EOF */
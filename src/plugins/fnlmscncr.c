@@ -2,6 +2,13 @@
 
    Este plugin LADSPA executa um algoritmo de cancelamento de eco acu'stico
 
+   Alem do descritor em float (BLAS), a biblioteca oferece dois descritores
+   com armazenamento reduzido para caudas longas: os coeficientes ficam em
+   fp16 ou bf16 e o buffer de x(n) em int16, com acumulacao em float. Isso
+   corta pela metade a memoria lida a cada amostra. Os nucleos usam F16C/AVX2
+   quando o processador tem, e caem para codigo escalar quando nao tem; o
+   escalar soma na mesma ordem, entao a saida nao depende do nucleo.
+
    Possui pouca protecao de memoria. Falhas no malloc nao se recuperam bem.
    E' recomendado usar o Memory Lock e um nucleo (kernel) de baixa latencia.
 
@@ -10,6 +17,11 @@
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
+#include "simd.h"
 
 /*****************************************************************************/
 
@@ -17,7 +29,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include <cblas.h> /* Biblioteca para otimizacao de operacoes de algebra linear */
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 /*****************************************************************************/
 
@@ -27,6 +43,22 @@
 #define MAX_DTD_MS 20 /* Valores em milissegundos */
 #define EPSILON 0.001 /* Valor do epsilon do e-NLMS */
 
+/* Modos de armazenamento, um por descritor */
+
+#define PRECISAO_FP32 0 /* Coeficientes e x(n) em float */
+#define PRECISAO_FP16 1 /* Coeficientes em fp16, x(n) em int16 */
+#define PRECISAO_BF16 2 /* Coeficientes em bf16, x(n) em int16 */
+
+#define NO_DESCRIPTORS 3
+
+/* UniqueID de cada modo; o instantiate() escolhe o modo por eles */
+
+#define ID_FP32 900
+#define ID_FP16 901
+#define ID_BF16 902
+
+#define ESCALA_X 32767.0f /* Escala de x(n) no buffer int16 */
+
 /*****************************************************************************/
 
 /* A numeracao das portas do filtro */
@@ -40,10 +72,16 @@
 #define LMS_INPUTX        6
 #define LMS_OUTPUT        7
 
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define LMS_ERLE          8
+#define LMS_UPDATE_RATE   9
+#define LMS_DNCR          10
+
 
 /* Quantidade de portas */
 
-#define NOPORTS 8
+#define NOPORTS 11
 
 /*****************************************************************************/
 
@@ -52,9 +90,9 @@
 #define ABS(x)       				\
 (((x) > 0) ? x : -x)
 #define LIMIT_BETWEEN_0_AND_MAX_ECO_MS(x)  	\
-(((x) < 0) ? 0 : (((0) > MAX_ECO_MS) ? MAX_ECO_MS : (x)))
+(((x) < 0) ? 0 : (((x) > MAX_ECO_MS) ? MAX_ECO_MS : (x)))
 #define LIMIT_BETWEEN_0_AND_MAX_DTD_MS(x)  	\
-(((x) < 0) ? 0 : (((0) > MAX_DTD_MS) ? MAX_DTD_MS : (x)))
+(((x) < 0) ? 0 : (((x) > MAX_DTD_MS) ? MAX_DTD_MS : (x)))
 #define DB_CO(g) 				\
 (powf(10.0f, (g) * 0.05f)) /* powf e' a versao rapida (fast) da funcao pow */
 #define CO_DB(v)				\
@@ -78,6 +116,14 @@ typedef struct
 
     LADSPA_Data * m_fXVar;
 
+    /* Armazenamento reduzido (PRECISAO_FP16/BF16): substitui m_pfCoefs e m_pfBufferX */
+    uint16_t * m_pusCoefs;
+    int16_t * m_psBufferX;
+
+    /* Modo de armazenamento e nucleo escolhidos no instantiate */
+    int m_iPrecision;
+    int m_iSimd;
+
     /* O tamanho do buffer em potencia de 2 agiliza a "circularização do vetor, transformando uma equacao de resto de divisão em uma operação de E lógico bit a bit */
     unsigned long m_lFilterSize;
 
@@ -114,10 +160,327 @@ typedef struct
     /* Output audio port data location. */
     LADSPA_Data * m_pfOutput;
 
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
 } Filter;
 
 /*****************************************************************************/
 
+/* Conversoes escalares entre float e os formatos de 16 bits dos
+   coeficientes (arredondamento para o par mais proximo) */
+
+static float halfToFloat(uint16_t usHalf)
+{
+
+    uint32_t ulBits;
+    uint32_t ulExp;
+    float fValue;
+    float fMagic;
+
+    ulBits = ((uint32_t)usHalf & 0x7fff) << 13;
+    ulExp = ulBits & (0x7c00u << 13);
+    ulBits += (127 - 15) << 23;
+    if (ulExp == (0x7c00u << 13)) /* Inf/NaN */
+    {
+        ulBits += (128 - 16) << 23;
+        memcpy(&fValue, &ulBits, sizeof(fValue));
+    }
+    else if (ulExp == 0) /* Subnormal */
+    {
+        ulBits += 1 << 23;
+        memcpy(&fValue, &ulBits, sizeof(fValue));
+        ulBits = 113u << 23;
+        memcpy(&fMagic, &ulBits, sizeof(fMagic));
+        fValue -= fMagic;
+    }
+    else
+    {
+        memcpy(&fValue, &ulBits, sizeof(fValue));
+    }
+
+    ulBits = ((uint32_t)usHalf & 0x8000) << 16;
+    if (ulBits)
+        fValue = -fValue;
+    return fValue;
+}
+
+static uint16_t floatToHalf(float fValue)
+{
+
+    uint32_t ulBits;
+    uint32_t ulSign;
+    uint32_t ulMagic;
+    float fMagic;
+    uint16_t usHalf;
+
+    memcpy(&ulBits, &fValue, sizeof(ulBits));
+    ulSign = ulBits & 0x80000000u;
+    ulBits ^= ulSign;
+
+    if (ulBits >= ((127u + 16) << 23)) /* Estoura: Inf (ou NaN) */
+    {
+        usHalf = (ulBits > (255u << 23)) ? 0x7e00 : 0x7c00;
+    }
+    else if (ulBits < (113u << 23)) /* Subnormal em fp16 */
+    {
+        ulMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+        memcpy(&fMagic, &ulMagic, sizeof(fMagic));
+        memcpy(&fValue, &ulBits, sizeof(fValue));
+        fValue += fMagic;
+        memcpy(&ulBits, &fValue, sizeof(ulBits));
+        usHalf = (uint16_t)(ulBits - ulMagic);
+    }
+    else
+    {
+        ulBits += ((uint32_t)(15 - 127) << 23) + 0xfff + ((ulBits >> 13) & 1);
+        usHalf = (uint16_t)(ulBits >> 13);
+    }
+
+    return usHalf | (uint16_t)(ulSign >> 16);
+}
+
+static float coefToFloat(uint16_t usCoef, int iPrecision)
+{
+
+    uint32_t ulBits;
+    float fValue;
+
+    if (iPrecision == PRECISAO_FP16)
+        return halfToFloat(usCoef);
+
+    ulBits = (uint32_t)usCoef << 16;
+    memcpy(&fValue, &ulBits, sizeof(fValue));
+    return fValue;
+}
+
+static uint16_t floatToCoef(float fValue, int iPrecision)
+{
+
+    uint32_t ulBits;
+
+    if (iPrecision == PRECISAO_FP16)
+        return floatToHalf(fValue);
+
+    memcpy(&ulBits, &fValue, sizeof(ulBits));
+    ulBits += 0x7fff + ((ulBits >> 16) & 1);
+    return (uint16_t)(ulBits >> 16);
+}
+
+/* Satura e quantiza x(n) para o buffer int16 */
+static int16_t floatToSampleX(LADSPA_Data fValue)
+{
+    if (fValue >= 1.0f)
+        return 32767;
+    if (fValue <= -1.0f)
+        return -32767;
+    return (int16_t)lrintf(fValue * ESCALA_X);
+}
+
+/*****************************************************************************/
+
+/* Nucleos escalares do armazenamento reduzido. Seguem a ordem das somas
+   e os fma dos nucleos AVX2: com coeficientes de 16 bits, um
+   arredondamento diferente no produto interno muda a quantizacao da
+   atualizacao e o filtro segue outra trajetoria, entao os nucleos tem de
+   dar a mesma saida bit a bit. */
+
+/* Soma de 8 parcelas na ordem de sum8() */
+static float sumLanes8(const float * pfLanes)
+{
+    return ((pfLanes[0] + pfLanes[4]) + (pfLanes[2] + pfLanes[6])) + ((pfLanes[1] + pfLanes[5]) + (pfLanes[3] + pfLanes[7]));
+}
+
+/* w(n)*x(n), ainda na escala do buffer int16: 16 parcelas, como em
+   dotReducedAvx2(), e o resto em sequencia */
+static float dotReducedScalar(const uint16_t * pusCoefs, const int16_t * psX, unsigned long lCount, int iPrecision)
+{
+
+    float afAcc[16];
+    float fTail;
+    unsigned long lIndex;
+    unsigned long lLane;
+
+    memset(afAcc, 0, sizeof(afAcc));
+    for (lIndex = 0; lIndex < (lCount & ~15UL); lIndex++)
+        afAcc[lIndex & 15] = fmaf(coefToFloat(pusCoefs[lIndex], iPrecision), (float)psX[lIndex], afAcc[lIndex & 15]);
+    for (lLane = 0; lLane < 8; lLane++)
+        afAcc[lLane] += afAcc[lLane + 8];
+
+    fTail = 0;
+    for (; lIndex < lCount; lIndex++)
+        fTail = fmaf(coefToFloat(pusCoefs[lIndex], iPrecision), (float)psX[lIndex], fTail);
+    return sumLanes8(afAcc) + fTail;
+}
+
+/* w(n)*pdx(n): 8 parcelas, como em dotPdxAvx2(), e o resto em sequencia */
+static float dotPdxScalar(const float * pfPdx, const uint16_t * pusCoefs, unsigned long lCount, int iPrecision)
+{
+
+    float afAcc[8];
+    float fTail;
+    unsigned long lIndex;
+
+    memset(afAcc, 0, sizeof(afAcc));
+    for (lIndex = 0; lIndex < (lCount & ~7UL); lIndex++)
+        afAcc[lIndex & 7] = fmaf(pfPdx[lIndex], coefToFloat(pusCoefs[lIndex], iPrecision), afAcc[lIndex & 7]);
+
+    fTail = 0;
+    for (; lIndex < lCount; lIndex++)
+        fTail = fmaf(pfPdx[lIndex], coefToFloat(pusCoefs[lIndex], iPrecision), fTail);
+    return sumLanes8(afAcc) + fTail;
+}
+
+/* w(n+1) = w(n) + passo * x(n), com fStep ja na escala do buffer int16 */
+static void updateReducedScalar(uint16_t * pusCoefs, float fStep, const int16_t * psX, unsigned long lCount, int iPrecision)
+{
+
+    unsigned long lIndex;
+
+    for (lIndex = 0; lIndex < lCount; lIndex++)
+        pusCoefs[lIndex] = floatToCoef(fmaf(fStep, (float)psX[lIndex], coefToFloat(pusCoefs[lIndex], iPrecision)), iPrecision);
+}
+
+/*****************************************************************************/
+
+/* Nucleos AVX2/F16C do armazenamento reduzido: 8 coeficientes por vez,
+   com o resto tratado pelas versoes escalares */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+
+static inline TARGET_AVX2 __m256 loadCoefs8(const uint16_t * pusCoefs, int iPrecision)
+{
+
+    __m128i xHalf;
+
+    xHalf = _mm_loadu_si128((const __m128i *)pusCoefs);
+    if (iPrecision == PRECISAO_FP16)
+        return _mm256_cvtph_ps(xHalf);
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(xHalf), 16));
+}
+
+static inline TARGET_AVX2 void storeCoefs8(uint16_t * pusCoefs, __m256 yValue, int iPrecision)
+{
+
+    __m256i yBits;
+
+    if (iPrecision == PRECISAO_FP16)
+    {
+        _mm_storeu_si128((__m128i *)pusCoefs, _mm256_cvtps_ph(yValue, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+        return;
+    }
+
+    /* bf16: soma 0x7fff + bit menos significativo e fica com os 16 bits altos */
+    yBits = _mm256_castps_si256(yValue);
+    yBits = _mm256_add_epi32(yBits, _mm256_add_epi32(_mm256_set1_epi32(0x7fff), _mm256_and_si256(_mm256_srli_epi32(yBits, 16), _mm256_set1_epi32(1))));
+    yBits = _mm256_srli_epi32(yBits, 16);
+    yBits = _mm256_permute4x64_epi64(_mm256_packus_epi32(yBits, yBits), 0xd8);
+    _mm_storeu_si128((__m128i *)pusCoefs, _mm256_castsi256_si128(yBits));
+}
+
+static inline TARGET_AVX2 __m256 loadSamplesX8(const int16_t * psX)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)psX)));
+}
+
+static inline TARGET_AVX2 float sum8(__m256 yValue)
+{
+
+    __m128 xSum;
+
+    xSum = _mm_add_ps(_mm256_castps256_ps128(yValue), _mm256_extractf128_ps(yValue, 1));
+    xSum = _mm_add_ps(xSum, _mm_movehl_ps(xSum, xSum));
+    xSum = _mm_add_ss(xSum, _mm_shuffle_ps(xSum, xSum, 1));
+    return _mm_cvtss_f32(xSum);
+}
+
+static TARGET_AVX2 float dotReducedAvx2(const uint16_t * pusCoefs, const int16_t * psX, unsigned long lCount, int iPrecision)
+{
+
+    __m256 yAcc0;
+    __m256 yAcc1;
+    unsigned long lIndex;
+
+    yAcc0 = _mm256_setzero_ps();
+    yAcc1 = _mm256_setzero_ps();
+    for (lIndex = 0; lIndex + 16 <= lCount; lIndex += 16)
+    {
+        yAcc0 = _mm256_fmadd_ps(loadCoefs8(pusCoefs + lIndex, iPrecision), loadSamplesX8(psX + lIndex), yAcc0);
+        yAcc1 = _mm256_fmadd_ps(loadCoefs8(pusCoefs + lIndex + 8, iPrecision), loadSamplesX8(psX + lIndex + 8), yAcc1);
+    }
+    return sum8(_mm256_add_ps(yAcc0, yAcc1)) + dotReducedScalar(pusCoefs + lIndex, psX + lIndex, lCount - lIndex, iPrecision);
+}
+
+static TARGET_AVX2 float dotPdxAvx2(const float * pfPdx, const uint16_t * pusCoefs, unsigned long lCount, int iPrecision)
+{
+
+    __m256 yAcc;
+    unsigned long lIndex;
+
+    yAcc = _mm256_setzero_ps();
+    for (lIndex = 0; lIndex + 8 <= lCount; lIndex += 8)
+        yAcc = _mm256_fmadd_ps(_mm256_loadu_ps(pfPdx + lIndex), loadCoefs8(pusCoefs + lIndex, iPrecision), yAcc);
+    return sum8(yAcc) + dotPdxScalar(pfPdx + lIndex, pusCoefs + lIndex, lCount - lIndex, iPrecision);
+}
+
+static TARGET_AVX2 void updateReducedAvx2(uint16_t * pusCoefs, float fStep, const int16_t * psX, unsigned long lCount, int iPrecision)
+{
+
+    __m256 yStep;
+    unsigned long lIndex;
+
+    yStep = _mm256_set1_ps(fStep);
+    for (lIndex = 0; lIndex + 8 <= lCount; lIndex += 8)
+        storeCoefs8(pusCoefs + lIndex, _mm256_fmadd_ps(yStep, loadSamplesX8(psX + lIndex), loadCoefs8(pusCoefs + lIndex, iPrecision)), iPrecision);
+    updateReducedScalar(pusCoefs + lIndex, fStep, psX + lIndex, lCount - lIndex, iPrecision);
+}
+
+#endif
+
+/*****************************************************************************/
+
+/* Despacho para o nucleo escolhido no instantiate */
+
+static float dotReduced(const Filter * pFilter, const int16_t * psX, unsigned long lCount)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (pFilter->m_iSimd >= SIMD_AVX2)
+        return dotReducedAvx2(pFilter->m_pusCoefs, psX, lCount, pFilter->m_iPrecision);
+#endif
+    return dotReducedScalar(pFilter->m_pusCoefs, psX, lCount, pFilter->m_iPrecision);
+}
+
+static float dotPdx(const Filter * pFilter, unsigned long lCount)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (pFilter->m_iSimd >= SIMD_AVX2)
+        return dotPdxAvx2(pFilter->m_pfPdx, pFilter->m_pusCoefs, lCount, pFilter->m_iPrecision);
+#endif
+    return dotPdxScalar(pFilter->m_pfPdx, pFilter->m_pusCoefs, lCount, pFilter->m_iPrecision);
+}
+
+static void updateReduced(Filter * pFilter, float fStep, const int16_t * psX, unsigned long lCount)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (pFilter->m_iSimd >= SIMD_AVX2)
+    {
+        updateReducedAvx2(pFilter->m_pusCoefs, fStep, psX, lCount, pFilter->m_iPrecision);
+        return;
+    }
+#endif
+    updateReducedScalar(pFilter->m_pusCoefs, fStep, psX, lCount, pFilter->m_iPrecision);
+}
+
+/*****************************************************************************/
+
 LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned long SampleRate)
 {
 
@@ -135,11 +498,13 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     }
 
     pFilter->m_fSampleRate = (LADSPA_Data)SampleRate;
+    memset(&pFilter->m_sMeters, 0, sizeof(MeterPorts));
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
 
     /* O tamanho do buffer e' a menor potencia de dois que seja maior que o tamanho necessario */
     /* Isto torna a "circularizacao" do vetor muito mais simples */
-    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS);
-    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS);
+    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS * 0.001);
+    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS * 0.001);
 
     pFilter->m_lFilterSize = 1;
     pFilter->m_lDtdSize = 1;
@@ -154,9 +519,36 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
         pFilter->m_lDtdSize <<= 1;
     }
 
+    switch (Descriptor->UniqueID)
+    {
+    case ID_FP16:
+        pFilter->m_iPrecision = PRECISAO_FP16;
+        break;
+    case ID_BF16:
+        pFilter->m_iPrecision = PRECISAO_BF16;
+        break;
+    default:
+        pFilter->m_iPrecision = PRECISAO_FP32;
+        break;
+    }
+    pFilter->m_iSimd = simdLevel();
+    pFilter->m_pfBufferX = NULL;
+    pFilter->m_pfCoefs = NULL;
+    pFilter->m_psBufferX = NULL;
+    pFilter->m_pusCoefs = NULL;
+
     /* cria um buffer "zerado" com o tamanho achado acima de LADSPA_Datas (ou seja floats, ver em ladspa.h) */
-    pFilter->m_pfBufferX  = (LADSPA_Data *)calloc(pFilter->m_lFilterSize * 2, sizeof(LADSPA_Data));
-    pFilter->m_pfCoefs  = (LADSPA_Data *)calloc(pFilter->m_lFilterSize, sizeof(LADSPA_Data));
+    /* O buffer de x(n) tem duas copias para que a janela do filtro seja sempre contigua */
+    if (pFilter->m_iPrecision == PRECISAO_FP32)
+    {
+        pFilter->m_pfBufferX  = (LADSPA_Data *)calloc(pFilter->m_lFilterSize * 2, sizeof(LADSPA_Data));
+        pFilter->m_pfCoefs  = (LADSPA_Data *)calloc(pFilter->m_lFilterSize, sizeof(LADSPA_Data));
+    }
+    else
+    {
+        pFilter->m_psBufferX = (int16_t *)calloc(pFilter->m_lFilterSize * 2, sizeof(int16_t));
+        pFilter->m_pusCoefs = (uint16_t *)calloc(pFilter->m_lFilterSize, sizeof(uint16_t));
+    }
 
     pFilter->m_pfPdx  = (LADSPA_Data *)calloc(pFilter->m_lDtdSize, sizeof(LADSPA_Data));
     pFilter->m_fXVar = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data));
@@ -164,11 +556,13 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     pFilter->m_lWritePointerX = 0; /* Inicializa o vetor de escrita */
     pFilter->m_fEchoTimeant = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data));
 
-    if (pFilter->m_pfBufferX == NULL || pFilter->m_pfCoefs == NULL || pFilter->m_pfPdx == NULL || pFilter->m_fXVar == NULL || pFilter->m_fDVar == NULL || pFilter->m_fEchoTimeant == NULL)
+    if (((pFilter->m_pfBufferX == NULL || pFilter->m_pfCoefs == NULL) && (pFilter->m_psBufferX == NULL || pFilter->m_pusCoefs == NULL)) || pFilter->m_pfPdx == NULL || pFilter->m_fXVar == NULL || pFilter->m_fDVar == NULL || pFilter->m_fEchoTimeant == NULL)
     {
         fputs("Out of memory.\n", stderr);
         exit(EXIT_FAILURE);
     }
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, LMS_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
 
     return pFilter;
 }
@@ -182,13 +576,23 @@ void activateFilter(LADSPA_Handle Instance)
     Filter * pFilter;
     pFilter = (Filter *)Instance;
 
-    memset(pFilter->m_pfBufferX, 0, 2 * sizeof(LADSPA_Data) * pFilter->m_lFilterSize);
-    memset(pFilter->m_pfCoefs, 0, sizeof(LADSPA_Data) * pFilter->m_lFilterSize);
+    if (pFilter->m_iPrecision == PRECISAO_FP32)
+    {
+        memset(pFilter->m_pfBufferX, 0, 2 * sizeof(LADSPA_Data) * pFilter->m_lFilterSize);
+        memset(pFilter->m_pfCoefs, 0, sizeof(LADSPA_Data) * pFilter->m_lFilterSize);
+        *pFilter->m_pfCoefs = 1;
+    }
+    else
+    {
+        memset(pFilter->m_psBufferX, 0, 2 * sizeof(int16_t) * pFilter->m_lFilterSize);
+        memset(pFilter->m_pusCoefs, 0, sizeof(uint16_t) * pFilter->m_lFilterSize);
+        *pFilter->m_pusCoefs = floatToCoef(1, pFilter->m_iPrecision);
+    }
     memset(pFilter->m_pfPdx, 0, sizeof(LADSPA_Data) * pFilter->m_lDtdSize);
     *pFilter->m_fEchoTimeant=0;
-    *pFilter->m_pfCoefs = 1;
     *pFilter->m_fXVar = 0;
     *pFilter->m_fDVar = 0;
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
 
 
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/
@@ -203,6 +607,8 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
 
     pFilter = (Filter *)Instance;
 
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+
     switch (Port)
     {
     case LMS_FILTER_LENGTH :
@@ -229,6 +635,11 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
     case LMS_OUTPUT:
         pFilter->m_pfOutput = DataLocation;
         break;
+    case LMS_ERLE:
+    case LMS_UPDATE_RATE:
+    case LMS_DNCR:
+        meterConnect(&pFilter->m_sMeters, Port - LMS_ERLE, DataLocation);
+        break;
     }
 }
 
@@ -251,14 +662,18 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     LADSPA_Data fConvSample=0; /* Variavel auxiliar da convolucao */
     LADSPA_Data fDtdThreshold; /* Limiar do Double-Talk detector */
     LADSPA_Data fErrSample; /* Valor atual do e(n) */
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
     LADSPA_Data fSetThreshold; /* Limiar do Set-Membership */
     LADSPA_Data fDNCR=0;
     LADSPA_Data fgammaD;
 
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
+
     Filter * pFilter;
 
     unsigned long lBufferXSizeMinusOne;
-    unsigned long lBufferDXSizeMinusOne;
     unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */
     unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */
     unsigned long lIndexW; /* Indice usado para gravar no buffer */
@@ -266,10 +681,12 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     unsigned long lConv=0; /* Contador da convolucao */
 
     pFilter = (Filter *)Instance;
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
 
     lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1;
     lXCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001);
-    lBufferDXSizeMinusOne = pFilter->m_lDtdSize - 1;
     lDCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001);
     if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */
     fgammaD = ((float)lDCoefs - 1.0f)/ (float)lDCoefs;
@@ -291,6 +708,8 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     fDtdThreshold = *pFilter->m_pfDtdThreshold;
     fSetThreshold = DB_CO(*pFilter->m_pfSetThreshold);
 
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
     {
 
@@ -299,8 +718,11 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
         fConvSample = cblas_sdot(lXCoefs, pfCoefs, 1, pfBufferX + lIndexW, 1); /* w(n)*x(n) */ 
 
-        fErrSample = *pfInputD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */
+        fD = *pfInputD;
+        fErrSample = fD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */
         *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
 
         if(*pFilter->m_fEchoTimeant == *pFilter->m_pfEchoTime) /* Se o tamanho do filtro nao mudar calcula tr[Rx] pelo metodo incremental */
         {
@@ -317,16 +739,19 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         }
 
         *pfDVar *= fgammaD; /* Utiliza o metodo IIR para estimar var(D) */
-        *pfDVar += (1 - fgammaD) * (*pfInputD) * (*pfInputD);
+        *pfDVar += (1 - fgammaD) * fD * fD;
 
 		cblas_sscal(lDCoefs, fgammaD, pfPdx, 1);
-		cblas_saxpy(lDCoefs, (1 - fgammaD) * (*pfInputD), pfBufferX + lIndexW, 1, pfPdx, 1);
+		cblas_saxpy(lDCoefs, (1 - fgammaD) * fD, pfBufferX + lIndexW, 1, pfPdx, 1);
 		fDNCR = cblas_sdot(lDCoefs, pfCoefs, 1,  pfPdx, 1); /* w(n)*pdx(n) */ 
         fDNCR /= *pfDVar; /* Falta dividir por var(D): fDNCR = (r_dx * w) / *pfDVar */
 
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(fDNCR > fDtdThreshold), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(fDNCR > fDtdThreshold), lSampleIndex);
         if (fDNCR > fDtdThreshold && ABS(fErrSample) > fSetThreshold)
         {
             fStep = fMu * fErrSample / (*pfXVar + EPSILON); /* Aplica a regra do e-NLMS */
+            lUpdates++;
 
 			cblas_saxpy(lXCoefs, fStep, pfBufferX + lIndexW, 1, pfCoefs, 1);
         }
@@ -336,8 +761,152 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         pfInputD++; /* Recebe proxima amostra de D */
     }
 
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, fDNCR, 1);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, fDNCR, 1);
+
+    pFilter->m_lWritePointerX = lIndexW; /* Atualiza o indice do ponteiro dos vetores circulares*/
+
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
+
+}
+
+/*****************************************************************************/
+
+/* Roda a instancia do filtro adaptativo com armazenamento reduzido */
+void runFilterReduced(LADSPA_Handle Instance, unsigned long SampleCount)
+{
+
+    int16_t * psBufferX; /* Vetor que armazena os valores antigos de x(n), em int16 */
+    LADSPA_Data * pfInputX; /* Aponta para o bloco de amostras da entrada x(n) */
+    LADSPA_Data * pfInputD; /* Aponta para o bloco de amostras da entrada d(n) */
+    LADSPA_Data * pfOutput; /* Aponta para o bloco de amostras da saida */
+    LADSPA_Data * pfXVar; /* A variancia de X */
+    LADSPA_Data * pfDVar; /* A variancia de D */
+    LADSPA_Data * pfPdx; /* A correlação cruzada de D e X */
+    LADSPA_Data fMu; /* Fator do passo */
+    LADSPA_Data fStep=0; /* Valor do passo */
+    LADSPA_Data fConvSample=0; /* Variavel auxiliar da convolucao */
+    LADSPA_Data fDtdThreshold; /* Limiar do Double-Talk detector */
+    LADSPA_Data fErrSample; /* Valor atual do e(n) */
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
+    LADSPA_Data fSetThreshold; /* Limiar do Set-Membership */
+    LADSPA_Data fDNCR=0;
+    LADSPA_Data fgammaD;
+    LADSPA_Data fSampleX; /* x(n) ja quantizado, em float */
+    LADSPA_Data fScaleD; /* (1 - gammaD) * d(n) / ESCALA_X */
+    int16_t sSampleX;
+
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
+
+    Filter * pFilter;
+
+    unsigned long lBufferXSizeMinusOne;
+    unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */
+    unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */
+    unsigned long lIndexW; /* Indice usado para gravar no buffer */
+    unsigned long lSampleIndex;
+    unsigned long lConv=0; /* Contador da convolucao */
+
+    pFilter = (Filter *)Instance;
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
+
+    lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1;
+    lXCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001);
+    lDCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001);
+    if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */
+    if (lXCoefs > pFilter->m_lFilterSize) lXCoefs = pFilter->m_lFilterSize;
+    if (lDCoefs > pFilter->m_lDtdSize) lDCoefs = pFilter->m_lDtdSize;
+    fgammaD = ((float)lDCoefs - 1.0f)/ (float)lDCoefs;
+
+    /* Conecta os ponteiros */
+    pfInputD      =  pFilter->m_pfInputD;
+    pfInputX      =  pFilter->m_pfInputX;
+    pfOutput      =  pFilter->m_pfOutput;
+    psBufferX     =  pFilter->m_psBufferX;
+    pfPdx         =  pFilter->m_pfPdx;
+    pfXVar        =  pFilter->m_fXVar;
+    pfDVar        =  pFilter->m_fDVar;
+    fMu           = *pFilter->m_pfMu;
+    lIndexW 	  =  pFilter->m_lWritePointerX;
+
+    /* Atribui valor aos coeficientes em dB */
+
+    fDtdThreshold = *pFilter->m_pfDtdThreshold;
+    fSetThreshold = DB_CO(*pFilter->m_pfSetThreshold);
+
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
+    for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
+    {
+
+        sSampleX = floatToSampleX(*pfInputX);
+        psBufferX[lIndexW] = sSampleX; /* O buffer recebe a mais recente amostra de x(n) */
+        psBufferX[lIndexW + pFilter->m_lFilterSize] = sSampleX;
+        fSampleX = (float)sSampleX / ESCALA_X;
+
+        fConvSample = dotReduced(pFilter, psBufferX + lIndexW, lXCoefs) / ESCALA_X; /* w(n)*x(n) */
+
+        fD = *pfInputD;
+        fErrSample = fD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */
+        *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
+
+        if(*pFilter->m_fEchoTimeant == *pFilter->m_pfEchoTime) /* Se o tamanho do filtro nao mudar calcula tr[Rx] pelo metodo incremental */
+        {
+            fConvSample = (float)psBufferX[(lIndexW + lXCoefs) & lBufferXSizeMinusOne] / ESCALA_X;
+            *pfXVar += fSampleX * fSampleX - fConvSample * fConvSample;
+        }
+        else /* Se o tempo mudou, recalcula o valor e atualiza o valor do EchoTime anterior */
+        {
+            *pFilter->m_fEchoTimeant = *pFilter->m_pfEchoTime;
+            *pfXVar = 0;
+            for(lConv = 0; lConv < lXCoefs; lConv++)
+            {
+                fConvSample = (float)psBufferX[lIndexW + lConv] / ESCALA_X;
+                *pfXVar += fConvSample * fConvSample;
+            }
+        }
+
+        *pfDVar *= fgammaD; /* Utiliza o metodo IIR para estimar var(D) */
+        *pfDVar += (1 - fgammaD) * fD * fD;
+
+        fScaleD = (1 - fgammaD) * fD / ESCALA_X;
+        for(lConv = 0; lConv < lDCoefs; lConv++)
+        {
+            pfPdx[lConv] = fgammaD * pfPdx[lConv] + fScaleD * (float)psBufferX[lIndexW + lConv];
+        }
+        fDNCR = dotPdx(pFilter, lDCoefs); /* w(n)*pdx(n) */
+        fDNCR /= *pfDVar; /* Falta dividir por var(D): fDNCR = (r_dx * w) / *pfDVar */
+
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(fDNCR > fDtdThreshold), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(fDNCR > fDtdThreshold), lSampleIndex);
+        if (fDNCR > fDtdThreshold && ABS(fErrSample) > fSetThreshold)
+        {
+            fStep = fMu * fErrSample / (*pfXVar + EPSILON); /* Aplica a regra do e-NLMS */
+            lUpdates++;
+
+            updateReduced(pFilter, fStep / ESCALA_X, psBufferX + lIndexW, lXCoefs);
+        }
+
+	    lIndexW = (lIndexW - 1) & lBufferXSizeMinusOne; /* Atualiza o indice dos buffers */
+        pfInputX++; /* Recebe proxima amostra de X */
+        pfInputD++; /* Recebe proxima amostra de D */
+    }
+
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, fDNCR, 1);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, fDNCR, 1);
+
     pFilter->m_lWritePointerX = lIndexW; /* Atualiza o indice do ponteiro dos vetores circulares*/
 
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
+
 }
 
 /*****************************************************************************/
@@ -349,49 +918,73 @@ void cleanupFilter(LADSPA_Handle Instance)
     Filter * pFilter;
 
     pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    dumpStop(&pFilter->m_sDump);
     free(pFilter->m_pfPdx);
     free(pFilter->m_fXVar);
     free(pFilter->m_fDVar);
     free(pFilter->m_pfBufferX);
     free(pFilter->m_pfCoefs);
+    free(pFilter->m_psBufferX);
+    free(pFilter->m_pusCoefs);
+    free(pFilter->m_fEchoTimeant);
+    TIMING_DESTROY(pFilter->m_psTiming);
     free(pFilter);
 }
 
 /*****************************************************************************/
 
-LADSPA_Descriptor * g_psDescriptor = NULL;
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
 
 /*****************************************************************************/
 
-/* _init() e' o construtor do descritor do filtro */
-void _init()
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
+/*****************************************************************************/
+
+LADSPA_Descriptor * g_psDescriptors[NO_DESCRIPTORS];
+
+/*****************************************************************************/
+
+/* Monta um descritor; os tres modos de armazenamento so diferem no
+   UniqueID, nos nomes e na funcao run() */
+static LADSPA_Descriptor * createDescriptor(unsigned long lUniqueID, const char * pcLabel, const char * pcName, void (*fRun)(LADSPA_Handle, unsigned long))
 {
 
+    LADSPA_Descriptor * psDescriptor;
     char ** pcPortNames;
     LADSPA_PortDescriptor * piPortDescriptors;
     LADSPA_PortRangeHint * psPortRangeHints;
 
-    g_psDescriptor
+    psDescriptor
     = (LADSPA_Descriptor *)malloc(sizeof(LADSPA_Descriptor));
-    if (g_psDescriptor)
+    if (psDescriptor)
     {
-        g_psDescriptor->UniqueID
-        = 900;
-        g_psDescriptor->Label
-        = strdup("adapt_fnlmscncr");
-        g_psDescriptor->Properties
+        psDescriptor->UniqueID
+        = lUniqueID;
+        psDescriptor->Label
+        = strdup(pcLabel);
+        psDescriptor->Properties
         = LADSPA_PROPERTY_HARD_RT_CAPABLE;
-        g_psDescriptor->Name
-        = strdup("Fast NLMS com CheapNCR");
-        g_psDescriptor->Maker
+        psDescriptor->Name
+        = strdup(pcName);
+        psDescriptor->Maker
         = strdup("Pedro Nariyoshi");
-        g_psDescriptor->Copyright
+        psDescriptor->Copyright
         = strdup("None");
-        g_psDescriptor->PortCount
+        psDescriptor->PortCount
         = NOPORTS;
         piPortDescriptors
         = (LADSPA_PortDescriptor *)calloc(NOPORTS, sizeof(LADSPA_PortDescriptor));
-        g_psDescriptor->PortDescriptors
+        psDescriptor->PortDescriptors
         = (const LADSPA_PortDescriptor *)piPortDescriptors;
         piPortDescriptors[LMS_FILTER_LENGTH]
         = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
@@ -411,7 +1004,7 @@ void _init()
         = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
         pcPortNames
         = (char **)calloc(NOPORTS, sizeof(char *));
-        g_psDescriptor->PortNames
+        psDescriptor->PortNames
         = (const char **)pcPortNames;
         pcPortNames[LMS_FILTER_LENGTH]
         = strdup("Tamanho do filtro (ms)");
@@ -431,7 +1024,7 @@ void _init()
         = strdup("Output");
         psPortRangeHints = ((LADSPA_PortRangeHint *)
                             calloc(NOPORTS, sizeof(LADSPA_PortRangeHint)));
-        g_psDescriptor->PortRangeHints
+        psDescriptor->PortRangeHints
         = (const LADSPA_PortRangeHint *)psPortRangeHints;
         psPortRangeHints[LMS_FILTER_LENGTH].HintDescriptor
         = (LADSPA_HINT_BOUNDED_BELOW
@@ -479,43 +1072,63 @@ void _init()
         = 0;
         psPortRangeHints[LMS_OUTPUT].HintDescriptor
         = 0;
-        g_psDescriptor->instantiate
+        meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, LMS_ERLE, METER_PORTS_LINEAR);
+        psDescriptor->instantiate
         = instantiateFilter;
-        g_psDescriptor->connect_port
+        psDescriptor->connect_port
         = connectPortToFilter;
-        g_psDescriptor->activate
+        psDescriptor->activate
         = activateFilter;
-        g_psDescriptor->run
-        = runFilter;
-        g_psDescriptor->run_adding
+        psDescriptor->run
+        = fRun;
+        psDescriptor->run_adding
         = NULL;
-        g_psDescriptor->set_run_adding_gain
+        psDescriptor->set_run_adding_gain
         = NULL;
-        g_psDescriptor->deactivate
+        psDescriptor->deactivate
         = NULL;
-        g_psDescriptor->cleanup
+        psDescriptor->cleanup
         = cleanupFilter;
     }
+
+    return psDescriptor;
 }
 
 /*****************************************************************************/
 
-/* _fini() e' o destrutor do descritor do filtro */
+/* _init() e' o construtor dos descritores do filtro */
+void _init()
+{
+    g_psDescriptors[PRECISAO_FP32] = createDescriptor(ID_FP32, "adapt_fnlmscncr", "Fast NLMS com CheapNCR", runFilter);
+    g_psDescriptors[PRECISAO_FP16] = createDescriptor(ID_FP16, "adapt_fnlmscncr_fp16", "Fast NLMS com CheapNCR (coeficientes fp16)", runFilterReduced);
+    g_psDescriptors[PRECISAO_BF16] = createDescriptor(ID_BF16, "adapt_fnlmscncr_bf16", "Fast NLMS com CheapNCR (coeficientes bf16)", runFilterReduced);
+}
+
+/*****************************************************************************/
+
+/* _fini() e' o destrutor dos descritores do filtro */
 void _fini()
 {
     long lIndexW;
-    if (g_psDescriptor)
+    long lDescriptor;
+    LADSPA_Descriptor * psDescriptor;
+
+    for (lDescriptor = 0; lDescriptor < NO_DESCRIPTORS; lDescriptor++)
     {
-        free((char *)g_psDescriptor->Label);
-        free((char *)g_psDescriptor->Name);
-        free((char *)g_psDescriptor->Maker);
-        free((char *)g_psDescriptor->Copyright);
-        free((LADSPA_PortDescriptor *)g_psDescriptor->PortDescriptors);
-        for (lIndexW = 0; lIndexW < g_psDescriptor->PortCount; lIndexW++)
-            free((char *)(g_psDescriptor->PortNames[lIndexW]));
-        free((char **)g_psDescriptor->PortNames);
-        free((LADSPA_PortRangeHint *)g_psDescriptor->PortRangeHints);
-        free(g_psDescriptor);
+        psDescriptor = g_psDescriptors[lDescriptor];
+        if (psDescriptor)
+        {
+            free((char *)psDescriptor->Label);
+            free((char *)psDescriptor->Name);
+            free((char *)psDescriptor->Maker);
+            free((char *)psDescriptor->Copyright);
+            free((LADSPA_PortDescriptor *)psDescriptor->PortDescriptors);
+            for (lIndexW = 0; lIndexW < psDescriptor->PortCount; lIndexW++)
+                free((char *)(psDescriptor->PortNames[lIndexW]));
+            free((char **)psDescriptor->PortNames);
+            free((LADSPA_PortRangeHint *)psDescriptor->PortRangeHints);
+            free(psDescriptor);
+        }
     }
 }
 
@@ -524,8 +1137,8 @@ void _fini()
 /* Devolve o descritor desejado */
 const LADSPA_Descriptor * ladspa_descriptor(unsigned long Index)
 {
-    if (Index == 0)
-        return g_psDescriptor;
+    if (Index < NO_DESCRIPTORS)
+        return g_psDescriptors[Index];
     else
         return NULL;
 }
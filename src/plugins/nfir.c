@@ -0,0 +1,390 @@
+/* Software livre por Pedro Nariyoshi. Sem garantias.
+
+   Esta biblioteca de plugins LADSPA oferece filtros FIR estaticos de 8,
+   16, 32, 64, 128 e 256 coeficientes, um descritor para cada tamanho. O
+   uso e' o mesmo do 16coefs.c, mas para quando muitos filtros curtos
+   precisam rodar no mesmo nucleo do processador.
+
+   Cada tamanho tem o seu proprio nucleo, especializado em tempo de
+   compilacao (N constante): os coeficientes sao copiados das portas uma
+   unica vez por bloco para um vetor alinhado, o historico de x(n) e'
+   linear (sem mascara de buffer circular) e so a cauda de N-1 amostras
+   e' copiada entre blocos. O laco interno percorre as amostras do bloco
+   e e' vetorizado pelo compilador.
+
+   Possui pouca protecao de memoria. Falhas no malloc nao se recuperam bem.
+*/
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+#include "ladspa.h"
+#include "sondas.h"
+
+/*****************************************************************************/
+
+/* A numeracao das portas do filtro: os coeficientes ficam entre a
+   entrada e a saida, como no 16coefs. */
+
+#define FIR_INPUT      0
+#define FIR_COEF0      1
+#define FIR_OUTPUT(N)  ((N) + 1)
+
+/* Quantidade de portas */
+
+#define NOPORTS(N) ((N) + 2)
+
+/* Tamanhos disponiveis e maior deles */
+
+#define NO_DESCRIPTORS 6
+#define MAX_TAPS 256
+
+/* Amostras processadas por passada do nucleo */
+
+#define TAM_BLOCO 256
+
+/*****************************************************************************/
+
+/* Estrutura do filtro */
+typedef struct
+{
+
+    /* Historico linear: N-1 amostras antigas seguidas do bloco atual */
+    LADSPA_Data * m_pfHistory;
+
+    /* Numero de coeficientes deste descritor */
+    unsigned long m_lTaps;
+
+    /* Entrada de audio x(n) */
+    LADSPA_Data * m_pfInput;
+
+    /* Portas dos coeficientes */
+    LADSPA_Data * m_ppfCoefs[MAX_TAPS];
+
+    /* Saida de audio y(n) */
+    LADSPA_Data * m_pfOutput;
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+} Filter;
+
+/*****************************************************************************/
+
+LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned long SampleRate)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)calloc(1, sizeof(Filter));
+
+    if (pFilter == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    pFilter->m_lTaps = Descriptor->PortCount - 2;
+
+    /* Alinhado a 64 bytes para as cargas vetoriais */
+    if (posix_memalign((void **)&pFilter->m_pfHistory, 64, sizeof(LADSPA_Data) * (MAX_TAPS + TAM_BLOCO)) != 0)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(pFilter->m_pfHistory, 0, sizeof(LADSPA_Data) * (MAX_TAPS + TAM_BLOCO));
+
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
+
+    return pFilter;
+}
+
+/*****************************************************************************/
+
+/* Inicializa os valores do filtro no caso desativa/ativa */
+void activateFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+    pFilter = (Filter *)Instance;
+
+    memset(pFilter->m_pfHistory, 0, sizeof(LADSPA_Data) * (MAX_TAPS + TAM_BLOCO));
+
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
+
+}
+
+/*****************************************************************************/
+
+/* Conecta os ponteiros 'as portas do filtro */
+void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data * DataLocation)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+
+    if (Port == FIR_INPUT)
+        pFilter->m_pfInput = DataLocation;
+    else if (Port == FIR_OUTPUT(pFilter->m_lTaps))
+        pFilter->m_pfOutput = DataLocation;
+    else if (Port - FIR_COEF0 < pFilter->m_lTaps)
+        pFilter->m_ppfCoefs[Port - FIR_COEF0] = DataLocation;
+}
+
+/*****************************************************************************/
+
+/* Nucleo generico. Sempre expandido em linha com lTaps constante, de
+   modo que cada tamanho ganha laco desenrolado e vetorizado proprio. */
+static inline __attribute__((always_inline))
+void runFirKernel(Filter * pFilter, unsigned long SampleCount, const unsigned long lTaps)
+{
+
+    LADSPA_Data afCoefs[MAX_TAPS] __attribute__((aligned(64)));
+    LADSPA_Data afAcc[TAM_BLOCO] __attribute__((aligned(64)));
+    LADSPA_Data * pfHistory;
+    LADSPA_Data * pfInput;
+    LADSPA_Data * pfOutput;
+    const LADSPA_Data * pfTap;
+    LADSPA_Data fCoef;
+    unsigned long lChunk;
+    unsigned long lIndex;
+    unsigned long lTap;
+
+    /* Le as portas dos coeficientes uma vez por bloco */
+    for (lTap = 0; lTap < lTaps; lTap++)
+        afCoefs[lTap] = *pFilter->m_ppfCoefs[lTap];
+
+    pfHistory = pFilter->m_pfHistory;
+    pfInput   = pFilter->m_pfInput;
+    pfOutput  = pFilter->m_pfOutput;
+
+    while (SampleCount > 0)
+    {
+        lChunk = (SampleCount < TAM_BLOCO) ? SampleCount : TAM_BLOCO;
+
+        memcpy(pfHistory + lTaps - 1, pfInput, sizeof(LADSPA_Data) * lChunk);
+
+        /* y(n) = soma_k c_k x(n - k); x(n) esta em pfHistory[lTaps - 1 + n] */
+        memset(afAcc, 0, sizeof(LADSPA_Data) * lChunk);
+#pragma GCC unroll 8
+        for (lTap = 0; lTap < lTaps; lTap++)
+        {
+            fCoef = afCoefs[lTap];
+            pfTap = pfHistory + lTaps - 1 - lTap;
+            for (lIndex = 0; lIndex < lChunk; lIndex++)
+                afAcc[lIndex] += fCoef * pfTap[lIndex];
+        }
+
+        memcpy(pfOutput, afAcc, sizeof(LADSPA_Data) * lChunk);
+
+        /* Copia a cauda: as ultimas N-1 amostras viram o inicio do historico */
+        memmove(pfHistory, pfHistory + lChunk, sizeof(LADSPA_Data) * (lTaps - 1));
+
+        pfInput     += lChunk;
+        pfOutput    += lChunk;
+        SampleCount -= lChunk;
+    }
+}
+
+/*****************************************************************************/
+
+/* Uma funcao run() especializada para cada tamanho; os coeficientes sao
+   fixos, entao run_exit sempre informa zero atualizacoes */
+
+#define DEFINE_FIR_RUN(N)                                                \
+void runFilter##N(LADSPA_Handle Instance, unsigned long SampleCount)    \
+{                                                                       \
+    Filter * pFilter = (Filter *)Instance;                              \
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);         \
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, N);                      \
+    runFirKernel(pFilter, SampleCount, N);                              \
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, 0);       \
+}
+
+DEFINE_FIR_RUN(8)
+DEFINE_FIR_RUN(16)
+DEFINE_FIR_RUN(32)
+DEFINE_FIR_RUN(64)
+DEFINE_FIR_RUN(128)
+DEFINE_FIR_RUN(256)
+
+/*****************************************************************************/
+
+/* Este e' o destrutor do filtro */
+void cleanupFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+
+    free(pFilter->m_pfHistory);
+
+    free(pFilter);
+}
+
+/*****************************************************************************/
+
+LADSPA_Descriptor * g_psDescriptors[NO_DESCRIPTORS];
+
+/*****************************************************************************/
+
+/* Monta o descritor do filtro de lTaps coeficientes */
+static LADSPA_Descriptor * createDescriptor(unsigned long lUniqueID, unsigned long lTaps, void (*fRun)(LADSPA_Handle, unsigned long))
+{
+
+    char acText[64];
+    char ** pcPortNames;
+    LADSPA_PortDescriptor * piPortDescriptors;
+    LADSPA_PortRangeHint * psPortRangeHints;
+    LADSPA_Descriptor * psDescriptor;
+    unsigned long lTap;
+
+    psDescriptor
+    = (LADSPA_Descriptor *)malloc(sizeof(LADSPA_Descriptor));
+    if (psDescriptor)
+    {
+        psDescriptor->UniqueID
+        = lUniqueID;
+        snprintf(acText, sizeof(acText), "fir%lucoefs", lTaps);
+        psDescriptor->Label
+        = strdup(acText);
+        psDescriptor->Properties
+        = LADSPA_PROPERTY_HARD_RT_CAPABLE;
+        snprintf(acText, sizeof(acText), "Filtro FIR com %lu coeficientes", lTaps);
+        psDescriptor->Name
+        = strdup(acText);
+        psDescriptor->Maker
+        = strdup("Pedro Nariyoshi");
+        psDescriptor->Copyright
+        = strdup("None");
+        psDescriptor->PortCount
+        = NOPORTS(lTaps);
+        piPortDescriptors
+        = (LADSPA_PortDescriptor *)calloc(NOPORTS(lTaps), sizeof(LADSPA_PortDescriptor));
+        psDescriptor->PortDescriptors
+        = (const LADSPA_PortDescriptor *)piPortDescriptors;
+        pcPortNames
+        = (char **)calloc(NOPORTS(lTaps), sizeof(char *));
+        psDescriptor->PortNames
+        = (const char **)pcPortNames;
+        psPortRangeHints = ((LADSPA_PortRangeHint *)
+                            calloc(NOPORTS(lTaps), sizeof(LADSPA_PortRangeHint)));
+        psDescriptor->PortRangeHints
+        = (const LADSPA_PortRangeHint *)psPortRangeHints;
+
+        piPortDescriptors[FIR_INPUT]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+        pcPortNames[FIR_INPUT]
+        = strdup("Input");
+        psPortRangeHints[FIR_INPUT].HintDescriptor
+        = 0;
+
+        for (lTap = 0; lTap < lTaps; lTap++)
+        {
+            piPortDescriptors[FIR_COEF0 + lTap]
+            = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+            snprintf(acText, sizeof(acText), "Coeficiente %lu", lTap + 1);
+            pcPortNames[FIR_COEF0 + lTap]
+            = strdup(acText);
+            psPortRangeHints[FIR_COEF0 + lTap].HintDescriptor
+            = (LADSPA_HINT_BOUNDED_BELOW
+               | LADSPA_HINT_BOUNDED_ABOVE
+               | LADSPA_HINT_DEFAULT_MIDDLE);
+            psPortRangeHints[FIR_COEF0 + lTap].LowerBound
+            = -1;
+            psPortRangeHints[FIR_COEF0 + lTap].UpperBound
+            = +1;
+        }
+
+        piPortDescriptors[FIR_OUTPUT(lTaps)]
+        = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
+        pcPortNames[FIR_OUTPUT(lTaps)]
+        = strdup("Output");
+        psPortRangeHints[FIR_OUTPUT(lTaps)].HintDescriptor
+        = 0;
+
+        psDescriptor->instantiate
+        = instantiateFilter;
+        psDescriptor->connect_port
+        = connectPortToFilter;
+        psDescriptor->activate
+        = activateFilter;
+        psDescriptor->run
+        = fRun;
+        psDescriptor->run_adding
+        = NULL;
+        psDescriptor->set_run_adding_gain
+        = NULL;
+        psDescriptor->deactivate
+        = NULL;
+        psDescriptor->cleanup
+        = cleanupFilter;
+    }
+
+    return psDescriptor;
+}
+
+/*****************************************************************************/
+
+/* _init() e' o construtor dos descritores */
+void _init()
+{
+    g_psDescriptors[0] = createDescriptor(991,   8, runFilter8);
+    g_psDescriptors[1] = createDescriptor(992,  16, runFilter16);
+    g_psDescriptors[2] = createDescriptor(993,  32, runFilter32);
+    g_psDescriptors[3] = createDescriptor(994,  64, runFilter64);
+    g_psDescriptors[4] = createDescriptor(995, 128, runFilter128);
+    g_psDescriptors[5] = createDescriptor(996, 256, runFilter256);
+}
+
+/*****************************************************************************/
+
+/* _fini() e' o destrutor dos descritores */
+void _fini()
+{
+    long lIndex;
+    long lDescriptor;
+    LADSPA_Descriptor * psDescriptor;
+
+    for (lDescriptor = 0; lDescriptor < NO_DESCRIPTORS; lDescriptor++)
+    {
+        psDescriptor = g_psDescriptors[lDescriptor];
+        if (psDescriptor)
+        {
+            free((char *)psDescriptor->Label);
+            free((char *)psDescriptor->Name);
+            free((char *)psDescriptor->Maker);
+            free((char *)psDescriptor->Copyright);
+            free((LADSPA_PortDescriptor *)psDescriptor->PortDescriptors);
+            for (lIndex = 0; lIndex < psDescriptor->PortCount; lIndex++)
+                free((char *)(psDescriptor->PortNames[lIndex]));
+            free((char **)psDescriptor->PortNames);
+            free((LADSPA_PortRangeHint *)psDescriptor->PortRangeHints);
+            free(psDescriptor);
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/* Devolve o descritor desejado */
+const LADSPA_Descriptor *
+ladspa_descriptor(unsigned long Index)
+{
+    if (Index < NO_DESCRIPTORS)
+        return g_psDescriptors[Index];
+    else
+        return NULL;
+}
+
+/*****************************************************************************/
+
+/* EOF */
@@ -17,6 +17,7 @@
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "sondas.h"
 
 /*****************************************************************************/
 
@@ -115,6 +116,8 @@ typedef struct
 
     unsigned long m_lBufferOffset;
 
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
 } Filter;
 
 /*****************************************************************************/
@@ -143,6 +146,8 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
 
     pFilter->m_lBufferOffset = 0;
 
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
+
     return pFilter;
 }
 
@@ -159,6 +164,8 @@ void activateFilter(LADSPA_Handle Instance)
 
     pFilter->m_lBufferOffset = 0;
 
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
+
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoef*/
 
 /*****************************************************************************/
@@ -290,6 +297,9 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
     lBufferOffset = pFilter->m_lBufferOffset;
 
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, TAM_FILTRO);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
     {
         /* O buffer recebe a mais recente amostra de x(n) */
@@ -320,6 +330,9 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
     pFilter->m_lBufferOffset = (pFilter->m_lBufferOffset + SampleCount) & TAM_FILTRO_1; /* Atualiza o indice do ponteiro dos vetores circulares*/
 
+    /* Coeficientes fixos, vindos das portas: nada se adapta */
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, 0);
+
 }
 
 /*****************************************************************************/
@@ -332,6 +345,7 @@ cleanupFilter(LADSPA_Handle Instance)
     Filter * pFilter;
 
     pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
 
     free(pFilter->m_pfBuffer);
 
@@ -16,6 +16,10 @@
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
 
 /*****************************************************************************/
 
@@ -37,10 +41,16 @@
 #define LMS_INPUTX        6
 #define LMS_OUTPUT        7
 
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define LMS_ERLE          8
+#define LMS_UPDATE_RATE   9
+#define LMS_GEIGEL        10
+
 
 /* Quantidade de portas */
 
-#define NOPORTS 8
+#define NOPORTS 11
 
 /*****************************************************************************/
 
@@ -102,6 +112,15 @@ typedef struct
     /* Output audio port data location. */
     LADSPA_Data * m_pfOutput;
 
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
 } Filter;
 
 /*****************************************************************************/
@@ -122,10 +141,12 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     }
 
     pFilter->m_fSampleRate = (LADSPA_Data)SampleRate;
+    memset(&pFilter->m_sMeters, 0, sizeof(MeterPorts));
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
 
     /* O tamanho do buffer e' a menor potencia de dois que seja maior que o tamanho necessario */
     /* Isto torna a "circularizacao" do vetor muito mais simples */
-    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS);
+    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS * 0.001) + 1;
 
     pFilter->m_lFilterSize = 1;
     pFilter->m_lDtdSize = 1;
@@ -147,6 +168,8 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
 
     pFilter->m_fXVar = 0;
     pFilter->m_lWritePointerX = 0; /* Inicializa o vetor de escrita */
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, LMS_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
 
     return pFilter;
 }
@@ -163,6 +186,7 @@ void activateFilter(LADSPA_Handle Instance) {
     memset(pFilter->m_pfCoefs, 0, sizeof(LADSPA_Data) * pFilter->m_lFilterSize);
     pFilter->m_fXVar = 0;
     pFilter->m_lWritePointerX = 0;
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
 
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/
 
@@ -176,6 +200,8 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
 
     pFilter = (Filter *)Instance;
 
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+
     switch (Port)
     {
         case LMS_FILTER_LENGTH :
@@ -202,6 +228,11 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
         case LMS_OUTPUT:
             pFilter->m_pfOutput = DataLocation;
             break;
+        case LMS_ERLE:
+        case LMS_UPDATE_RATE:
+        case LMS_GEIGEL:
+            meterConnect(&pFilter->m_sMeters, Port - LMS_ERLE, DataLocation);
+            break;
     }
 }
 
@@ -222,27 +253,35 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     LADSPA_Data fConvSample;
     LADSPA_Data fDtdThreshold;
     LADSPA_Data fErrSample;
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
     LADSPA_Data fMaxX; /* Variavel para DTD pelo metodo de Geigel*/
+    LADSPA_Data fGeigel=0; /* |d(n)| / max|x|, comparado ao limiar do DTD */
     LADSPA_Data fSetThreshold;
 
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
+
     Filter * pFilter;
 
     unsigned long lBufferXSizeMinusOne;
     unsigned long lBufferXWriteOffset;
     unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */
     unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */
-    unsigned long lBufferDSizeMinusOne;
     unsigned long lIndex;
     unsigned long lSampleIndex;
     unsigned long lCorrIndex;
     unsigned long lConv; /* Contador da convolucao */
 
     pFilter = (Filter *)Instance;
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
 
     lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1;
     lXCoefs = (unsigned long)(LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001;
-    lBufferDSizeMinusOne = pFilter->m_lDtdSize - 1;
-    lDCoefs = (unsigned long)(LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001;;
+    lDCoefs = (unsigned long)(LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001;
+    if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */
 
     pfInputD      =  pFilter->m_pfInputD;
     pfInputX      =  pFilter->m_pfInputX;
@@ -255,6 +294,8 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     fSetThreshold = *pFilter->m_pfSetThreshold;
     lBufferXWriteOffset = pFilter->m_lWritePointerX;
 
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
     {
         lIndex = lSampleIndex + lBufferXWriteOffset;
@@ -268,21 +309,28 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         }
 
         fMaxX = 0; /* Zera a variavel */
-        for (lCorrIndex = 0; lCorrIndex < lDCoefs; lCorrIndex++)
+        for (lCorrIndex = 0; lCorrIndex < lDCoefs; lCorrIndex++) /* max |x(n - k)| nas ultimas lDCoefs amostras */
         {
-            if (fMaxX < ABS(pfBufferX[(lIndex + lCorrIndex) & lBufferXSizeMinusOne]))
+            if (fMaxX < ABS(pfBufferX[(lIndex - lCorrIndex) & lBufferXSizeMinusOne]))
             {
-                fMaxX = ABS(pfBufferX[(lIndex + lCorrIndex) & lBufferXSizeMinusOne]);
+                fMaxX = ABS(pfBufferX[(lIndex - lCorrIndex) & lBufferXSizeMinusOne]);
             }
         }
 
-        fErrSample = *pfInputD - fConvSample;
+        fD = *pfInputD;
+        fErrSample = fD - fConvSample;
         *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
 
         *pfXVar += pfBufferX[lIndex & lBufferXSizeMinusOne]*pfBufferX[lIndex & lBufferXSizeMinusOne] - pfBufferX[(lIndex - lXCoefs) & lBufferXSizeMinusOne] * pfBufferX[(lIndex - lXCoefs) & lBufferXSizeMinusOne];
 
-        if (ABS(*pfInputD)/fMaxX < fDtdThreshold && ABS(fErrSample) > fSetThreshold)
+        fGeigel = ABS(fD)/fMaxX;
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(fGeigel < fDtdThreshold), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(fGeigel < fDtdThreshold), lSampleIndex);
+        if (fGeigel < fDtdThreshold && ABS(fErrSample) > fSetThreshold)
         {
+            lUpdates++;
             if (*pfXVar > EPSILON)
             {
                 fStep = fMu * fErrSample / *pfXVar;
@@ -301,7 +349,13 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
         pfInputD++;
     }
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, fGeigel, 1);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, fGeigel, 1);
+
     pFilter->m_lWritePointerX = ((pFilter->m_lWritePointerX + SampleCount) & lBufferXSizeMinusOne); /* Atualiza o indice do ponteiro dos vetores circulares*/
+
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
 }
 
 /*****************************************************************************/
@@ -313,14 +367,33 @@ cleanupFilter(LADSPA_Handle Instance) {
   Filter * pFilter;
 
   pFilter = (Filter *)Instance;
+  PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+  dumpStop(&pFilter->m_sDump);
 
   free(pFilter->m_pfBufferX);
   free(pFilter->m_pfCoefs);
+  TIMING_DESTROY(pFilter->m_psTiming);
   free(pFilter);
 }
 
 /*****************************************************************************/
 
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
+
+/*****************************************************************************/
+
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
+/*****************************************************************************/
+
 LADSPA_Descriptor * g_psDescriptor = NULL;
 
 /*****************************************************************************/
@@ -441,6 +514,7 @@ void _init() {
       = 0;
     psPortRangeHints[LMS_OUTPUT].HintDescriptor
       = 0;
+    meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, LMS_ERLE, METER_PORTS_LINEAR);
     g_psDescriptor->instantiate
       = instantiateFilter;
     g_psDescriptor->connect_port
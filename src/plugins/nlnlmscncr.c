@@ -9,7 +9,12 @@
 
 /*****************************************************************************/ 
 
-#include "ladspa.h" 
+#include "ladspa.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
+#include "telemetria.h"
 
 /*****************************************************************************/ 
 
@@ -40,10 +45,17 @@
 #define LMS_INPUTX        7 
 #define LMS_OUTPUT        8 
 
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define LMS_ERLE          9
+#define LMS_UPDATE_RATE   10
+#define LMS_DNCR          11
+#define LMS_ALPHA_OUT     12
+
 
 /* Quantidade de portas */ 
 
-#define NOPORTS 9
+#define NOPORTS 13
 
 /*****************************************************************************/ 
 
@@ -87,7 +99,10 @@ typedef struct
     unsigned long m_lDtdSize; 
 
     /* Indice do ponteiro do buffer de X */ 
-    unsigned long m_lWritePointerX; 
+    unsigned long m_lWritePointerX;
+
+    /* Registros de cada bloco para o host (veja telemetria.h) */
+    TelemetryRing * m_psTelemetry;
 
     /* Ports: 
      ------ */ 
@@ -120,6 +135,15 @@ typedef struct
     /* Output audio port data location. */ 
     LADSPA_Data * m_pfOutput; 
 
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
 } Filter; 
 
 /*****************************************************************************/ 
@@ -141,11 +165,13 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     } 
 
     pFilter->m_fSampleRate = (LADSPA_Data)SampleRate; 
+    memset(&pFilter->m_sMeters, 0, sizeof(MeterPorts));
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
 
     /* O tamanho do buffer e' a menor potencia de dois que seja maior que o tamanho necessario */ 
     /* Isto torna a "circularizacao" do vetor muito mais simples */ 
-    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS); 
-    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS); 
+    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS * 0.001) + 1; 
+    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS * 0.001) + 1; 
 
     pFilter->m_lFilterSize = 1; 
     pFilter->m_lDtdSize = 1; 
@@ -170,13 +196,16 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     pFilter->m_fDVar = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data));
 	pFilter->m_pfAlpha = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data)); 
     pFilter->m_lWritePointerX = 0; /* Inicializa o vetor de escrita */ 
-    pFilter->m_fEchoTimeant = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data)); 
+    pFilter->m_fEchoTimeant = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data));
+    pFilter->m_psTelemetry = (TelemetryRing *)aligned_alloc(64, sizeof(TelemetryRing));
 
-    if (pFilter->m_pfBufferX == NULL || pFilter->m_pfBufferdX == NULL || pFilter->m_pfCoefs == NULL || pFilter->m_pfPdx == NULL || pFilter->m_fXVar == NULL || pFilter->m_fDVar == NULL || pFilter->m_fEchoTimeant == NULL) 
+    if (pFilter->m_pfBufferX == NULL || pFilter->m_pfBufferdX == NULL || pFilter->m_pfCoefs == NULL || pFilter->m_pfPdx == NULL || pFilter->m_fXVar == NULL || pFilter->m_fDVar == NULL || pFilter->m_pfAlpha == NULL || pFilter->m_fEchoTimeant == NULL || pFilter->m_psTelemetry == NULL) 
     { 
         fputs("Out of memory.\n", stderr); 
         exit(EXIT_FAILURE); 
     } 
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, LMS_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
 
     return pFilter; 
 } 
@@ -198,7 +227,9 @@ void activateFilter(LADSPA_Handle Instance)
     *pFilter->m_pfCoefs = 1; 
     *pFilter->m_fXVar = 0; 
     *pFilter->m_fDVar = 0; 
-	*pFilter->m_pfAlpha = 1; 
+	*pFilter->m_pfAlpha = 1;
+    telemetryReset(pFilter->m_psTelemetry);
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
 
 
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/ 
@@ -213,6 +244,8 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
 
     pFilter = (Filter *)Instance; 
 
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+
     switch (Port) 
     { 
     case LMS_FILTER_LENGTH : 
@@ -242,6 +275,12 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
     case LMS_OUTPUT: 
         pFilter->m_pfOutput = DataLocation; 
         break; 
+    case LMS_ERLE:
+    case LMS_UPDATE_RATE:
+    case LMS_DNCR:
+    case LMS_ALPHA_OUT:
+        meterConnect(&pFilter->m_sMeters, Port - LMS_ERLE, DataLocation);
+        break;
     } 
 } 
 
@@ -267,26 +306,32 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     LADSPA_Data fConvSample=0; /* Variavel auxiliar da convolucao */ 
     LADSPA_Data fDtdThreshold; /* Limiar do Double-Talk detector */ 
     LADSPA_Data fErrSample=0; /* Valor atual do e(n) */ 
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
     LADSPA_Data fSetThreshold; /* Limiar do Set-Membership */ 
     LADSPA_Data fDNCR=0; 
     LADSPA_Data fgammaD;
 	LADSPA_Data auxvar; /* Variavel auxiliar */
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    TelemetryRecord * psRecord; /* Registro de telemetria do bloco */
 
     Filter * pFilter; 
 
     unsigned long lBufferXSizeMinusOne; 
-    unsigned long lBufferDXSizeMinusOne; 
     unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */ 
     unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */ 
     unsigned long lIndexW; /* Indice usado para gravar no buffer */ 
     unsigned long lSampleIndex; 
-    unsigned long lConv=0; /* Contador da convolucao */ 
+    unsigned long lConv=0; /* Contador da convolucao */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
 
     pFilter = (Filter *)Instance; 
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
 
     lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1; 
     lXCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001); 
-    lBufferDXSizeMinusOne = pFilter->m_lDtdSize - 1; 
     lDCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001); 
     if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */ 
     fgammaD = ((float)lDCoefs - 1.0f)/ (float)lDCoefs; 
@@ -311,6 +356,8 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     fDtdThreshold = *pFilter->m_pfDtdThreshold; 
     fSetThreshold = DB_CO(*pFilter->m_pfSetThreshold); 
 
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++) 
     {
 		auxvar = (*pfAlpha)*(*pfInputX);
@@ -323,8 +370,11 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
             fConvSample+=pfCoefs[lConv]*pfBufferX[((lIndexW + lConv) & lBufferXSizeMinusOne)]; 
         } 
 
-        fErrSample = *pfInputD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */ 
-        *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */ 
+        fD = *pfInputD;
+        fErrSample = fD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */ 
+        *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
 
         if(*pFilter->m_fEchoTimeant == *pFilter->m_pfEchoTime) /* Se o tamanho do filtro nao mudar calcula tr[Rx] pelo metodo incremental */ 
         {
@@ -345,21 +395,24 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         } 
 
         *pfDVar *= fgammaD; /* Utiliza o metodo IIR para estimar var(D) */ 
-        *pfDVar += (1 - fgammaD) * (*pfInputD) * (*pfInputD); 
+        *pfDVar += (1 - fgammaD) * fD * fD; 
 
         fDNCR=0; 
         for(lConv = 0; lConv < lDCoefs; lConv++) 
         { 
             pfPdx[lConv] *= fgammaD; /*Obtemos uma estimativa da correlacao cruzada de D e X pelo metodo IIR */ 
-            pfPdx[lConv] += (1 - fgammaD) * pfBufferX[(lIndexW + lConv) & lBufferXSizeMinusOne] * (*pfInputD); 
+            pfPdx[lConv] += (1 - fgammaD) * pfBufferX[(lIndexW + lConv) & lBufferXSizeMinusOne] * fD; 
             fDNCR += pfPdx[lConv] * pfCoefs[lConv]; /*Depois incrementamos o fator DNCR */ 
         } 
 
         fDNCR /= *pfDVar; /* Falta dividir por var(D): fDNCR = (r_dx * w) / *pfDVar */ 
 
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(fDNCR > fDtdThreshold), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(fDNCR > fDtdThreshold), lSampleIndex);
         if (fDNCR > fDtdThreshold && ABS(fErrSample) > fSetThreshold) 
         { 
-            fStep = fMu * fErrSample / (*pfXVar + EPSILON); 
+            fStep = fMu * fErrSample / (*pfXVar + EPSILON);
+            lUpdates++;
             
             for(lConv = 0; lConv < lXCoefs; lConv++) /* w(n+1) = w(n) + 2 * mu * e(n) * X(n) */ 
             {
@@ -381,10 +434,28 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         pfInputD++; /* Recebe proxima amostra de D */ 
     }
 
-	fprintf(stderr,"Alfa = %g  AlfaStep = %g AlfaCorr = %g fDNCR = %g fDTDTh = %g\n",*pfAlpha,fMuNL * fErrSample * fConvSample, fConvSample * fConvSample, fDNCR,fDtdThreshold);
+    /* Publica o estado do bloco; o host le com ladspa_telemetry() fora da thread de audio */
+    psRecord = telemetryReserve(pFilter->m_psTelemetry);
+    if (psRecord != NULL)
+    {
+        psRecord->m_lSamples = SampleCount;
+        psRecord->m_lUpdates = lUpdates;
+        psRecord->m_fAlpha = *pfAlpha;
+        psRecord->m_fDNCR = fDNCR;
+        psRecord->m_fXVar = *pfXVar;
+        psRecord->m_fDVar = *pfDVar;
+        psRecord->m_fERLE = 10.0f * log10f((fPotD + 1e-20f) / (fPotE + 1e-20f));
+        telemetryCommit(pFilter->m_psTelemetry);
+    }
+
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, fDNCR, *pfAlpha);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, fDNCR, *pfAlpha);
 
     pFilter->m_lWritePointerX = (lIndexW & lBufferXSizeMinusOne); /* Atualiza o indice do ponteiro dos vetores circulares*/ 
 
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
+
 } 
 
 /*****************************************************************************/ 
@@ -396,12 +467,43 @@ void cleanupFilter(LADSPA_Handle Instance)
     Filter * pFilter; 
 
     pFilter = (Filter *)Instance; 
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    dumpStop(&pFilter->m_sDump);
     free(pFilter->m_pfPdx); 
     free(pFilter->m_fXVar); 
     free(pFilter->m_fDVar); 
     free(pFilter->m_pfBufferX); 
-    free(pFilter->m_pfCoefs); 
-    free(pFilter); 
+    free(pFilter->m_pfCoefs);
+    free(pFilter->m_pfBufferdX);
+    free(pFilter->m_pfAlpha);
+    free(pFilter->m_fEchoTimeant);
+    free(pFilter->m_psTelemetry);
+    TIMING_DESTROY(pFilter->m_psTiming);
+    free(pFilter);
+}
+
+/*****************************************************************************/
+
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
+
+/*****************************************************************************/
+
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
+/*****************************************************************************/
+
+/* Fila de telemetria da instancia, para o host esvaziar fora da thread de audio */
+TelemetryRing * ladspa_telemetry(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTelemetry;
 } 
 
 /*****************************************************************************/ 
@@ -538,7 +640,8 @@ void _init()
         = 0; 
         psPortRangeHints[LMS_OUTPUT].HintDescriptor 
         = 0; 
-        g_psDescriptor->instantiate 
+        meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, LMS_ERLE, METER_PORTS_NL);
+        g_psDescriptor->instantiate
         = instantiateFilter; 
         g_psDescriptor->connect_port 
         = connectPortToFilter; 
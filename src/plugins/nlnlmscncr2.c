@@ -9,7 +9,11 @@
 
 /*****************************************************************************/ 
 
-#include "ladspa.h" 
+#include "ladspa.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
 
 /*****************************************************************************/ 
 
@@ -40,10 +44,17 @@
 #define LMS_INPUTX        6 
 #define LMS_OUTPUT        7 
 
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define LMS_ERLE          8
+#define LMS_UPDATE_RATE   9
+#define LMS_DNCR          10
+#define LMS_ALPHA_OUT     11
+
 
 /* Quantidade de portas */ 
 
-#define NOPORTS 8
+#define NOPORTS 12
 
 /*****************************************************************************/ 
 
@@ -117,6 +128,15 @@ typedef struct
     /* Output audio port data location. */ 
     LADSPA_Data * m_pfOutput; 
 
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
 } Filter; 
 
 /*****************************************************************************/ 
@@ -138,11 +158,13 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     } 
 
     pFilter->m_fSampleRate = (LADSPA_Data)SampleRate; 
+    memset(&pFilter->m_sMeters, 0, sizeof(MeterPorts));
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
 
     /* O tamanho do buffer e' a menor potencia de dois que seja maior que o tamanho necessario */ 
     /* Isto torna a "circularizacao" do vetor muito mais simples */ 
-    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS); 
-    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS); 
+    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS * 0.001) + 1; 
+    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS * 0.001) + 1; 
 
     pFilter->m_lFilterSize = 1; 
     pFilter->m_lDtdSize = 1; 
@@ -175,6 +197,8 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
         fputs("Out of memory.\n", stderr); 
         exit(EXIT_FAILURE); 
     } 
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, LMS_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
 
     return pFilter; 
 } 
@@ -197,6 +221,7 @@ void activateFilter(LADSPA_Handle Instance)
     *pFilter->m_fXVar = 0; 
     *pFilter->m_fDVar = 0; 
 	*pFilter->m_pfAlpha = 1; 
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
 
 
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/ 
@@ -211,6 +236,8 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
 
     pFilter = (Filter *)Instance; 
 
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+
     switch (Port) 
     { 
     case LMS_FILTER_LENGTH : 
@@ -237,6 +264,12 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
     case LMS_OUTPUT: 
         pFilter->m_pfOutput = DataLocation; 
         break; 
+    case LMS_ERLE:
+    case LMS_UPDATE_RATE:
+    case LMS_DNCR:
+    case LMS_ALPHA_OUT:
+        meterConnect(&pFilter->m_sMeters, Port - LMS_ERLE, DataLocation);
+        break;
     } 
 } 
 
@@ -261,15 +294,19 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     LADSPA_Data fConvSample=0; /* Variavel auxiliar da convolucao */ 
     LADSPA_Data fDtdThreshold; /* Limiar do Double-Talk detector */ 
     LADSPA_Data fErrSample=0; /* Valor atual do e(n) */ 
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
     LADSPA_Data fSetThreshold; /* Limiar do Set-Membership */ 
     LADSPA_Data fDNCR=0; 
     LADSPA_Data fgammaD;
 	LADSPA_Data auxvar; /* Variavel auxiliar */
 
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
+
     Filter * pFilter; 
 
     unsigned long lBufferXSizeMinusOne; 
-    unsigned long lBufferDXSizeMinusOne; 
     unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */ 
     unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */ 
     unsigned long lIndexW; /* Indice usado para gravar no buffer */ 
@@ -277,10 +314,12 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     unsigned long lConv=0; /* Contador da convolucao */ 
 
     pFilter = (Filter *)Instance; 
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
 
     lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1; 
     lXCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001); 
-    lBufferDXSizeMinusOne = pFilter->m_lDtdSize - 1; 
     lDCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001); 
     if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */ 
     fgammaD = ((float)lDCoefs - 1.0f)/ (float)lDCoefs; 
@@ -304,6 +343,8 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     fDtdThreshold = *pFilter->m_pfDtdThreshold; 
     fSetThreshold = DB_CO(*pFilter->m_pfSetThreshold); 
 
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++) 
     {
 		auxvar = (*pfAlpha)*(*pfInputX);
@@ -316,8 +357,11 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
             fConvSample+=pfCoefs[lConv]*pfBufferX[((lIndexW + lConv) & lBufferXSizeMinusOne)]; 
         } 
 
-        fErrSample = *pfInputD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */ 
+        fD = *pfInputD;
+        fErrSample = fD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */ 
         *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */ 
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
 
         if(*pFilter->m_fEchoTimeant == *pFilter->m_pfEchoTime) /* Se o tamanho do filtro nao mudar calcula tr[Rx] pelo metodo incremental */ 
         {
@@ -338,18 +382,20 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         } 
 
         *pfDVar *= fgammaD; /* Utiliza o metodo IIR para estimar var(D) */
-        *pfDVar += (1 - fgammaD) * (*pfInputD) * (*pfInputD); 
+        *pfDVar += (1 - fgammaD) * fD * fD; 
 
         fDNCR=0; 
         for(lConv = 0; lConv < lDCoefs; lConv++) 
         { 
             pfPdx[lConv] *= fgammaD; /*Obtemos uma estimativa da correlacao cruzada de D e X pelo metodo IIR */ 
-            pfPdx[lConv] += (1 - fgammaD) * pfBufferX[(lIndexW + lConv) & lBufferXSizeMinusOne] * (*pfInputD); 
+            pfPdx[lConv] += (1 - fgammaD) * pfBufferX[(lIndexW + lConv) & lBufferXSizeMinusOne] * fD; 
             fDNCR += pfPdx[lConv] * pfCoefs[lConv]; /*Depois incrementamos o fator DNCR */ 
         } 
 
         fDNCR /= *pfDVar; /* fDNCR = fDNCR / *pfDVar */ 
 
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(fDNCR > fDtdThreshold), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(fDNCR > fDtdThreshold), lSampleIndex);
         if (fDNCR > fDtdThreshold && ABS(fErrSample) > fSetThreshold) 
         { 
 
@@ -361,6 +407,8 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
             fStep = fMu * fErrSample / (*pfXVar + EPSILON + fConvSample*fConvSample);
 
+            lUpdates++;
+
             
             for(lConv = 0; lConv < lXCoefs; lConv++) /* w(n+1) = w(n) + 2 * mu * e(n) * X(n) */ 
             {
@@ -377,8 +425,14 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         pfInputD++; /* Recebe proxima amostra de D */ 
     }
 
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, fDNCR, *pfAlpha);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, fDNCR, *pfAlpha);
+
     pFilter->m_lWritePointerX = (lIndexW & lBufferXSizeMinusOne); /* Atualiza o indice do ponteiro dos vetores circulares*/ 
 
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
+
 } 
 
 /*****************************************************************************/ 
@@ -390,14 +444,33 @@ void cleanupFilter(LADSPA_Handle Instance)
     Filter * pFilter; 
 
     pFilter = (Filter *)Instance; 
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    dumpStop(&pFilter->m_sDump);
     free(pFilter->m_pfPdx); 
     free(pFilter->m_fXVar); 
     free(pFilter->m_fDVar); 
     free(pFilter->m_pfBufferX); 
     free(pFilter->m_pfCoefs); 
+    TIMING_DESTROY(pFilter->m_psTiming);
     free(pFilter); 
 } 
 
+/*****************************************************************************/
+
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
+
+/*****************************************************************************/
+
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
 /*****************************************************************************/ 
 
 LADSPA_Descriptor * g_psDescriptor = NULL; 
@@ -520,7 +593,8 @@ void _init()
         = 0; 
         psPortRangeHints[LMS_OUTPUT].HintDescriptor 
         = 0; 
-        g_psDescriptor->instantiate 
+        meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, LMS_ERLE, METER_PORTS_NL);
+        g_psDescriptor->instantiate
         = instantiateFilter; 
         g_psDescriptor->connect_port 
         = connectPortToFilter; 
@@ -9,7 +9,11 @@
 
 /*****************************************************************************/ 
 
-#include "ladspa.h" 
+#include "ladspa.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
 
 /*****************************************************************************/ 
 
@@ -40,9 +44,16 @@
 #define LMS_INPUTX        6 
 #define LMS_OUTPUT        7 
 
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define LMS_ERLE          8
+#define LMS_UPDATE_RATE   9
+#define LMS_DNCR          10
+#define LMS_ALPHA_OUT     11
+
 /* Quantidade de portas */ 
 
-#define NOPORTS 		  8
+#define NOPORTS 		  12
 
 /*****************************************************************************/ 
 
@@ -116,6 +127,15 @@ typedef struct
     /* Output audio port data location. */ 
     LADSPA_Data * m_pfOutput; 
 
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
 } Filter; 
 
 /*****************************************************************************/ 
@@ -137,11 +157,13 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
     } 
 
     pFilter->m_fSampleRate = (LADSPA_Data)SampleRate; 
+    memset(&pFilter->m_sMeters, 0, sizeof(MeterPorts));
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
 
     /* O tamanho do buffer e' a menor potencia de dois que seja maior que o tamanho necessario */ 
     /* Isto torna a "circularizacao" do vetor muito mais simples */ 
-    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS); 
-    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS); 
+    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS * 0.001) + 1; 
+    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS * 0.001) + 1; 
 
     pFilter->m_lFilterSize = 1; 
     pFilter->m_lDtdSize = 1; 
@@ -174,6 +196,8 @@ LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned l
         fputs("Out of memory.\n", stderr); 
         exit(EXIT_FAILURE); 
     } 
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, LMS_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
 
     return pFilter; 
 } 
@@ -197,6 +221,7 @@ void activateFilter(LADSPA_Handle Instance)
     *pFilter->m_fXVar = 0; 
     *pFilter->m_fDVar = 0; 
 	*pFilter->m_pfAlpha = 1; 
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
 
 } /* Atribui zero a todos os "size of... " bytes do m_pfBuffer e do m_pfCoefs*/ 
 
@@ -210,6 +235,8 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
 
     pFilter = (Filter *)Instance; 
 
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+
     switch (Port) 
     { 
     case LMS_FILTER_LENGTH : 
@@ -236,6 +263,12 @@ void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data
     case LMS_OUTPUT: 
         pFilter->m_pfOutput = DataLocation; 
         break; 
+    case LMS_ERLE:
+    case LMS_UPDATE_RATE:
+    case LMS_DNCR:
+    case LMS_ALPHA_OUT:
+        meterConnect(&pFilter->m_sMeters, Port - LMS_ERLE, DataLocation);
+        break;
     } 
 } 
 
@@ -260,15 +293,19 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     LADSPA_Data fConvSample=0; /* Variavel auxiliar da convolucao */ 
     LADSPA_Data fDtdThreshold; /* Limiar do Double-Talk detector */ 
     LADSPA_Data fErrSample=0; /* Valor atual do e(n) */ 
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
     LADSPA_Data fSetThreshold; /* Limiar do Set-Membership */ 
     LADSPA_Data fDNCR=0; 
     LADSPA_Data fgammaD;
 	LADSPA_Data auxvar; /* Variavel auxiliar */
 
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
+
     Filter * pFilter; 
 
     unsigned long lBufferXSizeMinusOne; 
-    unsigned long lBufferDXSizeMinusOne; 
     unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */ 
     unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */ 
     unsigned long lIndexW; /* Indice usado para gravar no buffer */ 
@@ -276,10 +313,12 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     unsigned long lConv=0; /* Contador da convolucao */ 
 
     pFilter = (Filter *)Instance; 
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
 
     lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1; 
     lXCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001); 
-    lBufferDXSizeMinusOne = pFilter->m_lDtdSize - 1; 
     lDCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001); 
     if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */ 
     fgammaD = ((float)lDCoefs - 1.0f)/ (float)lDCoefs; 
@@ -303,6 +342,8 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
     fDtdThreshold = DB_CO(*pFilter->m_pfDtdThreshold); 
     fSetThreshold = DB_CO(*pFilter->m_pfSetThreshold); 
 
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
     for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++) 
     {
 		auxvar = (*pfAlpha)*(*pfInputX);
@@ -313,8 +354,11 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
         fConvSample = cblas_sdot(lXCoefs, pfCoefs, 1, pfBufferX + lIndexW, 1); /* w(n)*x(n) */ 
 
-        fErrSample = *pfInputD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */ 
+        fD = *pfInputD;
+        fErrSample = fD - fConvSample; /* e(n) = d(n) - w(n)*x(n) */ 
         *(pfOutput++) = fErrSample; /* Joga o "erro" na saida */ 
+        fPotD += fD * fD;
+        fPotE += fErrSample * fErrSample;
 
         if(*pFilter->m_fEchoTimeant == *pFilter->m_pfEchoTime) /* Se o tamanho do filtro nao mudar calcula tr[Rx] pelo metodo incremental */ 
         {
@@ -335,17 +379,20 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
         } 
 
         *pfDVar *= fgammaD; /* Utiliza o metodo IIR para estimar var(D) */
-        *pfDVar += (1 - fgammaD) * (*pfInputD) * (*pfInputD); 
+        *pfDVar += (1 - fgammaD) * fD * fD; 
 
 		cblas_sscal(lDCoefs, fgammaD, pfPdx, 1);
-		cblas_saxpy(lDCoefs, (1 - fgammaD) * (*pfInputD), pfBufferX + lIndexW, 1, pfPdx, 1);
+		cblas_saxpy(lDCoefs, (1 - fgammaD) * fD, pfBufferX + lIndexW, 1, pfPdx, 1);
 		fDNCR = cblas_sdot(lDCoefs, pfCoefs, 1,  pfPdx, 1); /* w(n)*pdx(n) */ 
         fDNCR /= *pfDVar; /* Falta dividir por var(D): fDNCR = (r_dx * w) / *pfDVar */
 
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(fDNCR > fDtdThreshold), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(fDNCR > fDtdThreshold), lSampleIndex);
         if (fDNCR > fDtdThreshold && ABS(fErrSample) > fSetThreshold) 
         {
 			fConvSample = cblas_sdot(lXCoefs, pfCoefs, 1, pfBufferdX + lIndexW, 1); /* w(n)*f'(x(n)) */ 
             fStep = fMu * fErrSample / (*pfXVar + fConvSample * fConvSample + EPSILON); 
+            lUpdates++;
             
             cblas_saxpy(lXCoefs, fStep, pfBufferX + lIndexW, 1, pfCoefs, 1);
 
@@ -359,8 +406,14 @@ void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
 
 	// fprintf(stderr,"%c = %g\n",224,*pfAlpha); Opcional para medir o valor de Alfa
 
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, fDNCR, *pfAlpha);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, fDNCR, *pfAlpha);
+
     pFilter->m_lWritePointerX = (lIndexW & lBufferXSizeMinusOne); /* Atualiza o indice do ponteiro dos vetores circulares*/ 
 
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
+
 } 
 
 /*****************************************************************************/ 
@@ -372,14 +425,33 @@ void cleanupFilter(LADSPA_Handle Instance)
     Filter * pFilter; 
 
     pFilter = (Filter *)Instance; 
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    dumpStop(&pFilter->m_sDump);
     free(pFilter->m_pfPdx); 
     free(pFilter->m_fXVar); 
     free(pFilter->m_fDVar); 
     free(pFilter->m_pfBufferX); 
     free(pFilter->m_pfCoefs); 
+    TIMING_DESTROY(pFilter->m_psTiming);
     free(pFilter); 
 } 
 
+/*****************************************************************************/
+
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
+
+/*****************************************************************************/
+
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
 /*****************************************************************************/ 
 
 LADSPA_Descriptor * g_psDescriptor = NULL; 
@@ -502,7 +574,8 @@ void _init()
         = 0; 
         psPortRangeHints[LMS_OUTPUT].HintDescriptor 
         = 0; 
-        g_psDescriptor->instantiate 
+        meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, LMS_ERLE, METER_PORTS_NL);
+        g_psDescriptor->instantiate
         = instantiateFilter; 
         g_psDescriptor->connect_port 
         = connectPortToFilter; 
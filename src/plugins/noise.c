@@ -5,6 +5,10 @@
 
    This LADSPA plugin provides a simple mono noise source. 
 
+   Each instance has its own generator, restarted from the same seed by
+   activate(), so the output does not depend on other instances or
+   threads and repeats exactly after a reset.
+
    This file has poor memory protection. Failures during malloc() will
    not recover nicely. */
 
@@ -16,6 +20,7 @@
 /*****************************************************************************/
 
 #include "ladspa.h"
+#include "sondas.h"
 
 /*****************************************************************************/
 
@@ -26,11 +31,13 @@
 #define NOISE_OUTPUT    2
 
 #define NO_PORTS        3
+
+/* Seed for the per-instance generator: */
+#define NOISE_SEED      1050u
 /*****************************************************************************/
 
 /* The structure used to hold port connection information (and gain if
-   runAdding() is in use) and state (actually there's no further state
-   to store here). */
+   runAdding() is in use) and the generator state. */
 
 typedef struct {
 
@@ -40,6 +47,12 @@ typedef struct {
   LADSPA_Data * m_pfInputBuffer;
   LADSPA_Data * m_pfOutputBuffer;
 
+  /* Generator state (32-bit LCG):
+     ----------------------------- */
+  unsigned int m_uSeed;
+
+  ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
 } NoiseSource;
 
 /*****************************************************************************/
@@ -48,7 +61,22 @@ typedef struct {
 LADSPA_Handle 
 instantiateNoiseSource(const LADSPA_Descriptor * Descriptor,
 		       unsigned long             SampleRate) {
-  return malloc(sizeof(NoiseSource));
+  NoiseSource * psNoiseSource;
+  psNoiseSource = (NoiseSource *)malloc(sizeof(NoiseSource));
+  if (psNoiseSource) {
+    psNoiseSource->m_uSeed = NOISE_SEED;
+    PROBE_INSTANTIATE(&psNoiseSource->m_sProbes, psNoiseSource, Descriptor->UniqueID, SampleRate);
+  }
+  return psNoiseSource;
+}
+
+/*****************************************************************************/
+
+/* Restart the generator so every activation produces the same noise. */
+void 
+activateNoiseSource(LADSPA_Handle Instance) {
+  ((NoiseSource *)Instance)->m_uSeed = NOISE_SEED;
+  PROBE_ACTIVATE(&((NoiseSource *)Instance)->m_sProbes, Instance);
 }
 
 /*****************************************************************************/
@@ -80,13 +108,24 @@ runNoiseSource(LADSPA_Handle Instance,
   
   NoiseSource * psNoiseSource;
   LADSPA_Data * pfOutput;
+  LADSPA_Data fAmplitude;
   unsigned long lSampleIndex;
+  unsigned int uSeed;
 
   psNoiseSource = (NoiseSource *)Instance;
 
   pfOutput = psNoiseSource->m_pfOutputBuffer;
-  for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++) 
-    *(pfOutput++) = (rand()*2.0f/RAND_MAX - 1) * (*(psNoiseSource->m_pfAmplitudeValue));
+  fAmplitude = *(psNoiseSource->m_pfAmplitudeValue);
+  uSeed = psNoiseSource->m_uSeed;
+  PROBE_RUN_ENTRY(&psNoiseSource->m_sProbes, psNoiseSource, SampleCount);
+  for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++) {
+    /* Numerical Recipes LCG; the top 24 bits give a uniform value in
+       [-1, 1). */
+    uSeed = uSeed * 1664525u + 1013904223u;
+    *(pfOutput++) = ((LADSPA_Data)(uSeed >> 8) * (2.0f / 16777216.0f) - 1) * fAmplitude;
+  }
+  psNoiseSource->m_uSeed = uSeed;
+  PROBE_RUN_EXIT(&psNoiseSource->m_sProbes, psNoiseSource, SampleCount, 0);
 }
 
 /*****************************************************************************/
@@ -94,6 +133,7 @@ runNoiseSource(LADSPA_Handle Instance,
 /* Throw away a simple delay line. */
 void 
 cleanupNoiseSource(LADSPA_Handle Instance) {
+  PROBE_CLEANUP(&((NoiseSource *)Instance)->m_sProbes, Instance);
   free(Instance);
 }
 
@@ -171,7 +211,7 @@ _init() {
     g_psDescriptor->connect_port 
       = connectPortToNoiseSource;
     g_psDescriptor->activate
-      = NULL;
+      = activateNoiseSource;
     g_psDescriptor->run
       = runNoiseSource;
     g_psDescriptor->run_adding
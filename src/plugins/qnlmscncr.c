@@ -0,0 +1,954 @@
+/* Software livre por Pedro Nariyoshi. Sem garantias.
+
+   Este plugin LADSPA executa o mesmo algoritmo do nlmscncr.c (e-NLMS com
+   detector de fala dupla CheapNCR e Set-Membership), mas em ponto fixo,
+   para uso em processadores sem unidade de ponto flutuante rapida.
+
+   Formatos:
+     x(n), d(n), e(n)  Q15 saturado em int16 (+-32767)
+     coeficientes      Q30 em int32 (copia usada na adaptacao) e
+                       Q14 em int16 (copia usada na filtragem)
+     var(X), var(D)    Q30 em int64; var(X) e' exata (soma de inteiros)
+     r_dx              Q30 em int32
+     acumuladores      int64
+
+   O passo do NLMS e' calculado em ponto flutuante em blocos: mu*e(n) e
+   var(X) + epsilon sao normalizados (mantissa de 31 bits e expoente) e o
+   quociente vira uma mantissa de 16 bits com deslocamento. Assim a
+   atualizacao dos coeficientes so usa multiplicacoes 16x16 bits.
+
+   Toda a aritmetica e' inteira, entao o resultado e' identico bit a bit
+   entre os nucleos escalar, SSE4.1 e AVX2 (escolhidos no instantiate(),
+   veja simd.h). As entradas e saidas continuam em LADSPA_Data: a
+   conversao acontece nas bordas do run().
+
+   Possui pouca protecao de memoria. Falhas no malloc nao se recuperam bem.
+   E' recomendado usar o Memory Lock e um nucleo (kernel) de baixa latencia.
+
+*/
+
+/*****************************************************************************/
+
+#include "ladspa.h"
+#include "medidores.h"
+#include "cronometro.h"
+#include "sondas.h"
+#include "gravador.h"
+#include "simd.h"
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*****************************************************************************/
+
+/* Parametros do filtro */
+
+#define MAX_ECO_MS 600 /* Maximo tempo de eco (cuidado com a memoria) */
+#define MAX_DTD_MS 20 /* Valores em milissegundos */
+#define EPSILON 0.001 /* Valor do epsilon do e-NLMS */
+
+/* Escalas dos formatos de ponto fixo */
+
+#define Q15_ONE 32768.0f
+#define Q15_MAX 32767 /* -32768 fica de fora para que pares de produtos nao estourem */
+#define Q30_ONE 1073741824.0
+
+/*****************************************************************************/
+
+/* A numeracao das portas do filtro */
+
+#define LMS_FILTER_LENGTH 0
+#define LMS_DTD_LENGTH    1
+#define LMS_DTD_THRESHOLD 2
+#define LMS_MU            3
+#define LMS_SET_THRESHOLD 4
+#define LMS_INPUTD        5
+#define LMS_INPUTX        6
+#define LMS_OUTPUT        7
+
+/* Portas de medicao (saida de controle, veja medidores.h) */
+
+#define LMS_ERLE          8
+#define LMS_UPDATE_RATE   9
+#define LMS_DNCR          10
+
+
+/* Quantidade de portas */
+
+#define NOPORTS 11
+
+/*****************************************************************************/
+
+/* Macros */
+
+#define ABS(x)       				\
+(((x) > 0) ? (x) : -(x))
+#define LIMIT_BETWEEN_0_AND_MAX_ECO_MS(x)  	\
+(((x) < 0) ? 0 : (((x) > MAX_ECO_MS) ? MAX_ECO_MS : (x)))
+#define LIMIT_BETWEEN_0_AND_MAX_DTD_MS(x)  	\
+(((x) < 0) ? 0 : (((x) > MAX_DTD_MS) ? MAX_DTD_MS : (x)))
+#define DB_CO(g) 				\
+(powf(10.0f, (g) * 0.05f)) /* powf e' a versao rapida (fast) da funcao pow */
+#define SATURATE_Q15(x)				\
+(((x) > Q15_MAX) ? Q15_MAX : (((x) < -Q15_MAX) ? -Q15_MAX : (x)))
+
+/*****************************************************************************/
+
+/* Estrutura do filtro */
+typedef struct
+{
+
+    LADSPA_Data m_fSampleRate;
+
+    int16_t * m_psBufferX; /* Valores anteriores de X (Q15), em duas copias */
+
+    int32_t * m_piCoefs; /* coeficientes do filtro (Q30) */
+
+    int16_t * m_psCoefs; /* coeficientes do filtro (Q14) */
+
+    int32_t * m_piPdx; /* Correlacao cruzada de D e X (Q30) */
+
+    int64_t m_llXVar; /* Q30 */
+
+    int64_t m_llDVar; /* Q30 */
+
+    /* O tamanho do buffer em potencia de 2 agiliza a "circularização do vetor, transformando uma equacao de resto de divisão em uma operação de E lógico bit a bit */
+    unsigned long m_lFilterSize;
+
+    unsigned long m_lDtdSize;
+
+    /* Indice do ponteiro do buffer de X */
+    unsigned long m_lWritePointerX;
+
+    /* Comprimento do filtro usado no calculo anterior de var(X) */
+    unsigned long m_lXCoefsAnt;
+
+    /* Nucleo escolhido no instantiate */
+    int m_iSimd;
+
+    /* Ports:
+     ------ */
+
+    /* Tamanho do eco maximo em ms */
+    LADSPA_Data * m_pfEchoTime;
+
+    /* Tamanho do eco maximo em ms */
+    LADSPA_Data * m_pfDtdTime;
+
+    /* Limiar do DTD */
+    LADSPA_Data * m_pfDtdThreshold;
+
+    /* Valor do fator de convergencia */
+    LADSPA_Data * m_pfMu;
+
+    /* Valor do fator do erro maximo para o Set Membership */
+    LADSPA_Data * m_pfSetThreshold;
+
+    /* Input audio port data location. */
+    LADSPA_Data * m_pfInputD;
+
+    /* Input audio port data location. */
+    LADSPA_Data * m_pfInputX;
+
+    /* Output audio port data location. */
+    LADSPA_Data * m_pfOutput;
+
+    /* Portas de medicao (veja medidores.h) */
+    MeterPorts m_sMeters;
+
+    RunTiming * m_psTiming; /* Tempos do run() (make INSTRUMENTAR=1) */
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+    DumpState m_sDump; /* Gravacao dos sinais (veja gravador.h) */
+
+} Filter;
+
+/*****************************************************************************/
+
+/* Nucleos escalares. Sao a referencia: os vetoriais tem de dar
+   exatamente o mesmo resultado. */
+
+/* Soma de w(Q14) * x(Q15), resultado em Q29 */
+static int64_t dotQ15Scalar(const int16_t * psCoefs, const int16_t * psX, unsigned long lCount)
+{
+
+    unsigned long lIndex;
+    int64_t llSum;
+
+    llSum = 0;
+    for (lIndex = 0; lIndex < lCount; lIndex++)
+        llSum += (int32_t)psCoefs[lIndex] * (int32_t)psX[lIndex];
+    return llSum;
+}
+
+/* Soma saturada em 32 bits */
+static inline int32_t addSat32(int32_t iA, int32_t iB)
+{
+
+    int64_t llSum;
+
+    llSum = (int64_t)iA + (int64_t)iB;
+    if (llSum > INT32_MAX)
+        return INT32_MAX;
+    if (llSum < INT32_MIN)
+        return INT32_MIN;
+    return (int32_t)llSum;
+}
+
+/* Copia Q14 de um coeficiente Q30, com arredondamento e saturacao */
+static inline int16_t coefQ14(int32_t iCoef)
+{
+
+    int32_t iRounded;
+
+    iRounded = (iCoef >> 16) + ((iCoef >> 15) & 1);
+    if (iRounded > INT16_MAX)
+        return INT16_MAX;
+    return (int16_t)iRounded;
+}
+
+/* w(n+1) = w(n) + (passo * x(n)) >> iShift, com 0 < iShift < 31 */
+static void updateQ15Scalar(int32_t * piCoefs, int16_t * psCoefs, int16_t sStep, int iShift, const int16_t * psX, unsigned long lCount)
+{
+
+    unsigned long lIndex;
+    int32_t iRound;
+    int32_t iDelta;
+
+    iRound = (int32_t)1 << (iShift - 1);
+    for (lIndex = 0; lIndex < lCount; lIndex++)
+    {
+        iDelta = ((int32_t)sStep * (int32_t)psX[lIndex] + iRound) >> iShift;
+        piCoefs[lIndex] = addSat32(piCoefs[lIndex], iDelta);
+        psCoefs[lIndex] = coefQ14(piCoefs[lIndex]);
+    }
+}
+
+/* Mesma atualizacao para iShift <= 0 (passo muito grande); caminho raro,
+   compartilhado por todos os nucleos */
+static void updateQ15LeftShift(int32_t * piCoefs, int16_t * psCoefs, int16_t sStep, int iShift, const int16_t * psX, unsigned long lCount)
+{
+
+    unsigned long lIndex;
+    int64_t llDelta;
+
+    for (lIndex = 0; lIndex < lCount; lIndex++)
+    {
+        llDelta = ((int64_t)sStep * (int64_t)psX[lIndex]) * ((int64_t)1 << -iShift);
+        if (llDelta > INT32_MAX)
+            llDelta = INT32_MAX;
+        if (llDelta < INT32_MIN)
+            llDelta = INT32_MIN;
+        piCoefs[lIndex] = addSat32(piCoefs[lIndex], (int32_t)llDelta);
+        psCoefs[lIndex] = coefQ14(piCoefs[lIndex]);
+    }
+}
+
+/*****************************************************************************/
+
+/* Nucleos SSE4.1 e AVX2: pmaddwd soma pares de produtos 16x16 em 32 bits
+   (sem estouro porque x nunca vale -32768) e os pares sao estendidos para
+   64 bits antes de acumular. */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+
+static TARGET_SSE41 int64_t dotQ15Sse41(const int16_t * psCoefs, const int16_t * psX, unsigned long lCount)
+{
+
+    __m128i xAcc;
+    __m128i xPairs;
+    unsigned long lIndex;
+    int64_t allLanes[2];
+
+    xAcc = _mm_setzero_si128();
+    for (lIndex = 0; lIndex + 8 <= lCount; lIndex += 8)
+    {
+        xPairs = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(psCoefs + lIndex)), _mm_loadu_si128((const __m128i *)(psX + lIndex)));
+        xAcc = _mm_add_epi64(xAcc, _mm_cvtepi32_epi64(xPairs));
+        xAcc = _mm_add_epi64(xAcc, _mm_cvtepi32_epi64(_mm_srli_si128(xPairs, 8)));
+    }
+    _mm_storeu_si128((__m128i *)allLanes, xAcc);
+    return allLanes[0] + allLanes[1] + dotQ15Scalar(psCoefs + lIndex, psX + lIndex, lCount - lIndex);
+}
+
+static TARGET_AVX2 int64_t dotQ15Avx2(const int16_t * psCoefs, const int16_t * psX, unsigned long lCount)
+{
+
+    __m256i yAcc;
+    __m256i yPairs;
+    unsigned long lIndex;
+    int64_t allLanes[4];
+
+    yAcc = _mm256_setzero_si256();
+    for (lIndex = 0; lIndex + 16 <= lCount; lIndex += 16)
+    {
+        yPairs = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(psCoefs + lIndex)), _mm256_loadu_si256((const __m256i *)(psX + lIndex)));
+        yAcc = _mm256_add_epi64(yAcc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(yPairs)));
+        yAcc = _mm256_add_epi64(yAcc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(yPairs, 1)));
+    }
+    _mm256_storeu_si256((__m256i *)allLanes, yAcc);
+    return allLanes[0] + allLanes[1] + allLanes[2] + allLanes[3] + dotQ15Scalar(psCoefs + lIndex, psX + lIndex, lCount - lIndex);
+}
+
+/* Soma saturada de 32 bits: estoura quando a e b tem o mesmo sinal e a
+   soma tem sinal diferente */
+static inline TARGET_SSE41 __m128i addSat32Sse41(__m128i xA, __m128i xB)
+{
+
+    __m128i xSum;
+    __m128i xOverflow;
+    __m128i xLimit;
+
+    xSum = _mm_add_epi32(xA, xB);
+    xOverflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(xA, xSum), _mm_xor_si128(xB, xSum)), 31);
+    xLimit = _mm_xor_si128(_mm_srai_epi32(xA, 31), _mm_set1_epi32(INT32_MAX));
+    return _mm_blendv_epi8(xSum, xLimit, xOverflow);
+}
+
+static inline TARGET_AVX2 __m256i addSat32Avx2(__m256i yA, __m256i yB)
+{
+
+    __m256i ySum;
+    __m256i yOverflow;
+    __m256i yLimit;
+
+    ySum = _mm256_add_epi32(yA, yB);
+    yOverflow = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(yA, ySum), _mm256_xor_si256(yB, ySum)), 31);
+    yLimit = _mm256_xor_si256(_mm256_srai_epi32(yA, 31), _mm256_set1_epi32(INT32_MAX));
+    return _mm256_blendv_epi8(ySum, yLimit, yOverflow);
+}
+
+static TARGET_SSE41 void updateQ15Sse41(int32_t * piCoefs, int16_t * psCoefs, int16_t sStep, int iShift, const int16_t * psX, unsigned long lCount)
+{
+
+    __m128i xStep;
+    __m128i xRound;
+    __m128i xShift;
+    __m128i xDelta;
+    __m128i xLo;
+    __m128i xHi;
+    __m128i xX;
+    unsigned long lIndex;
+
+    xStep  = _mm_set1_epi32(sStep);
+    xRound = _mm_set1_epi32((int32_t)1 << (iShift - 1));
+    xShift = _mm_cvtsi32_si128(iShift);
+    for (lIndex = 0; lIndex + 8 <= lCount; lIndex += 8)
+    {
+        xX = _mm_loadu_si128((const __m128i *)(psX + lIndex));
+
+        xDelta = _mm_sra_epi32(_mm_add_epi32(_mm_mullo_epi32(xStep, _mm_cvtepi16_epi32(xX)), xRound), xShift);
+        xLo = addSat32Sse41(_mm_loadu_si128((const __m128i *)(piCoefs + lIndex)), xDelta);
+        _mm_storeu_si128((__m128i *)(piCoefs + lIndex), xLo);
+
+        xDelta = _mm_sra_epi32(_mm_add_epi32(_mm_mullo_epi32(xStep, _mm_cvtepi16_epi32(_mm_srli_si128(xX, 8))), xRound), xShift);
+        xHi = addSat32Sse41(_mm_loadu_si128((const __m128i *)(piCoefs + lIndex + 4)), xDelta);
+        _mm_storeu_si128((__m128i *)(piCoefs + lIndex + 4), xHi);
+
+        /* Q30 -> Q14 com arredondamento; packs satura em 16 bits */
+        xLo = _mm_add_epi32(_mm_srai_epi32(xLo, 16), _mm_and_si128(_mm_srai_epi32(xLo, 15), _mm_set1_epi32(1)));
+        xHi = _mm_add_epi32(_mm_srai_epi32(xHi, 16), _mm_and_si128(_mm_srai_epi32(xHi, 15), _mm_set1_epi32(1)));
+        _mm_storeu_si128((__m128i *)(psCoefs + lIndex), _mm_packs_epi32(xLo, xHi));
+    }
+    updateQ15Scalar(piCoefs + lIndex, psCoefs + lIndex, sStep, iShift, psX + lIndex, lCount - lIndex);
+}
+
+static TARGET_AVX2 void updateQ15Avx2(int32_t * piCoefs, int16_t * psCoefs, int16_t sStep, int iShift, const int16_t * psX, unsigned long lCount)
+{
+
+    __m256i yStep;
+    __m256i yRound;
+    __m128i xShift;
+    __m256i yDelta;
+    __m256i yLo;
+    __m256i yHi;
+    __m256i yX;
+    unsigned long lIndex;
+
+    yStep  = _mm256_set1_epi32(sStep);
+    yRound = _mm256_set1_epi32((int32_t)1 << (iShift - 1));
+    xShift = _mm_cvtsi32_si128(iShift);
+    for (lIndex = 0; lIndex + 16 <= lCount; lIndex += 16)
+    {
+        yX = _mm256_loadu_si256((const __m256i *)(psX + lIndex));
+
+        yDelta = _mm256_sra_epi32(_mm256_add_epi32(_mm256_mullo_epi32(yStep, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(yX))), yRound), xShift);
+        yLo = addSat32Avx2(_mm256_loadu_si256((const __m256i *)(piCoefs + lIndex)), yDelta);
+        _mm256_storeu_si256((__m256i *)(piCoefs + lIndex), yLo);
+
+        yDelta = _mm256_sra_epi32(_mm256_add_epi32(_mm256_mullo_epi32(yStep, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(yX, 1))), yRound), xShift);
+        yHi = addSat32Avx2(_mm256_loadu_si256((const __m256i *)(piCoefs + lIndex + 8)), yDelta);
+        _mm256_storeu_si256((__m256i *)(piCoefs + lIndex + 8), yHi);
+
+        /* Q30 -> Q14; packs trabalha por metades de 128 bits, dai o permute */
+        yLo = _mm256_add_epi32(_mm256_srai_epi32(yLo, 16), _mm256_and_si256(_mm256_srai_epi32(yLo, 15), _mm256_set1_epi32(1)));
+        yHi = _mm256_add_epi32(_mm256_srai_epi32(yHi, 16), _mm256_and_si256(_mm256_srai_epi32(yHi, 15), _mm256_set1_epi32(1)));
+        _mm256_storeu_si256((__m256i *)(psCoefs + lIndex), _mm256_permute4x64_epi64(_mm256_packs_epi32(yLo, yHi), 0xd8));
+    }
+    updateQ15Scalar(piCoefs + lIndex, psCoefs + lIndex, sStep, iShift, psX + lIndex, lCount - lIndex);
+}
+
+#endif
+
+/*****************************************************************************/
+
+/* Despacho para o nucleo escolhido no instantiate */
+
+static int64_t dotQ15(const Filter * pFilter, const int16_t * psX, unsigned long lCount)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (pFilter->m_iSimd >= SIMD_AVX2)
+        return dotQ15Avx2(pFilter->m_psCoefs, psX, lCount);
+    if (pFilter->m_iSimd >= SIMD_SSE41)
+        return dotQ15Sse41(pFilter->m_psCoefs, psX, lCount);
+#endif
+    return dotQ15Scalar(pFilter->m_psCoefs, psX, lCount);
+}
+
+static void updateQ15(Filter * pFilter, int16_t sStep, int iShift, const int16_t * psX, unsigned long lCount)
+{
+    if (iShift >= 31) /* O incremento arredonda para zero em todos os coeficientes */
+        return;
+
+    if (iShift <= 0)
+    {
+        updateQ15LeftShift(pFilter->m_piCoefs, pFilter->m_psCoefs, sStep, iShift, psX, lCount);
+        return;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (pFilter->m_iSimd >= SIMD_AVX2)
+    {
+        updateQ15Avx2(pFilter->m_piCoefs, pFilter->m_psCoefs, sStep, iShift, psX, lCount);
+        return;
+    }
+    if (pFilter->m_iSimd >= SIMD_SSE41)
+    {
+        updateQ15Sse41(pFilter->m_piCoefs, pFilter->m_psCoefs, sStep, iShift, psX, lCount);
+        return;
+    }
+#endif
+    updateQ15Scalar(pFilter->m_piCoefs, pFilter->m_psCoefs, sStep, iShift, psX, lCount);
+}
+
+/*****************************************************************************/
+
+/* Ponto flutuante em blocos: normaliza |llValue| > 0 para uma mantissa
+   em [2^30, 2^31) e devolve o expoente (llValue = mantissa * 2^expoente) */
+static int normalize31(int64_t llValue, int64_t * pllMantissa)
+{
+
+    int iBits;
+
+    iBits = 64 - __builtin_clzll((unsigned long long)llValue);
+    if (iBits > 31)
+    {
+        *pllMantissa = llValue >> (iBits - 31);
+        return iBits - 31;
+    }
+    *pllMantissa = llValue << (31 - iBits);
+    return iBits - 31;
+}
+
+/*****************************************************************************/
+
+LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned long SampleRate)
+{
+
+    unsigned long lMinimumBufferXSize;
+    unsigned long lMinimumBufferDSize;
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)calloc(1, sizeof(Filter));
+
+    if (pFilter == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    pFilter->m_fSampleRate = (LADSPA_Data)SampleRate;
+    pFilter->m_iSimd = simdLevel();
+    pFilter->m_psTiming = TIMING_CREATE(SampleRate);
+
+    /* O tamanho do buffer e' a menor potencia de dois que seja maior que o tamanho necessario */
+    lMinimumBufferXSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_ECO_MS * 0.001) + 1;
+    lMinimumBufferDSize = (unsigned long)((LADSPA_Data)SampleRate * MAX_DTD_MS * 0.001) + 1;
+
+    pFilter->m_lFilterSize = 1;
+    pFilter->m_lDtdSize = 1;
+
+    while (pFilter->m_lFilterSize < lMinimumBufferXSize) /*multiplica por 2 até ser maior que o buffer mínimo */
+    {
+        pFilter->m_lFilterSize <<= 1;
+    }
+
+    while (pFilter->m_lDtdSize < lMinimumBufferDSize) /*multiplica por 2 até ser maior que o buffer mínimo */
+    {
+        pFilter->m_lDtdSize <<= 1;
+    }
+
+    /* O buffer de x(n) tem duas copias para que a janela do filtro seja sempre contigua */
+    pFilter->m_psBufferX = (int16_t *)calloc(pFilter->m_lFilterSize * 2, sizeof(int16_t));
+    pFilter->m_piCoefs = (int32_t *)calloc(pFilter->m_lFilterSize, sizeof(int32_t));
+    pFilter->m_psCoefs = (int16_t *)calloc(pFilter->m_lFilterSize, sizeof(int16_t));
+    pFilter->m_piPdx = (int32_t *)calloc(pFilter->m_lDtdSize, sizeof(int32_t));
+
+    if (pFilter->m_psBufferX == NULL || pFilter->m_piCoefs == NULL || pFilter->m_psCoefs == NULL || pFilter->m_piPdx == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    dumpInit(&pFilter->m_sDump, Descriptor, SampleRate, LMS_INPUTD);
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
+
+    return pFilter;
+}
+
+/*****************************************************************************/
+
+/* Inicializa os valores do filtro no caso desativa/ativa */
+void activateFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+    pFilter = (Filter *)Instance;
+
+    memset(pFilter->m_psBufferX, 0, 2 * sizeof(int16_t) * pFilter->m_lFilterSize);
+    memset(pFilter->m_piCoefs, 0, sizeof(int32_t) * pFilter->m_lFilterSize);
+    memset(pFilter->m_psCoefs, 0, sizeof(int16_t) * pFilter->m_lFilterSize);
+    memset(pFilter->m_piPdx, 0, sizeof(int32_t) * pFilter->m_lDtdSize);
+    pFilter->m_piCoefs[0] = (int32_t)Q30_ONE; /* w(0) = 1, como no nlmscncr */
+    pFilter->m_psCoefs[0] = coefQ14(pFilter->m_piCoefs[0]);
+    pFilter->m_llXVar = 0;
+    pFilter->m_llDVar = 0;
+    pFilter->m_lXCoefsAnt = 0;
+    pFilter->m_lWritePointerX = 0;
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
+
+}
+
+/*****************************************************************************/
+
+/* Conecta os ponteiros 'as portas do filtro */
+void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data * DataLocation)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+
+    dumpConnect(&pFilter->m_sDump, Port, DataLocation);
+
+    switch (Port)
+    {
+    case LMS_FILTER_LENGTH :
+        pFilter->m_pfEchoTime = DataLocation;
+        break;
+    case LMS_DTD_LENGTH :
+        pFilter->m_pfDtdTime = DataLocation;
+        break;
+    case LMS_DTD_THRESHOLD :
+        pFilter->m_pfDtdThreshold = DataLocation;
+        break;
+    case LMS_MU:
+        pFilter->m_pfMu = DataLocation;
+        break;
+    case LMS_SET_THRESHOLD :
+        pFilter->m_pfSetThreshold = DataLocation;
+        break;
+    case LMS_INPUTD:
+        pFilter->m_pfInputD = DataLocation;
+        break;
+    case LMS_INPUTX:
+        pFilter->m_pfInputX = DataLocation;
+        break;
+    case LMS_OUTPUT:
+        pFilter->m_pfOutput = DataLocation;
+        break;
+    case LMS_ERLE:
+    case LMS_UPDATE_RATE:
+    case LMS_DNCR:
+        meterConnect(&pFilter->m_sMeters, Port - LMS_ERLE, DataLocation);
+        break;
+    }
+}
+
+/*****************************************************************************/
+
+/* Roda a instancia do filtro adaptativo */
+void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
+{
+
+    int16_t * psBufferX; /* Vetor que armazena os valores antigos de x(n) */
+    int32_t * piPdx; /* A correlação cruzada de D e X */
+    LADSPA_Data * pfInputX; /* Aponta para o bloco de amostras da entrada x(n) */
+    LADSPA_Data * pfInputD; /* Aponta para o bloco de amostras da entrada d(n) */
+    LADSPA_Data * pfOutput; /* Aponta para o bloco de amostras da saida */
+    int64_t llConvSample; /* Variavel auxiliar da convolucao (Q29) */
+    int64_t llDNCR=0; /* Numerador do DNCR (Q44) */
+    int64_t llMantissaP; /* mu * e(n) normalizado */
+    int64_t llMantissaX; /* var(X) + epsilon normalizado */
+    int64_t llEpsilon; /* epsilon em Q30 */
+    int64_t llGammaD; /* gammaD em Q31 */
+    int64_t llOneMinusGammaD; /* 1 - gammaD em Q31 */
+    int64_t llProduct;
+    int32_t iMu; /* Fator do passo (Q15) */
+    int32_t iDtdThreshold; /* Limiar do Double-Talk detector (Q15) */
+    int32_t iSetThreshold; /* Limiar do Set-Membership (Q15) */
+    LADSPA_Data fD; /* d(n), lido antes de escrever e(n) (a saida pode ser a entrada) */
+    int32_t iSampleD; /* d(n) em Q15 */
+    int32_t iErrSample; /* e(n) em Q15 */
+    int32_t iOld;
+    int16_t sSampleX; /* x(n) em Q15 */
+    int16_t sStep; /* Mantissa do passo */
+    int iExpP;
+    int iExpX;
+    int iShift;
+
+    LADSPA_Data fPotD=0; /* Energia de d(n) no bloco */
+    LADSPA_Data fPotE=0; /* Energia de e(n) no bloco */
+    unsigned long lUpdates=0; /* Amostras em que o filtro foi atualizado */
+
+    Filter * pFilter;
+
+    unsigned long lBufferXSizeMinusOne;
+    unsigned long lXCoefs; /* Comprimento do filtro (em amostras) */
+    unsigned long lDCoefs; /* Comprimento do DTD (em amostras) */
+    unsigned long lIndexW; /* Indice usado para gravar no buffer */
+    unsigned long lSampleIndex;
+    unsigned long lConv=0; /* Contador da convolucao */
+
+    pFilter = (Filter *)Instance;
+    TIMING_BEGIN(pFilter->m_psTiming);
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    dumpBegin(&pFilter->m_sDump, SampleCount, pFilter->m_pfInputX, pFilter->m_pfInputD);
+
+    lBufferXSizeMinusOne = pFilter->m_lFilterSize - 1;
+    lXCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_ECO_MS(*pFilter->m_pfEchoTime)) * pFilter->m_fSampleRate * 0.001);
+    lDCoefs = (unsigned long)((LIMIT_BETWEEN_0_AND_MAX_DTD_MS(*pFilter->m_pfDtdTime)) * pFilter->m_fSampleRate * 0.001);
+    if (lDCoefs == 0) lDCoefs++; /* Impede que o DTD tenha comprimento 0 */
+
+    /* gammaD = (L - 1) / L, exato em Q31 */
+    llGammaD = (int64_t)(((uint64_t)(lDCoefs - 1) << 31) / lDCoefs);
+    llOneMinusGammaD = ((int64_t)1 << 31) - llGammaD;
+
+    /* Conecta os ponteiros */
+    pfInputD      =  pFilter->m_pfInputD;
+    pfInputX      =  pFilter->m_pfInputX;
+    pfOutput      =  pFilter->m_pfOutput;
+    psBufferX     =  pFilter->m_psBufferX;
+    piPdx         =  pFilter->m_piPdx;
+    lIndexW 	  =  pFilter->m_lWritePointerX;
+
+    /* Converte os parametros para ponto fixo uma vez por bloco */
+
+    iMu           = (int32_t)lrintf(*pFilter->m_pfMu * Q15_ONE);
+    iDtdThreshold = (int32_t)lrintf(*pFilter->m_pfDtdThreshold * Q15_ONE);
+    iSetThreshold = (int32_t)lrintf(DB_CO(*pFilter->m_pfSetThreshold) * Q15_ONE);
+    llEpsilon     = (int64_t)(EPSILON * Q30_ONE);
+
+    if (lXCoefs != pFilter->m_lXCoefsAnt) /* Se o tamanho do filtro mudou, recalcula var(X) */
+    {
+        pFilter->m_lXCoefsAnt = lXCoefs;
+        pFilter->m_llXVar = 0;
+        for(lConv = 0; lConv < lXCoefs; lConv++)
+        {
+            pFilter->m_llXVar += (int32_t)psBufferX[lIndexW + 1 + lConv] * (int32_t)psBufferX[lIndexW + 1 + lConv];
+        }
+    }
+
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, lXCoefs);
+
+    for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
+    {
+
+        sSampleX = (int16_t)SATURATE_Q15(lrintf(*pfInputX * Q15_ONE));
+        fD = *pfInputD;
+        iSampleD = SATURATE_Q15(lrintf(fD * Q15_ONE));
+
+        /* Var(X) exata pelo metodo incremental: sai x(n - L), entra x(n) */
+        iOld = psBufferX[(lIndexW + lXCoefs) & lBufferXSizeMinusOne];
+        if (lXCoefs > 0)
+            pFilter->m_llXVar += (int32_t)sSampleX * sSampleX - iOld * iOld;
+
+        psBufferX[lIndexW] = sSampleX; /* O buffer recebe a mais recente amostra de x(n) */
+        psBufferX[lIndexW + pFilter->m_lFilterSize] = sSampleX;
+
+        llConvSample = dotQ15(pFilter, psBufferX + lIndexW, lXCoefs); /* w(n)*x(n) em Q29 */
+
+        iErrSample = iSampleD - (int32_t)((llConvSample + (1 << 13)) >> 14); /* e(n) = d(n) - w(n)*x(n) */
+        iErrSample = SATURATE_Q15(iErrSample);
+        *(pfOutput++) = (LADSPA_Data)iErrSample / Q15_ONE; /* Joga o "erro" na saida */
+        fPotD += fD * fD;
+        fPotE += pfOutput[-1] * pfOutput[-1];
+
+        /* var(D) pelo metodo IIR */
+        pFilter->m_llDVar = ((pFilter->m_llDVar * llGammaD) >> 31) + (((int64_t)(iSampleD * iSampleD) * llOneMinusGammaD) >> 31);
+
+        llDNCR = 0;
+        for(lConv = 0; lConv < lDCoefs; lConv++)
+        {
+            /* Estimativa da correlacao cruzada de D e X pelo metodo IIR */
+            llProduct = (int64_t)((int32_t)psBufferX[lIndexW + lConv] * iSampleD);
+            piPdx[lConv] = (int32_t)(((piPdx[lConv] * llGammaD) >> 31) + ((llProduct * llOneMinusGammaD) >> 31));
+            llDNCR += (int64_t)piPdx[lConv] * pFilter->m_psCoefs[lConv];
+        }
+
+        /* DNCR > limiar  <=>  r_dx * w (Q44) > limiar (Q15) * var(D) (Q30) * 2^-1 */
+        PROBE_DTD(&pFilter->m_sProbes, pFilter, !(2 * llDNCR > (int64_t)iDtdThreshold * pFilter->m_llDVar), lSampleIndex);
+        dumpDtd(&pFilter->m_sDump, !(2 * llDNCR > (int64_t)iDtdThreshold * pFilter->m_llDVar), lSampleIndex);
+        if (2 * llDNCR > (int64_t)iDtdThreshold * pFilter->m_llDVar && ABS(iErrSample) > iSetThreshold && iMu > 0)
+        {
+            /* passo = mu * e(n) / (var(X) + epsilon), como mantissa de 16 bits e deslocamento */
+            iExpP = normalize31(ABS((int64_t)iMu * iErrSample), &llMantissaP);
+            iExpX = normalize31(pFilter->m_llXVar + llEpsilon, &llMantissaX);
+            sStep = (int16_t)((llMantissaP << 14) / llMantissaX);
+            if (iErrSample < 0)
+                sStep = -sStep;
+            iShift = iExpX - iExpP - 1;
+            lUpdates++;
+
+            updateQ15(pFilter, sStep, iShift, psBufferX + lIndexW, lXCoefs);
+        }
+
+        lIndexW = (lIndexW - 1) & lBufferXSizeMinusOne; /* Atualiza o indice dos buffers */
+        pfInputX++; /* Recebe proxima amostra de X */
+        pfInputD++; /* Recebe proxima amostra de D */
+    }
+
+    meterPublish(&pFilter->m_sMeters, SampleCount, fPotD, fPotE, lUpdates, pFilter->m_llDVar > 0 ? (LADSPA_Data)((double)llDNCR / ((double)pFilter->m_llDVar * 16384.0)) : 0, 1);
+    dumpEnd(&pFilter->m_sDump, pFilter->m_pfOutput, fPotD, fPotE, lUpdates, pFilter->m_llDVar > 0 ? (LADSPA_Data)((double)llDNCR / ((double)pFilter->m_llDVar * 16384.0)) : 0, 1);
+
+    pFilter->m_lWritePointerX = lIndexW; /* Atualiza o indice do ponteiro dos vetores circulares*/
+
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, lUpdates);
+    TIMING_END(pFilter->m_psTiming, SampleCount, lXCoefs);
+
+}
+
+/*****************************************************************************/
+
+/* Este e' o destrutor do filtro */
+void cleanupFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    dumpStop(&pFilter->m_sDump);
+    free(pFilter->m_piPdx);
+    free(pFilter->m_psBufferX);
+    free(pFilter->m_piCoefs);
+    free(pFilter->m_psCoefs);
+    TIMING_DESTROY(pFilter->m_psTiming);
+    free(pFilter);
+}
+
+/*****************************************************************************/
+
+/* Contadores de tempo da instancia (NULL sem make INSTRUMENTAR=1) */
+RunTiming * ladspa_timing(LADSPA_Handle Instance)
+{
+    return ((Filter *)Instance)->m_psTiming;
+}
+
+/*****************************************************************************/
+
+/* Liga (pcPath) ou desliga (NULL) a gravacao dos sinais; nao chamar da thread de audio */
+int ladspa_dump(LADSPA_Handle Instance, const char * pcPath)
+{
+    return dumpStart(&((Filter *)Instance)->m_sDump, pcPath);
+}
+
+/*****************************************************************************/
+
+LADSPA_Descriptor * g_psDescriptor = NULL;
+
+/*****************************************************************************/
+
+/* _init() e' o construtor do descritor do filtro */
+void _init()
+{
+
+    char ** pcPortNames;
+    LADSPA_PortDescriptor * piPortDescriptors;
+    LADSPA_PortRangeHint * psPortRangeHints;
+
+    g_psDescriptor
+    = (LADSPA_Descriptor *)malloc(sizeof(LADSPA_Descriptor));
+    if (g_psDescriptor)
+    {
+        g_psDescriptor->UniqueID
+        = 9;
+        g_psDescriptor->Label
+        = strdup("adapt_qnlmscncr");
+        g_psDescriptor->Properties
+        = LADSPA_PROPERTY_HARD_RT_CAPABLE;
+        g_psDescriptor->Name
+        = strdup("NLMS com CheapNCR (ponto fixo Q15)");
+        g_psDescriptor->Maker
+        = strdup("Pedro Nariyoshi");
+        g_psDescriptor->Copyright
+        = strdup("None");
+        g_psDescriptor->PortCount
+        = NOPORTS;
+        piPortDescriptors
+        = (LADSPA_PortDescriptor *)calloc(NOPORTS, sizeof(LADSPA_PortDescriptor));
+        g_psDescriptor->PortDescriptors
+        = (const LADSPA_PortDescriptor *)piPortDescriptors;
+        piPortDescriptors[LMS_FILTER_LENGTH]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[LMS_DTD_LENGTH]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[LMS_DTD_THRESHOLD]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[LMS_MU]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[LMS_SET_THRESHOLD]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[LMS_INPUTD]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+        piPortDescriptors[LMS_INPUTX]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+        piPortDescriptors[LMS_OUTPUT]
+        = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
+        pcPortNames
+        = (char **)calloc(NOPORTS, sizeof(char *));
+        g_psDescriptor->PortNames
+        = (const char **)pcPortNames;
+        pcPortNames[LMS_FILTER_LENGTH]
+        = strdup("Tamanho do filtro (ms)");
+        pcPortNames[LMS_DTD_LENGTH]
+        = strdup("Comprimento do DTD (ms)");
+        pcPortNames[LMS_DTD_THRESHOLD]
+        = strdup("Limiar do DTD");
+        pcPortNames[LMS_MU]
+        = strdup("µ - Fator de convergencia");
+        pcPortNames[LMS_SET_THRESHOLD]
+        = strdup("Limiar do Set Membership (dB)");
+        pcPortNames[LMS_INPUTD]
+        = strdup("Input D");
+        pcPortNames[LMS_INPUTX]
+        = strdup("Input X");
+        pcPortNames[LMS_OUTPUT]
+        = strdup("Output");
+        psPortRangeHints = ((LADSPA_PortRangeHint *)
+                            calloc(NOPORTS, sizeof(LADSPA_PortRangeHint)));
+        g_psDescriptor->PortRangeHints
+        = (const LADSPA_PortRangeHint *)psPortRangeHints;
+        psPortRangeHints[LMS_FILTER_LENGTH].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_LOW);
+        psPortRangeHints[LMS_FILTER_LENGTH].LowerBound
+        = 0;
+        psPortRangeHints[LMS_FILTER_LENGTH].UpperBound
+        = (LADSPA_Data)MAX_ECO_MS;
+        psPortRangeHints[LMS_DTD_LENGTH ].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_MIDDLE);
+        psPortRangeHints[LMS_DTD_LENGTH ].LowerBound
+        = 0;
+        psPortRangeHints[LMS_DTD_LENGTH ].UpperBound
+        = (LADSPA_Data)MAX_DTD_MS;
+        psPortRangeHints[LMS_DTD_THRESHOLD].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_MIDDLE);
+        psPortRangeHints[LMS_DTD_THRESHOLD].LowerBound
+        = 0;
+        psPortRangeHints[LMS_DTD_THRESHOLD].UpperBound
+        = 1;
+        psPortRangeHints[LMS_MU].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_LOW);
+        psPortRangeHints[LMS_MU].LowerBound
+        = 0;
+        psPortRangeHints[LMS_MU].UpperBound
+        = 2;
+        psPortRangeHints[LMS_SET_THRESHOLD].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_LOW);
+        psPortRangeHints[LMS_SET_THRESHOLD].LowerBound
+        = -120;
+        psPortRangeHints[LMS_SET_THRESHOLD].UpperBound
+        = 0;
+        psPortRangeHints[LMS_INPUTD].HintDescriptor
+        = 1;
+        psPortRangeHints[LMS_INPUTX].HintDescriptor
+        = 0;
+        psPortRangeHints[LMS_OUTPUT].HintDescriptor
+        = 0;
+        meterDescribePorts(piPortDescriptors, pcPortNames, psPortRangeHints, LMS_ERLE, METER_PORTS_LINEAR);
+        g_psDescriptor->instantiate
+        = instantiateFilter;
+        g_psDescriptor->connect_port
+        = connectPortToFilter;
+        g_psDescriptor->activate
+        = activateFilter;
+        g_psDescriptor->run
+        = runFilter;
+        g_psDescriptor->run_adding
+        = NULL;
+        g_psDescriptor->set_run_adding_gain
+        = NULL;
+        g_psDescriptor->deactivate
+        = NULL;
+        g_psDescriptor->cleanup
+        = cleanupFilter;
+    }
+}
+
+/*****************************************************************************/
+
+/* _fini() e' o destrutor do descritor do filtro */
+void _fini()
+{
+    long lIndexW;
+    if (g_psDescriptor)
+    {
+        free((char *)g_psDescriptor->Label);
+        free((char *)g_psDescriptor->Name);
+        free((char *)g_psDescriptor->Maker);
+        free((char *)g_psDescriptor->Copyright);
+        free((LADSPA_PortDescriptor *)g_psDescriptor->PortDescriptors);
+        for (lIndexW = 0; lIndexW < g_psDescriptor->PortCount; lIndexW++)
+            free((char *)(g_psDescriptor->PortNames[lIndexW]));
+        free((char **)g_psDescriptor->PortNames);
+        free((LADSPA_PortRangeHint *)g_psDescriptor->PortRangeHints);
+        free(g_psDescriptor);
+    }
+}
+
+/*****************************************************************************/
+
+/* Devolve o descritor desejado */
+const LADSPA_Descriptor * ladspa_descriptor(unsigned long Index)
+{
+    if (Index == 0)
+        return g_psDescriptor;
+    else
+        return NULL;
+}
+
+/*****************************************************************************/
+
+/* EOF */
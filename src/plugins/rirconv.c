@@ -0,0 +1,601 @@
+/* Software livre por Pedro Nariyoshi. Sem garantias.
+
+   Este plugin LADSPA simula um caminho de eco: convolui a entrada com
+   uma resposta ao impulso (RIR) de comprimento arbitrario, lida de um
+   arquivo no instantiate(). Serve para gerar eco realista nas bancadas
+   de teste dos canceladores, no lugar dos 16 coeficientes fixos do
+   16coefs/nl16coefs.
+
+   A convolucao e' particionada uniformemente e nao tem latencia: a
+   primeira particao e' feita no dominio do tempo, amostra a amostra, e
+   as demais por FFT (overlap-save com linha de atraso no dominio da
+   frequencia). A contribuicao das particoes da cauda para o proximo
+   bloco fica pronta assim que o bloco atual completa, entao o run()
+   aceita qualquer SampleCount, inclusive 1.
+
+   O arquivo da RIR e' indicado pela variavel de ambiente RIRCONV_ARQUIVO:
+   floats de 32 bits crus (ordem de bytes da maquina) ou, se o nome
+   terminar em ".txt", um valor por linha (linhas em branco sao
+   ignoradas). A RIR deve estar na mesma taxa de amostragem do host. Sem
+   arquivo, a RIR e' um impulso unitario. Uma RIR com mais de MAX_RIR_S
+   segundos e' cortada com aviso; um valor invalido no texto, ou um erro
+   de leitura, faz o instantiate() falhar (devolve NULL).
+
+   Possui pouca protecao de memoria. Falhas no malloc nao se recuperam bem.
+*/
+
+/*****************************************************************************/
+
+#include "ladspa.h"
+#include "fft.h"
+#include "sondas.h"
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*****************************************************************************/
+
+/* Parametros do filtro */
+
+#define TAM_PARTICAO 128 /* Tamanho de cada particao (potencia de 2) */
+#define TAM_FFT (2 * TAM_PARTICAO)
+#define NO_BINS (TAM_PARTICAO + 1)
+#define MAX_RIR_S 10 /* Maior RIR aceita, em segundos (cuidado com a memoria) */
+#define VAR_ARQUIVO "RIRCONV_ARQUIVO"
+
+/*****************************************************************************/
+
+/* A numeracao das portas do filtro */
+
+#define RIR_ALPHA  0
+#define RIR_INPUT  1
+#define RIR_OUTPUT 2
+
+/* Quantidade de portas */
+
+#define NOPORTS 3
+
+/*****************************************************************************/
+
+/* Estrutura do filtro */
+typedef struct
+{
+
+    FFTPlan * m_pPlan;
+
+    /* Primeira particao da RIR, invertida no tempo para a convolucao direta */
+    LADSPA_Data * m_pfHeadCoefs;
+
+    /* Espectros das particoes 1..m_lPartitions-1 (m_lPartitions * NO_BINS cada) */
+    LADSPA_Data * m_pfTailRe;
+    LADSPA_Data * m_pfTailIm;
+
+    /* Linha de atraso no dominio da frequencia: espectros dos ultimos blocos de entrada */
+    LADSPA_Data * m_pfDelayRe;
+    LADSPA_Data * m_pfDelayIm;
+
+    /* Janela de entrada do overlap-save: [bloco anterior, bloco atual] */
+    LADSPA_Data * m_pfWindow;
+
+    /* Contribuicao da cauda para o bloco atual */
+    LADSPA_Data * m_pfTailOut;
+
+    /* Areas de trabalho da FFT */
+    LADSPA_Data * m_pfAccRe;
+    LADSPA_Data * m_pfAccIm;
+    LADSPA_Data * m_pfTimeWork;
+
+    /* Numero de particoes da RIR (incluindo a primeira) */
+    unsigned long m_lPartitions;
+
+    /* Posicao no bloco atual e posicao mais recente da linha de atraso */
+    unsigned long m_lBlockPos;
+    unsigned long m_lDelayPos;
+
+    /* Ports:
+     ------ */
+
+    /* Coeficiente da nao linearidade atan(alfa * x); 0 desliga */
+    LADSPA_Data * m_pfAlpha;
+
+    /* Input audio port data location. */
+    LADSPA_Data * m_pfInput;
+
+    /* Output audio port data location. */
+    LADSPA_Data * m_pfOutput;
+
+    ProbeState m_sProbes; /* Sondas USDT (veja sondas.h) */
+
+} Filter;
+
+/*****************************************************************************/
+
+/* Le a RIR do arquivo apontado por RIRCONV_ARQUIVO. Guarda o vetor
+   alocado em *ppfRir e o numero de amostras lidas em *plLength (0 se nao
+   ha arquivo). Devolve 0 se o arquivo tem valor invalido ou erro de
+   leitura. */
+static int loadImpulseResponse(unsigned long SampleRate, LADSPA_Data ** ppfRir, unsigned long * plLength)
+{
+
+    const char * pcPath;
+    FILE * pFile;
+    LADSPA_Data * pfRir;
+    char acLine[256];
+    char * pcEnd;
+    unsigned long lMaxLength;
+    unsigned long lLength;
+    unsigned long lLine;
+    size_t lNameLength;
+    float fValue;
+    int iOk;
+    int iTruncated;
+
+    *ppfRir = NULL;
+    *plLength = 0;
+    pcPath = getenv(VAR_ARQUIVO);
+    if (pcPath == NULL || *pcPath == '\0')
+        return 1;
+
+    pFile = fopen(pcPath, "rb");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "rirconv: nao consegui abrir %s, usando impulso unitario.\n", pcPath);
+        return 1;
+    }
+
+    lMaxLength = SampleRate * MAX_RIR_S;
+    pfRir = (LADSPA_Data *)calloc(lMaxLength, sizeof(LADSPA_Data));
+    if (pfRir == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    iOk = 1;
+    iTruncated = 0;
+    lLength = 0;
+    lNameLength = strlen(pcPath);
+    if (lNameLength > 4 && strcmp(pcPath + lNameLength - 4, ".txt") == 0)
+    {
+        for (lLine = 1; iOk && fgets(acLine, sizeof(acLine), pFile) != NULL; lLine++)
+        {
+            if (strchr(acLine, '\n') == NULL && !feof(pFile))
+            {
+                fprintf(stderr, "rirconv: %s: linha %lu longa demais.\n", pcPath, lLine);
+                iOk = 0;
+                continue;
+            }
+            if (acLine[strspn(acLine, " \t\r\n")] == '\0') /* Linha em branco */
+                continue;
+            fValue = strtof(acLine, &pcEnd);
+            if (pcEnd == acLine || pcEnd[strspn(pcEnd, " \t\r\n")] != '\0')
+            {
+                fprintf(stderr, "rirconv: %s: valor invalido na linha %lu.\n", pcPath, lLine);
+                iOk = 0;
+            }
+            else if (lLength < lMaxLength)
+                pfRir[lLength++] = fValue;
+            else
+                iTruncated = 1; /* Continua lendo para validar o resto */
+        }
+    }
+    else
+    {
+        lLength = fread(pfRir, sizeof(LADSPA_Data), lMaxLength, pFile);
+        iTruncated = lLength == lMaxLength && fgetc(pFile) != EOF;
+    }
+
+    if (iOk && ferror(pFile))
+    {
+        fprintf(stderr, "rirconv: erro lendo %s.\n", pcPath);
+        iOk = 0;
+    }
+    fclose(pFile);
+
+    if (!iOk)
+    {
+        free(pfRir);
+        return 0;
+    }
+    if (iTruncated)
+        fprintf(stderr, "rirconv: %s tem mais de %lu amostras (%d s), RIR truncada.\n", pcPath, lMaxLength, MAX_RIR_S);
+
+    *ppfRir = pfRir;
+    *plLength = lLength;
+    return 1;
+}
+
+/*****************************************************************************/
+
+LADSPA_Handle instantiateFilter(const LADSPA_Descriptor * Descriptor, unsigned long SampleRate)
+{
+
+    Filter * pFilter;
+    LADSPA_Data * pfRir;
+    LADSPA_Data * pfPadded;
+    unsigned long lRirLength;
+    unsigned long lPartition;
+    unsigned long lTap;
+
+    pFilter = (Filter *)calloc(1, sizeof(Filter));
+
+    if (pFilter == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!loadImpulseResponse(SampleRate, &pfRir, &lRirLength))
+    {
+        free(pFilter);
+        return NULL;
+    }
+    if (lRirLength == 0) /* Sem RIR: impulso unitario */
+    {
+        free(pfRir);
+        pfRir = (LADSPA_Data *)calloc(1, sizeof(LADSPA_Data));
+        if (pfRir == NULL)
+        {
+            fputs("Out of memory.\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+        pfRir[0] = 1;
+        lRirLength = 1;
+    }
+
+    pFilter->m_lPartitions = (lRirLength + TAM_PARTICAO - 1) / TAM_PARTICAO;
+
+    pFilter->m_pPlan       = createFFTPlan(TAM_FFT);
+    pFilter->m_pfHeadCoefs = (LADSPA_Data *)calloc(TAM_PARTICAO, sizeof(LADSPA_Data));
+    pFilter->m_pfTailRe    = (LADSPA_Data *)calloc(pFilter->m_lPartitions * NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfTailIm    = (LADSPA_Data *)calloc(pFilter->m_lPartitions * NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfDelayRe   = (LADSPA_Data *)calloc(pFilter->m_lPartitions * NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfDelayIm   = (LADSPA_Data *)calloc(pFilter->m_lPartitions * NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfWindow    = (LADSPA_Data *)calloc(TAM_FFT, sizeof(LADSPA_Data));
+    pFilter->m_pfTailOut   = (LADSPA_Data *)calloc(TAM_PARTICAO, sizeof(LADSPA_Data));
+    pFilter->m_pfAccRe     = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfAccIm     = (LADSPA_Data *)calloc(NO_BINS, sizeof(LADSPA_Data));
+    pFilter->m_pfTimeWork  = (LADSPA_Data *)calloc(TAM_FFT, sizeof(LADSPA_Data));
+    pfPadded               = (LADSPA_Data *)calloc(TAM_FFT, sizeof(LADSPA_Data));
+
+    if (pFilter->m_pPlan == NULL || pFilter->m_pfHeadCoefs == NULL || pFilter->m_pfTailRe == NULL || pFilter->m_pfTailIm == NULL || pFilter->m_pfDelayRe == NULL || pFilter->m_pfDelayIm == NULL || pFilter->m_pfWindow == NULL || pFilter->m_pfTailOut == NULL || pFilter->m_pfAccRe == NULL || pFilter->m_pfAccIm == NULL || pFilter->m_pfTimeWork == NULL || pfPadded == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Particao 0: invertida no tempo para que a convolucao leia a janela em ordem crescente */
+    for (lTap = 0; lTap < TAM_PARTICAO && lTap < lRirLength; lTap++)
+        pFilter->m_pfHeadCoefs[TAM_PARTICAO - 1 - lTap] = pfRir[lTap];
+
+    /* Particoes 1..P-1: h_p zerado ate TAM_FFT (a segunda metade fica em zero) */
+    for (lPartition = 1; lPartition < pFilter->m_lPartitions; lPartition++)
+    {
+        memset(pfPadded, 0, sizeof(LADSPA_Data) * TAM_FFT);
+        for (lTap = 0; lTap < TAM_PARTICAO && lPartition * TAM_PARTICAO + lTap < lRirLength; lTap++)
+            pfPadded[lTap] = pfRir[lPartition * TAM_PARTICAO + lTap];
+        fftReal(pFilter->m_pPlan, pfPadded, pFilter->m_pfTailRe + lPartition * NO_BINS, pFilter->m_pfTailIm + lPartition * NO_BINS);
+    }
+
+    free(pfPadded);
+    free(pfRir);
+
+    PROBE_INSTANTIATE(&pFilter->m_sProbes, pFilter, Descriptor->UniqueID, SampleRate);
+
+    return pFilter;
+}
+
+/*****************************************************************************/
+
+/* Inicializa os valores do filtro no caso desativa/ativa */
+void activateFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+    pFilter = (Filter *)Instance;
+
+    memset(pFilter->m_pfDelayRe, 0, sizeof(LADSPA_Data) * pFilter->m_lPartitions * NO_BINS);
+    memset(pFilter->m_pfDelayIm, 0, sizeof(LADSPA_Data) * pFilter->m_lPartitions * NO_BINS);
+    memset(pFilter->m_pfWindow, 0, sizeof(LADSPA_Data) * TAM_FFT);
+    memset(pFilter->m_pfTailOut, 0, sizeof(LADSPA_Data) * TAM_PARTICAO);
+    pFilter->m_lBlockPos = 0;
+    pFilter->m_lDelayPos = 0;
+
+    PROBE_ACTIVATE(&pFilter->m_sProbes, pFilter);
+
+}
+
+/*****************************************************************************/
+
+/* Conecta os ponteiros 'as portas do filtro */
+void connectPortToFilter(LADSPA_Handle Instance, unsigned long Port, LADSPA_Data * DataLocation)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+
+    switch (Port)
+    {
+    case RIR_ALPHA:
+        pFilter->m_pfAlpha = DataLocation;
+        break;
+    case RIR_INPUT:
+        pFilter->m_pfInput = DataLocation;
+        break;
+    case RIR_OUTPUT:
+        pFilter->m_pfOutput = DataLocation;
+        break;
+    }
+}
+
+/*****************************************************************************/
+
+/* Chamado quando o bloco de entrada completa: empurra o espectro da
+   janela na linha de atraso e calcula a contribuicao das particoes
+   1..P-1 para o proximo bloco. */
+static void advanceBlock(Filter * pFilter)
+{
+
+    LADSPA_Data * pfAccRe;
+    LADSPA_Data * pfAccIm;
+    const LADSPA_Data * pfHRe;
+    const LADSPA_Data * pfHIm;
+    const LADSPA_Data * pfXRe;
+    const LADSPA_Data * pfXIm;
+    unsigned long lPartitions;
+    unsigned long lPartition;
+    unsigned long lSlot;
+    unsigned long lBin;
+
+    lPartitions = pFilter->m_lPartitions;
+
+    if (lPartitions > 1)
+    {
+        /* X_m entra na posicao mais recente da linha de atraso circular */
+        pFilter->m_lDelayPos = (pFilter->m_lDelayPos + 1) % lPartitions;
+        fftReal(pFilter->m_pPlan, pFilter->m_pfWindow, pFilter->m_pfDelayRe + pFilter->m_lDelayPos * NO_BINS, pFilter->m_pfDelayIm + pFilter->m_lDelayPos * NO_BINS);
+
+        pfAccRe = pFilter->m_pfAccRe;
+        pfAccIm = pFilter->m_pfAccIm;
+        memset(pfAccRe, 0, sizeof(LADSPA_Data) * NO_BINS);
+        memset(pfAccIm, 0, sizeof(LADSPA_Data) * NO_BINS);
+
+        /* Y = soma_p H_p * X_(m+1-p), p = 1..P-1 */
+        lSlot = pFilter->m_lDelayPos;
+        for (lPartition = 1; lPartition < lPartitions; lPartition++)
+        {
+            pfHRe = pFilter->m_pfTailRe + lPartition * NO_BINS;
+            pfHIm = pFilter->m_pfTailIm + lPartition * NO_BINS;
+            pfXRe = pFilter->m_pfDelayRe + lSlot * NO_BINS;
+            pfXIm = pFilter->m_pfDelayIm + lSlot * NO_BINS;
+            for (lBin = 0; lBin < NO_BINS; lBin++)
+            {
+                pfAccRe[lBin] += pfHRe[lBin] * pfXRe[lBin] - pfHIm[lBin] * pfXIm[lBin];
+                pfAccIm[lBin] += pfHRe[lBin] * pfXIm[lBin] + pfHIm[lBin] * pfXRe[lBin];
+            }
+            lSlot = (lSlot == 0) ? lPartitions - 1 : lSlot - 1;
+        }
+
+        /* Overlap-save: so a segunda metade da convolucao circular e' valida */
+        fftRealInverse(pFilter->m_pPlan, pfAccRe, pfAccIm, pFilter->m_pfTimeWork);
+        memcpy(pFilter->m_pfTailOut, pFilter->m_pfTimeWork + TAM_PARTICAO, sizeof(LADSPA_Data) * TAM_PARTICAO);
+    }
+
+    /* O bloco atual vira o bloco anterior da proxima janela */
+    memcpy(pFilter->m_pfWindow, pFilter->m_pfWindow + TAM_PARTICAO, sizeof(LADSPA_Data) * TAM_PARTICAO);
+    pFilter->m_lBlockPos = 0;
+}
+
+/*****************************************************************************/
+
+/* Roda a instancia do filtro */
+void runFilter(LADSPA_Handle Instance, unsigned long SampleCount)
+{
+
+    LADSPA_Data * pfInput; /* Aponta para o bloco de amostras da entrada x(n) */
+    LADSPA_Data * pfOutput; /* Aponta para o bloco de amostras da saida */
+    LADSPA_Data * pfWindow;
+    const LADSPA_Data * pfHeadCoefs;
+    const LADSPA_Data * pfRecent;
+    LADSPA_Data fAlpha;
+    LADSPA_Data fConvSample; /* Variavel auxiliar da convolucao */
+
+    Filter * pFilter;
+
+    unsigned long lSampleIndex;
+    unsigned long lBlockPos;
+    unsigned long lConv; /* Contador da convolucao */
+
+    pFilter = (Filter *)Instance;
+
+    pfInput     = pFilter->m_pfInput;
+    pfOutput    = pFilter->m_pfOutput;
+    pfWindow    = pFilter->m_pfWindow;
+    pfHeadCoefs = pFilter->m_pfHeadCoefs;
+    fAlpha      = *pFilter->m_pfAlpha;
+
+    PROBE_RUN_ENTRY(&pFilter->m_sProbes, pFilter, SampleCount);
+    PROBE_LENGTH(&pFilter->m_sProbes, pFilter, pFilter->m_lPartitions * TAM_PARTICAO);
+
+    for (lSampleIndex = 0; lSampleIndex < SampleCount; lSampleIndex++)
+    {
+        lBlockPos = pFilter->m_lBlockPos;
+
+        /* A janela recebe a mais recente amostra de x(n), com a nao linearidade opcional */
+        if (fAlpha > 0)
+            pfWindow[TAM_PARTICAO + lBlockPos] = atanf(fAlpha * (*pfInput));
+        else
+            pfWindow[TAM_PARTICAO + lBlockPos] = *pfInput;
+
+        /* Particao 0 no dominio do tempo: x(n - TAM_PARTICAO + 1) ... x(n) */
+        pfRecent = pfWindow + lBlockPos + 1;
+        fConvSample = 0;
+        for (lConv = 0; lConv < TAM_PARTICAO; lConv++)
+        {
+            fConvSample += pfHeadCoefs[lConv] * pfRecent[lConv];
+        }
+
+        *(pfOutput++) = fConvSample + pFilter->m_pfTailOut[lBlockPos];
+
+        pfInput++;
+        pFilter->m_lBlockPos = lBlockPos + 1;
+        if (pFilter->m_lBlockPos == TAM_PARTICAO)
+            advanceBlock(pFilter);
+    }
+
+    /* RIR fixa: nada se adapta */
+    PROBE_RUN_EXIT(&pFilter->m_sProbes, pFilter, SampleCount, 0);
+
+}
+
+/*****************************************************************************/
+
+/* Este e' o destrutor do filtro */
+void cleanupFilter(LADSPA_Handle Instance)
+{
+
+    Filter * pFilter;
+
+    pFilter = (Filter *)Instance;
+    PROBE_CLEANUP(&pFilter->m_sProbes, pFilter);
+    destroyFFTPlan(pFilter->m_pPlan);
+    free(pFilter->m_pfHeadCoefs);
+    free(pFilter->m_pfTailRe);
+    free(pFilter->m_pfTailIm);
+    free(pFilter->m_pfDelayRe);
+    free(pFilter->m_pfDelayIm);
+    free(pFilter->m_pfWindow);
+    free(pFilter->m_pfTailOut);
+    free(pFilter->m_pfAccRe);
+    free(pFilter->m_pfAccIm);
+    free(pFilter->m_pfTimeWork);
+    free(pFilter);
+}
+
+/*****************************************************************************/
+
+LADSPA_Descriptor * g_psDescriptor = NULL;
+
+/*****************************************************************************/
+
+/* _init() e' o construtor do descritor do filtro */
+void _init()
+{
+
+    char ** pcPortNames;
+    LADSPA_PortDescriptor * piPortDescriptors;
+    LADSPA_PortRangeHint * psPortRangeHints;
+
+    g_psDescriptor
+    = (LADSPA_Descriptor *)malloc(sizeof(LADSPA_Descriptor));
+    if (g_psDescriptor)
+    {
+        g_psDescriptor->UniqueID
+        = 997;
+        g_psDescriptor->Label
+        = strdup("rirconv");
+        g_psDescriptor->Properties
+        = LADSPA_PROPERTY_HARD_RT_CAPABLE;
+        g_psDescriptor->Name
+        = strdup("Convolucao com resposta ao impulso (RIR)");
+        g_psDescriptor->Maker
+        = strdup("Pedro Nariyoshi");
+        g_psDescriptor->Copyright
+        = strdup("None");
+        g_psDescriptor->PortCount
+        = NOPORTS;
+        piPortDescriptors
+        = (LADSPA_PortDescriptor *)calloc(NOPORTS, sizeof(LADSPA_PortDescriptor));
+        g_psDescriptor->PortDescriptors
+        = (const LADSPA_PortDescriptor *)piPortDescriptors;
+        piPortDescriptors[RIR_ALPHA]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL;
+        piPortDescriptors[RIR_INPUT]
+        = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+        piPortDescriptors[RIR_OUTPUT]
+        = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
+        pcPortNames
+        = (char **)calloc(NOPORTS, sizeof(char *));
+        g_psDescriptor->PortNames
+        = (const char **)pcPortNames;
+        pcPortNames[RIR_ALPHA]
+        = strdup("Coeficiente Alfa (0 = linear)");
+        pcPortNames[RIR_INPUT]
+        = strdup("Input");
+        pcPortNames[RIR_OUTPUT]
+        = strdup("Output");
+        psPortRangeHints = ((LADSPA_PortRangeHint *)
+                            calloc(NOPORTS, sizeof(LADSPA_PortRangeHint)));
+        g_psDescriptor->PortRangeHints
+        = (const LADSPA_PortRangeHint *)psPortRangeHints;
+        psPortRangeHints[RIR_ALPHA].HintDescriptor
+        = (LADSPA_HINT_BOUNDED_BELOW
+           | LADSPA_HINT_BOUNDED_ABOVE
+           | LADSPA_HINT_DEFAULT_0);
+        psPortRangeHints[RIR_ALPHA].LowerBound
+        = 0;
+        psPortRangeHints[RIR_ALPHA].UpperBound
+        = +10;
+        psPortRangeHints[RIR_INPUT].HintDescriptor
+        = 0;
+        psPortRangeHints[RIR_OUTPUT].HintDescriptor
+        = 0;
+        g_psDescriptor->instantiate
+        = instantiateFilter;
+        g_psDescriptor->connect_port
+        = connectPortToFilter;
+        g_psDescriptor->activate
+        = activateFilter;
+        g_psDescriptor->run
+        = runFilter;
+        g_psDescriptor->run_adding
+        = NULL;
+        g_psDescriptor->set_run_adding_gain
+        = NULL;
+        g_psDescriptor->deactivate
+        = NULL;
+        g_psDescriptor->cleanup
+        = cleanupFilter;
+    }
+}
+
+/*****************************************************************************/
+
+/* _fini() e' o destrutor do descritor do filtro */
+void _fini()
+{
+    long lIndex;
+    if (g_psDescriptor)
+    {
+        free((char *)g_psDescriptor->Label);
+        free((char *)g_psDescriptor->Name);
+        free((char *)g_psDescriptor->Maker);
+        free((char *)g_psDescriptor->Copyright);
+        free((LADSPA_PortDescriptor *)g_psDescriptor->PortDescriptors);
+        for (lIndex = 0; lIndex < g_psDescriptor->PortCount; lIndex++)
+            free((char *)(g_psDescriptor->PortNames[lIndex]));
+        free((char **)g_psDescriptor->PortNames);
+        free((LADSPA_PortRangeHint *)g_psDescriptor->PortRangeHints);
+        free(g_psDescriptor);
+    }
+}
+
+/*****************************************************************************/
+
+/* Devolve o descritor desejado */
+const LADSPA_Descriptor * ladspa_descriptor(unsigned long Index)
+{
+    if (Index == 0)
+        return g_psDescriptor;
+    else
+        return NULL;
+}
+
+/*****************************************************************************/
+
+/* EOF */
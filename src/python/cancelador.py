@@ -0,0 +1,356 @@
+"""cancelador.py
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Acesso aos plugins a partir do Python, para ajustar mu, limiares do
+   DTD e niveis do set-membership num notebook rodando o mesmo codigo C
+   da producao, em vez de uma copia em NumPy.
+
+   Biblioteca(caminho) abre um .so e tem uma classe por descritor, com o
+   label como nome:
+
+     import cancelador, numpy
+     lib = cancelador.Biblioteca("../plugins/nlmscncr.so")
+     aec = lib.adapt_nlmscncr(16000)
+     aec["Limiar do DTD"] = 0.6  # nome da porta, como em lote -c
+     e = aec.run(d, x)          # d, x: numpy.float32, uma dimensao
+
+   Cada instancia e' criada com instantiate(), tem os controles no padrao
+   do descritor (as mesmas regras de hospedeiro.h) e ja sai ativada.
+   aec[nome] le e escreve uma porta de controle (as de saida sao so
+   leitura), aec.controls lista todas, reset() faz deactivate() e
+   activate() e close() libera a instancia (tambem no with e no coletor
+   de lixo).
+
+   run() recebe uma entrada por porta de entrada de audio, na ordem das
+   portas (d(n) e depois x(n) nos canceladores), e devolve a saida, ou
+   uma tupla se houver mais de uma. As saidas podem ser passadas com
+   out=; senao sao alocadas (numpy se houver, senao array.array). Nada
+   e' copiado: connect_port() recebe o endereco dos dados do proprio
+   array, que precisa ser float32 contiguo (numpy ou qualquer objeto com
+   o protocolo de buffer e formato "f"). So uma entrada somente leitura
+   sem __array_interface__ (bytes, por exemplo) e' copiada.
+
+   As chamadas ao plugin passam pelo ctypes, que solta o GIL durante
+   connect_port() e run(): varias instancias em threads diferentes rodam
+   em paralelo na velocidade do C. Chamadas de threads diferentes a uma
+   mesma instancia sao serializadas. Labels que nao sao identificadores
+   (comecados por digito, por exemplo) sao acessados com getattr(). """
+
+import array
+import ctypes
+import ctypes.util
+import math
+import threading
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+###############################################################################
+
+PORT_INPUT = 0x1
+PORT_OUTPUT = 0x2
+PORT_CONTROL = 0x4
+PORT_AUDIO = 0x8
+
+HINT_BOUNDED_BELOW = 0x1
+HINT_SAMPLE_RATE = 0x8
+HINT_LOGARITHMIC = 0x10
+HINT_INTEGER = 0x20
+HINT_DEFAULT_MASK = 0x3C0
+HINT_DEFAULT_MINIMUM = 0x40
+HINT_DEFAULT_LOW = 0x80
+HINT_DEFAULT_MIDDLE = 0xC0
+HINT_DEFAULT_HIGH = 0x100
+HINT_DEFAULT_MAXIMUM = 0x140
+HINT_DEFAULT_0 = 0x200
+HINT_DEFAULT_1 = 0x240
+HINT_DEFAULT_100 = 0x280
+HINT_DEFAULT_440 = 0x2C0
+
+###############################################################################
+
+# Estruturas de ladspa.h
+
+
+class _PortRangeHint(ctypes.Structure):
+    _fields_ = [("HintDescriptor", ctypes.c_int),
+                ("LowerBound", ctypes.c_float),
+                ("UpperBound", ctypes.c_float)]
+
+
+class _Descriptor(ctypes.Structure):
+    pass
+
+
+_Handle = ctypes.c_void_p
+_Instantiate = ctypes.CFUNCTYPE(_Handle, ctypes.POINTER(_Descriptor), ctypes.c_ulong)
+_ConnectPort = ctypes.CFUNCTYPE(None, _Handle, ctypes.c_ulong, ctypes.c_void_p)
+_Activate = ctypes.CFUNCTYPE(None, _Handle)
+_Run = ctypes.CFUNCTYPE(None, _Handle, ctypes.c_ulong)
+_RunAdding = ctypes.CFUNCTYPE(None, _Handle, ctypes.c_ulong)
+_SetGain = ctypes.CFUNCTYPE(None, _Handle, ctypes.c_float)
+_Deactivate = ctypes.CFUNCTYPE(None, _Handle)
+_Cleanup = ctypes.CFUNCTYPE(None, _Handle)
+
+_Descriptor._fields_ = [("UniqueID", ctypes.c_ulong),
+                        ("Label", ctypes.c_char_p),
+                        ("Properties", ctypes.c_int),
+                        ("Name", ctypes.c_char_p),
+                        ("Maker", ctypes.c_char_p),
+                        ("Copyright", ctypes.c_char_p),
+                        ("PortCount", ctypes.c_ulong),
+                        ("PortDescriptors", ctypes.POINTER(ctypes.c_int)),
+                        ("PortNames", ctypes.POINTER(ctypes.c_char_p)),
+                        ("PortRangeHints", ctypes.POINTER(_PortRangeHint)),
+                        ("ImplementationData", ctypes.c_void_p),
+                        ("instantiate", _Instantiate),
+                        ("connect_port", _ConnectPort),
+                        ("activate", _Activate),
+                        ("run", _Run),
+                        ("run_adding", _RunAdding),
+                        ("set_run_adding_gain", _SetGain),
+                        ("deactivate", _Deactivate),
+                        ("cleanup", _Cleanup)]
+
+_libm = ctypes.CDLL(ctypes.util.find_library("m"))
+_libm.expf.restype = _libm.logf.restype = ctypes.c_float
+_libm.expf.argtypes = _libm.logf.argtypes = [ctypes.c_float]
+
+###############################################################################
+
+
+def _f32(fValor):
+    """Arredonda para float, como as contas de hostDefault()"""
+    return ctypes.c_float(fValor).value
+
+
+def default(sHint, lTaxa):
+    """Valor padrao de uma porta de controle (veja hostDefault())"""
+    iHint = sHint.HintDescriptor
+    fLower = sHint.LowerBound
+    fUpper = sHint.UpperBound
+    if iHint & HINT_SAMPLE_RATE:
+        fLower = _f32(fLower * lTaxa)
+        fUpper = _f32(fUpper * lTaxa)
+
+    iDefault = iHint & HINT_DEFAULT_MASK
+    dFixos = {HINT_DEFAULT_MINIMUM: fLower, HINT_DEFAULT_MAXIMUM: fUpper, HINT_DEFAULT_0: 0.0,
+              HINT_DEFAULT_1: 1.0, HINT_DEFAULT_100: 100.0, HINT_DEFAULT_440: 440.0}
+    if iDefault in dFixos:
+        return dFixos[iDefault]
+    dPesos = {HINT_DEFAULT_LOW: 0.25, HINT_DEFAULT_MIDDLE: 0.5, HINT_DEFAULT_HIGH: 0.75}
+    if iDefault not in dPesos:
+        return fLower if iHint & HINT_BOUNDED_BELOW else 0.0
+
+    fPeso = dPesos[iDefault]
+    if iHint & HINT_LOGARITHMIC and fLower > 0 and fUpper > 0:
+        fValor = _libm.expf(_f32(_f32((1 - fPeso) * _libm.logf(fLower)) + _f32(fPeso * _libm.logf(fUpper))))
+    else:
+        fValor = _f32(_f32((1 - fPeso) * fLower) + _f32(fPeso * fUpper))
+    if iHint & HINT_INTEGER:
+        fValor = float(math.floor(_f32(fValor + 0.5)))
+    return fValor
+
+
+def _ponteiro(oBuffer, iEscrita):
+    """Endereco e tamanho (em amostras) de um buffer float32 contiguo, sem
+    copia; devolve tambem o objeto que precisa ficar vivo durante o run()"""
+    dInterface = getattr(oBuffer, "__array_interface__", None)
+    if dInterface is not None:
+        if dInterface["typestr"] != "<f4" or len(dInterface["shape"]) != 1 \
+                or dInterface.get("strides") not in (None, (4,)):
+            raise TypeError("esperado array float32 contiguo de uma dimensao")
+        if iEscrita and dInterface["data"][1]:
+            raise TypeError("saida somente leitura")
+        return dInterface["data"][0], dInterface["shape"][0], oBuffer
+
+    sVisao = memoryview(oBuffer)
+    if sVisao.format != "f" or sVisao.ndim != 1 or not sVisao.c_contiguous:
+        raise TypeError("esperado buffer float32 contiguo de uma dimensao")
+    if sVisao.readonly:
+        if iEscrita:
+            raise TypeError("saida somente leitura")
+        oCopia = (ctypes.c_float * len(sVisao)).from_buffer_copy(sVisao)
+        return ctypes.addressof(oCopia), len(sVisao), oCopia
+    oVista = (ctypes.c_float * len(sVisao)).from_buffer(oBuffer)
+    return ctypes.addressof(oVista), len(sVisao), oVista
+
+
+def _aloca(lAmostras):
+    if numpy is not None:
+        return numpy.zeros(lAmostras, dtype=numpy.float32)
+    return array.array("f", bytes(4 * lAmostras))
+
+###############################################################################
+
+
+class Plugin(object):
+    """Instancia de um descritor; as subclasses de Biblioteca preenchem
+    _descritor"""
+
+    _descritor = None
+    _biblioteca = None
+
+    def __init__(self, taxa=16000):
+        psDescritor = self._descritor
+        self.taxa = taxa
+        self._lock = threading.Lock()
+        self._controles = (ctypes.c_float * (psDescritor.PortCount + 1))()
+        self._hHandle = psDescritor.instantiate(ctypes.pointer(psDescritor), taxa)
+        if not self._hHandle:
+            raise RuntimeError("%s: instantiate() falhou" % self.label)
+        for lPorta in range(psDescritor.PortCount):
+            iPorta = psDescritor.PortDescriptors[lPorta]
+            if iPorta & PORT_CONTROL:
+                if iPorta & PORT_INPUT:
+                    self._controles[lPorta] = default(psDescritor.PortRangeHints[lPorta], taxa)
+                psDescritor.connect_port(self._hHandle, lPorta, ctypes.addressof(self._controles) + 4 * lPorta)
+        self._ativo = False
+        self.activate()
+
+    # Ciclo de vida
+
+    def activate(self):
+        if not self._ativo and self._descritor.activate:
+            self._descritor.activate(self._hHandle)
+        self._ativo = True
+
+    def deactivate(self):
+        if self._ativo and self._descritor.deactivate:
+            self._descritor.deactivate(self._hHandle)
+        self._ativo = False
+
+    def reset(self):
+        """Volta ao estado de logo apos o activate(), como hostReset()"""
+        self.deactivate()
+        self.activate()
+
+    def close(self):
+        if self._hHandle:
+            self.deactivate()
+            self._descritor.cleanup(self._hHandle)
+            self._hHandle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *aArgs):
+        self.close()
+
+    def __del__(self):
+        if getattr(self, "_hHandle", None):
+            self.close()
+
+    # Controles
+
+    def _porta(self, sNome):
+        for lPorta in self.control_ports:
+            if self.port_names[lPorta] == sNome:
+                return lPorta
+        for lPorta in self.meter_ports:
+            if self.port_names[lPorta] == sNome:
+                return lPorta
+        raise KeyError(sNome)
+
+    def __getitem__(self, sNome):
+        return self._controles[self._porta(sNome)]
+
+    def __setitem__(self, sNome, fValor):
+        lPorta = self._porta(sNome)
+        if lPorta not in self.control_ports:
+            raise KeyError("%s e' uma porta de saida" % sNome)
+        self._controles[lPorta] = fValor
+
+    @property
+    def controls(self):
+        """Todas as portas de controle, de entrada e de saida, por nome"""
+        return dict((self.port_names[lPorta], self._controles[lPorta])
+                    for lPorta in self.control_ports + self.meter_ports)
+
+    # Audio
+
+    def run(self, *aEntradas, **dOpcoes):
+        """Roda o plugin sobre um bloco; veja o comeco do arquivo"""
+        aSaidas = dOpcoes.pop("out", None)
+        if dOpcoes:
+            raise TypeError("opcao invalida: %s" % ", ".join(dOpcoes))
+        if len(aEntradas) != len(self.audio_inputs):
+            raise TypeError("%s tem %d entradas de audio, %d dadas"
+                            % (self.label, len(self.audio_inputs), len(aEntradas)))
+        aPonteiros = [_ponteiro(oEntrada, False) for oEntrada in aEntradas]
+        lAmostras = aPonteiros[0][1] if aPonteiros else None
+        if aSaidas is None:
+            if lAmostras is None:
+                raise TypeError("sem entradas, out= e' obrigatorio")
+            aSaidas = [_aloca(lAmostras) for lPorta in self.audio_outputs]
+        elif len(self.audio_outputs) == 1 and not isinstance(aSaidas, (list, tuple)):
+            aSaidas = [aSaidas]
+        if len(aSaidas) != len(self.audio_outputs):
+            raise TypeError("%s tem %d saidas de audio" % (self.label, len(self.audio_outputs)))
+        aPonteiros += [_ponteiro(oSaida, True) for oSaida in aSaidas]
+        if lAmostras is None:
+            lAmostras = aPonteiros[0][1]
+        if any(aPonteiro[1] != lAmostras for aPonteiro in aPonteiros):
+            raise ValueError("buffers de tamanhos diferentes")
+        if not self._hHandle:
+            raise RuntimeError("instancia fechada")
+
+        with self._lock:
+            for lPorta, aPonteiro in zip(self.audio_inputs + self.audio_outputs, aPonteiros):
+                self._descritor.connect_port(self._hHandle, lPorta, aPonteiro[0])
+            if lAmostras > 0:
+                self._descritor.run(self._hHandle, lAmostras)
+        return aSaidas[0] if len(aSaidas) == 1 else tuple(aSaidas)
+
+
+class Biblioteca(object):
+    """Um .so de plugins; cada descritor vira um atributo com o label
+    como nome, subclasse de Plugin"""
+
+    def __init__(self, caminho):
+        self._so = ctypes.CDLL(caminho)
+        fDescritor = self._so.ladspa_descriptor
+        fDescritor.restype = ctypes.POINTER(_Descriptor)
+        fDescritor.argtypes = [ctypes.c_ulong]
+        self.labels = []
+        lIndice = 0
+        while True:
+            psDescritor = fDescritor(lIndice)
+            if not psDescritor:
+                break
+            sClasse = self._classe(psDescritor.contents)
+            setattr(self, sClasse.label, sClasse)
+            self.labels.append(sClasse.label)
+            lIndice += 1
+
+    def _classe(self, psDescritor):
+        aTipos = [psDescritor.PortDescriptors[lPorta] for lPorta in range(psDescritor.PortCount)]
+
+        def portas(iMascara):
+            return [lPorta for lPorta, iPorta in enumerate(aTipos) if iPorta & iMascara == iMascara]
+
+        dAtributos = {
+            "_descritor": psDescritor,
+            "_biblioteca": self,
+            "label": psDescritor.Label.decode(),
+            "name": psDescritor.Name.decode(),
+            "unique_id": psDescritor.UniqueID,
+            "port_names": [psDescritor.PortNames[lPorta].decode() for lPorta in range(psDescritor.PortCount)],
+            "audio_inputs": portas(PORT_AUDIO | PORT_INPUT),
+            "audio_outputs": portas(PORT_AUDIO | PORT_OUTPUT),
+            "control_ports": portas(PORT_CONTROL | PORT_INPUT),
+            "meter_ports": portas(PORT_CONTROL | PORT_OUTPUT),
+            "__doc__": psDescritor.Name.decode(),
+        }
+        return type(str(dAtributos["label"]), (Plugin,), dAtributos)
+
+    def __iter__(self):
+        return iter(getattr(self, sLabel) for sLabel in self.labels)
+
+###############################################################################
+
+# EOF
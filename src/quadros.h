@@ -0,0 +1,206 @@
+/* quadros.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Enquadramento para motores que processam quadros de tamanho fixo
+   (filtros no dominio da frequencia, LMS em blocos) dentro de um run()
+   que o host chama com qualquer SampleCount, inclusive 1:
+
+     framerInit()     aloca as filas de entrada e saida (instantiate)
+     framerReset()    zera as filas (activate)
+     framerLatency()  atraso da saida, em amostras (o tamanho do quadro)
+     framerRun()      passa um bloco do host pelo motor
+     framerFree()     libera (cleanup)
+
+   Cada entrada do host vai para uma fila de um quadro; quando ela
+   completa, o motor (FramerProcess) recebe o quadro inteiro e escreve o
+   quadro de saida, que sai para o host enquanto o quadro seguinte chega.
+   A saida fica atrasada de exatamente um quadro e nao depende de como o
+   host parte o sinal em blocos; declare o atraso numa porta "latency".
+
+   Com a fila vazia e pelo menos um quadro inteiro no bloco do host (em
+   particular quando o host usa o tamanho do quadro), o motor le direto
+   das portas de entrada, sem copia; a unica copia e' a da saida, que e'
+   o proprio atraso. Se uma saida do host for a mesma memoria de uma
+   entrada (processamento no lugar), o bloco passa pelas filas.
+
+   framerRun() nao aloca nem trava. */
+
+#ifndef QUADROS_H
+#define QUADROS_H
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+#define FRAMER_MAX_CHANNELS 8
+
+/* Processa um quadro: ppfIn[canal][0..lFrame) -> ppfOut[canal][0..lFrame) */
+typedef void (*FramerProcess)(void * pvContext, const float * const * ppfIn, float * const * ppfOut);
+
+typedef struct
+{
+
+    unsigned long m_lFrame; /* Tamanho do quadro */
+
+    unsigned int m_uInputs;
+
+    unsigned int m_uOutputs;
+
+    /* Filas de um quadro por canal */
+    float * m_apfIn[FRAMER_MAX_CHANNELS];
+    float * m_apfOut[FRAMER_MAX_CHANNELS];
+
+    /* Amostras no quadro de entrada atual, que e' tambem a posicao de
+       leitura no quadro de saida */
+    unsigned long m_lFill;
+
+} Framer;
+
+/*****************************************************************************/
+
+static inline void framerFree(Framer * psFramer)
+{
+
+    unsigned int uChannel;
+
+    for (uChannel = 0; uChannel < FRAMER_MAX_CHANNELS; uChannel++)
+    {
+        free(psFramer->m_apfIn[uChannel]);
+        free(psFramer->m_apfOut[uChannel]);
+        psFramer->m_apfIn[uChannel] = NULL;
+        psFramer->m_apfOut[uChannel] = NULL;
+    }
+}
+
+/* Devolve 0 se faltar memoria ou se os canais passarem do maximo */
+static inline int framerInit(Framer * psFramer, unsigned long lFrame, unsigned int uInputs, unsigned int uOutputs)
+{
+
+    unsigned int uChannel;
+    int iOk;
+
+    memset(psFramer, 0, sizeof(Framer));
+    if (lFrame == 0 || uInputs > FRAMER_MAX_CHANNELS || uOutputs > FRAMER_MAX_CHANNELS)
+        return 0;
+    psFramer->m_lFrame = lFrame;
+    psFramer->m_uInputs = uInputs;
+    psFramer->m_uOutputs = uOutputs;
+
+    iOk = 1;
+    for (uChannel = 0; uChannel < uInputs; uChannel++)
+    {
+        psFramer->m_apfIn[uChannel] = (float *)calloc(lFrame, sizeof(float));
+        iOk = iOk && psFramer->m_apfIn[uChannel] != NULL;
+    }
+    for (uChannel = 0; uChannel < uOutputs; uChannel++)
+    {
+        psFramer->m_apfOut[uChannel] = (float *)calloc(lFrame, sizeof(float));
+        iOk = iOk && psFramer->m_apfOut[uChannel] != NULL;
+    }
+    if (!iOk)
+        framerFree(psFramer);
+    return iOk;
+}
+
+/* O primeiro quadro de saida e' silencio */
+static inline void framerReset(Framer * psFramer)
+{
+
+    unsigned int uChannel;
+
+    for (uChannel = 0; uChannel < psFramer->m_uInputs; uChannel++)
+        memset(psFramer->m_apfIn[uChannel], 0, sizeof(float) * psFramer->m_lFrame);
+    for (uChannel = 0; uChannel < psFramer->m_uOutputs; uChannel++)
+        memset(psFramer->m_apfOut[uChannel], 0, sizeof(float) * psFramer->m_lFrame);
+    psFramer->m_lFill = 0;
+}
+
+static inline unsigned long framerLatency(const Framer * psFramer)
+{
+    return psFramer->m_lFrame;
+}
+
+/*****************************************************************************/
+
+/* Alguma saida do host cobre a mesma memoria que alguma entrada nas
+   lCount amostras a partir de lPos */
+static inline int framerAliased(const Framer * psFramer, const float * const * ppfIn, float * const * ppfOut,
+                                unsigned long lPos, unsigned long lCount)
+{
+
+    unsigned int uIn;
+    unsigned int uOut;
+    const float * pfIn;
+    const float * pfOut;
+
+    for (uOut = 0; uOut < psFramer->m_uOutputs; uOut++)
+    {
+        pfOut = ppfOut[uOut] + lPos;
+        for (uIn = 0; uIn < psFramer->m_uInputs; uIn++)
+        {
+            pfIn = ppfIn[uIn] + lPos;
+            if (pfOut < pfIn + lCount && pfIn < pfOut + lCount)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* Passa lCount amostras das portas ppfIn para as portas ppfOut. A saida
+   n e' a saida do motor para a entrada n - framerLatency(). */
+static inline void framerRun(Framer * psFramer, const float * const * ppfIn, float * const * ppfOut, unsigned long lCount,
+                             FramerProcess fProcess, void * pvContext)
+{
+
+    const float * apfDirect[FRAMER_MAX_CHANNELS];
+    unsigned long lFrame;
+    unsigned long lPos;
+    unsigned long lChunk;
+    unsigned int uChannel;
+
+    lFrame = psFramer->m_lFrame;
+    lPos = 0;
+    while (lPos < lCount)
+    {
+        /* Caminho rapido: quadros inteiros direto das portas */
+        if (psFramer->m_lFill == 0 && lCount - lPos >= lFrame && !framerAliased(psFramer, ppfIn, ppfOut, lPos, lFrame))
+        {
+            for (uChannel = 0; uChannel < psFramer->m_uOutputs; uChannel++)
+                memcpy(ppfOut[uChannel] + lPos, psFramer->m_apfOut[uChannel], sizeof(float) * lFrame);
+            for (uChannel = 0; uChannel < psFramer->m_uInputs; uChannel++)
+                apfDirect[uChannel] = ppfIn[uChannel] + lPos;
+            fProcess(pvContext, apfDirect, psFramer->m_apfOut);
+            lPos += lFrame;
+            continue;
+        }
+
+        /* Pelas filas: todas as entradas antes das saidas, para o caso
+           de alguma porta de saida ser tambem de entrada */
+        lChunk = lFrame - psFramer->m_lFill;
+        if (lChunk > lCount - lPos)
+            lChunk = lCount - lPos;
+        for (uChannel = 0; uChannel < psFramer->m_uInputs; uChannel++)
+            memcpy(psFramer->m_apfIn[uChannel] + psFramer->m_lFill, ppfIn[uChannel] + lPos, sizeof(float) * lChunk);
+        for (uChannel = 0; uChannel < psFramer->m_uOutputs; uChannel++)
+            memcpy(ppfOut[uChannel] + lPos, psFramer->m_apfOut[uChannel] + psFramer->m_lFill, sizeof(float) * lChunk);
+        psFramer->m_lFill += lChunk;
+        lPos += lChunk;
+
+        if (psFramer->m_lFill == lFrame)
+        {
+            fProcess(pvContext, (const float * const *)psFramer->m_apfIn, psFramer->m_apfOut);
+            psFramer->m_lFill = 0;
+        }
+    }
+}
+
+/*****************************************************************************/
+
+#endif /* QUADROS_H */
+
+/* EOF */
@@ -0,0 +1,113 @@
+/* simd.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Escolha, em tempo de execucao, do conjunto de instrucoes usado pelos
+   nucleos vetoriais dos plugins. Os plugins chamam simdLevel() no
+   instantiate() e guardam o resultado na instancia; o run() so consulta
+   o valor guardado.
+
+   A variavel de ambiente AEC_KERNEL limita o nivel escolhido ("scalar",
+   "sse", "avx2" ou "avx512"), o que permite comparar os nucleos entre si
+   na mesma maquina. */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/*****************************************************************************/
+
+/* Niveis em ordem crescente. SIMD_AVX2 inclui FMA e F16C. */
+
+#define SIMD_SCALAR 0
+#define SIMD_SSE41  1
+#define SIMD_AVX2   2
+#define SIMD_AVX512 3
+
+#define SIMD_ENV "AEC_KERNEL"
+
+/*****************************************************************************/
+
+/* Nome do nivel, para mensagens e relatorios */
+static inline const char * simdName(int iLevel)
+{
+    switch (iLevel)
+    {
+    case SIMD_SSE41:
+        return "sse";
+    case SIMD_AVX2:
+        return "avx2";
+    case SIMD_AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+/*****************************************************************************/
+
+/* Maior nivel suportado pelo processador, limitado por AEC_KERNEL.
+   Usa cpuid diretamente (e nao __builtin_cpu_supports) para nao depender
+   da libgcc, ja que os plugins sao ligados com ld -shared. */
+static inline int simdLevel(void)
+{
+
+    const char * pcLimit;
+    int iLevel;
+    int iLimit;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int uiEax;
+    unsigned int uiEbx;
+    unsigned int uiEcx;
+    unsigned int uiEdx;
+    unsigned int uiXcr0Lo;
+    unsigned int uiXcr0Hi;
+    unsigned int uiLeaf1Ecx;
+#endif
+
+    iLevel = SIMD_SCALAR;
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (__get_cpuid(1, &uiEax, &uiEbx, &uiEcx, &uiEdx) && (uiEcx & bit_SSE4_1))
+    {
+        iLevel = SIMD_SSE41;
+        uiLeaf1Ecx = uiEcx;
+
+        /* AVX exige que o sistema operacional salve os registradores YMM */
+        if ((uiLeaf1Ecx & bit_OSXSAVE) && (uiLeaf1Ecx & bit_AVX) && (uiLeaf1Ecx & bit_FMA) && (uiLeaf1Ecx & bit_F16C))
+        {
+            __asm__ volatile ("xgetbv" : "=a"(uiXcr0Lo), "=d"(uiXcr0Hi) : "c"(0));
+            if ((uiXcr0Lo & 0x6) == 0x6 && __get_cpuid_count(7, 0, &uiEax, &uiEbx, &uiEcx, &uiEdx) && (uiEbx & bit_AVX2))
+            {
+                iLevel = SIMD_AVX2;
+                if ((uiXcr0Lo & 0xe6) == 0xe6 && (uiEbx & bit_AVX512F) && (uiEbx & bit_AVX512BW))
+                    iLevel = SIMD_AVX512;
+            }
+        }
+    }
+#endif
+
+    pcLimit = getenv(SIMD_ENV);
+    if (pcLimit != NULL)
+    {
+        for (iLimit = SIMD_SCALAR; iLimit <= SIMD_AVX512; iLimit++)
+            if (strcmp(pcLimit, simdName(iLimit)) == 0 && iLimit < iLevel)
+                iLevel = iLimit;
+    }
+
+    return iLevel;
+}
+
+/*****************************************************************************/
+
+#endif /* SIMD_H */
+
+/* EOF */
@@ -0,0 +1,117 @@
+/* sondas.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Sondas estaticas (USDT, no formato do systemtap/sys/sdt.h) do
+   provedor "aec", para correlacionar picos de latencia no host com o
+   que o cancelador estava fazendo. Cada sonda leva o handle da
+   instancia e o UniqueID do descritor (que identifica o motor, ja que
+   os .so sao parecidos demais no perf):
+
+     aec:instantiate  (handle, id, SampleRate)
+     aec:activate     (handle, id)
+     aec:cleanup      (handle, id)
+     aec:run_entry    (handle, id, SampleCount)
+     aec:run_exit     (handle, id, SampleCount, atualizacoes no bloco)
+     aec:dtd          (handle, id, 1 = fala dupla / 0 = so eco, amostra no bloco)
+     aec:length       (handle, id, coeficientes em uso)
+
+   aec:dtd e aec:length so disparam quando o valor muda. Exemplo:
+
+       bpftrace -e 'usdt:/usr/lib/ladspa/nlmscncr.so:aec:dtd
+                    { printf("%x %d\n", arg0, arg2); }'
+
+   Sem <sys/sdt.h> (ou com -DAEC_SEM_SONDAS) as macros nao geram codigo.
+   Com ele, cada sonda e' um nop e uma nota ELF; os argumentos so sao
+   lidos quando um tracer esta conectado. */
+
+#ifndef SONDAS_H
+#define SONDAS_H
+
+/*****************************************************************************/
+
+#if defined(__has_include) && !defined(AEC_SEM_SONDAS)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define AEC_SONDAS
+#endif
+#endif
+
+/*****************************************************************************/
+
+/* Estado das sondas na instancia */
+typedef struct
+{
+
+    unsigned long m_lEngine; /* UniqueID do descritor */
+
+    unsigned long m_lTaps; /* Ultimo tamanho publicado em aec:length */
+
+    int m_iDtd; /* Ultima decisao publicada em aec:dtd (-1: nenhuma) */
+
+} ProbeState;
+
+/*****************************************************************************/
+
+#ifdef AEC_SONDAS
+
+#define PROBE_INSTANTIATE(psProbes, pFilter, lEngine, SampleRate) \
+do { \
+    (psProbes)->m_lEngine = (lEngine); \
+    (psProbes)->m_lTaps = 0; \
+    (psProbes)->m_iDtd = -1; \
+    DTRACE_PROBE3(aec, instantiate, (void *)(pFilter), (psProbes)->m_lEngine, (unsigned long)(SampleRate)); \
+} while (0)
+
+#define PROBE_ACTIVATE(psProbes, pFilter) \
+do { \
+    (psProbes)->m_lTaps = 0; \
+    (psProbes)->m_iDtd = -1; \
+    DTRACE_PROBE2(aec, activate, (void *)(pFilter), (psProbes)->m_lEngine); \
+} while (0)
+
+#define PROBE_CLEANUP(psProbes, pFilter) \
+DTRACE_PROBE2(aec, cleanup, (void *)(pFilter), (psProbes)->m_lEngine)
+
+#define PROBE_RUN_ENTRY(psProbes, pFilter, SampleCount) \
+DTRACE_PROBE3(aec, run_entry, (void *)(pFilter), (psProbes)->m_lEngine, (unsigned long)(SampleCount))
+
+#define PROBE_RUN_EXIT(psProbes, pFilter, SampleCount, lUpdates) \
+DTRACE_PROBE4(aec, run_exit, (void *)(pFilter), (psProbes)->m_lEngine, (unsigned long)(SampleCount), (unsigned long)(lUpdates))
+
+#define PROBE_DTD(psProbes, pFilter, iDoubleTalk, lSample) \
+do { \
+    if ((int)(iDoubleTalk) != (psProbes)->m_iDtd) \
+    { \
+        (psProbes)->m_iDtd = (int)(iDoubleTalk); \
+        DTRACE_PROBE4(aec, dtd, (void *)(pFilter), (psProbes)->m_lEngine, (psProbes)->m_iDtd, (unsigned long)(lSample)); \
+    } \
+} while (0)
+
+#define PROBE_LENGTH(psProbes, pFilter, lTaps) \
+do { \
+    if ((unsigned long)(lTaps) != (psProbes)->m_lTaps) \
+    { \
+        (psProbes)->m_lTaps = (unsigned long)(lTaps); \
+        DTRACE_PROBE3(aec, length, (void *)(pFilter), (psProbes)->m_lEngine, (psProbes)->m_lTaps); \
+    } \
+} while (0)
+
+#else
+
+#define PROBE_INSTANTIATE(psProbes, pFilter, lEngine, SampleRate) ((void)0)
+#define PROBE_ACTIVATE(psProbes, pFilter) ((void)0)
+#define PROBE_CLEANUP(psProbes, pFilter) ((void)0)
+#define PROBE_RUN_ENTRY(psProbes, pFilter, SampleCount) ((void)0)
+#define PROBE_RUN_EXIT(psProbes, pFilter, SampleCount, lUpdates) ((void)0)
+#define PROBE_DTD(psProbes, pFilter, iDoubleTalk, lSample) ((void)0)
+#define PROBE_LENGTH(psProbes, pFilter, lTaps) ((void)0)
+
+#endif /* AEC_SONDAS */
+
+/*****************************************************************************/
+
+#endif /* SONDAS_H */
+
+/* EOF */
@@ -0,0 +1,146 @@
+/* telemetria.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Fila circular de telemetria, sem travas, com um produtor (o run() do
+   plugin, na thread de audio) e um consumidor (qualquer thread que nao
+   seja de tempo real). Cada chamada do run() publica um registro com o
+   estado do cancelador ao fim do bloco.
+
+   O produtor so faz algumas escritas na memoria e uma escrita atomica
+   com release; se a fila estiver cheia o registro e' descartado e
+   contado em m_lDropped, sem nunca esperar pelo consumidor.
+
+   Os plugins que publicam telemetria exportam
+
+       TelemetryRing * ladspa_telemetry(LADSPA_Handle Instance);
+
+   que o host encontra com dlsym() e esvazia com telemetryRead(). */
+
+#ifndef TELEMETRIA_H
+#define TELEMETRIA_H
+
+/*****************************************************************************/
+
+#include <stdatomic.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Registros na fila (potencia de 2). A 48 kHz com blocos de 64 amostras
+   da' pouco mais de 1/3 de segundo de folga para o consumidor. */
+#define TELEMETRY_RECORDS 256
+
+/*****************************************************************************/
+
+/* Estado do cancelador ao fim de um bloco */
+typedef struct
+{
+
+    unsigned long m_lBlock; /* Numero do bloco desde o activate() */
+
+    unsigned long m_lSamples; /* Amostras no bloco */
+
+    unsigned long m_lUpdates; /* Amostras em que os coeficientes foram atualizados */
+
+    float m_fAlpha; /* Fator da nao linearidade (1 nos filtros lineares) */
+
+    float m_fDNCR; /* DNCR da ultima amostra */
+
+    float m_fXVar; /* var(X) da ultima amostra */
+
+    float m_fDVar; /* var(D) da ultima amostra */
+
+    float m_fERLE; /* 10 log10(sum d^2 / sum e^2) no bloco, em dB */
+
+} TelemetryRecord;
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    TelemetryRecord m_asRecords[TELEMETRY_RECORDS];
+
+    /* Indices crescentes (nunca voltam a zero); a posicao e' o indice
+       mascarado. Ficam em linhas de cache separadas para que produtor e
+       consumidor nao disputem a mesma linha. */
+    _Alignas(64) atomic_ulong m_lWrite;
+
+    _Alignas(64) atomic_ulong m_lRead;
+
+    /* So o produtor escreve */
+    _Alignas(64) atomic_ulong m_lDropped;
+
+    unsigned long m_lBlock;
+
+} TelemetryRing;
+
+/*****************************************************************************/
+
+/* Esvazia a fila. Chamado no activate(), sem consumidor ativo. */
+static inline void telemetryReset(TelemetryRing * psRing)
+{
+    atomic_store_explicit(&psRing->m_lWrite, 0, memory_order_relaxed);
+    atomic_store_explicit(&psRing->m_lRead, 0, memory_order_relaxed);
+    atomic_store_explicit(&psRing->m_lDropped, 0, memory_order_relaxed);
+    psRing->m_lBlock = 0;
+}
+
+/*****************************************************************************/
+
+/* Lado do produtor (thread de audio): devolve o registro livre, ou NULL
+   se a fila estiver cheia. Os campos sao preenchidos pelo chamador e o
+   registro so fica visivel depois de telemetryCommit(). */
+static inline TelemetryRecord * telemetryReserve(TelemetryRing * psRing)
+{
+
+    unsigned long lWrite;
+
+    lWrite = atomic_load_explicit(&psRing->m_lWrite, memory_order_relaxed);
+    if (lWrite - atomic_load_explicit(&psRing->m_lRead, memory_order_acquire) >= TELEMETRY_RECORDS)
+    {
+        atomic_store_explicit(&psRing->m_lDropped, atomic_load_explicit(&psRing->m_lDropped, memory_order_relaxed) + 1, memory_order_relaxed);
+        psRing->m_lBlock++;
+        return NULL;
+    }
+
+    psRing->m_asRecords[lWrite & (TELEMETRY_RECORDS - 1)].m_lBlock = psRing->m_lBlock++;
+    return &psRing->m_asRecords[lWrite & (TELEMETRY_RECORDS - 1)];
+}
+
+static inline void telemetryCommit(TelemetryRing * psRing)
+{
+    atomic_store_explicit(&psRing->m_lWrite, atomic_load_explicit(&psRing->m_lWrite, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/*****************************************************************************/
+
+/* Lado do consumidor: copia o registro mais antigo para psRecord.
+   Devolve 1 se havia registro e 0 se a fila estava vazia. */
+static inline int telemetryRead(TelemetryRing * psRing, TelemetryRecord * psRecord)
+{
+
+    unsigned long lRead;
+
+    lRead = atomic_load_explicit(&psRing->m_lRead, memory_order_relaxed);
+    if (lRead == atomic_load_explicit(&psRing->m_lWrite, memory_order_acquire))
+        return 0;
+
+    memcpy(psRecord, &psRing->m_asRecords[lRead & (TELEMETRY_RECORDS - 1)], sizeof(TelemetryRecord));
+    atomic_store_explicit(&psRing->m_lRead, lRead + 1, memory_order_release);
+    return 1;
+}
+
+/* Registros descartados por fila cheia desde o activate() */
+static inline unsigned long telemetryDropped(TelemetryRing * psRing)
+{
+    return atomic_load_explicit(&psRing->m_lDropped, memory_order_relaxed);
+}
+
+/*****************************************************************************/
+
+#endif /* TELEMETRIA_H */
+
+/* EOF */
@@ -0,0 +1,470 @@
+/* bench.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Mede o custo do run() de todos os descritores das bibliotecas dadas,
+   variando a taxa de amostragem, o tamanho do filtro, o comprimento do
+   DTD, o tamanho do bloco do host e o padrao de atividade:
+
+     silencio    x(n) = d(n) = 0
+     eco         so o lado remoto fala: d(n) e' o eco de x(n)
+     fala_dupla  eco mais um sinal local independente em d(n)
+
+   O tamanho do filtro e o comprimento do DTD vao para as portas
+   "Tamanho do filtro (ms)" e "Comprimento do DTD (ms)"; os outros
+   controles ficam no valor padrao do descritor. Valores fora dos
+   limites da porta sao levados ao limite (muitos motores param em 600
+   ms), as colunas tamanho_ms e dtd_ms mostram o valor efetivo e uma
+   configuracao que repete a anterior depois do limite nao e' medida de
+   novo. Descritores sem essas portas rodam uma vez so com o primeiro
+   valor da lista. Com duas
+   entradas de audio, a primeira recebe d(n) e a segunda x(n).
+
+   A saida e' CSV, uma linha por configuracao, com ns por amostra, o
+   fator de tempo real (tempo de processamento / duracao do audio) e
+   quantos canais cabem num nucleo. Se o plugin foi compilado com make
+   INSTRUMENTAR=1, as colunas seguintes vem de ladspa_timing() (veja
+   cronometro.h): chamadas fora do prazo e, com AEC_PERF=1, ciclos,
+   instrucoes por ciclo, faltas na L1D e na LLC e ciclos parados por
+   amostra. Sem isso ficam vazias.
+
+   Uso: bench [-r taxas] [-l tamanhos] [-d dtds] [-b blocos]
+              [-p padroes] [-s segundos] [-q] <plugin.so>...
+
+   As listas sao separadas por virgulas; por padrao o DTD varre 5, 10,
+   20 e 50 ms. -q e' uma rodada curta (16 kHz, 100 ms, DTD de 10 ms,
+   blocos de 256, meio segundo). */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include "ladspa.h"
+#include "cronometro.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define MAX_PORTS 512
+#define MAX_VALORES 32
+
+#define PORTA_TAMANHO "Tamanho do filtro (ms)"
+#define PORTA_DTD "Comprimento do DTD (ms)"
+
+#define PADRAO_SILENCIO 0
+#define PADRAO_ECO 1
+#define PADRAO_FALA_DUPLA 2
+#define NO_PADROES 3
+
+static const char * g_apcPadroes[NO_PADROES] = { "silencio", "eco", "fala_dupla" };
+
+/*****************************************************************************/
+
+/* Uma lista de valores da linha de comando */
+typedef struct
+{
+
+    unsigned long m_lValores;
+
+    double m_adValores[MAX_VALORES];
+
+} Lista;
+
+static void leLista(Lista * psLista, const char * pcTexto)
+{
+
+    char * pcFim;
+
+    psLista->m_lValores = 0;
+    while (*pcTexto != '\0' && psLista->m_lValores < MAX_VALORES)
+    {
+        psLista->m_adValores[psLista->m_lValores++] = strtod(pcTexto, &pcFim);
+        if (pcFim == pcTexto)
+        {
+            fprintf(stderr, "lista invalida: %s\n", pcTexto);
+            exit(EXIT_FAILURE);
+        }
+        pcTexto = *pcFim == ',' ? pcFim + 1 : pcFim;
+    }
+}
+
+/*****************************************************************************/
+
+/* Preenche x(n) e d(n) com lAmostras do padrao iPadrao */
+static void geraSinais(float * pfX, float * pfD, unsigned long lAmostras, unsigned long lTaxa, int iPadrao)
+{
+
+    unsigned long lAtraso;
+    unsigned long lIndex;
+    unsigned long lSemente;
+    float fCorX;
+    float fCorL;
+
+    lSemente = 12345;
+    if (iPadrao == PADRAO_SILENCIO)
+    {
+        memset(pfX, 0, lAmostras * sizeof(float));
+        memset(pfD, 0, lAmostras * sizeof(float));
+        return;
+    }
+
+    /* Eco simples: dois reflexos, a 5 e 10 ms */
+    lAtraso = lTaxa / 200;
+    fCorX = 0;
+    fCorL = 0;
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        fCorX = 0.9f * fCorX + hostNoise(&lSemente);
+        pfX[lIndex] = 0.3f * fCorX;
+        pfD[lIndex] = (lIndex >= lAtraso ? 0.5f * pfX[lIndex - lAtraso] : 0)
+                      + (lIndex >= 2 * lAtraso ? 0.25f * pfX[lIndex - 2 * lAtraso] : 0);
+        if (iPadrao == PADRAO_FALA_DUPLA)
+        {
+            fCorL = 0.8f * fCorL + hostNoise(&lSemente);
+            pfD[lIndex] += 0.3f * fCorL;
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/* dValor dentro dos limites da porta lPorta (ou dValor, sem a porta) */
+static double efetivo(const LADSPA_Descriptor * psDescritor, long lPorta, unsigned long lTaxa, double dValor)
+{
+
+    const LADSPA_PortRangeHint * psHint;
+    double dEscala;
+
+    if (lPorta < 0)
+        return dValor;
+    psHint = &psDescritor->PortRangeHints[lPorta];
+    dEscala = LADSPA_IS_HINT_SAMPLE_RATE(psHint->HintDescriptor) ? (double)lTaxa : 1.0;
+    if (LADSPA_IS_HINT_BOUNDED_ABOVE(psHint->HintDescriptor) && dValor > psHint->UpperBound * dEscala)
+        dValor = psHint->UpperBound * dEscala;
+    if (LADSPA_IS_HINT_BOUNDED_BELOW(psHint->HintDescriptor) && dValor < psHint->LowerBound * dEscala)
+        dValor = psHint->LowerBound * dEscala;
+    return dValor;
+}
+
+/* Algum valor da lista antes de lIndice cai no mesmo valor efetivo */
+static int repetido(const LADSPA_Descriptor * psDescritor, long lPorta, unsigned long lTaxa, const Lista * psLista, unsigned long lIndice)
+{
+
+    unsigned long lAnterior;
+    double dValor;
+
+    dValor = efetivo(psDescritor, lPorta, lTaxa, psLista->m_adValores[lIndice]);
+    for (lAnterior = 0; lAnterior < lIndice; lAnterior++)
+        if (efetivo(psDescritor, lPorta, lTaxa, psLista->m_adValores[lAnterior]) == dValor)
+            return 1;
+    return 0;
+}
+
+/*****************************************************************************/
+
+/* Roda uma configuracao e imprime a linha do CSV; dTamanho e dDtd ja
+   vem dentro dos limites das portas */
+static void mede(const char * pcArquivo, const LADSPA_Descriptor * psDescritor, RunTiming * (*fTiming)(LADSPA_Handle),
+                 unsigned long lTaxa, double dTamanho, double dDtd, unsigned long lBloco, int iPadrao,
+                 const float * pfX, const float * pfD, float * pfSaida, unsigned long lAmostras)
+{
+
+    LADSPA_Handle hInstancia;
+    LADSPA_Data afPortas[MAX_PORTS];
+    const float * apfEntradas[2];
+    unsigned long alEntradas[2];
+    unsigned long lEntradas;
+    unsigned long lPorta;
+    unsigned long lInicio;
+    unsigned long lAquecimento;
+    unsigned long lMedidas;
+    long lTamanho;
+    long lDtd;
+    RunTiming * psTiming;
+    TimingSnapshot sFoto;
+    PerfSlot * psSlot;
+    double dTempo;
+    double dFator;
+    int iSlot;
+
+    hInstancia = psDescritor->instantiate(psDescritor, lTaxa);
+    lEntradas = 0;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+    {
+        if (LADSPA_IS_PORT_CONTROL(psDescritor->PortDescriptors[lPorta]))
+        {
+            afPortas[lPorta] = hostDefault(&psDescritor->PortRangeHints[lPorta], lTaxa);
+            psDescritor->connect_port(hInstancia, lPorta, afPortas + lPorta);
+        }
+        else if (LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]))
+        {
+            if (lEntradas < 2)
+                alEntradas[lEntradas++] = lPorta;
+            else
+                psDescritor->connect_port(hInstancia, lPorta, (LADSPA_Data *)pfX);
+        }
+        else
+        {
+            psDescritor->connect_port(hInstancia, lPorta, pfSaida);
+        }
+    }
+    lTamanho = hostFindPort(psDescritor, PORTA_TAMANHO);
+    lDtd = hostFindPort(psDescritor, PORTA_DTD);
+    if (lTamanho >= 0)
+        afPortas[lTamanho] = (LADSPA_Data)dTamanho;
+    if (lDtd >= 0)
+        afPortas[lDtd] = (LADSPA_Data)dDtd;
+
+    /* Duas entradas: d(n) e x(n); uma: x(n) */
+    apfEntradas[0] = lEntradas == 2 ? pfD : pfX;
+    apfEntradas[1] = pfX;
+
+    if (psDescritor->activate != NULL)
+        psDescritor->activate(hInstancia);
+
+    /* Aquecimento: um decimo do sinal, fora da medida */
+    lAquecimento = lAmostras / 10;
+    for (lInicio = 0; lInicio + lBloco <= lAquecimento; lInicio += lBloco)
+    {
+        for (lPorta = 0; lPorta < lEntradas; lPorta++)
+            psDescritor->connect_port(hInstancia, alEntradas[lPorta], (LADSPA_Data *)apfEntradas[lPorta] + lInicio);
+        psDescritor->run(hInstancia, lBloco);
+    }
+
+    psTiming = fTiming != NULL ? fTiming(hInstancia) : NULL;
+    if (psTiming != NULL)
+        timingReset(psTiming);
+
+    lMedidas = 0;
+    dTempo = hostSeconds();
+    for (lInicio = 0; lInicio + lBloco <= lAmostras; lInicio += lBloco)
+    {
+        for (lPorta = 0; lPorta < lEntradas; lPorta++)
+            psDescritor->connect_port(hInstancia, alEntradas[lPorta], (LADSPA_Data *)apfEntradas[lPorta] + lInicio);
+        psDescritor->run(hInstancia, lBloco);
+        lMedidas += lBloco;
+    }
+    dTempo = hostSeconds() - dTempo;
+
+    dFator = dTempo * lTaxa / (double)lMedidas;
+    printf("%s,%s,%lu,%lu,", pcArquivo, psDescritor->Label, psDescritor->UniqueID, lTaxa);
+    if (lTamanho >= 0)
+        printf("%g,", dTamanho);
+    else
+        printf(",");
+    if (lDtd >= 0)
+        printf("%g,", dDtd);
+    else
+        printf(",");
+    printf("%lu,%s,%.3f,%.6f,%.1f", lBloco, g_apcPadroes[iPadrao], dTempo * 1e9 / (double)lMedidas, dFator, 1.0 / dFator);
+
+    if (psTiming != NULL)
+    {
+        timingRead(psTiming, &sFoto);
+        printf(",%lu", sFoto.m_lMisses);
+        psSlot = &sFoto.m_asPerf[0];
+        for (iSlot = 1; iSlot < PERF_SLOTS; iSlot++)
+            if (sFoto.m_asPerf[iSlot].m_lCalls > psSlot->m_lCalls)
+                psSlot = &sFoto.m_asPerf[iSlot];
+        if (psSlot->m_lSamples > 0 && (sFoto.m_iPerfMask & (1 << PERF_CYCLES)))
+        {
+            printf(",%lu,%.2f,%.2f,%.4f,%.4f,%.4f\n",
+                   psSlot->m_lTaps,
+                   (double)psSlot->m_aullCounts[PERF_CYCLES] / psSlot->m_lSamples,
+                   psSlot->m_aullCounts[PERF_CYCLES] ? (double)psSlot->m_aullCounts[PERF_INSTRUCTIONS] / psSlot->m_aullCounts[PERF_CYCLES] : 0,
+                   (double)psSlot->m_aullCounts[PERF_L1D_MISSES] / psSlot->m_lSamples,
+                   (double)psSlot->m_aullCounts[PERF_LLC_MISSES] / psSlot->m_lSamples,
+                   (double)psSlot->m_aullCounts[PERF_STALLS] / psSlot->m_lSamples);
+        }
+        else
+        {
+            printf(",,,,,,\n");
+        }
+    }
+    else
+    {
+        printf(",,,,,,,\n");
+    }
+    fflush(stdout);
+
+    psDescritor->cleanup(hInstancia);
+}
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    Lista sTaxas;
+    Lista sTamanhos;
+    Lista sDtds;
+    Lista sBlocos;
+    int aiPadroes[NO_PADROES];
+    int iPadroes;
+    int iPadrao;
+    int iOpcao;
+    double dSegundos;
+    char * pcPadrao;
+    void * pvBiblioteca;
+    LADSPA_Descriptor_Function fDescritor;
+    RunTiming * (*fTiming)(LADSPA_Handle);
+    const LADSPA_Descriptor * psDescritor;
+    unsigned long lDescritor;
+    unsigned long lTaxa;
+    unsigned long lTamanho;
+    unsigned long lDtd;
+    unsigned long lBloco;
+    unsigned long lAmostras;
+    long lPortaTamanho;
+    long lPortaDtd;
+    float * pfX;
+    float * pfD;
+    float * pfSaida;
+    int iArquivo;
+
+    leLista(&sTaxas, "8000,16000,48000,96000");
+    leLista(&sTamanhos, "10,100,500,2000");
+    leLista(&sDtds, "5,10,20,50");
+    leLista(&sBlocos, "1,64,256,4096");
+    for (iPadroes = 0; iPadroes < NO_PADROES; iPadroes++)
+        aiPadroes[iPadroes] = iPadroes;
+    dSegundos = 1.0;
+
+    while ((iOpcao = getopt(argc, argv, "r:l:d:b:p:s:q")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'r':
+            leLista(&sTaxas, optarg);
+            break;
+        case 'l':
+            leLista(&sTamanhos, optarg);
+            break;
+        case 'd':
+            leLista(&sDtds, optarg);
+            break;
+        case 'b':
+            leLista(&sBlocos, optarg);
+            break;
+        case 'p':
+            iPadroes = 0;
+            for (pcPadrao = strtok(optarg, ","); pcPadrao != NULL && iPadroes < NO_PADROES; pcPadrao = strtok(NULL, ","))
+            {
+                for (iPadrao = 0; iPadrao < NO_PADROES && strcmp(pcPadrao, g_apcPadroes[iPadrao]) != 0; iPadrao++);
+                if (iPadrao == NO_PADROES)
+                {
+                    fprintf(stderr, "padrao desconhecido: %s\n", pcPadrao);
+                    return EXIT_FAILURE;
+                }
+                aiPadroes[iPadroes++] = iPadrao;
+            }
+            break;
+        case 's':
+            dSegundos = atof(optarg);
+            break;
+        case 'q':
+            leLista(&sTaxas, "16000");
+            leLista(&sTamanhos, "100");
+            leLista(&sDtds, "10");
+            leLista(&sBlocos, "256");
+            dSegundos = 0.5;
+            break;
+        default:
+            fputs("Uso: bench [-r taxas] [-l tamanhos] [-d dtds] [-b blocos] [-p padroes] [-s segundos] [-q] <plugin.so>...\n", stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        fputs("Uso: bench [-r taxas] [-l tamanhos] [-d dtds] [-b blocos] [-p padroes] [-s segundos] [-q] <plugin.so>...\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("arquivo,label,id,taxa,tamanho_ms,dtd_ms,bloco,padrao,ns_amostra,fator_tempo_real,canais_por_nucleo,"
+           "fora_do_prazo,coeficientes,ciclos_amostra,ipc,l1d_amostra,llc_amostra,paradas_amostra\n");
+
+    for (iArquivo = optind; iArquivo < argc; iArquivo++)
+    {
+        pvBiblioteca = dlopen(argv[iArquivo], RTLD_NOW);
+        if (pvBiblioteca == NULL)
+        {
+            fprintf(stderr, "%s\n", dlerror());
+            continue;
+        }
+        fDescritor = (LADSPA_Descriptor_Function)dlsym(pvBiblioteca, "ladspa_descriptor");
+        fTiming = (RunTiming * (*)(LADSPA_Handle))dlsym(pvBiblioteca, "ladspa_timing");
+        if (fDescritor == NULL)
+        {
+            fprintf(stderr, "%s: nao e' um plugin LADSPA.\n", argv[iArquivo]);
+            continue;
+        }
+
+        for (lDescritor = 0; (psDescritor = fDescritor(lDescritor)) != NULL; lDescritor++)
+        {
+            if (psDescritor->PortCount > MAX_PORTS)
+            {
+                fprintf(stderr, "%s: %s tem portas demais, ignorado.\n", argv[iArquivo], psDescritor->Label);
+                continue;
+            }
+            lPortaTamanho = hostFindPort(psDescritor, PORTA_TAMANHO);
+            lPortaDtd = hostFindPort(psDescritor, PORTA_DTD);
+            for (lTaxa = 0; lTaxa < sTaxas.m_lValores; lTaxa++)
+            {
+                lAmostras = (unsigned long)(dSegundos * sTaxas.m_adValores[lTaxa]);
+                pfX = (float *)calloc(lAmostras + 1, sizeof(float));
+                pfD = (float *)calloc(lAmostras + 1, sizeof(float));
+                pfSaida = (float *)calloc(lAmostras + 1, sizeof(float));
+                if (pfX == NULL || pfD == NULL || pfSaida == NULL)
+                {
+                    fputs("Out of memory.\n", stderr);
+                    return EXIT_FAILURE;
+                }
+
+                for (iPadrao = 0; iPadrao < iPadroes; iPadrao++)
+                {
+                    geraSinais(pfX, pfD, lAmostras, (unsigned long)sTaxas.m_adValores[lTaxa], aiPadroes[iPadrao]);
+                    for (lTamanho = 0; lTamanho < sTamanhos.m_lValores; lTamanho++)
+                    {
+                        if (lTamanho > 0 && lPortaTamanho < 0)
+                            break;
+                        if (repetido(psDescritor, lPortaTamanho, (unsigned long)sTaxas.m_adValores[lTaxa], &sTamanhos, lTamanho))
+                            continue;
+                        for (lDtd = 0; lDtd < sDtds.m_lValores; lDtd++)
+                        {
+                            if (lDtd > 0 && lPortaDtd < 0)
+                                break;
+                            if (repetido(psDescritor, lPortaDtd, (unsigned long)sTaxas.m_adValores[lTaxa], &sDtds, lDtd))
+                                continue;
+                            for (lBloco = 0; lBloco < sBlocos.m_lValores; lBloco++)
+                            {
+                                if ((unsigned long)sBlocos.m_adValores[lBloco] == 0 || (unsigned long)sBlocos.m_adValores[lBloco] > lAmostras)
+                                    continue;
+                                mede(argv[iArquivo], psDescritor, fTiming,
+                                     (unsigned long)sTaxas.m_adValores[lTaxa],
+                                     efetivo(psDescritor, lPortaTamanho, (unsigned long)sTaxas.m_adValores[lTaxa], sTamanhos.m_adValores[lTamanho]),
+                                     efetivo(psDescritor, lPortaDtd, (unsigned long)sTaxas.m_adValores[lTaxa], sDtds.m_adValores[lDtd]),
+                                     (unsigned long)sBlocos.m_adValores[lBloco], aiPadroes[iPadrao], pfX, pfD, pfSaida, lAmostras);
+                            }
+                        }
+                    }
+                }
+
+                free(pfX);
+                free(pfD);
+                free(pfSaida);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+/* EOF */
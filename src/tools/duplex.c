@@ -0,0 +1,422 @@
+/* duplex.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Testes da ABI em C de libcancelador.so (api/cancelador.h), em
+   particular do cancelador duplex (api/duplex.hpp):
+
+     identidade  aec_duplex_render() e aec_duplex_capture() em threads
+                 separadas, com blocos de tamanhos diferentes, dao a
+                 mesma saida, bit a bit, que aec_process() com a
+                 referencia ja alinhada; e aec_init() o mesmo que
+                 aec_create()
+     reset       depois de aec_duplex_reset(), com e sem referencia
+                 pendente, a captura so ve a referencia nova
+     contadores  underrun, stale, gap e overrun num roteiro de uma
+                 thread so, com os valores esperados
+     erros       argumentos invalidos devolvem 0 ou NULL, e
+                 aec_config_default() nao escreve alem do StructSize
+
+   O sinal e' a cena HOST_SCENE_DOUBLE_TALK de hostSignals(). Imprime uma
+   linha por teste e devolve o numero de falhas.
+
+   Uso: duplex [-n amostras] */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "ladspa.h"
+#include "hospedeiro.h"
+#include "api/cancelador.h"
+
+/*****************************************************************************/
+
+#define USO "Uso: duplex [-n amostras]\n"
+
+#define SAMPLE_RATE 16000
+#define TAM_FILA 4096
+#define TAM_RENDER 256
+#define TAM_CAPTURA 160
+
+/* Relogio comum as duas threads: tempo da primeira amostra */
+#define INICIO 1000
+
+/*****************************************************************************/
+
+/* Estado das duas threads do teste de identidade */
+typedef struct
+{
+
+    AEC_Duplex * m_psDuplex;
+
+    const float * m_pfX;
+
+    const float * m_pfD;
+
+    float * m_pfE;
+
+    unsigned long m_lAmostras;
+
+    atomic_ulong m_lRenderizadas; /* Amostras ja entregues a render() */
+
+    atomic_ulong m_lCapturadas; /* Amostras ja processadas por capture() */
+
+    atomic_int m_iErros;
+
+} Duplex;
+
+/* Reproducao: nunca deixa a fila encher */
+static void * reproducao(void * pvDuplex)
+{
+
+    Duplex * psDuplex;
+    unsigned long lPos;
+    unsigned long lBloco;
+
+    psDuplex = (Duplex *)pvDuplex;
+    for (lPos = 0; lPos < psDuplex->m_lAmostras; lPos += lBloco)
+    {
+        lBloco = psDuplex->m_lAmostras - lPos < TAM_RENDER ? psDuplex->m_lAmostras - lPos : TAM_RENDER;
+        while (lPos + lBloco - atomic_load(&psDuplex->m_lCapturadas) > TAM_FILA)
+            sched_yield();
+        if (!aec_duplex_render(psDuplex->m_psDuplex, psDuplex->m_pfX + lPos, lBloco, INICIO + lPos))
+            atomic_fetch_add(&psDuplex->m_iErros, 1);
+        atomic_store(&psDuplex->m_lRenderizadas, lPos + lBloco);
+    }
+    return NULL;
+}
+
+/* Captura: so pede o que a reproducao ja entregou */
+static void * captura(void * pvDuplex)
+{
+
+    Duplex * psDuplex;
+    unsigned long lPos;
+    unsigned long lBloco;
+
+    psDuplex = (Duplex *)pvDuplex;
+    for (lPos = 0; lPos < psDuplex->m_lAmostras; lPos += lBloco)
+    {
+        lBloco = psDuplex->m_lAmostras - lPos < TAM_CAPTURA ? psDuplex->m_lAmostras - lPos : TAM_CAPTURA;
+        while (atomic_load(&psDuplex->m_lRenderizadas) < lPos + lBloco)
+            sched_yield();
+        if (!aec_duplex_capture(psDuplex->m_psDuplex, psDuplex->m_pfD + lPos, psDuplex->m_pfE + lPos, lBloco,
+                                INICIO + lPos, NULL))
+            atomic_fetch_add(&psDuplex->m_iErros, 1);
+        atomic_store(&psDuplex->m_lCapturadas, lPos + lBloco);
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/* Imprime o resultado de um teste; devolve 1 na falha */
+static int confere(int iOk, const char * pcTeste, const char * pcDetalhe)
+{
+    printf("%s %-11s %s\n", iOk ? "ok   " : "FALHA", pcTeste, pcDetalhe);
+    return !iOk;
+}
+
+/* Primeira amostra diferente (bit a bit), ou lAmostras */
+static unsigned long diferenca(const float * pfA, const float * pfB, unsigned long lAmostras)
+{
+
+    unsigned long lIndex;
+
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+        if (memcmp(pfA + lIndex, pfB + lIndex, sizeof(float)) != 0)
+            break;
+    return lIndex;
+}
+
+static int confereContadores(const AEC_Duplex * psDuplex, const char * pcTeste, unsigned long long ullOverruns,
+                             unsigned long long ullDropped, unsigned long long ullUnderruns, unsigned long long ullMissing,
+                             unsigned long long ullGap, unsigned long long ullStale)
+{
+
+    AEC_DuplexStats sStats;
+    char acDetalhe[256];
+    int iOk;
+
+    sStats.StructSize = sizeof(AEC_DuplexStats);
+    iOk = aec_duplex_stats(psDuplex, &sStats);
+    snprintf(acDetalhe, sizeof(acDetalhe), "overrun %llu/%llu descartadas %llu/%llu underrun %llu/%llu faltando %llu/%llu "
+             "gap %llu/%llu stale %llu/%llu", sStats.Overruns, ullOverruns, sStats.DroppedFrames, ullDropped,
+             sStats.Underruns, ullUnderruns, sStats.MissingFrames, ullMissing, sStats.GapFrames, ullGap,
+             sStats.StaleFrames, ullStale);
+    iOk = iOk && sStats.Overruns == ullOverruns && sStats.DroppedFrames == ullDropped && sStats.Underruns == ullUnderruns
+          && sStats.MissingFrames == ullMissing && sStats.GapFrames == ullGap && sStats.StaleFrames == ullStale;
+    return confere(iOk, pcTeste, acDetalhe);
+}
+
+/*****************************************************************************/
+
+/* aec_process() em blocos de TAM_CAPTURA, a referencia do teste */
+static int referencia(AEC_Canceller * psCanceller, const float * pfX, const float * pfD, float * pfE, unsigned long lAmostras)
+{
+
+    unsigned long lPos;
+    unsigned long lBloco;
+
+    for (lPos = 0; lPos < lAmostras; lPos += lBloco)
+    {
+        lBloco = lAmostras - lPos < TAM_CAPTURA ? lAmostras - lPos : TAM_CAPTURA;
+        if (!aec_process(psCanceller, pfD + lPos, pfX + lPos, pfE + lPos, lBloco, NULL))
+            return 0;
+    }
+    return 1;
+}
+
+static int testaIdentidade(const AEC_Config * psConfig, const float * pfX, const float * pfD, unsigned long lAmostras)
+{
+
+    AEC_Canceller * psCanceller;
+    Duplex sDuplex;
+    pthread_t sReproducao;
+    pthread_t sCaptura;
+    float * pfRef;
+    float * pfE;
+    void * pvMemoria;
+    size_t lMemoria;
+    unsigned long lDiferenca;
+    char acDetalhe[256];
+    int iFalhas;
+
+    iFalhas = 0;
+    pfRef = (float *)calloc(lAmostras, sizeof(float));
+    pfE = (float *)calloc(lAmostras, sizeof(float));
+    if (pfRef == NULL || pfE == NULL)
+        return confere(0, "identidade", "sem memoria");
+
+    psCanceller = aec_create(SAMPLE_RATE, psConfig);
+    iFalhas += confere(psCanceller != NULL && referencia(psCanceller, pfX, pfD, pfRef, lAmostras), "identidade", "aec_process()");
+    aec_destroy(psCanceller);
+
+    /* A mesma coisa sobre memoria dada */
+    lMemoria = aec_memory_size(SAMPLE_RATE);
+    pvMemoria = aligned_alloc(16, (lMemoria + 15) / 16 * 16);
+    psCanceller = pvMemoria == NULL ? NULL : aec_init(pvMemoria, lMemoria, SAMPLE_RATE, psConfig);
+    lDiferenca = psCanceller != NULL && referencia(psCanceller, pfX, pfD, pfE, lAmostras) ? diferenca(pfRef, pfE, lAmostras) : 0;
+    snprintf(acDetalhe, sizeof(acDetalhe), "aec_init(): %lu de %lu amostras iguais", lDiferenca, lAmostras);
+    iFalhas += confere(lDiferenca == lAmostras, "identidade", acDetalhe);
+    aec_destroy(psCanceller);
+    free(pvMemoria);
+
+    /* Duplex, com render() e capture() em threads separadas */
+    memset(pfE, 0, lAmostras * sizeof(float));
+    sDuplex.m_psDuplex = aec_duplex_create(SAMPLE_RATE, psConfig, TAM_FILA, TAM_CAPTURA);
+    sDuplex.m_pfX = pfX;
+    sDuplex.m_pfD = pfD;
+    sDuplex.m_pfE = pfE;
+    sDuplex.m_lAmostras = lAmostras;
+    atomic_init(&sDuplex.m_lRenderizadas, 0);
+    atomic_init(&sDuplex.m_lCapturadas, 0);
+    atomic_init(&sDuplex.m_iErros, 0);
+    if (sDuplex.m_psDuplex == NULL)
+        iFalhas += confere(0, "identidade", "aec_duplex_create()");
+    else
+    {
+        pthread_create(&sCaptura, NULL, captura, &sDuplex);
+        pthread_create(&sReproducao, NULL, reproducao, &sDuplex);
+        pthread_join(sReproducao, NULL);
+        pthread_join(sCaptura, NULL);
+        lDiferenca = diferenca(pfRef, pfE, lAmostras);
+        snprintf(acDetalhe, sizeof(acDetalhe), "duplex em duas threads: %lu de %lu amostras iguais, %d erros",
+                 lDiferenca, lAmostras, atomic_load(&sDuplex.m_iErros));
+        iFalhas += confere(lDiferenca == lAmostras && atomic_load(&sDuplex.m_iErros) == 0, "identidade", acDetalhe);
+        iFalhas += confereContadores(sDuplex.m_psDuplex, "identidade", 0, 0, 0, 0, 0, 0);
+        aec_duplex_destroy(sDuplex.m_psDuplex);
+    }
+
+    free(pfRef);
+    free(pfE);
+    return iFalhas;
+}
+
+/*****************************************************************************/
+
+/* Referencia constante fRef e microfone mudo: com o filtro zerado (so o
+   primeiro coeficiente em 1) a primeira saida e' -fRef */
+static int testaReset(const AEC_Config * psConfig)
+{
+
+    AEC_Duplex * psDuplex;
+    float afRef[TAM_CAPTURA];
+    float afMic[TAM_CAPTURA];
+    float afOut[TAM_CAPTURA];
+    unsigned long lBloco;
+    unsigned long lIndex;
+    char acDetalhe[256];
+    int iFalhas;
+
+    iFalhas = 0;
+    psDuplex = aec_duplex_create(SAMPLE_RATE, psConfig, TAM_FILA, TAM_CAPTURA);
+    if (psDuplex == NULL)
+        return confere(0, "reset", "aec_duplex_create()");
+    memset(afMic, 0, sizeof(afMic));
+
+    /* Dez blocos consumidos, reset e um bloco novo */
+    for (lIndex = 0; lIndex < TAM_CAPTURA; lIndex++)
+        afRef[lIndex] = 1.0f;
+    for (lBloco = 0; lBloco < 10; lBloco++)
+    {
+        aec_duplex_render(psDuplex, afRef, TAM_CAPTURA, lBloco * TAM_CAPTURA);
+        aec_duplex_capture(psDuplex, afMic, afOut, TAM_CAPTURA, lBloco * TAM_CAPTURA, NULL);
+    }
+    aec_duplex_reset(psDuplex);
+    for (lIndex = 0; lIndex < TAM_CAPTURA; lIndex++)
+        afRef[lIndex] = 2.0f;
+    aec_duplex_render(psDuplex, afRef, TAM_CAPTURA, 0);
+    aec_duplex_capture(psDuplex, afMic, afOut, TAM_CAPTURA, 0, NULL);
+    snprintf(acDetalhe, sizeof(acDetalhe), "apos blocos consumidos: saida %g (esperado -2)", afOut[0]);
+    iFalhas += confere(afOut[0] == -2.0f, "reset", acDetalhe);
+    iFalhas += confereContadores(psDuplex, "reset", 0, 0, 0, 0, 0, 0);
+
+    /* Referencia pendente (render() sem capture()) tambem sai */
+    for (lIndex = 0; lIndex < TAM_CAPTURA; lIndex++)
+        afRef[lIndex] = 1.0f;
+    for (lBloco = 0; lBloco < 5; lBloco++)
+        aec_duplex_render(psDuplex, afRef, TAM_CAPTURA, (lBloco + 1) * TAM_CAPTURA);
+    aec_duplex_reset(psDuplex);
+    for (lIndex = 0; lIndex < TAM_CAPTURA; lIndex++)
+        afRef[lIndex] = 3.0f;
+    aec_duplex_render(psDuplex, afRef, TAM_CAPTURA, 0);
+    aec_duplex_capture(psDuplex, afMic, afOut, TAM_CAPTURA, 0, NULL);
+    snprintf(acDetalhe, sizeof(acDetalhe), "com referencia pendente: saida %g (esperado -3)", afOut[0]);
+    iFalhas += confere(afOut[0] == -3.0f, "reset", acDetalhe);
+    iFalhas += confereContadores(psDuplex, "reset", 0, 0, 0, 0, 0, 0);
+
+    aec_duplex_destroy(psDuplex);
+    return iFalhas;
+}
+
+/*****************************************************************************/
+
+/* Roteiro numa thread so, fila de 1024 amostras */
+static int testaContadores(const AEC_Config * psConfig, const float * pfX, const float * pfD)
+{
+
+    AEC_Duplex * psDuplex;
+    float afOut[TAM_CAPTURA];
+    unsigned long lBloco;
+
+    psDuplex = aec_duplex_create(SAMPLE_RATE, psConfig, 1024, TAM_CAPTURA);
+    if (psDuplex == NULL)
+        return confere(0, "contadores", "aec_duplex_create()");
+
+    aec_duplex_capture(psDuplex, pfD, afOut, TAM_CAPTURA, 0, NULL); /* underrun: 0..160 sem referencia */
+    aec_duplex_render(psDuplex, pfX, 256, 0);
+    aec_duplex_render(psDuplex, pfX + 256, 256, 512); /* 256..512 pulado */
+    aec_duplex_capture(psDuplex, pfD, afOut, TAM_CAPTURA, 160, NULL); /* stale 0..160, 96 de referencia, gap 64 */
+    aec_duplex_capture(psDuplex, pfD, afOut, TAM_CAPTURA, 320, NULL); /* gap 160 */
+    aec_duplex_capture(psDuplex, pfD, afOut, TAM_CAPTURA, 480, NULL); /* gap 32, 128 de referencia */
+    for (lBloco = 0; lBloco < 5; lBloco++) /* 128 na fila: cabem 3 blocos */
+        aec_duplex_render(psDuplex, pfX, 256, 768 + 256 * lBloco);
+
+    lBloco = confereContadores(psDuplex, "contadores", 2, 512, 1, 160, 256, 160);
+    aec_duplex_destroy(psDuplex);
+    return (int)lBloco;
+}
+
+/*****************************************************************************/
+
+static int testaErros(const AEC_Config * psConfig, const float * pfX, const float * pfD)
+{
+
+    AEC_Duplex * psDuplex;
+    AEC_DuplexStats sStats;
+    AEC_Config sConfig;
+    AEC_Config sGuarda;
+    float afOut[TAM_CAPTURA + 1];
+    int iOk;
+
+    psDuplex = aec_duplex_create(SAMPLE_RATE, psConfig, 1024, TAM_CAPTURA);
+    sStats.StructSize = 0;
+    iOk = psDuplex != NULL
+          && !aec_duplex_capture(psDuplex, pfD, afOut, TAM_CAPTURA + 1, 0, NULL) /* maior que MaxBlock */
+          && !aec_duplex_render(psDuplex, pfX, 2048, 0) /* maior que a fila */
+          && !aec_duplex_render(NULL, pfX, 16, 0)
+          && !aec_duplex_capture(psDuplex, NULL, afOut, 16, 0, NULL)
+          && !aec_duplex_stats(psDuplex, &sStats)
+          && aec_duplex_create(SAMPLE_RATE, psConfig, 0, TAM_CAPTURA) == NULL
+          && aec_duplex_create(SAMPLE_RATE, psConfig, 1024, 0) == NULL
+          && aec_duplex_create(0, psConfig, 1024, TAM_CAPTURA) == NULL
+          && aec_create(0, psConfig) == NULL;
+    aec_duplex_destroy(psDuplex);
+
+    /* Chamador compilado com uma AEC_Config que terminava em Mu */
+    memset(&sConfig, 0x5a, sizeof(AEC_Config));
+    sConfig.StructSize = offsetof(AEC_Config, SetThresholdDb);
+    memset(&sGuarda, 0x5a, sizeof(AEC_Config));
+    iOk = iOk && aec_config_default(&sConfig) && sConfig.Mu == psConfig->Mu
+          && memcmp(&sConfig.SetThresholdDb, &sGuarda.SetThresholdDb, sizeof(AEC_Config) - offsetof(AEC_Config, SetThresholdDb)) == 0;
+    sConfig.StructSize = 0;
+    iOk = iOk && !aec_config_default(&sConfig) && !aec_config_default(NULL);
+    return confere(iOk, "erros", "argumentos invalidos devolvem 0 ou NULL");
+}
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    AEC_Config sConfig;
+    float * pfX;
+    float * pfD;
+    unsigned long lAmostras;
+    int iOpcao;
+    int iFalhas;
+
+    lAmostras = 4 * SAMPLE_RATE;
+    while ((iOpcao = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'n':
+            lAmostras = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (lAmostras < 4096)
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+
+    pfX = (float *)calloc(lAmostras, sizeof(float));
+    pfD = (float *)calloc(lAmostras, sizeof(float));
+    if (pfX == NULL || pfD == NULL || !hostSignals(pfX, pfD, lAmostras, SAMPLE_RATE, HOST_SCENE_DOUBLE_TALK))
+    {
+        fputs("Out of memory.\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("ABI %u (cabecalho %u)\n", aec_abi_version(), AEC_ABI_VERSION);
+    sConfig.StructSize = sizeof(AEC_Config);
+    aec_config_default(&sConfig);
+
+    iFalhas = 0;
+    iFalhas += confere(aec_abi_version() == AEC_ABI_VERSION, "abi", "aec_abi_version() igual ao cabecalho");
+    iFalhas += testaIdentidade(&sConfig, pfX, pfD, lAmostras);
+    iFalhas += testaReset(&sConfig);
+    iFalhas += testaContadores(&sConfig, pfX, pfD);
+    iFalhas += testaErros(&sConfig, pfX, pfD);
+    printf("%d falhas\n", iFalhas);
+
+    free(pfX);
+    free(pfD);
+    return iFalhas;
+}
+
+/* EOF */
@@ -0,0 +1,355 @@
+/* filtro.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Cancelador como filtro de pipeline: le da entrada padrao PCM bruto
+   intercalado de dois canais (canal 0: lado remoto x(n); canal 1:
+   microfone d(n)) e escreve e(n), mono e no mesmo formato, na saida
+   padrao. Serve para encaixar o cancelador entre sox ou ffmpeg sem
+   arquivos temporarios, por exemplo:
+
+     sox chamada.wav -t raw -e signed -b 16 - | filtro nlmscncr.so |
+         sox -t raw -e signed -b 16 -r 16000 -c 1 - limpo.wav
+
+   Le e escreve em blocos de -b quadros (padrao: 16384), com buffers
+   alocados uma vez so, de modo que a memoria nao depende do tamanho do
+   fluxo. Cada leitura junta um bloco inteiro antes de rodar o plugin, e
+   os pipes de entrada e saida sao aumentados (F_SETPIPE_SZ) para um
+   bloco, o que reduz as trocas de contexto entre os processos. A
+   separacao dos canais e a conversao para float sao feitas por pcm.h.
+
+   Com -z, se a saida padrao for um pipe, os blocos sao entregues com
+   vmsplice(), sem copia para o pipe: as paginas do buffer ficam no pipe
+   ate serem lidas. Por isso os buffers de saida formam um anel com
+   mais paginas do que cabem no pipe, e um buffer so e' reescrito quando
+   as paginas dele ja sairam. Isso vale quando o processo seguinte le o
+   pipe com read() (sox, ffmpeg, cat); se ele fizer splice() para outro
+   pipe, as paginas seguem referenciadas e podem ser reescritas antes de
+   chegar ao destino, e -z nao deve ser usado.
+
+   O formato (-f) e' s16 (padrao), s24 ou f32, little-endian; -r da a taxa
+   passada ao plugin (padrao: 16000 Hz). Os controles ficam no padrao do
+   descritor, menos os dados com -c "nome=valor". Um quadro incompleto no
+   fim do fluxo e' descartado. No fim imprime, na saida de erro, quantas
+   amostras passaram e quantas vezes o tempo real.
+
+   Uso: filtro [-l label] [-b bloco] [-r taxa] [-f s16|s24|f32] [-c porta=valor]...
+               [-z] <plugin.so> */
+
+/*****************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "ladspa.h"
+#include "hospedeiro.h"
+#include "pcm.h"
+
+/*****************************************************************************/
+
+#define MAX_CONTROLES 32
+
+/* Limite do anel de buffers de saida do -z */
+#define MAX_ANEL 64
+
+#define PAGINA 4096
+
+#define USO "Uso: filtro [-l label] [-b bloco] [-r taxa] [-f s16|s24|f32] [-c porta=valor]... [-z] <plugin.so>\n"
+
+/*****************************************************************************/
+
+/* Le ate uTamanho bytes, parando so no fim do fluxo; devolve quantos leu,
+   ou -1 */
+static ssize_t leTudo(int iFd, unsigned char * pucBuffer, size_t uTamanho)
+{
+
+    size_t uLidos;
+    ssize_t lLidos;
+
+    uLidos = 0;
+    while (uLidos < uTamanho)
+    {
+        lLidos = read(iFd, pucBuffer + uLidos, uTamanho - uLidos);
+        if (lLidos < 0 && errno == EINTR)
+            continue;
+        if (lLidos < 0)
+            return -1;
+        if (lLidos == 0)
+            break;
+        uLidos += (size_t)lLidos;
+    }
+    return (ssize_t)uLidos;
+}
+
+/* Escreve o buffer inteiro, com vmsplice() se iSplice */
+static int escreveTudo(int iFd, const unsigned char * pucBuffer, size_t uTamanho, int iSplice)
+{
+
+    struct iovec sVetor;
+    ssize_t lEscritos;
+
+    while (uTamanho > 0)
+    {
+        if (iSplice)
+        {
+            sVetor.iov_base = (void *)pucBuffer;
+            sVetor.iov_len = uTamanho;
+            lEscritos = vmsplice(iFd, &sVetor, 1, 0);
+        }
+        else
+            lEscritos = write(iFd, pucBuffer, uTamanho);
+        if (lEscritos < 0 && errno == EINTR)
+            continue;
+        if (lEscritos <= 0)
+            return 0;
+        pucBuffer += lEscritos;
+        uTamanho -= (size_t)lEscritos;
+    }
+    return 1;
+}
+
+/* Aumenta o pipe para uTamanho bytes, se o descritor for um pipe;
+   devolve o tamanho final, ou 0 se nao e' pipe */
+static long ajustaPipe(int iFd, size_t uTamanho)
+{
+
+    struct stat sStat;
+
+    if (fstat(iFd, &sStat) != 0 || !S_ISFIFO(sStat.st_mode))
+        return 0;
+    fcntl(iFd, F_SETPIPE_SZ, (int)uTamanho); /* Pode passar do limite do sistema; fica o que der */
+    return fcntl(iFd, F_GETPIPE_SZ);
+}
+
+int main(int argc, char ** argv)
+{
+
+    LADSPA_Descriptor_Function fDescritor;
+    const LADSPA_Descriptor * psDescritor;
+    HostInstance sInstancia;
+    const char * pcLabel;
+    const char * apcControles[MAX_CONTROLES];
+    char * pcIgual;
+    LADSPA_Data afControles[MAX_CONTROLES];
+    long alControles[MAX_CONTROLES];
+    unsigned long alEntradas[2];
+    unsigned long lEntradas;
+    unsigned long lSaida;
+    unsigned long lPorta;
+    unsigned long lBloco;
+    unsigned long lQuadros;
+    unsigned long long ullAmostras;
+    unsigned char * pucEntrada;
+    unsigned char * apucSaidas[MAX_ANEL];
+    size_t uQuadro;
+    size_t uSaida;
+    ssize_t lLidos;
+    long lPipe;
+    unsigned int uTaxa;
+    unsigned int uFormato;
+    unsigned int uBits;
+    int iControles;
+    int iSplice;
+    int iAnel;
+    int iBuffer;
+    int iSimd;
+    int iOpcao;
+    int iOk;
+    double dInicio;
+    double dTempo;
+
+    pcLabel = NULL;
+    lBloco = 16384;
+    uTaxa = 16000;
+    uFormato = PCM_INT;
+    uBits = 16;
+    iControles = 0;
+    iSplice = 0;
+
+    while ((iOpcao = getopt(argc, argv, "l:b:r:f:c:z")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'l':
+            pcLabel = optarg;
+            break;
+        case 'b':
+            lBloco = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            uTaxa = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            if (strcmp(optarg, "f32") == 0)
+            {
+                uFormato = PCM_FLOAT;
+                uBits = 32;
+            }
+            else if (strcmp(optarg, "s16") == 0 || strcmp(optarg, "s24") == 0)
+            {
+                uFormato = PCM_INT;
+                uBits = optarg[1] == '1' ? 16 : 24;
+            }
+            else
+            {
+                fprintf(stderr, "formato invalido: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'c':
+            pcIgual = strrchr(optarg, '=');
+            if (pcIgual == NULL || iControles == MAX_CONTROLES)
+            {
+                fprintf(stderr, "controle invalido: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            *pcIgual = '\0';
+            apcControles[iControles] = optarg;
+            afControles[iControles] = (LADSPA_Data)atof(pcIgual + 1);
+            iControles++;
+            break;
+        case 'z':
+            iSplice = 1;
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 1 || lBloco == 0 || lBloco > (1UL << 24) || uTaxa == 0)
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+
+    fDescritor = hostOpen(argv[optind]);
+    psDescritor = fDescritor != NULL ? hostFind(fDescritor, pcLabel) : NULL;
+    if (psDescritor == NULL)
+        return EXIT_FAILURE;
+
+    /* Entradas de audio na ordem das portas: d(n), x(n) */
+    lEntradas = 0;
+    lSaida = psDescritor->PortCount;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+    {
+        if (!LADSPA_IS_PORT_AUDIO(psDescritor->PortDescriptors[lPorta]))
+            continue;
+        if (LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]) && lEntradas < 2)
+            alEntradas[lEntradas++] = lPorta;
+        else if (LADSPA_IS_PORT_OUTPUT(psDescritor->PortDescriptors[lPorta]) && lSaida == psDescritor->PortCount)
+            lSaida = lPorta;
+    }
+    if (lEntradas != 2 || lSaida == psDescritor->PortCount)
+    {
+        fprintf(stderr, "%s: precisa de duas entradas e uma saida de audio.\n", psDescritor->Label);
+        return EXIT_FAILURE;
+    }
+    for (iOpcao = 0; iOpcao < iControles; iOpcao++)
+    {
+        alControles[iOpcao] = hostFindPort(psDescritor, apcControles[iOpcao]);
+        if (alControles[iOpcao] < 0)
+        {
+            fprintf(stderr, "%s: nao ha porta \"%s\".\n", psDescritor->Label, apcControles[iOpcao]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!hostInstantiate(&sInstancia, psDescritor, uTaxa, lBloco))
+        return EXIT_FAILURE;
+    for (iOpcao = 0; iOpcao < iControles; iOpcao++)
+        sInstancia.m_pfControls[alControles[iOpcao]] = afControles[iOpcao];
+    hostActivate(&sInstancia);
+
+    /* Buffers de saida em paginas inteiras, para que o vmsplice() de um
+       nao divida pagina com o seguinte */
+    uQuadro = uBits / 8;
+    uSaida = (lBloco * uQuadro + PAGINA - 1) / PAGINA * PAGINA;
+    ajustaPipe(STDIN_FILENO, lBloco * 2 * uQuadro);
+    lPipe = ajustaPipe(STDOUT_FILENO, uSaida);
+    iSplice = iSplice && lPipe > 0;
+    iAnel = 1;
+    if (iSplice)
+    {
+        iAnel = 1 + (int)((lPipe + uSaida - 1) / uSaida);
+        if (iAnel > MAX_ANEL)
+        {
+            fputs("pipe de saida grande demais para -z; usando write().\n", stderr);
+            iSplice = 0;
+            iAnel = 1;
+        }
+    }
+    pucEntrada = (unsigned char *)malloc(lBloco * 2 * uQuadro);
+    if (pucEntrada == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    for (iBuffer = 0; iBuffer < iAnel; iBuffer++)
+    {
+        if (posix_memalign((void **)&apucSaidas[iBuffer], PAGINA, uSaida) != 0)
+        {
+            fputs("Out of memory.\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    iSimd = simdLevel();
+    ullAmostras = 0;
+    iBuffer = 0;
+    iOk = 1;
+    dInicio = hostSeconds();
+    for (;;)
+    {
+        lLidos = leTudo(STDIN_FILENO, pucEntrada, lBloco * 2 * uQuadro);
+        if (lLidos < 0)
+        {
+            perror("entrada");
+            iOk = 0;
+            break;
+        }
+        lQuadros = (unsigned long)lLidos / (2 * uQuadro);
+        if (lQuadros == 0)
+            break;
+
+        pcmRead(pucEntrada, uFormato, uBits, 2, 1, lQuadros, sInstancia.m_ppfBuffers[alEntradas[0]], iSimd);
+        pcmRead(pucEntrada, uFormato, uBits, 2, 0, lQuadros, sInstancia.m_ppfBuffers[alEntradas[1]], iSimd);
+        hostRun(&sInstancia, lQuadros);
+        pcmWrite(sInstancia.m_ppfBuffers[lSaida], lQuadros, uFormato, uBits, apucSaidas[iBuffer], iSimd);
+        if (!escreveTudo(STDOUT_FILENO, apucSaidas[iBuffer], lQuadros * uQuadro, iSplice))
+        {
+            perror("saida");
+            iOk = 0;
+            break;
+        }
+        iBuffer = (iBuffer + 1) % iAnel;
+        ullAmostras += lQuadros;
+        if ((size_t)lLidos < lBloco * 2 * uQuadro)
+            break;
+    }
+    dTempo = hostSeconds() - dInicio;
+
+    if (iOk && lLidos > 0 && (size_t)lLidos % (2 * uQuadro) != 0)
+        fputs("quadro incompleto no fim da entrada descartado.\n", stderr);
+    fprintf(stderr, "%s: %llu amostras (%.1f s a %u Hz) em %.2f s, %.0fx tempo real%s\n", psDescritor->Label, ullAmostras,
+            (double)ullAmostras / uTaxa, uTaxa, dTempo, dTempo > 0 ? (double)ullAmostras / uTaxa / dTempo : 0.0,
+            iSplice ? " (vmsplice)" : "");
+
+    hostCleanup(&sInstancia);
+    free(pucEntrada);
+    for (iBuffer = 0; iBuffer < iAnel; iBuffer++)
+        free(apucSaidas[iBuffer]);
+    return iOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*****************************************************************************/
+
+/* EOF */
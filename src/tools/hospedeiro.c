@@ -0,0 +1,381 @@
+/* hospedeiro.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Host LADSPA de linha de comando (veja hospedeiro.h). Para cada
+   descritor das bibliotecas dadas:
+
+     1. confere o descritor e as dicas das portas;
+     2. instancia duas vezes e roda o mesmo sinal (ruido nas entradas de
+        audio, d(n) com eco de x(n) quando ha duas entradas) com blocos
+        fixos de -b amostras e com uma sequencia aleatoria de tamanhos
+        entre 1 e -b (semente -s);
+     3. confere que as saidas de audio e de controle sao finitas e
+        compara as saidas de audio das duas rodadas: um plugin que
+        processa amostra a amostra nao deveria depender do bloco.
+
+   Com -t, imprime o custo de cada rodada (ns por amostra e o pior
+   run()). -c "nome=valor" muda uma porta de controle (pode repetir).
+   Sai com erro se algum descritor for invalido, nao instanciar ou gerar
+   NaN/Inf; depender do bloco e' so um aviso.
+
+   Uso: hospedeiro [-r taxa] [-b bloco] [-n amostras] [-s semente]
+                   [-l label] [-c porta=valor]... [-t] <plugin.so>... */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ladspa.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define MAX_CONTROLES 32
+
+#define USO "Uso: hospedeiro [-r taxa] [-b bloco] [-n amostras] [-s semente] [-l label] [-c porta=valor]... [-t] <plugin.so>...\n"
+
+/*****************************************************************************/
+
+/* Controles pedidos na linha de comando */
+static const char * g_apcControles[MAX_CONTROLES];
+static LADSPA_Data g_afControles[MAX_CONTROLES];
+static int g_iControles = 0;
+
+static void leControle(const char * pcTexto)
+{
+
+    char * pcNome;
+    char * pcIgual;
+
+    pcNome = strdup(pcTexto);
+    pcIgual = pcNome != NULL ? strrchr(pcNome, '=') : NULL;
+    if (pcIgual == NULL || g_iControles == MAX_CONTROLES)
+    {
+        fprintf(stderr, "controle invalido: %s\n", pcTexto);
+        exit(EXIT_FAILURE);
+    }
+    *pcIgual = '\0';
+    g_apcControles[g_iControles] = pcNome;
+    g_afControles[g_iControles] = (LADSPA_Data)atof(pcIgual + 1);
+    g_iControles++;
+}
+
+/*****************************************************************************/
+
+/* lCanais buffers zerados de lAmostras */
+static float ** alocaCanais(unsigned long lCanais, unsigned long lAmostras)
+{
+
+    float ** ppfCanais;
+    unsigned long lCanal;
+
+    ppfCanais = (float **)calloc(lCanais + 1, sizeof(float *));
+    if (ppfCanais == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    for (lCanal = 0; lCanal < lCanais; lCanal++)
+    {
+        ppfCanais[lCanal] = (float *)calloc(lAmostras + 1, sizeof(float));
+        if (ppfCanais[lCanal] == NULL)
+        {
+            fputs("Out of memory.\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return ppfCanais;
+}
+
+static void liberaCanais(float ** ppfCanais, unsigned long lCanais)
+{
+
+    unsigned long lCanal;
+
+    for (lCanal = 0; lCanal < lCanais; lCanal++)
+        free(ppfCanais[lCanal]);
+    free(ppfCanais);
+}
+
+/* Uma entrada por porta de audio de entrada, lAmostras cada. Com duas
+   entradas, a primeira e' d(n) = eco de x(n) + ruido, a segunda x(n). */
+static float ** geraEntradas(unsigned long lEntradas, unsigned long lAmostras)
+{
+
+    float ** ppfEntradas;
+    unsigned long lEntrada;
+    unsigned long lIndex;
+    unsigned long lSemente;
+    float fCor;
+
+    ppfEntradas = alocaCanais(lEntradas, lAmostras);
+    for (lEntrada = 0; lEntrada < lEntradas; lEntrada++)
+    {
+        lSemente = 1 + lEntrada;
+        fCor = 0;
+        for (lIndex = 0; lIndex < lAmostras; lIndex++)
+        {
+            fCor = 0.9f * fCor + hostNoise(&lSemente);
+            ppfEntradas[lEntrada][lIndex] = 0.3f * fCor;
+        }
+    }
+
+    if (lEntradas == 2)
+        for (lIndex = lAmostras; lIndex-- > 0;)
+            ppfEntradas[0][lIndex] = 0.01f * ppfEntradas[0][lIndex]
+                                     + (lIndex >= 40 ? 0.5f * ppfEntradas[1][lIndex - 40] : 0)
+                                     + (lIndex >= 90 ? -0.25f * ppfEntradas[1][lIndex - 90] : 0);
+
+    return ppfEntradas;
+}
+
+/*****************************************************************************/
+
+/* Roda o descritor sobre as entradas, com blocos fixos (plSemente NULL)
+   ou aleatorios, copiando as entradas e saidas para os buffers do host.
+   Devolve o numero de valores nao finitos nas saidas. */
+static unsigned long roda(HostInstance * psInstancia, float ** ppfEntradas, float ** ppfSaidas,
+                          unsigned long lAmostras, unsigned long lBloco, unsigned long * plSemente)
+{
+
+    const LADSPA_Descriptor * psDescritor;
+    unsigned long lPorta;
+    unsigned long lEntrada;
+    unsigned long lSaida;
+    unsigned long lInicio;
+    unsigned long lTamanho;
+    unsigned long lIndex;
+    unsigned long lNaoFinitos;
+
+    psDescritor = psInstancia->m_psDescriptor;
+    lNaoFinitos = 0;
+    for (lInicio = 0; lInicio < lAmostras; lInicio += lTamanho)
+    {
+        lTamanho = plSemente != NULL ? hostBlockSize(plSemente, lBloco) : lBloco;
+        if (lTamanho > lAmostras - lInicio)
+            lTamanho = lAmostras - lInicio;
+
+        lEntrada = 0;
+        for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+            if (LADSPA_IS_PORT_AUDIO(psDescritor->PortDescriptors[lPorta]) && LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]))
+                memcpy(psInstancia->m_ppfBuffers[lPorta], ppfEntradas[lEntrada++] + lInicio, lTamanho * sizeof(float));
+
+        hostRun(psInstancia, lTamanho);
+
+        lSaida = 0;
+        for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+        {
+            if (!LADSPA_IS_PORT_OUTPUT(psDescritor->PortDescriptors[lPorta]))
+                continue;
+            if (LADSPA_IS_PORT_CONTROL(psDescritor->PortDescriptors[lPorta]))
+            {
+                if (!isfinite(psInstancia->m_pfControls[lPorta]))
+                    lNaoFinitos++;
+                continue;
+            }
+            memcpy(ppfSaidas[lSaida] + lInicio, psInstancia->m_ppfBuffers[lPorta], lTamanho * sizeof(float));
+            for (lIndex = 0; lIndex < lTamanho; lIndex++)
+                if (!isfinite(ppfSaidas[lSaida][lInicio + lIndex]))
+                    lNaoFinitos++;
+            lSaida++;
+        }
+    }
+    return lNaoFinitos;
+}
+
+static void imprimeTempo(const char * pcRodada, const HostInstance * psInstancia)
+{
+    if (psInstancia->m_lSamples == 0)
+        return;
+    printf("  %-10s %8.1f ns/amostra, %lu chamadas, pior run() %.1f us\n", pcRodada,
+           psInstancia->m_dSeconds * 1e9 / psInstancia->m_lSamples, psInstancia->m_lCalls, psInstancia->m_dWorst * 1e6);
+}
+
+/* Testa um descritor; devolve o numero de falhas */
+static int testa(const LADSPA_Descriptor * psDescritor, unsigned long lTaxa, unsigned long lBloco,
+                 unsigned long lAmostras, unsigned long lSemente, int iTempo)
+{
+
+    HostInstance sFixo;
+    HostInstance sAleatorio;
+    float ** ppfEntradas;
+    float ** ppfFixo;
+    float ** ppfAleatorio;
+    unsigned long lEntradas;
+    unsigned long lSaidas;
+    unsigned long lSaida;
+    unsigned long lIndex;
+    unsigned long lNaoFinitos;
+    unsigned long lPrimeira;
+    long lPorta;
+    double dMaior;
+    int iControle;
+    int iFalhas;
+
+    printf("%s (%lu): %s\n", psDescritor->Label, psDescritor->UniqueID, psDescritor->Name);
+    iFalhas = hostValidate(psDescritor, stdout);
+    if (iFalhas)
+        return iFalhas;
+
+    if (!hostInstantiate(&sFixo, psDescritor, lTaxa, lBloco))
+        return 1;
+    if (!hostInstantiate(&sAleatorio, psDescritor, lTaxa, lBloco))
+    {
+        hostCleanup(&sFixo);
+        return 1;
+    }
+    for (iControle = 0; iControle < g_iControles; iControle++)
+    {
+        lPorta = hostFindPort(psDescritor, g_apcControles[iControle]);
+        if (lPorta < 0)
+            continue;
+        sFixo.m_pfControls[lPorta] = g_afControles[iControle];
+        sAleatorio.m_pfControls[lPorta] = g_afControles[iControle];
+    }
+    sFixo.m_iTiming = iTempo;
+    sAleatorio.m_iTiming = iTempo;
+
+    lEntradas = hostCountPorts(psDescritor, LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO);
+    lSaidas = hostCountPorts(psDescritor, LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO);
+    ppfEntradas = geraEntradas(lEntradas, lAmostras);
+    ppfFixo = alocaCanais(lSaidas, lAmostras);
+    ppfAleatorio = alocaCanais(lSaidas, lAmostras);
+
+    hostActivate(&sFixo);
+    hostActivate(&sAleatorio);
+    lNaoFinitos = roda(&sFixo, ppfEntradas, ppfFixo, lAmostras, lBloco, NULL);
+    lNaoFinitos += roda(&sAleatorio, ppfEntradas, ppfAleatorio, lAmostras, lBloco, &lSemente);
+    if (lNaoFinitos)
+    {
+        printf("  erro: %lu valores nao finitos nas saidas\n", lNaoFinitos);
+        iFalhas++;
+    }
+
+    dMaior = 0;
+    lPrimeira = lAmostras;
+    for (lSaida = 0; lSaida < lSaidas; lSaida++)
+        for (lIndex = 0; lIndex < lAmostras; lIndex++)
+            if (ppfFixo[lSaida][lIndex] != ppfAleatorio[lSaida][lIndex])
+            {
+                if (lIndex < lPrimeira)
+                    lPrimeira = lIndex;
+                if (fabs((double)ppfFixo[lSaida][lIndex] - ppfAleatorio[lSaida][lIndex]) > dMaior)
+                    dMaior = fabs((double)ppfFixo[lSaida][lIndex] - ppfAleatorio[lSaida][lIndex]);
+            }
+    if (lPrimeira < lAmostras)
+        printf("  aviso: a saida depende do bloco (a partir da amostra %lu, maior diferenca %.3g)\n", lPrimeira, dMaior);
+    else
+        printf("  ok: %lu amostras, mesma saida com blocos de %lu e aleatorios\n", lAmostras, lBloco);
+
+    if (iTempo)
+    {
+        imprimeTempo("fixo", &sFixo);
+        imprimeTempo("aleatorio", &sAleatorio);
+    }
+
+    hostCleanup(&sFixo);
+    hostCleanup(&sAleatorio);
+    liberaCanais(ppfEntradas, lEntradas);
+    liberaCanais(ppfFixo, lSaidas);
+    liberaCanais(ppfAleatorio, lSaidas);
+
+    return iFalhas;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    LADSPA_Descriptor_Function fDescritor;
+    const LADSPA_Descriptor * psDescritor;
+    const char * pcLabel;
+    unsigned long lTaxa;
+    unsigned long lBloco;
+    unsigned long lAmostras;
+    unsigned long lSemente;
+    unsigned long lDescritor;
+    int iTempo;
+    int iOpcao;
+    int iArquivo;
+    int iFalhas;
+
+    lTaxa = 16000;
+    lBloco = 512;
+    lAmostras = 0;
+    lSemente = 1;
+    pcLabel = NULL;
+    iTempo = 0;
+
+    while ((iOpcao = getopt(argc, argv, "r:b:n:s:l:c:t")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'r':
+            lTaxa = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            lBloco = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            lAmostras = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            lSemente = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            pcLabel = optarg;
+            break;
+        case 'c':
+            leControle(optarg);
+            break;
+        case 't':
+            iTempo = 1;
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || lTaxa == 0 || lBloco == 0)
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+    if (lAmostras == 0)
+        lAmostras = lTaxa;
+
+    iFalhas = 0;
+    for (iArquivo = optind; iArquivo < argc; iArquivo++)
+    {
+        fDescritor = hostOpen(argv[iArquivo]);
+        if (fDescritor == NULL)
+        {
+            iFalhas++;
+            continue;
+        }
+
+        if (pcLabel != NULL)
+        {
+            psDescritor = hostFind(fDescritor, pcLabel);
+            if (psDescritor != NULL)
+                iFalhas += testa(psDescritor, lTaxa, lBloco, lAmostras, lSemente, iTempo);
+            continue;
+        }
+        for (lDescritor = 0; (psDescritor = fDescritor(lDescritor)) != NULL; lDescritor++)
+            iFalhas += testa(psDescritor, lTaxa, lBloco, lAmostras, lSemente, iTempo);
+    }
+
+    printf("%d falhas\n", iFalhas);
+    return iFalhas ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+/* EOF */
@@ -0,0 +1,1187 @@
+/* lote.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Processa gravacoes de chamadas offline, sem host de audio nem
+   servidor de som: mapeia o microfone (d(n)) e o lado remoto (x(n)) na
+   memoria, roda um descritor em blocos grandes e grava e(n) num arquivo
+   de saida tambem mapeado (veja wav.h).
+
+   Quando a entrada ja e' float mono (WAV float de 32 bits ou bruto
+   .f32/.raw), as portas do plugin apontam direto para o mapa, sem copia.
+   Entradas em PCM (16, 24 ou 32 bits, WAV ou bruto .s16/.s24) ou com
+   mais de um canal sao convertidas bloco a bloco por pcm.h, que separa o
+   canal e escala numa so passada vetorizada. "arquivo.wav:N" escolhe o
+   canal N (a partir de 0), o que permite usar uma gravacao estereo com o
+   microfone num canal e o remoto no outro.
+
+   A saida float aponta direto para o arquivo de saida. Com -f s16 ou
+   -f s24 (ou saida bruta .s16/.s24) o plugin escreve num buffer da
+   instancia e cada bloco e' convertido para PCM, com saturacao e
+   arredondamento, direto no arquivo.
+
+   Se os arquivos tiverem tamanhos diferentes, processa o menor. Os
+   controles ficam no valor padrao do descritor, menos os dados com -c
+   "nome=valor" (pode repetir). No fim imprime a duracao, o tempo e
+   quantas vezes o tempo real a chamada foi processada.
+
+   Com -m, processa um corpus: cada linha do manifesto tem as entradas e
+   a saida de uma chamada ("microfone remoto saida", separados por
+   espacos; linhas vazias e comecadas por # sao puladas). As chamadas sao
+   divididas entre -j threads (padrao: uma por nucleo), cada uma com a
+   sua instancia do plugin, reusada de uma chamada para a outra com
+   deactivate()/activate(). Cada thread comeca com uma faixa contigua do
+   manifesto e, quando acaba a sua, rouba chamadas do fim da faixa das
+   outras, de modo que chamadas longas nao deixam nucleos parados. Como
+   cada chamada comeca de uma instancia recem ativada, as saidas nao
+   dependem do numero de threads nem da ordem em que as chamadas saem.
+
+   Com -s N, os arquivos nao sao mapeados, e sim lidos e escritos em
+   fluxo pelo io_uring (veja fluxo.h): ate N blocos ficam em andamento,
+   com as leituras adiantadas e as escritas atrasadas em relacao ao
+   plugin, e a memoria usada nao depende do tamanho das chamadas. Serve
+   para discos lentos ou de rede, onde as faltas de pagina do mapa param
+   o processamento. No fim sai quanto tempo foi gasto esperando leituras,
+   processando e esperando escritas, o que diz se o gargalo e' a E/S ou o
+   plugin.
+
+   Uso: lote [-l label] [-b bloco] [-r taxa dos brutos] [-c porta=valor]...
+             [-s blocos] [-f f32|s16|s24] [-o saida.wav|.f32|.s16|.s24]
+             <plugin.so> <microfone> [remoto]
+        lote [-l label] [-b bloco] [-r taxa dos brutos] [-c porta=valor]...
+             [-s blocos] [-f f32|s16|s24] -m manifesto [-j threads] <plugin.so> */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "ladspa.h"
+#include "hospedeiro.h"
+#include "wav.h"
+#include "fluxo.h"
+
+/*****************************************************************************/
+
+#define MAX_CONTROLES 32
+
+#define MAX_THREADS 256
+
+#define MAX_FATIAS 16
+
+/* Quanto do comeco de um WAV e' lido para achar o bloco data no fluxo */
+#define CABECALHO_FLUXO 65536
+
+#define USO "Uso: lote [-l label] [-b bloco] [-r taxa dos brutos] [-c porta=valor]... [-s blocos] [-f f32|s16|s24] [-o saida.wav|.f32|.s16|.s24] <plugin.so> <microfone> [remoto]\n" \
+            "     lote [-l label] [-b bloco] [-r taxa dos brutos] [-c porta=valor]... [-s blocos] [-f f32|s16|s24] -m manifesto [-j threads] <plugin.so>\n"
+
+/*****************************************************************************/
+
+/* Uma entrada, mapeada ou (com -s) lida em fluxo */
+typedef struct
+{
+
+    const void * m_pvMapa;
+
+    size_t m_lTamanho;
+
+    WavInfo m_sInfo;
+
+    unsigned int m_uCanal;
+
+    int m_iFd; /* So no fluxo; m_sInfo.m_pucData fica NULL */
+
+    unsigned long long m_ullDados; /* Posicao do primeiro quadro no arquivo */
+
+} Entrada;
+
+/* Uma leitura ou escrita em andamento no fluxo */
+typedef struct
+{
+
+    int m_iFd;
+
+    int m_iEscrita;
+
+    unsigned char * m_pucBuffer;
+
+    unsigned int m_uTamanho;
+
+    unsigned int m_uFeito;
+
+    unsigned long long m_ullPosicao;
+
+} Operacao;
+
+/* Um bloco do fluxo: as entradas cruas como estao no arquivo e a saida.
+   As operacoes 0 e 1 sao as leituras das entradas, a 2 a escrita. */
+typedef struct
+{
+
+    unsigned char * m_apucEntradas[2];
+
+    unsigned char * m_pucSaida;
+
+    Operacao m_asOperacoes[3];
+
+    int m_iLeituras; /* Leituras pendentes */
+
+    int m_iEscrita; /* Escrita pendente */
+
+} Fatia;
+
+/* Uma chamada: entradas, saida e o resultado */
+typedef struct
+{
+
+    char * m_apcEntradas[2];
+
+    char * m_pcSaida;
+
+    unsigned long m_lAmostras;
+
+    unsigned int m_uTaxa;
+
+    int m_iOk;
+
+} Tarefa;
+
+/* O que e' comum a todas as threads */
+typedef struct
+{
+
+    const LADSPA_Descriptor * m_psDescritor;
+
+    unsigned long m_alEntradas[2];
+
+    unsigned long m_lEntradas;
+
+    unsigned long m_lSaida;
+
+    unsigned long m_lBloco;
+
+    unsigned int m_uTaxaBruto;
+
+    int m_iFatias; /* Blocos em andamento no fluxo; 0: arquivos mapeados */
+
+    unsigned int m_uFormato; /* Formato das saidas WAV (-f) */
+
+    unsigned int m_uBits;
+
+    int m_iSimd; /* Nivel de simd.h da conversao das saidas */
+
+    long m_alControles[MAX_CONTROLES];
+
+    LADSPA_Data m_afControles[MAX_CONTROLES];
+
+    int m_iControles;
+
+    Tarefa * m_psTarefas;
+
+    struct Trabalhador * m_psTrabalhadores;
+
+    int m_iTrabalhadores;
+
+} Lote;
+
+/* Uma thread: a faixa [m_iInicio, m_iFim) de tarefas que ainda sao dela
+   e a instancia do plugin */
+typedef struct Trabalhador
+{
+
+    pthread_t m_sThread;
+
+    pthread_mutex_t m_sTrava;
+
+    int m_iInicio;
+
+    int m_iFim;
+
+    Lote * m_psLote;
+
+    HostInstance m_sInstancia;
+
+    int m_iInstanciado;
+
+    int m_iIndice;
+
+    Stream m_sFluxo;
+
+    int m_iUring; /* O fluxo conseguiu um io_uring */
+
+    /* Contadores das etapas do fluxo */
+    double m_dEsperaLeitura;
+
+    double m_dProcessamento;
+
+    double m_dEsperaEscrita;
+
+    double m_dSubmissao; /* Pedidos: com dados em cache (ou sem io_uring) a copia e' feita aqui */
+
+    unsigned long long m_ullLidos;
+
+    unsigned long long m_ullEscritos;
+
+} Trabalhador;
+
+/*****************************************************************************/
+
+/* Extensao que indica arquivo bruto mono, e o formato dele: .f32 ou .raw
+   (float de 32 bits), .s16 ou .s24 (inteiros) */
+static int bruto(const char * pcArquivo, unsigned int * puFormato, unsigned int * puBits)
+{
+
+    const char * pcPonto;
+
+    pcPonto = strrchr(pcArquivo, '.');
+    if (pcPonto == NULL)
+        return 0;
+    if (strcmp(pcPonto, ".f32") == 0 || strcmp(pcPonto, ".raw") == 0)
+    {
+        *puFormato = PCM_FLOAT;
+        *puBits = 32;
+        return 1;
+    }
+    if (strcmp(pcPonto, ".s16") == 0 || strcmp(pcPonto, ".s24") == 0)
+    {
+        *puFormato = PCM_INT;
+        *puBits = pcPonto[2] == '1' ? 16 : 24;
+        return 1;
+    }
+    return 0;
+}
+
+/* Formato da saida de uma chamada: o da extensao, se for bruta, senao
+   o de -f */
+static int formatoSaida(const Lote * psLote, const char * pcSaida, unsigned int * puFormato, unsigned int * puBits)
+{
+    if (bruto(pcSaida, puFormato, puBits))
+        return 1;
+    *puFormato = psLote->m_uFormato;
+    *puBits = psLote->m_uBits;
+    return 0;
+}
+
+/* Separa "arquivo[:canal]" */
+static void separaCanal(const char * pcTexto, char * pcArquivo, size_t lArquivo, unsigned int * puCanal)
+{
+
+    char * pcDoisPontos;
+
+    snprintf(pcArquivo, lArquivo, "%s", pcTexto);
+    *puCanal = 0;
+    pcDoisPontos = strrchr(pcArquivo, ':');
+    if (pcDoisPontos != NULL && pcDoisPontos[1] >= '0' && pcDoisPontos[1] <= '9')
+    {
+        *puCanal = (unsigned int)strtoul(pcDoisPontos + 1, NULL, 10);
+        *pcDoisPontos = '\0';
+    }
+}
+
+/* Abre "arquivo[:canal]" */
+static int abre(Entrada * psEntrada, const char * pcTexto, unsigned int uTaxaBruto)
+{
+
+    char acArquivo[4096];
+    const char * pcErro;
+    unsigned int uFormato;
+    unsigned int uBits;
+
+    separaCanal(pcTexto, acArquivo, sizeof(acArquivo), &psEntrada->m_uCanal);
+    psEntrada->m_iFd = -1;
+    psEntrada->m_pvMapa = wavMap(acArquivo, &psEntrada->m_lTamanho);
+    if (psEntrada->m_pvMapa == NULL)
+        return 0;
+
+    if (bruto(acArquivo, &uFormato, &uBits))
+    {
+        wavRaw(psEntrada->m_pvMapa, psEntrada->m_lTamanho, uTaxaBruto, uFormato, uBits, &psEntrada->m_sInfo);
+    }
+    else if ((pcErro = wavParse(psEntrada->m_pvMapa, psEntrada->m_lTamanho, &psEntrada->m_sInfo)) != NULL)
+    {
+        fprintf(stderr, "%s: %s.\n", acArquivo, pcErro);
+        wavUnmap(psEntrada->m_pvMapa, psEntrada->m_lTamanho);
+        return 0;
+    }
+    if (psEntrada->m_uCanal >= psEntrada->m_sInfo.m_uChannels)
+    {
+        fprintf(stderr, "%s: nao ha canal %u.\n", acArquivo, psEntrada->m_uCanal);
+        wavUnmap(psEntrada->m_pvMapa, psEntrada->m_lTamanho);
+        return 0;
+    }
+    return 1;
+}
+
+/* Abre "arquivo[:canal]" para ler em fluxo: so o cabecalho e' lido
+   agora, para achar o formato e onde comecam as amostras */
+static int abreFluxo(Entrada * psEntrada, const char * pcTexto, unsigned int uTaxaBruto)
+{
+
+    char acArquivo[4096];
+    unsigned char * pucCabecalho;
+    const char * pcErro;
+    struct stat sStat;
+    ssize_t lLidos;
+    unsigned int uFormato;
+    unsigned int uBits;
+
+    separaCanal(pcTexto, acArquivo, sizeof(acArquivo), &psEntrada->m_uCanal);
+    psEntrada->m_pvMapa = NULL;
+    psEntrada->m_iFd = open(acArquivo, O_RDONLY);
+    if (psEntrada->m_iFd < 0 || fstat(psEntrada->m_iFd, &sStat) != 0)
+    {
+        perror(acArquivo);
+        if (psEntrada->m_iFd >= 0)
+            close(psEntrada->m_iFd);
+        return 0;
+    }
+    posix_fadvise(psEntrada->m_iFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (bruto(acArquivo, &uFormato, &uBits))
+    {
+        wavRaw(NULL, (size_t)sStat.st_size, uTaxaBruto, uFormato, uBits, &psEntrada->m_sInfo);
+        psEntrada->m_ullDados = 0;
+    }
+    else
+    {
+        pucCabecalho = (unsigned char *)malloc(CABECALHO_FLUXO);
+        if (pucCabecalho == NULL)
+        {
+            fputs("Out of memory.\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+        lLidos = pread(psEntrada->m_iFd, pucCabecalho, CABECALHO_FLUXO, 0);
+        pcErro = lLidos < 0 ? "erro de leitura"
+               : wavParseHead(pucCabecalho, (size_t)lLidos, (unsigned long long)sStat.st_size, &psEntrada->m_sInfo);
+        if (pcErro == NULL)
+            psEntrada->m_ullDados = (unsigned long long)(psEntrada->m_sInfo.m_pucData - pucCabecalho);
+        psEntrada->m_sInfo.m_pucData = NULL;
+        free(pucCabecalho);
+        if (pcErro != NULL)
+        {
+            fprintf(stderr, "%s: %s.\n", acArquivo, pcErro);
+            close(psEntrada->m_iFd);
+            return 0;
+        }
+    }
+    if (psEntrada->m_uCanal >= psEntrada->m_sInfo.m_uChannels)
+    {
+        fprintf(stderr, "%s: nao ha canal %u.\n", acArquivo, psEntrada->m_uCanal);
+        close(psEntrada->m_iFd);
+        return 0;
+    }
+    return 1;
+}
+
+/* Conecta a porta ao trecho [lInicio, lInicio + lTamanho) da entrada,
+   direto no mapa quando da, senao convertendo no buffer do host */
+static void conecta(HostInstance * psInstancia, unsigned long lPorta, const Entrada * psEntrada,
+                    unsigned long lInicio, unsigned long lTamanho)
+{
+
+    const float * pfDireto;
+
+    pfDireto = wavDirect(&psEntrada->m_sInfo, psEntrada->m_uCanal, lInicio);
+    if (pfDireto == NULL)
+    {
+        wavRead(&psEntrada->m_sInfo, psEntrada->m_uCanal, lInicio, lTamanho, psInstancia->m_ppfBuffers[lPorta]);
+        pfDireto = psInstancia->m_ppfBuffers[lPorta];
+    }
+    psInstancia->m_psDescriptor->connect_port(psInstancia->m_hHandle, lPorta, (LADSPA_Data *)pfDireto);
+}
+
+/* Deixa a instancia da thread pronta para uma chamada a uTaxa Hz:
+   instancia na primeira vez (ou se a taxa mudou), senao so reativa */
+static int prepara(Trabalhador * psTrabalhador, unsigned int uTaxa)
+{
+
+    Lote * psLote;
+    HostInstance * psInstancia;
+    int iControle;
+
+    psLote = psTrabalhador->m_psLote;
+    psInstancia = &psTrabalhador->m_sInstancia;
+    if (psTrabalhador->m_iInstanciado && psInstancia->m_lSampleRate == uTaxa)
+    {
+        hostReset(psInstancia);
+        return 1;
+    }
+
+    if (psTrabalhador->m_iInstanciado)
+        hostCleanup(psInstancia);
+    psTrabalhador->m_iInstanciado = hostInstantiate(psInstancia, psLote->m_psDescritor, uTaxa, psLote->m_lBloco);
+    if (!psTrabalhador->m_iInstanciado)
+        return 0;
+    for (iControle = 0; iControle < psLote->m_iControles; iControle++)
+        psInstancia->m_pfControls[psLote->m_alControles[iControle]] = psLote->m_afControles[iControle];
+    hostActivate(psInstancia);
+    return 1;
+}
+
+/* Confere taxas e tamanhos das entradas de uma chamada; devolve quantas
+   amostras processar (0 se nao da) */
+static unsigned long confere(const Lote * psLote, const Tarefa * psTarefa, const Entrada * psEntradas)
+{
+
+    unsigned long lAmostras;
+
+    lAmostras = psEntradas[0].m_sInfo.m_lFrames;
+    if (psLote->m_lEntradas == 2)
+    {
+        if (psEntradas[1].m_sInfo.m_uSampleRate != psEntradas[0].m_sInfo.m_uSampleRate)
+        {
+            fprintf(stderr, "%s: taxas diferentes: %u e %u Hz.\n", psTarefa->m_pcSaida, psEntradas[0].m_sInfo.m_uSampleRate,
+                    psEntradas[1].m_sInfo.m_uSampleRate);
+            return 0;
+        }
+        if (psEntradas[1].m_sInfo.m_lFrames != lAmostras)
+        {
+            fprintf(stderr, "%s: aviso: %lu e %lu amostras; processando o menor.\n", psTarefa->m_pcSaida, lAmostras,
+                    psEntradas[1].m_sInfo.m_lFrames);
+            if (psEntradas[1].m_sInfo.m_lFrames < lAmostras)
+                lAmostras = psEntradas[1].m_sInfo.m_lFrames;
+        }
+    }
+    if (lAmostras == 0)
+        fprintf(stderr, "%s: nada para processar.\n", psTarefa->m_pcSaida);
+    return lAmostras;
+}
+
+/* Roda o plugin sobre as entradas ja abertas (e mapeadas) de uma chamada */
+static int roda(Trabalhador * psTrabalhador, Tarefa * psTarefa, const Entrada * psEntradas)
+{
+
+    Lote * psLote;
+    WavOutput sSaida;
+    unsigned long lEntrada;
+    unsigned long lAmostras;
+    unsigned long lInicio;
+    unsigned long lTamanho;
+    unsigned int uTaxa;
+    unsigned int uFormato;
+    unsigned int uBits;
+    int iBruto;
+    LADSPA_Data * pfTemporario;
+
+    psLote = psTrabalhador->m_psLote;
+    uTaxa = psEntradas[0].m_sInfo.m_uSampleRate;
+    lAmostras = confere(psLote, psTarefa, psEntradas);
+    if (lAmostras == 0)
+        return 0;
+
+    iBruto = formatoSaida(psLote, psTarefa->m_pcSaida, &uFormato, &uBits);
+    if (!prepara(psTrabalhador, uTaxa) || !wavCreate(psTarefa->m_pcSaida, uTaxa, lAmostras, iBruto, uFormato, uBits, &sSaida))
+        return 0;
+    /* Saida inteira: o plugin escreve no buffer da instancia e pcm.h converte */
+    pfTemporario = psTrabalhador->m_sInstancia.m_ppfBuffers[psLote->m_lSaida];
+
+    for (lInicio = 0; lInicio < lAmostras; lInicio += lTamanho)
+    {
+        lTamanho = lAmostras - lInicio < psLote->m_lBloco ? lAmostras - lInicio : psLote->m_lBloco;
+        for (lEntrada = 0; lEntrada < psLote->m_lEntradas; lEntrada++)
+            conecta(&psTrabalhador->m_sInstancia, psLote->m_alEntradas[lEntrada], &psEntradas[lEntrada], lInicio, lTamanho);
+        if (sSaida.m_pfData != NULL)
+        {
+            psLote->m_psDescritor->connect_port(psTrabalhador->m_sInstancia.m_hHandle, psLote->m_lSaida, sSaida.m_pfData + lInicio);
+            hostRun(&psTrabalhador->m_sInstancia, lTamanho);
+        }
+        else
+        {
+            psLote->m_psDescritor->connect_port(psTrabalhador->m_sInstancia.m_hHandle, psLote->m_lSaida, pfTemporario);
+            hostRun(&psTrabalhador->m_sInstancia, lTamanho);
+            pcmWrite(pfTemporario, lTamanho, uFormato, uBits, sSaida.m_pucData + lInicio * (uBits / 8), psLote->m_iSimd);
+        }
+    }
+
+    if (!wavClose(&sSaida))
+    {
+        perror(psTarefa->m_pcSaida);
+        return 0;
+    }
+    psTarefa->m_lAmostras = lAmostras;
+    psTarefa->m_uTaxa = uTaxa;
+    return 1;
+}
+
+/* Pede ao kernel a operacao iOp da fatia iFatia (ou o resto dela, se a
+   anterior foi curta) */
+static void pede(Trabalhador * psTrabalhador, Fatia * psFatias, int iFatia, int iOp)
+{
+
+    Operacao * psOperacao;
+
+    psOperacao = &psFatias[iFatia].m_asOperacoes[iOp];
+    if (psOperacao->m_iEscrita)
+        streamWrite(&psTrabalhador->m_sFluxo, psOperacao->m_iFd, psOperacao->m_pucBuffer + psOperacao->m_uFeito,
+                    psOperacao->m_uTamanho - psOperacao->m_uFeito, psOperacao->m_ullPosicao + psOperacao->m_uFeito,
+                    (unsigned long)(iFatia * 3 + iOp));
+    else
+        streamRead(&psTrabalhador->m_sFluxo, psOperacao->m_iFd, psOperacao->m_pucBuffer + psOperacao->m_uFeito,
+                   psOperacao->m_uTamanho - psOperacao->m_uFeito, psOperacao->m_ullPosicao + psOperacao->m_uFeito,
+                   (unsigned long)(iFatia * 3 + iOp));
+}
+
+/* Pede as leituras do bloco que comeca em lInicio para a fatia iFatia */
+static void pedeBloco(Trabalhador * psTrabalhador, Fatia * psFatias, int iFatia, const Entrada * psEntradas,
+                      unsigned long lInicio, unsigned long lTamanho)
+{
+
+    Operacao * psOperacao;
+    unsigned long lEntrada;
+    unsigned int uQuadro;
+
+    for (lEntrada = 0; lEntrada < psTrabalhador->m_psLote->m_lEntradas; lEntrada++)
+    {
+        uQuadro = psEntradas[lEntrada].m_sInfo.m_uChannels * (psEntradas[lEntrada].m_sInfo.m_uBits / 8);
+        psOperacao = &psFatias[iFatia].m_asOperacoes[lEntrada];
+        psOperacao->m_iFd = psEntradas[lEntrada].m_iFd;
+        psOperacao->m_iEscrita = 0;
+        psOperacao->m_pucBuffer = psFatias[iFatia].m_apucEntradas[lEntrada];
+        psOperacao->m_uTamanho = (unsigned int)(lTamanho * uQuadro);
+        psOperacao->m_uFeito = 0;
+        psOperacao->m_ullPosicao = psEntradas[lEntrada].m_ullDados + (unsigned long long)lInicio * uQuadro;
+        psFatias[iFatia].m_iLeituras++;
+        pede(psTrabalhador, psFatias, iFatia, (int)lEntrada);
+    }
+}
+
+/* Espera a proxima operacao terminar e atualiza a fatia dela. Devolve 0
+   se a operacao falhou (a fatia fica livre do mesmo jeito). */
+static int colhe(Trabalhador * psTrabalhador, Fatia * psFatias, const char * pcSaida)
+{
+
+    Operacao * psOperacao;
+    unsigned long lTag;
+    long lResultado;
+    int iFatia;
+
+    if (!streamWait(&psTrabalhador->m_sFluxo, &lTag, &lResultado))
+    {
+        perror("io_uring_enter");
+        exit(EXIT_FAILURE);
+    }
+    iFatia = (int)(lTag / 3);
+    psOperacao = &psFatias[iFatia].m_asOperacoes[lTag % 3];
+
+    if (lResultado > 0)
+    {
+        psOperacao->m_uFeito += (unsigned int)lResultado;
+        if (psOperacao->m_iEscrita)
+            psTrabalhador->m_ullEscritos += (unsigned long long)lResultado;
+        else
+            psTrabalhador->m_ullLidos += (unsigned long long)lResultado;
+        if (psOperacao->m_uFeito < psOperacao->m_uTamanho)
+        {
+            pede(psTrabalhador, psFatias, iFatia, (int)(lTag % 3));
+            streamSubmit(&psTrabalhador->m_sFluxo);
+            return 1;
+        }
+    }
+
+    if (psOperacao->m_iEscrita)
+        psFatias[iFatia].m_iEscrita = 0;
+    else
+        psFatias[iFatia].m_iLeituras--;
+    if (lResultado <= 0)
+    {
+        fprintf(stderr, "%s: %s.\n", pcSaida, lResultado < 0 ? strerror((int)-lResultado) : "fim de arquivo antes da hora");
+        return 0;
+    }
+    return 1;
+}
+
+/* Roda o plugin sobre as entradas abertas em fluxo: ate m_iFatias blocos
+   em andamento, sendo lidos adiante, processados e escritos atras, com
+   memoria que nao depende do tamanho da chamada */
+static int rodaFluxo(Trabalhador * psTrabalhador, Tarefa * psTarefa, const Entrada * psEntradas)
+{
+
+    Lote * psLote;
+    HostInstance * psInstancia;
+    Fatia asFatias[MAX_FATIAS];
+    Fatia * psFatia;
+    Entrada sBloco;
+    unsigned char aucCabecalho[WAV_HEADER_SIZE];
+    unsigned long lEntrada;
+    unsigned long lAmostras;
+    unsigned long lBlocos;
+    unsigned long lBloco;
+    unsigned long lInicio;
+    unsigned long lTamanho;
+    unsigned int uCabecalho;
+    unsigned int uTaxa;
+    unsigned int uFormato;
+    unsigned int uBits;
+    int iFatias;
+    int iFatia;
+    int iSaida;
+    int iOk;
+    double dInicio;
+
+    psLote = psTrabalhador->m_psLote;
+    psInstancia = &psTrabalhador->m_sInstancia;
+    uTaxa = psEntradas[0].m_sInfo.m_uSampleRate;
+    lAmostras = confere(psLote, psTarefa, psEntradas);
+    if (lAmostras == 0 || !prepara(psTrabalhador, uTaxa))
+        return 0;
+
+    iSaida = open(psTarefa->m_pcSaida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (iSaida < 0)
+    {
+        perror(psTarefa->m_pcSaida);
+        return 0;
+    }
+    uCabecalho = 0;
+    if (!formatoSaida(psLote, psTarefa->m_pcSaida, &uFormato, &uBits))
+    {
+        wavHeader(aucCabecalho, uTaxa, lAmostras, uFormato, uBits);
+        uCabecalho = WAV_HEADER_SIZE;
+        if (pwrite(iSaida, aucCabecalho, uCabecalho, 0) != (ssize_t)uCabecalho)
+        {
+            perror(psTarefa->m_pcSaida);
+            close(iSaida);
+            return 0;
+        }
+    }
+
+    dInicio = hostSeconds();
+    lBlocos = (lAmostras + psLote->m_lBloco - 1) / psLote->m_lBloco;
+    iFatias = lBlocos < (unsigned long)psLote->m_iFatias ? (int)lBlocos : psLote->m_iFatias;
+    memset(asFatias, 0, sizeof(asFatias));
+    for (iFatia = 0; iFatia < iFatias; iFatia++)
+    {
+        for (lEntrada = 0; lEntrada < psLote->m_lEntradas; lEntrada++)
+            asFatias[iFatia].m_apucEntradas[lEntrada] = (unsigned char *)malloc(
+                psLote->m_lBloco * psEntradas[lEntrada].m_sInfo.m_uChannels * (psEntradas[lEntrada].m_sInfo.m_uBits / 8));
+        asFatias[iFatia].m_pucSaida = (unsigned char *)malloc(psLote->m_lBloco * (uBits / 8));
+        if (asFatias[iFatia].m_apucEntradas[0] == NULL || asFatias[iFatia].m_pucSaida == NULL
+            || (psLote->m_lEntradas == 2 && asFatias[iFatia].m_apucEntradas[1] == NULL))
+        {
+            fputs("Out of memory.\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+        lInicio = iFatia * psLote->m_lBloco;
+        lTamanho = lAmostras - lInicio < psLote->m_lBloco ? lAmostras - lInicio : psLote->m_lBloco;
+        pedeBloco(psTrabalhador, asFatias, iFatia, psEntradas, lInicio, lTamanho);
+    }
+    streamSubmit(&psTrabalhador->m_sFluxo);
+    psTrabalhador->m_dSubmissao += hostSeconds() - dInicio;
+
+    iOk = 1;
+    for (lBloco = 0; lBloco < lBlocos && iOk; lBloco++)
+    {
+        psFatia = &asFatias[lBloco % iFatias];
+        lInicio = lBloco * psLote->m_lBloco;
+        lTamanho = lAmostras - lInicio < psLote->m_lBloco ? lAmostras - lInicio : psLote->m_lBloco;
+
+        /* A saida da fatia ainda pode estar sendo escrita (bloco
+           lBloco - iFatias); as entradas, sendo lidas */
+        dInicio = hostSeconds();
+        while (psFatia->m_iEscrita && iOk)
+            iOk = colhe(psTrabalhador, asFatias, psTarefa->m_pcSaida);
+        psTrabalhador->m_dEsperaEscrita += hostSeconds() - dInicio;
+        dInicio = hostSeconds();
+        while (psFatia->m_iLeituras && iOk)
+            iOk = colhe(psTrabalhador, asFatias, psTarefa->m_pcSaida);
+        psTrabalhador->m_dEsperaLeitura += hostSeconds() - dInicio;
+        if (!iOk)
+            break;
+
+        dInicio = hostSeconds();
+        for (lEntrada = 0; lEntrada < psLote->m_lEntradas; lEntrada++)
+        {
+            sBloco = psEntradas[lEntrada];
+            sBloco.m_sInfo.m_pucData = psFatia->m_apucEntradas[lEntrada];
+            conecta(psInstancia, psLote->m_alEntradas[lEntrada], &sBloco, 0, lTamanho);
+        }
+        if (uFormato == PCM_FLOAT)
+        {
+            psLote->m_psDescritor->connect_port(psInstancia->m_hHandle, psLote->m_lSaida, (LADSPA_Data *)psFatia->m_pucSaida);
+            hostRun(psInstancia, lTamanho);
+        }
+        else
+        {
+            psLote->m_psDescritor->connect_port(psInstancia->m_hHandle, psLote->m_lSaida, psInstancia->m_ppfBuffers[psLote->m_lSaida]);
+            hostRun(psInstancia, lTamanho);
+            pcmWrite(psInstancia->m_ppfBuffers[psLote->m_lSaida], lTamanho, uFormato, uBits, psFatia->m_pucSaida, psLote->m_iSimd);
+        }
+        psTrabalhador->m_dProcessamento += hostSeconds() - dInicio;
+
+        dInicio = hostSeconds();
+        iFatia = (int)(psFatia - asFatias);
+        psFatia->m_asOperacoes[2].m_iFd = iSaida;
+        psFatia->m_asOperacoes[2].m_iEscrita = 1;
+        psFatia->m_asOperacoes[2].m_pucBuffer = psFatia->m_pucSaida;
+        psFatia->m_asOperacoes[2].m_uTamanho = (unsigned int)(lTamanho * (uBits / 8));
+        psFatia->m_asOperacoes[2].m_uFeito = 0;
+        psFatia->m_asOperacoes[2].m_ullPosicao = uCabecalho + (unsigned long long)lInicio * (uBits / 8);
+        psFatia->m_iEscrita = 1;
+        pede(psTrabalhador, asFatias, iFatia, 2);
+        if (lBloco + iFatias < lBlocos)
+        {
+            lInicio = (lBloco + iFatias) * psLote->m_lBloco;
+            lTamanho = lAmostras - lInicio < psLote->m_lBloco ? lAmostras - lInicio : psLote->m_lBloco;
+            pedeBloco(psTrabalhador, asFatias, iFatia, psEntradas, lInicio, lTamanho);
+        }
+        streamSubmit(&psTrabalhador->m_sFluxo);
+        psTrabalhador->m_dSubmissao += hostSeconds() - dInicio;
+    }
+
+    /* O kernel ainda pode estar usando os buffers */
+    dInicio = hostSeconds();
+    while (psTrabalhador->m_sFluxo.m_uInFlight != 0)
+        if (!colhe(psTrabalhador, asFatias, psTarefa->m_pcSaida))
+            iOk = 0;
+    psTrabalhador->m_dEsperaEscrita += hostSeconds() - dInicio;
+
+    for (iFatia = 0; iFatia < iFatias; iFatia++)
+    {
+        free(asFatias[iFatia].m_apucEntradas[0]);
+        free(asFatias[iFatia].m_apucEntradas[1]);
+        free(asFatias[iFatia].m_pucSaida);
+    }
+    if (close(iSaida) != 0)
+    {
+        perror(psTarefa->m_pcSaida);
+        iOk = 0;
+    }
+    if (!iOk)
+        return 0;
+    psTarefa->m_lAmostras = lAmostras;
+    psTarefa->m_uTaxa = uTaxa;
+    return 1;
+}
+
+/* Processa uma chamada inteira */
+static int processa(Trabalhador * psTrabalhador, Tarefa * psTarefa)
+{
+
+    Lote * psLote;
+    Entrada asEntradas[2];
+    unsigned long lEntradas;
+    int iOk;
+
+    psLote = psTrabalhador->m_psLote;
+    memset(asEntradas, 0, sizeof(asEntradas));
+    for (lEntradas = 0; lEntradas < psLote->m_lEntradas; lEntradas++)
+        if (!(psLote->m_iFatias ? abreFluxo : abre)(&asEntradas[lEntradas], psTarefa->m_apcEntradas[lEntradas],
+                                                     psLote->m_uTaxaBruto))
+            break;
+
+    iOk = lEntradas == psLote->m_lEntradas
+       && (psLote->m_iFatias ? rodaFluxo : roda)(psTrabalhador, psTarefa, asEntradas);
+
+    while (lEntradas-- > 0)
+    {
+        if (asEntradas[lEntradas].m_pvMapa != NULL)
+            wavUnmap(asEntradas[lEntradas].m_pvMapa, asEntradas[lEntradas].m_lTamanho);
+        else
+            close(asEntradas[lEntradas].m_iFd);
+    }
+    return iOk;
+}
+
+/*****************************************************************************/
+
+/* Tira uma tarefa da faixa de psTrabalhador: do inicio se for a dona
+   (iRoubo = 0), do fim se for outra thread. -1 se a faixa esta vazia. */
+static int pega(Trabalhador * psTrabalhador, int iRoubo)
+{
+
+    int iTarefa;
+
+    iTarefa = -1;
+    pthread_mutex_lock(&psTrabalhador->m_sTrava);
+    if (psTrabalhador->m_iInicio < psTrabalhador->m_iFim)
+        iTarefa = iRoubo ? --psTrabalhador->m_iFim : psTrabalhador->m_iInicio++;
+    pthread_mutex_unlock(&psTrabalhador->m_sTrava);
+    return iTarefa;
+}
+
+/* Laco de uma thread: a propria faixa primeiro, depois as das outras.
+   Nenhuma tarefa nova aparece, entao uma volta sem achar nada e' o fim. */
+static void * trabalha(void * pvTrabalhador)
+{
+
+    Trabalhador * psTrabalhador;
+    Lote * psLote;
+    Tarefa * psTarefa;
+    int iTarefa;
+    int iVitima;
+
+    psTrabalhador = (Trabalhador *)pvTrabalhador;
+    psLote = psTrabalhador->m_psLote;
+    if (psLote->m_iFatias)
+    {
+        streamInit(&psTrabalhador->m_sFluxo, (unsigned int)(3 * psLote->m_iFatias));
+        psTrabalhador->m_iUring = psTrabalhador->m_sFluxo.m_iRing >= 0;
+    }
+    for (;;)
+    {
+        iTarefa = pega(psTrabalhador, 0);
+        for (iVitima = 1; iTarefa < 0 && iVitima < psLote->m_iTrabalhadores; iVitima++)
+            iTarefa = pega(&psLote->m_psTrabalhadores[(psTrabalhador->m_iIndice + iVitima) % psLote->m_iTrabalhadores], 1);
+        if (iTarefa < 0)
+            break;
+        psTarefa = &psLote->m_psTarefas[iTarefa];
+        psTarefa->m_iOk = processa(psTrabalhador, psTarefa);
+    }
+
+    if (psTrabalhador->m_iInstanciado)
+        hostCleanup(&psTrabalhador->m_sInstancia);
+    if (psLote->m_iFatias)
+        streamClose(&psTrabalhador->m_sFluxo);
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/* Le o manifesto; cada linha tem lEntradas entradas e uma saida */
+static Tarefa * leManifesto(const char * pcArquivo, unsigned long lEntradas, int * piTarefas)
+{
+
+    FILE * pfManifesto;
+    Tarefa * psTarefas;
+    char acLinha[3 * 4096];
+    char * apcCampos[3];
+    char * pcCampo;
+    unsigned long lCampos;
+    unsigned long lCampo;
+    int iTarefas;
+    int iAlocadas;
+    int iLinha;
+
+    pfManifesto = fopen(pcArquivo, "r");
+    if (pfManifesto == NULL)
+    {
+        perror(pcArquivo);
+        return NULL;
+    }
+
+    psTarefas = NULL;
+    iTarefas = 0;
+    iAlocadas = 0;
+    iLinha = 0;
+    while (fgets(acLinha, sizeof(acLinha), pfManifesto) != NULL)
+    {
+        iLinha++;
+        lCampos = 0;
+        for (pcCampo = strtok(acLinha, " \t\r\n"); pcCampo != NULL; pcCampo = strtok(NULL, " \t\r\n"))
+        {
+            if (lCampos == 0 && pcCampo[0] == '#')
+                break;
+            if (lCampos == 3)
+            {
+                lCampos++;
+                break;
+            }
+            apcCampos[lCampos++] = pcCampo;
+        }
+        if (lCampos == 0)
+            continue;
+        if (lCampos != lEntradas + 1)
+        {
+            fprintf(stderr, "%s:%d: esperava %lu arquivos.\n", pcArquivo, iLinha, lEntradas + 1);
+            fclose(pfManifesto);
+            return NULL;
+        }
+
+        if (iTarefas == iAlocadas)
+        {
+            iAlocadas = iAlocadas ? 2 * iAlocadas : 256;
+            psTarefas = (Tarefa *)realloc(psTarefas, iAlocadas * sizeof(Tarefa));
+            if (psTarefas == NULL)
+            {
+                fputs("Out of memory.\n", stderr);
+                exit(EXIT_FAILURE);
+            }
+        }
+        memset(&psTarefas[iTarefas], 0, sizeof(Tarefa));
+        for (lCampo = 0; lCampo < lCampos; lCampo++)
+            if ((apcCampos[lCampo] = strdup(apcCampos[lCampo])) == NULL)
+            {
+                fputs("Out of memory.\n", stderr);
+                exit(EXIT_FAILURE);
+            }
+        for (lCampo = 0; lCampo < lEntradas; lCampo++)
+            psTarefas[iTarefas].m_apcEntradas[lCampo] = apcCampos[lCampo];
+        psTarefas[iTarefas].m_pcSaida = apcCampos[lEntradas];
+        iTarefas++;
+    }
+    fclose(pfManifesto);
+
+    if (iTarefas == 0)
+    {
+        fprintf(stderr, "%s: manifesto vazio.\n", pcArquivo);
+        free(psTarefas);
+        return NULL;
+    }
+    *piTarefas = iTarefas;
+    return psTarefas;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    LADSPA_Descriptor_Function fDescritor;
+    Lote sLote;
+    Tarefa sUnica;
+    Tarefa * psTarefas;
+    Trabalhador * psTrabalhadores;
+    const char * pcLabel;
+    const char * pcSaida;
+    const char * pcManifesto;
+    const char * apcControles[MAX_CONTROLES];
+    char * pcIgual;
+    unsigned long lPorta;
+    double dAudio;
+    double dTempo;
+    double dEsperaLeitura;
+    double dProcessamento;
+    double dEsperaEscrita;
+    double dSubmissao;
+    unsigned long long ullLidos;
+    unsigned long long ullEscritos;
+    long lProcessadores;
+    int iTarefas;
+    int iTrabalhadores;
+    int iTrabalhador;
+    int iTarefa;
+    int iFalhas;
+    int iOpcao;
+    int iArquivos;
+
+    memset(&sLote, 0, sizeof(Lote));
+    pcLabel = NULL;
+    pcSaida = "saida.wav";
+    pcManifesto = NULL;
+    iTrabalhadores = 0;
+    sLote.m_lBloco = 65536;
+    sLote.m_uTaxaBruto = 16000;
+    sLote.m_uFormato = PCM_FLOAT;
+    sLote.m_uBits = 32;
+    sLote.m_iSimd = simdLevel();
+
+    while ((iOpcao = getopt(argc, argv, "l:b:r:c:o:m:j:s:f:")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'l':
+            pcLabel = optarg;
+            break;
+        case 'b':
+            sLote.m_lBloco = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            sLote.m_uTaxaBruto = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            pcIgual = strrchr(optarg, '=');
+            if (pcIgual == NULL || sLote.m_iControles == MAX_CONTROLES)
+            {
+                fprintf(stderr, "controle invalido: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            *pcIgual = '\0';
+            apcControles[sLote.m_iControles] = optarg;
+            sLote.m_afControles[sLote.m_iControles] = (LADSPA_Data)atof(pcIgual + 1);
+            sLote.m_iControles++;
+            break;
+        case 'o':
+            pcSaida = optarg;
+            break;
+        case 'm':
+            pcManifesto = optarg;
+            break;
+        case 'j':
+            iTrabalhadores = atoi(optarg);
+            break;
+        case 's':
+            sLote.m_iFatias = atoi(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "f32") == 0)
+            {
+                sLote.m_uFormato = PCM_FLOAT;
+                sLote.m_uBits = 32;
+            }
+            else if (strcmp(optarg, "s16") == 0 || strcmp(optarg, "s24") == 0)
+            {
+                sLote.m_uFormato = PCM_INT;
+                sLote.m_uBits = optarg[1] == '1' ? 16 : 24;
+            }
+            else
+            {
+                fprintf(stderr, "formato invalido: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    iArquivos = argc - optind - 1;
+    if ((pcManifesto == NULL && (iArquivos < 1 || iArquivos > 2)) || (pcManifesto != NULL && iArquivos != 0)
+        || sLote.m_lBloco == 0 || sLote.m_uTaxaBruto == 0 || iTrabalhadores < 0 || iTrabalhadores > MAX_THREADS
+        || sLote.m_iFatias < 0 || sLote.m_iFatias > MAX_FATIAS || sLote.m_lBloco > (1UL << 24))
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+
+    fDescritor = hostOpen(argv[optind]);
+    sLote.m_psDescritor = fDescritor != NULL ? hostFind(fDescritor, pcLabel) : NULL;
+    if (sLote.m_psDescritor == NULL)
+        return EXIT_FAILURE;
+
+    /* Entradas de audio na ordem das portas: d(n), x(n) */
+    sLote.m_lSaida = sLote.m_psDescritor->PortCount;
+    for (lPorta = 0; lPorta < sLote.m_psDescritor->PortCount; lPorta++)
+    {
+        if (!LADSPA_IS_PORT_AUDIO(sLote.m_psDescritor->PortDescriptors[lPorta]))
+            continue;
+        if (LADSPA_IS_PORT_INPUT(sLote.m_psDescritor->PortDescriptors[lPorta]) && sLote.m_lEntradas < 2)
+            sLote.m_alEntradas[sLote.m_lEntradas++] = lPorta;
+        else if (LADSPA_IS_PORT_OUTPUT(sLote.m_psDescritor->PortDescriptors[lPorta]) && sLote.m_lSaida == sLote.m_psDescritor->PortCount)
+            sLote.m_lSaida = lPorta;
+    }
+    if (sLote.m_lEntradas == 0 || sLote.m_lSaida == sLote.m_psDescritor->PortCount
+        || (pcManifesto == NULL && sLote.m_lEntradas != (unsigned long)iArquivos))
+    {
+        fprintf(stderr, "%s: %lu entradas de audio, %d arquivos dados.\n", sLote.m_psDescritor->Label, sLote.m_lEntradas, iArquivos);
+        return EXIT_FAILURE;
+    }
+    for (iOpcao = 0; iOpcao < sLote.m_iControles; iOpcao++)
+    {
+        sLote.m_alControles[iOpcao] = hostFindPort(sLote.m_psDescritor, apcControles[iOpcao]);
+        if (sLote.m_alControles[iOpcao] < 0)
+        {
+            fprintf(stderr, "%s: nao ha porta \"%s\".\n", sLote.m_psDescritor->Label, apcControles[iOpcao]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (pcManifesto != NULL)
+    {
+        psTarefas = leManifesto(pcManifesto, sLote.m_lEntradas, &iTarefas);
+        if (psTarefas == NULL)
+            return EXIT_FAILURE;
+        if (iTrabalhadores == 0)
+        {
+            lProcessadores = sysconf(_SC_NPROCESSORS_ONLN);
+            iTrabalhadores = lProcessadores < 1 ? 1 : lProcessadores > MAX_THREADS ? MAX_THREADS : (int)lProcessadores;
+        }
+    }
+    else
+    {
+        memset(&sUnica, 0, sizeof(Tarefa));
+        sUnica.m_apcEntradas[0] = argv[optind + 1];
+        sUnica.m_apcEntradas[1] = iArquivos == 2 ? argv[optind + 2] : NULL;
+        sUnica.m_pcSaida = (char *)pcSaida;
+        psTarefas = &sUnica;
+        iTarefas = 1;
+        iTrabalhadores = 1;
+    }
+    if (iTrabalhadores > iTarefas)
+        iTrabalhadores = iTarefas;
+
+    /* Faixas contiguas e de tamanhos quase iguais */
+    psTrabalhadores = (Trabalhador *)calloc(iTrabalhadores, sizeof(Trabalhador));
+    if (psTrabalhadores == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    sLote.m_psTarefas = psTarefas;
+    sLote.m_psTrabalhadores = psTrabalhadores;
+    sLote.m_iTrabalhadores = iTrabalhadores;
+    for (iTrabalhador = 0; iTrabalhador < iTrabalhadores; iTrabalhador++)
+    {
+        pthread_mutex_init(&psTrabalhadores[iTrabalhador].m_sTrava, NULL);
+        psTrabalhadores[iTrabalhador].m_iInicio = (int)((long)iTarefas * iTrabalhador / iTrabalhadores);
+        psTrabalhadores[iTrabalhador].m_iFim = (int)((long)iTarefas * (iTrabalhador + 1) / iTrabalhadores);
+        psTrabalhadores[iTrabalhador].m_psLote = &sLote;
+        psTrabalhadores[iTrabalhador].m_iIndice = iTrabalhador;
+    }
+
+    dTempo = hostSeconds();
+    for (iTrabalhador = 1; iTrabalhador < iTrabalhadores; iTrabalhador++)
+        if (pthread_create(&psTrabalhadores[iTrabalhador].m_sThread, NULL, trabalha, &psTrabalhadores[iTrabalhador]) != 0)
+        {
+            fputs("pthread_create falhou.\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    trabalha(&psTrabalhadores[0]);
+    for (iTrabalhador = 1; iTrabalhador < iTrabalhadores; iTrabalhador++)
+        pthread_join(psTrabalhadores[iTrabalhador].m_sThread, NULL);
+    dTempo = hostSeconds() - dTempo;
+
+    dAudio = 0;
+    iFalhas = 0;
+    for (iTarefa = 0; iTarefa < iTarefas; iTarefa++)
+    {
+        if (psTarefas[iTarefa].m_iOk)
+            dAudio += (double)psTarefas[iTarefa].m_lAmostras / psTarefas[iTarefa].m_uTaxa;
+        else
+            iFalhas++;
+    }
+
+    if (pcManifesto == NULL)
+    {
+        if (iFalhas == 0)
+            fprintf(stderr, "%s: %lu amostras (%.1f s a %u Hz) em %.2f s, %.0fx tempo real\n", sLote.m_psDescritor->Label,
+                    sUnica.m_lAmostras, dAudio, sUnica.m_uTaxa, dTempo, dTempo > 0 ? dAudio / dTempo : 0);
+    }
+    else
+    {
+        fprintf(stderr, "%s: %d chamadas (%d falhas), %.1f s de audio em %.2f s com %d threads, %.0fx tempo real\n",
+                sLote.m_psDescritor->Label, iTarefas, iFalhas, dAudio, dTempo, iTrabalhadores, dTempo > 0 ? dAudio / dTempo : 0);
+        for (iTarefa = 0; iTarefa < iTarefas; iTarefa++)
+        {
+            free(psTarefas[iTarefa].m_apcEntradas[0]);
+            free(psTarefas[iTarefa].m_apcEntradas[1]);
+            free(psTarefas[iTarefa].m_pcSaida);
+        }
+        free(psTarefas);
+    }
+
+    /* Onde o fluxo passou o tempo: se as esperas dominam, o gargalo e' o
+       disco, senao o plugin */
+    if (sLote.m_iFatias)
+    {
+        dEsperaLeitura = dProcessamento = dEsperaEscrita = dSubmissao = 0;
+        ullLidos = ullEscritos = 0;
+        for (iTrabalhador = 0; iTrabalhador < iTrabalhadores; iTrabalhador++)
+        {
+            dEsperaLeitura += psTrabalhadores[iTrabalhador].m_dEsperaLeitura;
+            dProcessamento += psTrabalhadores[iTrabalhador].m_dProcessamento;
+            dEsperaEscrita += psTrabalhadores[iTrabalhador].m_dEsperaEscrita;
+            dSubmissao += psTrabalhadores[iTrabalhador].m_dSubmissao;
+            ullLidos += psTrabalhadores[iTrabalhador].m_ullLidos;
+            ullEscritos += psTrabalhadores[iTrabalhador].m_ullEscritos;
+        }
+        fprintf(stderr, "fluxo (%s, %d blocos de %lu): espera de leitura %.2f s, processamento %.2f s, "
+                "espera de escrita %.2f s, submissao %.2f s; %.1f MB lidos, %.1f MB escritos\n",
+                psTrabalhadores[0].m_iUring ? "io_uring" : "pread/pwrite", sLote.m_iFatias, sLote.m_lBloco,
+                dEsperaLeitura, dProcessamento, dEsperaEscrita, dSubmissao, ullLidos / 1e6, ullEscritos / 1e6);
+    }
+
+    for (iTrabalhador = 0; iTrabalhador < iTrabalhadores; iTrabalhador++)
+        pthread_mutex_destroy(&psTrabalhadores[iTrabalhador].m_sTrava);
+    free(psTrabalhadores);
+
+    return iFalhas == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*****************************************************************************/
+
+/* EOF */
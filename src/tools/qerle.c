@@ -0,0 +1,237 @@
+/* qerle.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Compara o cancelador em ponto fixo (qnlmscncr) com o de ponto
+   flutuante (nlmscncr) sobre o mesmo sinal sintetico: um ruido colorido
+   em x(n), passado por uma resposta ao impulso com decaimento
+   exponencial e somado a um ruido de fundo para formar d(n).
+
+   Imprime a ERLE (10 log10 var(d)/var(e)) segundo a segundo para os dois
+   plugins e depois roda o qnlmscncr com cada nucleo (AEC_KERNEL=scalar,
+   sse e avx2), conferindo que as saidas sao identicas bit a bit.
+
+   Uso: qerle <nlmscncr.so> <qnlmscncr.so> [eco em ms] [segundos] */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+
+#include "ladspa.h"
+#include "simd.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define SAMPLE_RATE 16000
+#define TAM_BLOCO 256
+
+/* Valores das portas de controle (mesma numeracao nos dois plugins) */
+#define DTD_MS 10
+#define DTD_LIMIAR 0.0f
+#define MU 0.5f
+#define SET_DB -120.0f
+
+/*****************************************************************************/
+
+static const LADSPA_Descriptor * carregaPlugin(const char * pcArquivo)
+{
+
+    void * pvBiblioteca;
+    LADSPA_Descriptor_Function fDescritor;
+
+    pvBiblioteca = dlopen(pcArquivo, RTLD_NOW);
+    if (pvBiblioteca == NULL)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        exit(EXIT_FAILURE);
+    }
+
+    fDescritor = (LADSPA_Descriptor_Function)dlsym(pvBiblioteca, "ladspa_descriptor");
+    if (fDescritor == NULL || fDescritor(0) == NULL)
+    {
+        fprintf(stderr, "%s: nao e' um plugin LADSPA.\n", pcArquivo);
+        exit(EXIT_FAILURE);
+    }
+
+    return fDescritor(0);
+}
+
+/*****************************************************************************/
+
+/* Roda o plugin sobre todo o sinal, em blocos de TAM_BLOCO amostras */
+static void processa(const LADSPA_Descriptor * psDescritor, LADSPA_Data fEcoMs, const float * pfX, const float * pfD, float * pfE, unsigned long lAmostras)
+{
+
+    LADSPA_Handle hInstancia;
+    LADSPA_Data afControles[5];
+    unsigned long lInicio;
+    unsigned long lBloco;
+    unsigned long lPorta;
+
+    afControles[0] = fEcoMs;
+    afControles[1] = DTD_MS;
+    afControles[2] = DTD_LIMIAR;
+    afControles[3] = MU;
+    afControles[4] = SET_DB;
+
+    hInstancia = psDescritor->instantiate(psDescritor, SAMPLE_RATE);
+    for (lPorta = 0; lPorta < 5; lPorta++)
+        psDescritor->connect_port(hInstancia, lPorta, afControles + lPorta);
+    psDescritor->activate(hInstancia);
+
+    for (lInicio = 0; lInicio < lAmostras; lInicio += lBloco)
+    {
+        lBloco = lAmostras - lInicio < TAM_BLOCO ? lAmostras - lInicio : TAM_BLOCO;
+        psDescritor->connect_port(hInstancia, 5, (LADSPA_Data *)pfD + lInicio);
+        psDescritor->connect_port(hInstancia, 6, (LADSPA_Data *)pfX + lInicio);
+        psDescritor->connect_port(hInstancia, 7, pfE + lInicio);
+        psDescritor->run(hInstancia, lBloco);
+    }
+
+    psDescritor->cleanup(hInstancia);
+}
+
+/*****************************************************************************/
+
+static double erle(const float * pfD, const float * pfE, unsigned long lAmostras)
+{
+
+    double dPotD;
+    double dPotE;
+    unsigned long lIndex;
+
+    dPotD = 0;
+    dPotE = 0;
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        dPotD += (double)pfD[lIndex] * pfD[lIndex];
+        dPotE += (double)pfE[lIndex] * pfE[lIndex];
+    }
+    return 10.0 * log10(dPotD / (dPotE + 1e-20));
+}
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    const LADSPA_Descriptor * psFloat;
+    const LADSPA_Descriptor * psFixo;
+    float * pfRir;
+    float * pfX;
+    float * pfD;
+    float * pfEFloat;
+    float * pfEFixo;
+    float * pfENucleo;
+    float fCor;
+    double dAcc;
+    LADSPA_Data fEcoMs;
+    unsigned long lSegundos;
+    unsigned long lAmostras;
+    unsigned long lTaps;
+    unsigned long lIndex;
+    unsigned long lSemente;
+    unsigned long lTap;
+    unsigned long lSegundo;
+    int iNucleo;
+    int iFalhas;
+
+    if (argc < 3)
+    {
+        fputs("Uso: qerle <nlmscncr.so> <qnlmscncr.so> [eco em ms] [segundos]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    psFloat = carregaPlugin(argv[1]);
+    psFixo  = carregaPlugin(argv[2]);
+    fEcoMs    = argc > 3 ? (LADSPA_Data)atof(argv[3]) : 64;
+    lSegundos = argc > 4 ? strtoul(argv[4], NULL, 10) : 10;
+
+    lAmostras = lSegundos * SAMPLE_RATE;
+    lTaps     = (unsigned long)(fEcoMs * SAMPLE_RATE * 0.001);
+
+    pfRir     = (float *)calloc(lTaps + 1, sizeof(float));
+    pfX       = (float *)calloc(lAmostras, sizeof(float));
+    pfD       = (float *)calloc(lAmostras, sizeof(float));
+    pfEFloat  = (float *)calloc(lAmostras, sizeof(float));
+    pfEFixo   = (float *)calloc(lAmostras, sizeof(float));
+    pfENucleo = (float *)calloc(lAmostras, sizeof(float));
+
+    if (pfRir == NULL || pfX == NULL || pfD == NULL || pfEFloat == NULL || pfEFixo == NULL || pfENucleo == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    /* Resposta ao impulso com decaimento exponencial, mais curta que o filtro */
+    lSemente = 12345;
+    for (lTap = 0; lTap < lTaps; lTap++)
+        pfRir[lTap] = hostNoise(&lSemente) * expf(-(float)lTap / (lTaps / 6.0f + 1.0f)) * 0.5f;
+
+    /* x(n): ruido passa-baixas; d(n): eco de x(n) mais ruido de fundo */
+    fCor = 0;
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        fCor = 0.9f * fCor + hostNoise(&lSemente);
+        pfX[lIndex] = 0.3f * fCor;
+    }
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        dAcc = 0;
+        for (lTap = 0; lTap < lTaps && lTap <= lIndex; lTap++)
+            dAcc += pfRir[lTap] * pfX[lIndex - lTap];
+        pfD[lIndex] = (float)dAcc + 1e-4f * hostNoise(&lSemente);
+    }
+
+    processa(psFloat, fEcoMs, pfX, pfD, pfEFloat, lAmostras);
+    processa(psFixo, fEcoMs, pfX, pfD, pfEFixo, lAmostras);
+
+    printf("ERLE (dB) por segundo, eco de %.0f ms\n", fEcoMs);
+    printf("%4s %10s %10s\n", "s", psFloat->Label, "fixo");
+    for (lSegundo = 0; lSegundo < lSegundos; lSegundo++)
+        printf("%4lu %10.1f %10.1f\n", lSegundo,
+               erle(pfD + lSegundo * SAMPLE_RATE, pfEFloat + lSegundo * SAMPLE_RATE, SAMPLE_RATE),
+               erle(pfD + lSegundo * SAMPLE_RATE, pfEFixo + lSegundo * SAMPLE_RATE, SAMPLE_RATE));
+
+    /* O run() do plugin ja usou o melhor nucleo; compara com cada um dos outros */
+    iFalhas = 0;
+    for (iNucleo = SIMD_SCALAR; iNucleo <= SIMD_AVX2; iNucleo++)
+    {
+        setenv(SIMD_ENV, simdName(iNucleo), 1);
+        if (simdLevel() != iNucleo)
+        {
+            printf("nucleo %-6s nao suportado\n", simdName(iNucleo));
+            continue;
+        }
+        processa(psFixo, fEcoMs, pfX, pfD, pfENucleo, lAmostras);
+        if (memcmp(pfENucleo, pfEFixo, lAmostras * sizeof(float)) == 0)
+        {
+            printf("nucleo %-6s identico\n", simdName(iNucleo));
+        }
+        else
+        {
+            printf("nucleo %-6s DIFERENTE\n", simdName(iNucleo));
+            iFalhas++;
+        }
+    }
+    unsetenv(SIMD_ENV);
+
+    free(pfRir);
+    free(pfX);
+    free(pfD);
+    free(pfEFloat);
+    free(pfEFixo);
+    free(pfENucleo);
+
+    return iFalhas ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+/* EOF */
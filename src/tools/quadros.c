@@ -0,0 +1,415 @@
+/* quadros.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Matriz de tamanhos de bloco: confere que a saida de cada descritor nao
+   depende de como o host parte o sinal nas chamadas de run(). Roda o
+   mesmo sinal (hostSignals(), cena HOST_SCENE_DOUBLE_TALK: eco com fala
+   dupla na segunda metade) com blocos de 1 amostra, que e' a referencia, e depois
+   com:
+
+     1 a 16, 2^k - 1, 2^k e 2^k + 1 ate 8192, 160, 441, 480 e 1000
+     uma sequencia aleatoria de tamanhos em [1, 8192] (hostBlockSize())
+     a mesma sequencia e blocos de 256 no lugar: a primeira entrada e a
+     saida de audio apontam para o mesmo buffer (se o descritor nao
+     tiver LADSPA_PROPERTY_INPLACE_BROKEN)
+
+   As saidas de audio tem de ser identicas bit a bit a' referencia; na
+   primeira diferenca de cada rodada, imprime o bloco, a amostra e os
+   dois valores. Os controles sao os de hostExercise(), como no
+   regressao: filtro de 32 ms, DTD e Set-Membership abertos e
+   coeficientes nao nulos nos filtros fixos, para a adaptacao entrar na
+   comparacao; o rirconv le o caminho de eco das cenas de um arquivo
+   temporario apontado por RIRCONV_ARQUIVO. As portas sao apontadas
+   direto para o sinal, como faria um host. Uma porta de saida de
+   controle chamada "latency" (quadros.h) e' mostrada e tem de ter o
+   mesmo valor em toda rodada.
+
+   O descritor tambem falha se o filtro nao trabalhou: com o medidor de
+   taxa de adaptacao, se a media ficou abaixo de TAXA_MINIMA em todas as
+   rodadas (um motor em quadros so conta as atualizacoes no bloco em que
+   o quadro fecha, entao a media depende dos blocos); sem ele, se a saida
+   da referencia for nula ou igual a' primeira entrada.
+
+   Uso: quadros [-n amostras] [-v] <plugin.so>... */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ladspa.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define USO "Uso: quadros [-n amostras] [-v] <plugin.so>...\n"
+
+#define MAX_PORTS 512
+#define MAX_BLOCO 8192
+
+#define SAMPLE_RATE 16000
+#define TAMANHO_MS 32
+#define BLOCO_NO_LUGAR 256
+
+#define PORTA_LATENCIA "latency"
+#define PORTA_TAXA "Taxa de adaptacao"
+#define TAXA_MINIMA 0.01 /* Fracao minima das amostras em que o filtro adapta */
+
+/* Tamanhos fora das potencias de 2 */
+static const unsigned long g_alAvulsos[] = { 160, 441, 480, 1000, 0 };
+
+/* Rodadas alem dos tamanhos fixos */
+#define RODADA_ALEATORIA 0
+#define RODADA_NO_LUGAR 1
+#define RODADA_NO_LUGAR_ALEATORIA 2
+
+/*****************************************************************************/
+
+/* Uma rodada: blocos de lFixo amostras, ou a sequencia aleatoria com
+   lFixo == 0. Com iNoLugar, a primeira entrada de audio e a primeira
+   saida usam pfSaida, que comeca com o sinal da entrada. Devolve a
+   porta "latency" (ou -1) e as saidas de audio em pfSaida, uma apos a
+   outra. Em pdTaxa vai a taxa de adaptacao media, pesada pelos blocos
+   (ou -1, se o descritor nao tiver o medidor). */
+static float roda(const LADSPA_Descriptor * psDescritor, const float * pfX, const float * pfD, unsigned long lAmostras,
+                  unsigned long lFixo, int iNoLugar, float * pfSaida, double * pdTaxa)
+{
+
+    LADSPA_Handle hInstancia;
+    LADSPA_Data afPortas[MAX_PORTS];
+    const float * apfEntradas[2];
+    unsigned long alEntradas[2];
+    unsigned long alSaidas[MAX_PORTS];
+    unsigned long lEntradas;
+    unsigned long lSaidas;
+    unsigned long lPorta;
+    unsigned long lLatencia;
+    unsigned long lTaxa;
+    unsigned long lInicio;
+    unsigned long lTamanho;
+    unsigned long lSemente;
+    int iLatencia;
+    int iTaxa;
+    double dTaxa;
+
+    hInstancia = psDescritor->instantiate(psDescritor, SAMPLE_RATE);
+    if (hInstancia == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    lEntradas = 0;
+    lSaidas = 0;
+    lLatencia = 0;
+    iLatencia = 0;
+    lTaxa = 0;
+    iTaxa = 0;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+    {
+        afPortas[lPorta] = 0;
+        if (LADSPA_IS_PORT_CONTROL(psDescritor->PortDescriptors[lPorta]))
+        {
+            if (LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]))
+                afPortas[lPorta] = hostExercise(psDescritor, lPorta, SAMPLE_RATE, TAMANHO_MS);
+            else if (strcmp(psDescritor->PortNames[lPorta], PORTA_LATENCIA) == 0)
+            {
+                lLatencia = lPorta;
+                iLatencia = 1;
+            }
+            else if (strcmp(psDescritor->PortNames[lPorta], PORTA_TAXA) == 0)
+            {
+                lTaxa = lPorta;
+                iTaxa = 1;
+            }
+            psDescritor->connect_port(hInstancia, lPorta, afPortas + lPorta);
+        }
+        else if (LADSPA_IS_PORT_OUTPUT(psDescritor->PortDescriptors[lPorta]))
+            alSaidas[lSaidas++] = lPorta;
+        else if (lEntradas < 2)
+            alEntradas[lEntradas++] = lPorta;
+        else
+            psDescritor->connect_port(hInstancia, lPorta, (LADSPA_Data *)pfX);
+    }
+
+    /* Duas entradas: d(n) e x(n); uma: x(n) */
+    apfEntradas[0] = lEntradas == 2 ? pfD : pfX;
+    apfEntradas[1] = pfX;
+    if (iNoLugar)
+    {
+        memcpy(pfSaida, apfEntradas[0], sizeof(float) * lAmostras);
+        apfEntradas[0] = pfSaida;
+    }
+
+    if (psDescritor->activate != NULL)
+        psDescritor->activate(hInstancia);
+
+    lSemente = 1;
+    dTaxa = 0;
+    for (lInicio = 0; lInicio < lAmostras; lInicio += lTamanho)
+    {
+        lTamanho = lFixo != 0 ? lFixo : hostBlockSize(&lSemente, MAX_BLOCO);
+        if (lTamanho > lAmostras - lInicio)
+            lTamanho = lAmostras - lInicio;
+        for (lPorta = 0; lPorta < lEntradas; lPorta++)
+            psDescritor->connect_port(hInstancia, alEntradas[lPorta], (LADSPA_Data *)apfEntradas[lPorta] + lInicio);
+        for (lPorta = 0; lPorta < lSaidas; lPorta++)
+            psDescritor->connect_port(hInstancia, alSaidas[lPorta], pfSaida + lPorta * lAmostras + lInicio);
+        psDescritor->run(hInstancia, lTamanho);
+        if (iTaxa)
+            dTaxa += (double)afPortas[lTaxa] * lTamanho;
+    }
+    *pdTaxa = iTaxa ? dTaxa / lAmostras : -1;
+
+    if (psDescritor->deactivate != NULL)
+        psDescritor->deactivate(hInstancia);
+    psDescritor->cleanup(hInstancia);
+
+    return iLatencia ? afPortas[lLatencia] : -1;
+}
+
+/*****************************************************************************/
+
+/* Compara uma rodada com a referencia; imprime a primeira diferenca */
+static int compara(const LADSPA_Descriptor * psDescritor, const char * pcRodada, const float * pfEsperado,
+                   const float * pfObtido, unsigned long lTotal, float fLatencia, float fLatenciaRef)
+{
+
+    unsigned long lIndex;
+
+    if (fLatencia != fLatenciaRef)
+    {
+        printf("%s: %s: latencia %g, na referencia %g\n", psDescritor->Label, pcRodada, fLatencia, fLatenciaRef);
+        return 0;
+    }
+    if (memcmp(pfEsperado, pfObtido, sizeof(float) * lTotal) == 0)
+        return 1;
+    for (lIndex = 0; lIndex < lTotal && memcmp(pfEsperado + lIndex, pfObtido + lIndex, sizeof(float)) == 0; lIndex++)
+        ;
+    printf("%s: %s: difere na amostra %lu: %.9g, na referencia %.9g\n", psDescritor->Label, pcRodada, lIndex,
+           pfObtido[lIndex], pfEsperado[lIndex]);
+    return 0;
+}
+
+/* O filtro trabalhou? Imprime a falha e devolve 0 se a maior taxa media
+   de adaptacao das rodadas, dTaxa, ficou abaixo de TAXA_MINIMA ou, sem o
+   medidor (dTaxa < 0), se a primeira saida da referencia e' nula ou a
+   entrada */
+static int trabalhou(const LADSPA_Descriptor * psDescritor, const float * pfEntrada, const float * pfSaida,
+                     unsigned long lAmostras, double dTaxa)
+{
+
+    unsigned long lIndex;
+    int iNula;
+    int iIgual;
+
+    if (dTaxa >= 0)
+    {
+        if (dTaxa >= TAXA_MINIMA)
+            return 1;
+        printf("%s: o filtro quase nao adaptou (taxa de adaptacao media %.4f)\n", psDescritor->Label, dTaxa);
+        return 0;
+    }
+
+    iNula = 1;
+    iIgual = 1;
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        if (pfSaida[lIndex] != 0)
+            iNula = 0;
+        if (pfSaida[lIndex] != pfEntrada[lIndex])
+            iIgual = 0;
+    }
+    if (!iNula && !iIgual)
+        return 1;
+    printf("%s: referencia: o filtro nao filtrou (saida %s)\n", psDescritor->Label, iNula ? "nula" : "igual a' entrada");
+    return 0;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    int iVerboso;
+    int iOpcao;
+    int iArquivo;
+    int iRodada;
+    int iFalhas;
+    int iRodadas;
+    int iFalhasDescritor;
+    int iRodadasDescritor;
+    char acRodada[64];
+    LADSPA_Descriptor_Function fDescritor;
+    const LADSPA_Descriptor * psDescritor;
+    unsigned long alTamanhos[64];
+    unsigned long lTamanhos;
+    unsigned long lTamanho;
+    unsigned long lAmostras;
+    unsigned long lDescritor;
+    unsigned long lSaidas;
+    unsigned long lIndex;
+    float * pfX;
+    float * pfD;
+    float * pfEsperado;
+    float * pfObtido;
+    float fLatencia;
+    float fLatenciaRef;
+    double dTaxa;
+    double dTaxaMaxima;
+    char acRir[] = "/tmp/quadros-rir-XXXXXX";
+    int iRir;
+
+    iVerboso = 0;
+    lAmostras = 2 * SAMPLE_RATE;
+    while ((iOpcao = getopt(argc, argv, "n:v")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'n':
+            lAmostras = strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            iVerboso = 1;
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || lAmostras == 0)
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+
+    /* 1 (a referencia) a 16, vizinhos das potencias de 2 e os avulsos */
+    lTamanhos = 0;
+    for (lTamanho = 1; lTamanho <= 16; lTamanho++)
+        alTamanhos[lTamanhos++] = lTamanho;
+    for (lTamanho = 32; lTamanho <= MAX_BLOCO; lTamanho *= 2)
+    {
+        alTamanhos[lTamanhos++] = lTamanho - 1;
+        alTamanhos[lTamanhos++] = lTamanho;
+        if (lTamanho < MAX_BLOCO)
+            alTamanhos[lTamanhos++] = lTamanho + 1;
+    }
+    for (lIndex = 0; g_alAvulsos[lIndex] != 0; lIndex++)
+        alTamanhos[lTamanhos++] = g_alAvulsos[lIndex];
+
+    pfX = (float *)calloc(lAmostras, sizeof(float));
+    pfD = (float *)calloc(lAmostras, sizeof(float));
+    if (pfX == NULL || pfD == NULL || !hostSignals(pfX, pfD, lAmostras, SAMPLE_RATE, HOST_SCENE_DOUBLE_TALK))
+    {
+        fputs("Out of memory.\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    /* A RIR do rirconv: o caminho de eco das cenas */
+    iRir = mkstemp(acRir);
+    if (iRir < 0)
+    {
+        perror(acRir);
+        return EXIT_FAILURE;
+    }
+    close(iRir);
+    if (!hostWriteRir(acRir, SAMPLE_RATE))
+    {
+        unlink(acRir);
+        return EXIT_FAILURE;
+    }
+    setenv("RIRCONV_ARQUIVO", acRir, 1);
+
+    iFalhas = 0;
+    iRodadas = 0;
+    for (iArquivo = optind; iArquivo < argc; iArquivo++)
+    {
+        fDescritor = hostOpen(argv[iArquivo]);
+        if (fDescritor == NULL)
+        {
+            iFalhas++;
+            continue;
+        }
+
+        for (lDescritor = 0; (psDescritor = fDescritor(lDescritor)) != NULL; lDescritor++)
+        {
+            lSaidas = hostCountPorts(psDescritor, LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO);
+            if (psDescritor->PortCount > MAX_PORTS || lSaidas == 0
+                || hostCountPorts(psDescritor, LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO) == 0)
+                continue;
+
+            pfEsperado = (float *)calloc(lSaidas * lAmostras, sizeof(float));
+            pfObtido = (float *)calloc(lSaidas * lAmostras, sizeof(float));
+            if (pfEsperado == NULL || pfObtido == NULL)
+            {
+                fputs("Out of memory.\n", stderr);
+                unlink(acRir);
+                return EXIT_FAILURE;
+            }
+
+            fLatenciaRef = roda(psDescritor, pfX, pfD, lAmostras, 1, 0, pfEsperado, &dTaxaMaxima);
+            iFalhasDescritor = 0;
+            iRodadasDescritor = 0;
+
+            for (lIndex = 1; lIndex < lTamanhos; lIndex++)
+            {
+                fLatencia = roda(psDescritor, pfX, pfD, lAmostras, alTamanhos[lIndex], 0, pfObtido, &dTaxa);
+                dTaxaMaxima = dTaxa > dTaxaMaxima ? dTaxa : dTaxaMaxima;
+                snprintf(acRodada, sizeof(acRodada), "bloco %lu", alTamanhos[lIndex]);
+                iRodadasDescritor++;
+                if (!compara(psDescritor, acRodada, pfEsperado, pfObtido, lSaidas * lAmostras, fLatencia, fLatenciaRef))
+                    iFalhasDescritor++;
+                else if (iVerboso)
+                    printf("%s: %s igual\n", psDescritor->Label, acRodada);
+            }
+
+            for (iRodada = RODADA_ALEATORIA; iRodada <= RODADA_NO_LUGAR_ALEATORIA; iRodada++)
+            {
+                if (iRodada != RODADA_ALEATORIA && LADSPA_IS_INPLACE_BROKEN(psDescritor->Properties))
+                    continue;
+                fLatencia = roda(psDescritor, pfX, pfD, lAmostras, iRodada == RODADA_NO_LUGAR ? BLOCO_NO_LUGAR : 0,
+                                 iRodada != RODADA_ALEATORIA, pfObtido, &dTaxa);
+                dTaxaMaxima = dTaxa > dTaxaMaxima ? dTaxa : dTaxaMaxima;
+                snprintf(acRodada, sizeof(acRodada), "%s%s", iRodada == RODADA_NO_LUGAR ? "bloco 256" : "aleatorio",
+                         iRodada == RODADA_ALEATORIA ? "" : " no lugar");
+                iRodadasDescritor++;
+                if (!compara(psDescritor, acRodada, pfEsperado, pfObtido, lSaidas * lAmostras, fLatencia, fLatenciaRef))
+                    iFalhasDescritor++;
+                else if (iVerboso)
+                    printf("%s: %s igual\n", psDescritor->Label, acRodada);
+            }
+
+            if (!trabalhou(psDescritor, hostCountPorts(psDescritor, LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO) >= 2 ? pfD : pfX,
+                           pfEsperado, lAmostras, dTaxaMaxima))
+                iFalhasDescritor++;
+
+            if (fLatenciaRef >= 0)
+                printf("%s: %d rodadas, %d falhas, latencia %g amostras\n", psDescritor->Label, iRodadasDescritor,
+                       iFalhasDescritor, fLatenciaRef);
+            else
+                printf("%s: %d rodadas, %d falhas\n", psDescritor->Label, iRodadasDescritor, iFalhasDescritor);
+            iRodadas += iRodadasDescritor;
+            iFalhas += iFalhasDescritor;
+
+            free(pfEsperado);
+            free(pfObtido);
+        }
+    }
+
+    unlink(acRir);
+    printf("%d rodadas, %d falhas\n", iRodadas, iFalhas);
+
+    free(pfX);
+    free(pfD);
+
+    return iFalhas ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+/* EOF */
@@ -0,0 +1,860 @@
+/* qualidade.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Compara convergencia e custo dos canceladores. So velocidade engana:
+   um motor com atualizacao parcial ou decimado pode ser mais rapido e
+   nunca chegar la. Para cada caminho de eco sintetico e cada tamanho de
+   filtro, roda todos os descritores das bibliotecas dadas (os que tem a
+   porta "Tamanho do filtro (ms)" e duas entradas de audio) sobre o
+   mesmo sinal:
+
+     x(n)  fala sintetica do lado remoto (pulsos glotais e ruido por dois
+           formantes, em silabas com pausas)
+     d(n)  (h * x)(n) + fala local + ruido de fundo a -60 dBFS
+
+   A fala local so existe entre 60% e 75% da duracao (fala dupla). Os
+   caminhos h(n) sao ruido com decaimento exponencial, com ERL de 6 dB:
+
+     curto  atraso de 1 ms, constante de tempo de 4 ms   (~25 ms)
+     medio  atraso de 3 ms, constante de tempo de 12 ms  (~75 ms)
+     longo  atraso de 8 ms, constante de tempo de 40 ms  (~250 ms)
+
+   Como o sinal e' sintetico, o eco residual r(n) = e(n) - fala local -
+   ruido e' conhecido exatamente, e as medidas nao dependem do DTD:
+
+     erle_regime_db   10 log10 soma (h*x)^2 / soma r^2 de 40% a 60%
+     erle_pos_dt_db   o mesmo de 85% ao fim (recuperacao da fala dupla)
+     tN_s             fim da primeira janela com ERLE >= N dB antes da
+                      fala dupla (vazio se nunca chega)
+     desalinhamento   10 log10 ||h - w||^2 / ||h||^2, antes da fala dupla
+                      e no fim
+
+   Os coeficientes w nao saem pela interface LADSPA, entao o
+   desalinhamento e' medido de fora: as portas "µ..." vao a zero
+   (congelando o filtro), x(n) continua com um ruido branco e a razao
+   entre a energia de e(n) e a de (h*x)(n) nesse trecho e' a do
+   desalinhamento. O custo (ns por amostra) e' o da rodada principal, em
+   blocos de -b amostras.
+
+   Um descritor com uma porta de saida "latency" (o fdnlms) entrega e(n)
+   atrasado desse tanto; as medidas descontam o atraso, comparando e(n)
+   com o d(n) que o gerou, e deixam de fora o fim que ainda nao saiu.
+
+   A saida e' CSV, uma linha por (caminho, descritor, tamanho), com duas
+   marcas de Pareto entre custo e erle_regime_db: pareto_motor diz se o
+   ponto esta na curva do proprio descritor (variando so o tamanho) e
+   pareto_global, se nenhum outro ponto do mesmo caminho e' mais barato
+   e melhor. Com -t, a ERLE janela a janela vai para outro CSV.
+
+   Uso: qualidade [-r taxa] [-l tamanhos] [-c caminhos] [-n niveis]
+                  [-s segundos] [-j janela ms] [-b bloco] [-t serie.csv]
+                  [-q] <plugin.so>...
+
+   As listas sao separadas por virgulas; -q e' uma rodada curta (8 kHz,
+   caminho curto, 32 e 64 ms, 6 segundos). */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ladspa.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define MAX_PORTS 512
+#define MAX_VALORES 32
+#define MAX_PONTOS 1024
+
+#define PORTA_TAMANHO "Tamanho do filtro (ms)"
+#define PREFIXO_MU "µ"
+#define PORTA_LATENCIA "latency"
+
+/* Trechos do sinal, em fracao da duracao */
+#define INICIO_DT 0.60
+#define FIM_DT 0.75
+#define INICIO_REGIME 0.40
+#define INICIO_POS_DT 0.85
+
+/* Niveis (RMS) */
+#define NIVEL_REMOTO 0.1
+#define NIVEL_LOCAL 0.05
+#define NIVEL_RUIDO 0.001
+
+/* Energia do caminho de eco (ERL de 6 dB) */
+#define ENERGIA_CAMINHO 0.25
+
+/* Janelas com eco abaixo disso (por amostra) nao entram na serie */
+#define ENERGIA_MINIMA 1e-6
+
+#define NO_CAMINHOS 3
+
+typedef struct
+{
+
+    const char * m_pcNome;
+
+    double m_dAtrasoMs;
+
+    double m_dTauMs;
+
+} Caminho;
+
+static const Caminho g_asCaminhos[NO_CAMINHOS] =
+{
+    { "curto", 1, 4 },
+    { "medio", 3, 12 },
+    { "longo", 8, 40 }
+};
+
+/*****************************************************************************/
+
+/* Uma lista de valores da linha de comando */
+typedef struct
+{
+
+    unsigned long m_lValores;
+
+    double m_adValores[MAX_VALORES];
+
+} Lista;
+
+static void leLista(Lista * psLista, const char * pcTexto)
+{
+
+    char * pcFim;
+
+    psLista->m_lValores = 0;
+    while (*pcTexto != '\0' && psLista->m_lValores < MAX_VALORES)
+    {
+        psLista->m_adValores[psLista->m_lValores++] = strtod(pcTexto, &pcFim);
+        if (pcFim == pcTexto)
+        {
+            fprintf(stderr, "lista invalida: %s\n", pcTexto);
+            exit(EXIT_FAILURE);
+        }
+        pcTexto = *pcFim == ',' ? pcFim + 1 : pcFim;
+    }
+}
+
+/*****************************************************************************/
+
+/* Escala pfSinal[0..lAmostras) para o valor RMS dado */
+static void normaliza(float * pfSinal, unsigned long lAmostras, double dRms)
+{
+
+    unsigned long lIndex;
+    double dEnergia;
+    double dGanho;
+
+    dEnergia = 0;
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+        dEnergia += (double)pfSinal[lIndex] * pfSinal[lIndex];
+    if (dEnergia <= 0)
+        return;
+    dGanho = dRms / sqrt(dEnergia / lAmostras);
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+        pfSinal[lIndex] = (float)(pfSinal[lIndex] * dGanho);
+}
+
+/* Fala sintetica: silabas de 120 a 320 ms (um quarto delas mudas) com
+   envelope sen^2; a excitacao e' um trem de pulsos em dPitch Hz mais um
+   pouco de ruido, filtrada por dois ressonadores (formantes) sorteados
+   a cada silaba */
+static void geraFala(float * pfSaida, unsigned long lAmostras, unsigned long lTaxa, double dPitch, unsigned long lSemente)
+{
+
+    unsigned long lIndex;
+    unsigned long lSilaba;
+    unsigned long lDuracao;
+    int iAtiva;
+    int iFormante;
+    double adA1[2];
+    double adA2[2];
+    double adY1[2];
+    double adY2[2];
+    double dFase;
+    double dPasso;
+    double dAmostra;
+    double dY;
+    double dFrequencia;
+
+    memset(adY1, 0, sizeof(adY1));
+    memset(adY2, 0, sizeof(adY2));
+    memset(adA1, 0, sizeof(adA1));
+    memset(adA2, 0, sizeof(adA2));
+    dFase = 0;
+    dPasso = 0;
+    lSilaba = 0;
+    lDuracao = 0;
+    iAtiva = 0;
+
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        if (lSilaba == lDuracao)
+        {
+            lSilaba = 0;
+            lDuracao = (unsigned long)((0.12 + 0.4 * (hostNoise(&lSemente) + 0.5f)) * lTaxa);
+            iAtiva = hostNoise(&lSemente) > -0.25f;
+            dPasso = dPitch * (1 + 0.2 * hostNoise(&lSemente)) / lTaxa;
+            for (iFormante = 0; iFormante < 2; iFormante++)
+            {
+                dFrequencia = iFormante == 0 ? 300 + 600 * (hostNoise(&lSemente) + 0.5f) : 900 + 1600 * (hostNoise(&lSemente) + 0.5f);
+                if (dFrequencia > 0.4 * lTaxa)
+                    dFrequencia = 0.4 * lTaxa;
+                adA1[iFormante] = 2 * 0.97 * cos(2 * M_PI * dFrequencia / lTaxa);
+                adA2[iFormante] = -0.97 * 0.97;
+            }
+        }
+
+        dFase += dPasso;
+        dAmostra = 0.1 * hostNoise(&lSemente);
+        if (dFase >= 1)
+        {
+            dFase -= 1;
+            dAmostra += 1;
+        }
+        for (iFormante = 0; iFormante < 2; iFormante++)
+        {
+            dY = dAmostra + adA1[iFormante] * adY1[iFormante] + adA2[iFormante] * adY2[iFormante];
+            adY2[iFormante] = adY1[iFormante];
+            adY1[iFormante] = dY;
+            dAmostra = dY;
+        }
+
+        dY = sin(M_PI * (double)lSilaba / lDuracao);
+        pfSaida[lIndex] = iAtiva ? (float)(dAmostra * dY * dY) : 0;
+        lSilaba++;
+    }
+}
+
+/* Resposta ao impulso: ruido com decaimento exponencial, ate -52 dB */
+static float * geraCaminho(const Caminho * psCaminho, unsigned long lTaxa, unsigned long * plTamanho)
+{
+
+    float * pfCaminho;
+    unsigned long lAtraso;
+    unsigned long lIndex;
+    unsigned long lSemente;
+    double dTau;
+
+    lAtraso = (unsigned long)(psCaminho->m_dAtrasoMs * lTaxa / 1000);
+    dTau = psCaminho->m_dTauMs * lTaxa / 1000;
+    *plTamanho = lAtraso + (unsigned long)(6 * dTau) + 1;
+
+    pfCaminho = (float *)calloc(*plTamanho, sizeof(float));
+    if (pfCaminho == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    lSemente = 777;
+    for (lIndex = lAtraso; lIndex < *plTamanho; lIndex++)
+        pfCaminho[lIndex] = (float)(hostNoise(&lSemente) * exp(-(double)(lIndex - lAtraso) / dTau));
+    normaliza(pfCaminho, *plTamanho, sqrt(ENERGIA_CAMINHO / *plTamanho));
+
+    return pfCaminho;
+}
+
+/* pfEco[n] = (h * x)(n), contando com zeros antes de x[0] */
+static void convolve(const float * pfX, float * pfEco, unsigned long lAmostras, const float * pfCaminho, unsigned long lTamanho)
+{
+
+    unsigned long lIndex;
+    unsigned long lCoef;
+    double dSoma;
+
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        dSoma = 0;
+        for (lCoef = 0; lCoef < lTamanho && lCoef <= lIndex; lCoef++)
+            dSoma += (double)pfCaminho[lCoef] * pfX[lIndex - lCoef];
+        pfEco[lIndex] = (float)dSoma;
+    }
+}
+
+/*****************************************************************************/
+
+/* Uma instancia com as portas ligadas; d(n) e x(n) sao religadas a cada bloco */
+typedef struct
+{
+
+    const LADSPA_Descriptor * m_psDescritor;
+
+    LADSPA_Handle m_hInstancia;
+
+    LADSPA_Data m_afPortas[MAX_PORTS];
+
+    unsigned long m_alEntradas[2];
+
+    unsigned long m_lSaida;
+
+    long m_lLatencia; /* Porta "latency" (ou -1) */
+
+} Rodada;
+
+static void comeca(Rodada * psRodada, const LADSPA_Descriptor * psDescritor, unsigned long lTaxa, double dTamanho)
+{
+
+    unsigned long lPorta;
+    unsigned long lEntradas;
+    long lTamanho;
+
+    psRodada->m_psDescritor = psDescritor;
+    psRodada->m_hInstancia = psDescritor->instantiate(psDescritor, lTaxa);
+    if (psRodada->m_hInstancia == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    lEntradas = 0;
+    psRodada->m_lLatencia = -1;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+    {
+        if (LADSPA_IS_PORT_CONTROL(psDescritor->PortDescriptors[lPorta]))
+        {
+            psRodada->m_afPortas[lPorta] = hostDefault(&psDescritor->PortRangeHints[lPorta], lTaxa);
+            psDescritor->connect_port(psRodada->m_hInstancia, lPorta, psRodada->m_afPortas + lPorta);
+            if (LADSPA_IS_PORT_OUTPUT(psDescritor->PortDescriptors[lPorta]) && strcmp(psDescritor->PortNames[lPorta], PORTA_LATENCIA) == 0)
+                psRodada->m_lLatencia = (long)lPorta;
+        }
+        else if (LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]))
+        {
+            psRodada->m_alEntradas[lEntradas++] = lPorta;
+        }
+        else
+        {
+            psRodada->m_lSaida = lPorta;
+        }
+    }
+    lTamanho = hostFindPort(psDescritor, PORTA_TAMANHO);
+    psRodada->m_afPortas[lTamanho] = (LADSPA_Data)dTamanho;
+
+    if (psDescritor->activate != NULL)
+        psDescritor->activate(psRodada->m_hInstancia);
+}
+
+/* Processa lAmostras de x(n) e d(n) em blocos de lBloco, saida em pfE */
+static void processa(Rodada * psRodada, const float * pfX, const float * pfD, float * pfE, unsigned long lAmostras, unsigned long lBloco)
+{
+
+    const LADSPA_Descriptor * psDescritor;
+    unsigned long lInicio;
+    unsigned long lTamanho;
+
+    psDescritor = psRodada->m_psDescritor;
+    for (lInicio = 0; lInicio < lAmostras; lInicio += lTamanho)
+    {
+        lTamanho = lAmostras - lInicio < lBloco ? lAmostras - lInicio : lBloco;
+        psDescritor->connect_port(psRodada->m_hInstancia, psRodada->m_alEntradas[0], (LADSPA_Data *)pfD + lInicio);
+        psDescritor->connect_port(psRodada->m_hInstancia, psRodada->m_alEntradas[1], (LADSPA_Data *)pfX + lInicio);
+        psDescritor->connect_port(psRodada->m_hInstancia, psRodada->m_lSaida, pfE + lInicio);
+        psDescritor->run(psRodada->m_hInstancia, lTamanho);
+    }
+}
+
+/* Atraso declarado pelo descritor, em amostras (no maximo lAmostras) */
+static unsigned long latencia(const Rodada * psRodada, unsigned long lAmostras)
+{
+
+    float fLatencia;
+
+    if (psRodada->m_lLatencia < 0)
+        return 0;
+    fLatencia = psRodada->m_afPortas[psRodada->m_lLatencia];
+    if (!(fLatencia > 0))
+        return 0;
+    return (unsigned long)fLatencia < lAmostras ? (unsigned long)fLatencia : lAmostras;
+}
+
+/* Tira de pfE as lLatencia amostras de atraso, para e(n) ficar alinhado
+   com d(n); o fim, que o filtro ainda nao entregou, fica em zero e nao
+   entra nas medidas */
+static void alinha(float * pfE, unsigned long lAmostras, unsigned long lLatencia)
+{
+    memmove(pfE, pfE + lLatencia, (lAmostras - lLatencia) * sizeof(float));
+    memset(pfE + lAmostras - lLatencia, 0, lLatencia * sizeof(float));
+}
+
+/* Congela a adaptacao (portas "µ..." em zero), continua x(n) com
+   ruido branco por lSonda amostras e devolve o desalinhamento em dB */
+static double desalinhamento(Rodada * psRodada, const float * pfX, unsigned long lAte,
+                             const float * pfCaminho, unsigned long lTamanho, unsigned long lSonda, unsigned long lBloco)
+{
+
+    const LADSPA_Descriptor * psDescritor;
+    unsigned long lPorta;
+    unsigned long lHistorico;
+    unsigned long lIndex;
+    unsigned long lSemente;
+    unsigned long lLatencia;
+    float * pfXs;
+    float * pfDs;
+    float * pfEs;
+    double dEco;
+    double dResiduo;
+
+    psDescritor = psRodada->m_psDescritor;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+        if (LADSPA_IS_PORT_CONTROL(psDescritor->PortDescriptors[lPorta]) && LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta])
+            && strncmp(psDescritor->PortNames[lPorta], PREFIXO_MU, strlen(PREFIXO_MU)) == 0)
+            psRodada->m_afPortas[lPorta] = 0;
+
+    /* O eco da sonda inclui o final de x(n) que ainda esta no caminho */
+    lHistorico = lAte < lTamanho ? lAte : lTamanho;
+    pfXs = (float *)calloc(lHistorico + lSonda, sizeof(float));
+    pfDs = (float *)calloc(lHistorico + lSonda, sizeof(float));
+    pfEs = (float *)calloc(lSonda, sizeof(float));
+    if (pfXs == NULL || pfDs == NULL || pfEs == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(pfXs, pfX + lAte - lHistorico, lHistorico * sizeof(float));
+    lSemente = 4242;
+    for (lIndex = 0; lIndex < lSonda; lIndex++)
+        pfXs[lHistorico + lIndex] = (float)(NIVEL_REMOTO * 3.4641 * hostNoise(&lSemente));
+    convolve(pfXs, pfDs, lHistorico + lSonda, pfCaminho, lTamanho);
+
+    processa(psRodada, pfXs + lHistorico, pfDs + lHistorico, pfEs, lSonda, lBloco);
+    lLatencia = latencia(psRodada, lSonda);
+    alinha(pfEs, lSonda, lLatencia);
+
+    dEco = 0;
+    dResiduo = 0;
+    for (lIndex = 0; lIndex < lSonda - lLatencia; lIndex++)
+    {
+        dEco += (double)pfDs[lHistorico + lIndex] * pfDs[lHistorico + lIndex];
+        dResiduo += (double)pfEs[lIndex] * pfEs[lIndex];
+    }
+
+    free(pfXs);
+    free(pfDs);
+    free(pfEs);
+
+    return 10 * log10((dResiduo + 1e-30) / (dEco + 1e-30));
+}
+
+static void termina(Rodada * psRodada)
+{
+    psRodada->m_psDescritor->cleanup(psRodada->m_hInstancia);
+}
+
+/*****************************************************************************/
+
+/* Um ponto da curva custo x qualidade */
+typedef struct
+{
+
+    const char * m_pcArquivo;
+
+    const LADSPA_Descriptor * m_psDescritor;
+
+    double m_dTamanho;
+
+    double m_dNsAmostra;
+
+    double m_dErleRegime;
+
+    double m_dErlePosDt;
+
+    double m_adTempos[MAX_VALORES];
+
+    double m_dDesalinhamentoDt;
+
+    double m_dDesalinhamentoFim;
+
+} Ponto;
+
+/* Sinais de um caminho, compartilhados por todos os descritores */
+typedef struct
+{
+
+    const Caminho * m_psCaminho;
+
+    unsigned long m_lTaxa;
+
+    unsigned long m_lAmostras;
+
+    float * m_pfCaminho;
+
+    unsigned long m_lTamanho;
+
+    float * m_pfX;
+
+    float * m_pfEco;
+
+    float * m_pfLocal; /* Fala local mais ruido */
+
+    float * m_pfD;
+
+} Cenario;
+
+static void montaCenario(Cenario * psCenario, const Caminho * psCaminho, unsigned long lTaxa, double dSegundos)
+{
+
+    unsigned long lAmostras;
+    unsigned long lInicioDt;
+    unsigned long lFimDt;
+    unsigned long lIndex;
+    unsigned long lSemente;
+
+    lAmostras = (unsigned long)(dSegundos * lTaxa);
+    psCenario->m_psCaminho = psCaminho;
+    psCenario->m_lTaxa = lTaxa;
+    psCenario->m_lAmostras = lAmostras;
+    psCenario->m_pfCaminho = geraCaminho(psCaminho, lTaxa, &psCenario->m_lTamanho);
+    psCenario->m_pfX = (float *)calloc(lAmostras, sizeof(float));
+    psCenario->m_pfEco = (float *)calloc(lAmostras, sizeof(float));
+    psCenario->m_pfLocal = (float *)calloc(lAmostras, sizeof(float));
+    psCenario->m_pfD = (float *)calloc(lAmostras, sizeof(float));
+    if (psCenario->m_pfX == NULL || psCenario->m_pfEco == NULL || psCenario->m_pfLocal == NULL || psCenario->m_pfD == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    geraFala(psCenario->m_pfX, lAmostras, lTaxa, 120, 12345);
+    normaliza(psCenario->m_pfX, lAmostras, NIVEL_REMOTO);
+    convolve(psCenario->m_pfX, psCenario->m_pfEco, lAmostras, psCenario->m_pfCaminho, psCenario->m_lTamanho);
+
+    lInicioDt = (unsigned long)(INICIO_DT * lAmostras);
+    lFimDt = (unsigned long)(FIM_DT * lAmostras);
+    geraFala(psCenario->m_pfLocal + lInicioDt, lFimDt - lInicioDt, lTaxa, 210, 54321);
+    normaliza(psCenario->m_pfLocal + lInicioDt, lFimDt - lInicioDt, NIVEL_LOCAL);
+
+    lSemente = 999;
+    for (lIndex = 0; lIndex < lAmostras; lIndex++)
+    {
+        psCenario->m_pfLocal[lIndex] += (float)(NIVEL_RUIDO * 3.4641 * hostNoise(&lSemente));
+        psCenario->m_pfD[lIndex] = psCenario->m_pfEco[lIndex] + psCenario->m_pfLocal[lIndex];
+    }
+}
+
+static void liberaCenario(Cenario * psCenario)
+{
+    free(psCenario->m_pfCaminho);
+    free(psCenario->m_pfX);
+    free(psCenario->m_pfEco);
+    free(psCenario->m_pfLocal);
+    free(psCenario->m_pfD);
+}
+
+/* ERLE verdadeira (eco / eco residual) em [lInicio, lFim), em dB */
+static double erle(const Cenario * psCenario, const float * pfE, unsigned long lInicio, unsigned long lFim)
+{
+
+    unsigned long lIndex;
+    double dEco;
+    double dResiduo;
+    double dR;
+
+    dEco = 0;
+    dResiduo = 0;
+    for (lIndex = lInicio; lIndex < lFim; lIndex++)
+    {
+        dR = (double)pfE[lIndex] - psCenario->m_pfLocal[lIndex];
+        dEco += (double)psCenario->m_pfEco[lIndex] * psCenario->m_pfEco[lIndex];
+        dResiduo += dR * dR;
+    }
+    if (dEco < ENERGIA_MINIMA * (lFim - lInicio))
+        return NAN;
+    return 10 * log10(dEco / (dResiduo + 1e-30));
+}
+
+/* Roda um descritor num cenario e preenche psPonto */
+static void mede(Ponto * psPonto, const Cenario * psCenario, const Lista * psNiveis, unsigned long lJanela,
+                 unsigned long lBloco, FILE * pfSerie)
+{
+
+    Rodada sRodada;
+    float * pfE;
+    unsigned long lAmostras;
+    unsigned long lInicioDt;
+    unsigned long lInicio;
+    unsigned long lSonda;
+    unsigned long lNivel;
+    unsigned long lLatencia;
+    double dTempo;
+    double dErle;
+
+    lAmostras = psCenario->m_lAmostras;
+    lInicioDt = (unsigned long)(INICIO_DT * lAmostras);
+    lSonda = psCenario->m_lTaxa > 4 * psCenario->m_lTamanho ? psCenario->m_lTaxa : 4 * psCenario->m_lTamanho;
+    pfE = (float *)calloc(lAmostras, sizeof(float));
+    if (pfE == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Rodada principal: custo, ERLE e desalinhamento no fim */
+    comeca(&sRodada, psPonto->m_psDescritor, psCenario->m_lTaxa, psPonto->m_dTamanho);
+    dTempo = hostSeconds();
+    processa(&sRodada, psCenario->m_pfX, psCenario->m_pfD, pfE, lAmostras, lBloco);
+    dTempo = hostSeconds() - dTempo;
+    psPonto->m_dNsAmostra = dTempo * 1e9 / (double)lAmostras;
+    lLatencia = latencia(&sRodada, lAmostras);
+    alinha(pfE, lAmostras, lLatencia);
+    psPonto->m_dDesalinhamentoFim = desalinhamento(&sRodada, psCenario->m_pfX, lAmostras,
+                                                   psCenario->m_pfCaminho, psCenario->m_lTamanho, lSonda, lBloco);
+    termina(&sRodada);
+
+    psPonto->m_dErleRegime = erle(psCenario, pfE, (unsigned long)(INICIO_REGIME * lAmostras), lInicioDt);
+    psPonto->m_dErlePosDt = erle(psCenario, pfE, (unsigned long)(INICIO_POS_DT * lAmostras), lAmostras - lLatencia);
+
+    for (lNivel = 0; lNivel < psNiveis->m_lValores; lNivel++)
+        psPonto->m_adTempos[lNivel] = NAN;
+    for (lInicio = 0; lInicio + lJanela <= lAmostras - lLatencia; lInicio += lJanela)
+    {
+        dErle = erle(psCenario, pfE, lInicio, lInicio + lJanela);
+        if (pfSerie != NULL)
+        {
+            fprintf(pfSerie, "%s,%s,%lu,%s,%g,%.3f,", psPonto->m_pcArquivo, psPonto->m_psDescritor->Label, psPonto->m_psDescritor->UniqueID,
+                    psCenario->m_psCaminho->m_pcNome, psPonto->m_dTamanho, (double)(lInicio + lJanela) / psCenario->m_lTaxa);
+            if (isnan(dErle))
+                fputs("\n", pfSerie);
+            else
+                fprintf(pfSerie, "%.2f\n", dErle);
+        }
+        if (lInicio + lJanela > lInicioDt || isnan(dErle))
+            continue;
+        for (lNivel = 0; lNivel < psNiveis->m_lValores; lNivel++)
+            if (isnan(psPonto->m_adTempos[lNivel]) && dErle >= psNiveis->m_adValores[lNivel])
+                psPonto->m_adTempos[lNivel] = (double)(lInicio + lJanela) / psCenario->m_lTaxa;
+    }
+
+    /* Desalinhamento antes da fala dupla: outra instancia ate la */
+    comeca(&sRodada, psPonto->m_psDescritor, psCenario->m_lTaxa, psPonto->m_dTamanho);
+    processa(&sRodada, psCenario->m_pfX, psCenario->m_pfD, pfE, lInicioDt, lBloco);
+    psPonto->m_dDesalinhamentoDt = desalinhamento(&sRodada, psCenario->m_pfX, lInicioDt,
+                                                  psCenario->m_pfCaminho, psCenario->m_lTamanho, lSonda, lBloco);
+    termina(&sRodada);
+
+    free(pfE);
+}
+
+/* psA domina psB: nao e' mais caro, nao e' pior, e e' estritamente
+   melhor em algum dos dois */
+static int domina(const Ponto * psA, const Ponto * psB)
+{
+    if (isnan(psA->m_dErleRegime))
+        return 0;
+    if (isnan(psB->m_dErleRegime))
+        return 1;
+    return psA->m_dNsAmostra <= psB->m_dNsAmostra && psA->m_dErleRegime >= psB->m_dErleRegime
+           && (psA->m_dNsAmostra < psB->m_dNsAmostra || psA->m_dErleRegime > psB->m_dErleRegime);
+}
+
+static void imprimeNumero(double dValor, const char * pcFormato)
+{
+    putchar(',');
+    if (!isnan(dValor))
+        printf(pcFormato, dValor);
+}
+
+/* Imprime os pontos de um caminho com as marcas de Pareto */
+static void imprime(const Cenario * psCenario, const Ponto * psPontos, unsigned long lPontos, const Lista * psNiveis)
+{
+
+    unsigned long lPonto;
+    unsigned long lOutro;
+    unsigned long lNivel;
+    int iMotor;
+    int iGlobal;
+
+    for (lPonto = 0; lPonto < lPontos; lPonto++)
+    {
+        iMotor = 1;
+        iGlobal = 1;
+        for (lOutro = 0; lOutro < lPontos; lOutro++)
+        {
+            if (!domina(psPontos + lOutro, psPontos + lPonto))
+                continue;
+            iGlobal = 0;
+            if (psPontos[lOutro].m_psDescritor == psPontos[lPonto].m_psDescritor)
+                iMotor = 0;
+        }
+
+        printf("%s,%s,%lu,%lu,%s,%g,%.3f", psPontos[lPonto].m_pcArquivo, psPontos[lPonto].m_psDescritor->Label,
+               psPontos[lPonto].m_psDescritor->UniqueID, psCenario->m_lTaxa, psCenario->m_psCaminho->m_pcNome,
+               psPontos[lPonto].m_dTamanho, psPontos[lPonto].m_dNsAmostra);
+        imprimeNumero(psPontos[lPonto].m_dErleRegime, "%.2f");
+        imprimeNumero(psPontos[lPonto].m_dErlePosDt, "%.2f");
+        for (lNivel = 0; lNivel < psNiveis->m_lValores; lNivel++)
+            imprimeNumero(psPontos[lPonto].m_adTempos[lNivel], "%.3f");
+        imprimeNumero(psPontos[lPonto].m_dDesalinhamentoDt, "%.2f");
+        imprimeNumero(psPontos[lPonto].m_dDesalinhamentoFim, "%.2f");
+        printf(",%d,%d\n", iMotor, iGlobal);
+    }
+    fflush(stdout);
+}
+
+/*****************************************************************************/
+
+#define USO "Uso: qualidade [-r taxa] [-l tamanhos] [-c caminhos] [-n niveis] [-s segundos] [-j janela ms] [-b bloco] [-t serie.csv] [-q] <plugin.so>...\n"
+
+int main(int argc, char ** argv)
+{
+
+    Lista sTamanhos;
+    Lista sNiveis;
+    int aiCaminhos[NO_CAMINHOS];
+    int iCaminhos;
+    int iCaminho;
+    int iOpcao;
+    int iArquivo;
+    unsigned long lTaxa;
+    unsigned long lBloco;
+    unsigned long lJanela;
+    unsigned long lTamanho;
+    unsigned long lNivel;
+    unsigned long lDescritor;
+    unsigned long lPontos;
+    double dSegundos;
+    double dJanelaMs;
+    char * pcCaminho;
+    FILE * pfSerie;
+    LADSPA_Descriptor_Function fDescritor;
+    const LADSPA_Descriptor * psDescritor;
+    Cenario sCenario;
+    Ponto * psPontos;
+
+    lTaxa = 16000;
+    leLista(&sTamanhos, "32,64,128,256");
+    leLista(&sNiveis, "10,20,30");
+    for (iCaminhos = 0; iCaminhos < NO_CAMINHOS; iCaminhos++)
+        aiCaminhos[iCaminhos] = iCaminhos;
+    dSegundos = 10;
+    dJanelaMs = 200;
+    lBloco = 256;
+    pfSerie = NULL;
+
+    while ((iOpcao = getopt(argc, argv, "r:l:c:n:s:j:b:t:q")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'r':
+            lTaxa = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            leLista(&sTamanhos, optarg);
+            break;
+        case 'c':
+            iCaminhos = 0;
+            for (pcCaminho = strtok(optarg, ","); pcCaminho != NULL && iCaminhos < NO_CAMINHOS; pcCaminho = strtok(NULL, ","))
+            {
+                for (iCaminho = 0; iCaminho < NO_CAMINHOS && strcmp(pcCaminho, g_asCaminhos[iCaminho].m_pcNome) != 0; iCaminho++);
+                if (iCaminho == NO_CAMINHOS)
+                {
+                    fprintf(stderr, "caminho desconhecido: %s\n", pcCaminho);
+                    return EXIT_FAILURE;
+                }
+                aiCaminhos[iCaminhos++] = iCaminho;
+            }
+            break;
+        case 'n':
+            leLista(&sNiveis, optarg);
+            break;
+        case 's':
+            dSegundos = atof(optarg);
+            break;
+        case 'j':
+            dJanelaMs = atof(optarg);
+            break;
+        case 'b':
+            lBloco = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            pfSerie = fopen(optarg, "w");
+            if (pfSerie == NULL)
+            {
+                perror(optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'q':
+            lTaxa = 8000;
+            leLista(&sTamanhos, "32,64");
+            aiCaminhos[0] = 0;
+            iCaminhos = 1;
+            dSegundos = 6;
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || lTaxa == 0 || lBloco == 0 || dSegundos <= 0)
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+    lJanela = (unsigned long)(dJanelaMs * lTaxa / 1000);
+    if (lJanela == 0)
+        lJanela = 1;
+
+    psPontos = (Ponto *)calloc(MAX_PONTOS, sizeof(Ponto));
+    if (psPontos == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("arquivo,label,id,taxa,caminho,tamanho_ms,ns_amostra,erle_regime_db,erle_pos_dt_db");
+    for (lNivel = 0; lNivel < sNiveis.m_lValores; lNivel++)
+        printf(",t%g_s", sNiveis.m_adValores[lNivel]);
+    printf(",desalinhamento_dt_db,desalinhamento_fim_db,pareto_motor,pareto_global\n");
+    if (pfSerie != NULL)
+        fputs("arquivo,label,id,caminho,tamanho_ms,tempo_s,erle_db\n", pfSerie);
+
+    for (iCaminho = 0; iCaminho < iCaminhos; iCaminho++)
+    {
+        montaCenario(&sCenario, g_asCaminhos + aiCaminhos[iCaminho], lTaxa, dSegundos);
+        lPontos = 0;
+
+        for (iArquivo = optind; iArquivo < argc; iArquivo++)
+        {
+            fDescritor = hostOpen(argv[iArquivo]);
+            if (fDescritor == NULL)
+                continue;
+
+            /* So canceladores: porta de tamanho e entradas d(n) e x(n) */
+            for (lDescritor = 0; (psDescritor = fDescritor(lDescritor)) != NULL; lDescritor++)
+            {
+                if (psDescritor->PortCount > MAX_PORTS || hostFindPort(psDescritor, PORTA_TAMANHO) < 0
+                    || hostCountPorts(psDescritor, LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO) != 2)
+                    continue;
+                for (lTamanho = 0; lTamanho < sTamanhos.m_lValores && lPontos < MAX_PONTOS; lTamanho++)
+                {
+                    psPontos[lPontos].m_pcArquivo = argv[iArquivo];
+                    psPontos[lPontos].m_psDescritor = psDescritor;
+                    psPontos[lPontos].m_dTamanho = sTamanhos.m_adValores[lTamanho];
+                    mede(psPontos + lPontos, &sCenario, &sNiveis, lJanela, lBloco, pfSerie);
+                    lPontos++;
+                }
+            }
+        }
+
+        imprime(&sCenario, psPontos, lPontos, &sNiveis);
+        liberaCenario(&sCenario);
+    }
+
+    if (pfSerie != NULL)
+        fclose(pfSerie);
+    free(psPontos);
+
+    return EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+/* EOF */
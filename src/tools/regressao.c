@@ -0,0 +1,645 @@
+/* regressao.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Regressao contra saidas de referencia ("golden"). Com -g, roda cada
+   descritor das bibliotecas dadas sobre tres conjuntos fixos de sinais
+   com o nucleo escalar (AEC_KERNEL=scalar) e grava em <dir> um arquivo
+   por descritor e sinal. Sem -g, roda de novo com cada nucleo suportado
+   pela maquina (scalar, sse, avx2, avx512) e compara com o arquivo
+   gravado. Os sinais sao as cenas de hostSignals() (hospedeiro.h):
+
+     eco         ruido colorido em x(n), d(n) = eco de 20 ms + ruido
+     fala_dupla  o mesmo, com um sinal local em d(n) na segunda metade
+     troca       o caminho de eco muda (e inverte) na metade do sinal
+
+   Sao comparadas as saidas de audio amostra a amostra e as saidas de
+   controle (os medidores de medidores.h, que expoem o estado interno do
+   filtro: ERLE, taxa de adaptacao, DTD e alfa) bloco a bloco. Uma
+   diferenca passa se |obtido - esperado| <= abs + rel * |esperado|, com
+   abs e rel por motor (g_asTolerancias; -a e -e mudam o padrao). Na
+   primeira falha de cada rodada, imprime a porta, a amostra, o bloco e
+   os dois valores.
+
+   Cada descritor com ao menos uma entrada de audio (fora os de
+   g_apcIgnorados) roda com os controles de hostExercise(): filtro de
+   32 ms, DTD e Set-Membership abertos para o filtro adaptar em toda a
+   cena e coeficientes nao nulos nos filtros fixos. O rirconv le o
+   caminho de eco das cenas, gravado num arquivo temporario apontado por
+   RIRCONV_ARQUIVO. Com duas entradas, a primeira recebe d(n) e a
+   segunda x(n). Os blocos tem 160 amostras, que nao e' multiplo da
+   largura de nenhum nucleo.
+
+   Uma referencia de um filtro parado nao pega nada, entao cada rodada
+   (inclusive com -g) falha se o filtro nao trabalhou: com o medidor de
+   taxa de adaptacao, se o filtro atualizou os coeficientes em menos de
+   TAXA_MINIMA das amostras; sem ele, se a saida for nula ou igual a'
+   primeira entrada.
+
+   As referencias dependem do compilador, de -march=native e da BLAS, por
+   isso nao ficam no repositorio: grave-as com make golden antes de uma
+   mudanca e confira com make regressao depois.
+
+   Uso: regressao [-g] [-a abs] [-e rel] [-v] <dir> <plugin.so>... */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ladspa.h"
+#include "simd.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define MAX_PORTS 512
+#define MAX_NOME 1024
+
+#define SAMPLE_RATE 16000
+#define AMOSTRAS (2 * SAMPLE_RATE)
+#define TAM_BLOCO 160
+#define BLOCOS ((AMOSTRAS + TAM_BLOCO - 1) / TAM_BLOCO)
+#define TAMANHO_MS 32
+
+#define PORTA_TAXA "Taxa de adaptacao"
+#define TAXA_MINIMA 0.01 /* Fracao minima das amostras da cena em que o filtro adapta */
+
+#define GOLDEN_MAGIC "AECGOLD1"
+#define GOLDEN_VERSION 1
+
+#define SINAL_ECO HOST_SCENE_ECHO
+#define SINAL_FALA_DUPLA HOST_SCENE_DOUBLE_TALK
+#define SINAL_TROCA HOST_SCENE_SWAP
+#define NO_SINAIS 3
+
+static const char * g_apcSinais[NO_SINAIS] = { "eco", "fala_dupla", "troca" };
+
+/*****************************************************************************/
+
+/* Tolerancias por motor, pelo Label. Os motores inteiros (Q15) e os de
+   coeficientes em 16 bits (cujos nucleos somam na mesma ordem) tem de
+   ser identicos; os de ponto flutuante mudam a ordem das somas entre
+   nucleos e entre BLAS, e o filtro adaptativo propaga a diferenca. */
+typedef struct
+{
+
+    const char * m_pcLabel;
+
+    double m_dAbs;
+
+    double m_dRel;
+
+} Tolerancia;
+
+static const Tolerancia g_asTolerancias[] =
+{
+    { "adapt_qnlmscncr", 0, 0 },
+    { "adapt_nlmscncr_double", 1e-6, 1e-5 },
+    { "adapt_nlmscncr_kahan", 1e-6, 1e-5 },
+    { "adapt_fnlmscncr_fp16", 0, 0 },
+    { "adapt_fnlmscncr_bf16", 0, 0 },
+    { NULL, 0, 0 }
+};
+
+/* Descritores sem saida reproduzivel (hoje nenhum: o noise_white tem
+   gerador proprio por instancia, reiniciado no activate()) */
+static const char * g_apcIgnorados[] = { NULL };
+
+static double g_dAbsPadrao = 1e-5;
+static double g_dRelPadrao = 1e-4;
+
+static int ignorado(const char * pcLabel)
+{
+
+    int iIndex;
+
+    for (iIndex = 0; g_apcIgnorados[iIndex] != NULL; iIndex++)
+        if (strcmp(g_apcIgnorados[iIndex], pcLabel) == 0)
+            return 1;
+    return 0;
+}
+
+static void tolerancia(const char * pcLabel, double * pdAbs, double * pdRel)
+{
+
+    const Tolerancia * psTolerancia;
+
+    *pdAbs = g_dAbsPadrao;
+    *pdRel = g_dRelPadrao;
+    for (psTolerancia = g_asTolerancias; psTolerancia->m_pcLabel != NULL; psTolerancia++)
+        if (strcmp(psTolerancia->m_pcLabel, pcLabel) == 0)
+        {
+            *pdAbs = psTolerancia->m_dAbs;
+            *pdRel = psTolerancia->m_dRel;
+        }
+}
+
+/*****************************************************************************/
+
+/* Saidas de uma rodada: audio amostra a amostra, controle bloco a bloco */
+typedef struct
+{
+
+    unsigned long m_lAudio; /* Numero de saidas de audio */
+
+    unsigned long m_lControle; /* Numero de saidas de controle */
+
+    unsigned long m_alAudio[MAX_PORTS]; /* Indices das portas */
+
+    unsigned long m_alControle[MAX_PORTS];
+
+    float * m_pfAudio; /* m_lAudio x AMOSTRAS */
+
+    float * m_pfControle; /* BLOCOS x m_lControle */
+
+} Saidas;
+
+static void alocaSaidas(Saidas * psSaidas, const LADSPA_Descriptor * psDescritor)
+{
+
+    unsigned long lPorta;
+
+    psSaidas->m_lAudio = 0;
+    psSaidas->m_lControle = 0;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+    {
+        if (!LADSPA_IS_PORT_OUTPUT(psDescritor->PortDescriptors[lPorta]))
+            continue;
+        if (LADSPA_IS_PORT_AUDIO(psDescritor->PortDescriptors[lPorta]))
+            psSaidas->m_alAudio[psSaidas->m_lAudio++] = lPorta;
+        else
+            psSaidas->m_alControle[psSaidas->m_lControle++] = lPorta;
+    }
+
+    psSaidas->m_pfAudio = (float *)calloc(psSaidas->m_lAudio * AMOSTRAS + 1, sizeof(float));
+    psSaidas->m_pfControle = (float *)calloc(psSaidas->m_lControle * BLOCOS + 1, sizeof(float));
+    if (psSaidas->m_pfAudio == NULL || psSaidas->m_pfControle == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void liberaSaidas(Saidas * psSaidas)
+{
+    free(psSaidas->m_pfAudio);
+    free(psSaidas->m_pfControle);
+}
+
+/* Roda o descritor sobre x(n) e d(n) e guarda as saidas */
+static void roda(const LADSPA_Descriptor * psDescritor, const float * pfX, const float * pfD, Saidas * psSaidas)
+{
+
+    LADSPA_Handle hInstancia;
+    LADSPA_Data afPortas[MAX_PORTS];
+    const float * apfEntradas[2];
+    unsigned long alEntradas[2];
+    unsigned long lEntradas;
+    unsigned long lPorta;
+    unsigned long lSaida;
+    unsigned long lInicio;
+    unsigned long lBloco;
+    unsigned long lTamanho;
+
+    hInstancia = psDescritor->instantiate(psDescritor, SAMPLE_RATE);
+    if (hInstancia == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    lEntradas = 0;
+    for (lPorta = 0; lPorta < psDescritor->PortCount; lPorta++)
+    {
+        afPortas[lPorta] = 0;
+        if (LADSPA_IS_PORT_CONTROL(psDescritor->PortDescriptors[lPorta]))
+        {
+            if (LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]))
+                afPortas[lPorta] = hostExercise(psDescritor, lPorta, SAMPLE_RATE, TAMANHO_MS);
+            psDescritor->connect_port(hInstancia, lPorta, afPortas + lPorta);
+        }
+        else if (LADSPA_IS_PORT_INPUT(psDescritor->PortDescriptors[lPorta]))
+        {
+            if (lEntradas < 2)
+                alEntradas[lEntradas++] = lPorta;
+            else
+                psDescritor->connect_port(hInstancia, lPorta, (LADSPA_Data *)pfX);
+        }
+    }
+
+    /* Duas entradas: d(n) e x(n); uma: x(n) */
+    apfEntradas[0] = lEntradas == 2 ? pfD : pfX;
+    apfEntradas[1] = pfX;
+
+    if (psDescritor->activate != NULL)
+        psDescritor->activate(hInstancia);
+
+    for (lBloco = 0, lInicio = 0; lInicio < AMOSTRAS; lBloco++, lInicio += lTamanho)
+    {
+        lTamanho = AMOSTRAS - lInicio < TAM_BLOCO ? AMOSTRAS - lInicio : TAM_BLOCO;
+        for (lPorta = 0; lPorta < lEntradas; lPorta++)
+            psDescritor->connect_port(hInstancia, alEntradas[lPorta], (LADSPA_Data *)apfEntradas[lPorta] + lInicio);
+        for (lSaida = 0; lSaida < psSaidas->m_lAudio; lSaida++)
+            psDescritor->connect_port(hInstancia, psSaidas->m_alAudio[lSaida], psSaidas->m_pfAudio + lSaida * AMOSTRAS + lInicio);
+        psDescritor->run(hInstancia, lTamanho);
+        for (lSaida = 0; lSaida < psSaidas->m_lControle; lSaida++)
+            psSaidas->m_pfControle[lBloco * psSaidas->m_lControle + lSaida] = afPortas[psSaidas->m_alControle[lSaida]];
+    }
+
+    psDescritor->cleanup(hInstancia);
+}
+
+/* O filtro trabalhou na rodada? Imprime a falha e devolve 0 se a taxa
+   media de adaptacao ficou abaixo de TAXA_MINIMA ou, sem o medidor, se
+   a saida e' nula ou a entrada */
+static int trabalhou(const LADSPA_Descriptor * psDescritor, const char * pcRodada, const float * pfEntrada, const Saidas * psSaidas)
+{
+
+    unsigned long lSaida;
+    unsigned long lIndex;
+    int iNula;
+    int iIgual;
+    double dTaxa;
+
+    for (lSaida = 0; lSaida < psSaidas->m_lControle; lSaida++)
+    {
+        if (strcmp(psDescritor->PortNames[psSaidas->m_alControle[lSaida]], PORTA_TAXA) != 0)
+            continue;
+        dTaxa = 0;
+        for (lIndex = 0; lIndex < BLOCOS; lIndex++)
+            dTaxa += psSaidas->m_pfControle[lIndex * psSaidas->m_lControle + lSaida];
+        dTaxa /= BLOCOS;
+        if (dTaxa >= TAXA_MINIMA)
+            return 1;
+        printf("FALHA %s-%lu %s: o filtro quase nao adaptou (taxa de adaptacao media %.4f)\n",
+               psDescritor->Label, psDescritor->UniqueID, pcRodada, dTaxa);
+        return 0;
+    }
+
+    iNula = 1;
+    iIgual = 1;
+    for (lIndex = 0; lIndex < AMOSTRAS && psSaidas->m_lAudio > 0; lIndex++)
+    {
+        if (psSaidas->m_pfAudio[lIndex] != 0)
+            iNula = 0;
+        if (psSaidas->m_pfAudio[lIndex] != pfEntrada[lIndex])
+            iIgual = 0;
+    }
+    if (!iNula && !iIgual)
+        return 1;
+    printf("FALHA %s-%lu %s: o filtro nao filtrou (saida %s)\n",
+           psDescritor->Label, psDescritor->UniqueID, pcRodada, iNula ? "nula" : "igual a' entrada");
+    return 0;
+}
+
+/*****************************************************************************/
+
+/* Cabecalho do arquivo de referencia, seguido de m_lAudio x AMOSTRAS
+   floats de audio e BLOCOS x m_lControle floats de controle */
+typedef struct
+{
+
+    char m_acMagic[8];
+
+    unsigned int m_uiVersion;
+
+    unsigned int m_uiSampleRate;
+
+    unsigned int m_uiAmostras;
+
+    unsigned int m_uiBloco;
+
+    unsigned int m_uiAudio;
+
+    unsigned int m_uiControle;
+
+} GoldenHeader;
+
+static void nomeArquivo(char * pcNome, const char * pcDir, const LADSPA_Descriptor * psDescritor, int iSinal)
+{
+    snprintf(pcNome, MAX_NOME, "%s/%s-%lu.%s.golden", pcDir, psDescritor->Label, psDescritor->UniqueID, g_apcSinais[iSinal]);
+}
+
+static int grava(const char * pcNome, const Saidas * psSaidas)
+{
+
+    GoldenHeader sHeader;
+    FILE * pfArquivo;
+    int iOk;
+
+    memset(&sHeader, 0, sizeof(sHeader));
+    memcpy(sHeader.m_acMagic, GOLDEN_MAGIC, sizeof(sHeader.m_acMagic));
+    sHeader.m_uiVersion = GOLDEN_VERSION;
+    sHeader.m_uiSampleRate = SAMPLE_RATE;
+    sHeader.m_uiAmostras = AMOSTRAS;
+    sHeader.m_uiBloco = TAM_BLOCO;
+    sHeader.m_uiAudio = (unsigned int)psSaidas->m_lAudio;
+    sHeader.m_uiControle = (unsigned int)psSaidas->m_lControle;
+
+    pfArquivo = fopen(pcNome, "wb");
+    if (pfArquivo == NULL)
+    {
+        perror(pcNome);
+        return 0;
+    }
+    iOk = fwrite(&sHeader, sizeof(sHeader), 1, pfArquivo) == 1
+          && fwrite(psSaidas->m_pfAudio, sizeof(float), psSaidas->m_lAudio * AMOSTRAS, pfArquivo) == psSaidas->m_lAudio * AMOSTRAS
+          && fwrite(psSaidas->m_pfControle, sizeof(float), psSaidas->m_lControle * BLOCOS, pfArquivo) == psSaidas->m_lControle * BLOCOS;
+    if (fclose(pfArquivo) != 0 || !iOk)
+    {
+        perror(pcNome);
+        return 0;
+    }
+    return 1;
+}
+
+/* Le a referencia para psEsperado (ja alocado com o mesmo descritor) */
+static int le(const char * pcNome, Saidas * psEsperado)
+{
+
+    GoldenHeader sHeader;
+    FILE * pfArquivo;
+    int iOk;
+
+    pfArquivo = fopen(pcNome, "rb");
+    if (pfArquivo == NULL)
+    {
+        perror(pcNome);
+        return 0;
+    }
+    iOk = fread(&sHeader, sizeof(sHeader), 1, pfArquivo) == 1;
+    if (!iOk || memcmp(sHeader.m_acMagic, GOLDEN_MAGIC, sizeof(sHeader.m_acMagic)) != 0 || sHeader.m_uiVersion != GOLDEN_VERSION
+        || sHeader.m_uiSampleRate != SAMPLE_RATE || sHeader.m_uiAmostras != AMOSTRAS || sHeader.m_uiBloco != TAM_BLOCO
+        || sHeader.m_uiAudio != psEsperado->m_lAudio || sHeader.m_uiControle != psEsperado->m_lControle)
+    {
+        fprintf(stderr, "%s: referencia incompativel, grave de novo com -g.\n", pcNome);
+        fclose(pfArquivo);
+        return 0;
+    }
+    iOk = fread(psEsperado->m_pfAudio, sizeof(float), psEsperado->m_lAudio * AMOSTRAS, pfArquivo) == psEsperado->m_lAudio * AMOSTRAS
+          && fread(psEsperado->m_pfControle, sizeof(float), psEsperado->m_lControle * BLOCOS, pfArquivo) == psEsperado->m_lControle * BLOCOS;
+    fclose(pfArquivo);
+    if (!iOk)
+        fprintf(stderr, "%s: arquivo truncado.\n", pcNome);
+    return iOk;
+}
+
+/*****************************************************************************/
+
+/* Uma diferenca dentro da tolerancia? NaN so casa com NaN */
+static int confere(float fEsperado, float fObtido, double dAbs, double dRel)
+{
+    if (isnan(fEsperado) || isnan(fObtido))
+        return isnan(fEsperado) && isnan(fObtido);
+    if (fEsperado == fObtido)
+        return 1;
+    return fabs((double)fObtido - fEsperado) <= dAbs + dRel * fabs((double)fEsperado);
+}
+
+/* Compara as saidas; imprime a primeira divergencia e devolve 1 se
+   tudo bate. Com iVerboso, imprime tambem a maior diferenca. */
+static int compara(const LADSPA_Descriptor * psDescritor, const char * pcRodada,
+                   const Saidas * psEsperado, const Saidas * psObtido, int iVerboso)
+{
+
+    unsigned long lSaida;
+    unsigned long lIndex;
+    unsigned long lPrimeira;
+    unsigned long lPrimeiraPorta;
+    int iControle;
+    double dAbs;
+    double dRel;
+    double dMaior;
+    const float * pfEsperado;
+    const float * pfObtido;
+
+    tolerancia(psDescritor->Label, &dAbs, &dRel);
+    dMaior = 0;
+    lPrimeira = (unsigned long)-1;
+    lPrimeiraPorta = 0;
+    iControle = 0;
+
+    /* Audio: a primeira amostra divergente entre todas as saidas */
+    for (lSaida = 0; lSaida < psEsperado->m_lAudio; lSaida++)
+    {
+        pfEsperado = psEsperado->m_pfAudio + lSaida * AMOSTRAS;
+        pfObtido = psObtido->m_pfAudio + lSaida * AMOSTRAS;
+        for (lIndex = 0; lIndex < AMOSTRAS; lIndex++)
+        {
+            if (fabs((double)pfObtido[lIndex] - pfEsperado[lIndex]) > dMaior)
+                dMaior = fabs((double)pfObtido[lIndex] - pfEsperado[lIndex]);
+            if (lIndex < lPrimeira && !confere(pfEsperado[lIndex], pfObtido[lIndex], dAbs, dRel))
+            {
+                lPrimeira = lIndex;
+                lPrimeiraPorta = psEsperado->m_alAudio[lSaida];
+            }
+        }
+    }
+
+    /* Estado (controle): so se o audio bateu, no bloco */
+    if (lPrimeira == (unsigned long)-1)
+    {
+        for (lIndex = 0; lIndex < BLOCOS * psEsperado->m_lControle && lPrimeira == (unsigned long)-1; lIndex++)
+        {
+            if (!confere(psEsperado->m_pfControle[lIndex], psObtido->m_pfControle[lIndex], dAbs, dRel))
+            {
+                lPrimeira = lIndex / psEsperado->m_lControle;
+                lPrimeiraPorta = psEsperado->m_alControle[lIndex % psEsperado->m_lControle];
+                iControle = 1;
+            }
+        }
+    }
+
+    if (lPrimeira == (unsigned long)-1)
+    {
+        if (iVerboso)
+            printf("ok    %s-%lu %s (maior diferenca %.3g)\n", psDescritor->Label, psDescritor->UniqueID, pcRodada, dMaior);
+        return 1;
+    }
+
+    if (iControle)
+    {
+        lIndex = lPrimeira * psEsperado->m_lControle;
+        for (lSaida = 0; psEsperado->m_alControle[lSaida] != lPrimeiraPorta; lSaida++);
+        printf("FALHA %s-%lu %s: porta \"%s\", bloco %lu (amostras %lu a %lu): esperado %.9g, obtido %.9g (abs %g, rel %g)\n",
+               psDescritor->Label, psDescritor->UniqueID, pcRodada, psDescritor->PortNames[lPrimeiraPorta],
+               lPrimeira, lPrimeira * TAM_BLOCO, (lPrimeira + 1) * TAM_BLOCO - 1,
+               psEsperado->m_pfControle[lIndex + lSaida], psObtido->m_pfControle[lIndex + lSaida], dAbs, dRel);
+    }
+    else
+    {
+        for (lSaida = 0; psEsperado->m_alAudio[lSaida] != lPrimeiraPorta; lSaida++);
+        printf("FALHA %s-%lu %s: porta \"%s\", amostra %lu (bloco %lu, posicao %lu): esperado %.9g, obtido %.9g (abs %g, rel %g)\n",
+               psDescritor->Label, psDescritor->UniqueID, pcRodada, psDescritor->PortNames[lPrimeiraPorta],
+               lPrimeira, lPrimeira / TAM_BLOCO, lPrimeira % TAM_BLOCO,
+               psEsperado->m_pfAudio[lSaida * AMOSTRAS + lPrimeira], psObtido->m_pfAudio[lSaida * AMOSTRAS + lPrimeira], dAbs, dRel);
+    }
+    return 0;
+}
+
+/*****************************************************************************/
+
+#define USO "Uso: regressao [-g] [-a abs] [-e rel] [-v] <dir> <plugin.so>...\n"
+
+int main(int argc, char ** argv)
+{
+
+    int iGrava;
+    int iVerboso;
+    int iOpcao;
+    int iArquivo;
+    int iSinal;
+    int iNucleo;
+    int iFalhas;
+    int iRodadas;
+    const char * pcDir;
+    const float * pfEntrada;
+    char acNome[MAX_NOME];
+    char acRir[] = "/tmp/regressao-rir-XXXXXX";
+    int iRir;
+    char acRodada[64];
+    LADSPA_Descriptor_Function fDescritor;
+    const LADSPA_Descriptor * psDescritor;
+    unsigned long lDescritor;
+    float * pfX;
+    float * pfD;
+    Saidas sEsperado;
+    Saidas sObtido;
+
+    iGrava = 0;
+    iVerboso = 0;
+    while ((iOpcao = getopt(argc, argv, "ga:e:v")) != -1)
+    {
+        switch (iOpcao)
+        {
+        case 'g':
+            iGrava = 1;
+            break;
+        case 'a':
+            g_dAbsPadrao = atof(optarg);
+            break;
+        case 'e':
+            g_dRelPadrao = atof(optarg);
+            break;
+        case 'v':
+            iVerboso = 1;
+            break;
+        default:
+            fputs(USO, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 >= argc)
+    {
+        fputs(USO, stderr);
+        return EXIT_FAILURE;
+    }
+    pcDir = argv[optind];
+
+    pfX = (float *)calloc(AMOSTRAS, sizeof(float));
+    pfD = (float *)calloc(AMOSTRAS, sizeof(float));
+    if (pfX == NULL || pfD == NULL)
+    {
+        fputs("Out of memory.\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    /* A RIR do rirconv: o caminho de eco das cenas */
+    iRir = mkstemp(acRir);
+    if (iRir < 0)
+    {
+        perror(acRir);
+        return EXIT_FAILURE;
+    }
+    close(iRir);
+    if (!hostWriteRir(acRir, SAMPLE_RATE))
+    {
+        unlink(acRir);
+        return EXIT_FAILURE;
+    }
+    setenv("RIRCONV_ARQUIVO", acRir, 1);
+
+    iFalhas = 0;
+    iRodadas = 0;
+    for (iArquivo = optind + 1; iArquivo < argc; iArquivo++)
+    {
+        fDescritor = hostOpen(argv[iArquivo]);
+        if (fDescritor == NULL)
+        {
+            iFalhas++;
+            continue;
+        }
+
+        for (lDescritor = 0; (psDescritor = fDescritor(lDescritor)) != NULL; lDescritor++)
+        {
+            if (psDescritor->PortCount > MAX_PORTS || ignorado(psDescritor->Label)
+                || hostCountPorts(psDescritor, LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO) == 0)
+                continue;
+
+            alocaSaidas(&sEsperado, psDescritor);
+            alocaSaidas(&sObtido, psDescritor);
+
+            for (iSinal = 0; iSinal < NO_SINAIS; iSinal++)
+            {
+                if (!hostSignals(pfX, pfD, AMOSTRAS, SAMPLE_RATE, iSinal))
+                {
+                    unlink(acRir);
+                    return EXIT_FAILURE;
+                }
+                nomeArquivo(acNome, pcDir, psDescritor, iSinal);
+                pfEntrada = hostCountPorts(psDescritor, LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO) == 2 ? pfD : pfX;
+
+                if (iGrava)
+                {
+                    setenv(SIMD_ENV, simdName(SIMD_SCALAR), 1);
+                    roda(psDescritor, pfX, pfD, &sEsperado);
+                    if (!trabalhou(psDescritor, g_apcSinais[iSinal], pfEntrada, &sEsperado) || !grava(acNome, &sEsperado))
+                        iFalhas++;
+                    else if (iVerboso)
+                        printf("gravado %s\n", acNome);
+                    continue;
+                }
+
+                if (!le(acNome, &sEsperado))
+                {
+                    iFalhas++;
+                    continue;
+                }
+                for (iNucleo = SIMD_SCALAR; iNucleo <= SIMD_AVX512; iNucleo++)
+                {
+                    setenv(SIMD_ENV, simdName(iNucleo), 1);
+                    if (simdLevel() != iNucleo)
+                        continue;
+                    roda(psDescritor, pfX, pfD, &sObtido);
+                    snprintf(acRodada, sizeof(acRodada), "%s/%s", g_apcSinais[iSinal], simdName(iNucleo));
+                    iRodadas++;
+                    if (!trabalhou(psDescritor, acRodada, pfEntrada, &sObtido)
+                        || !compara(psDescritor, acRodada, &sEsperado, &sObtido, iVerboso))
+                        iFalhas++;
+                }
+            }
+
+            liberaSaidas(&sEsperado);
+            liberaSaidas(&sObtido);
+        }
+    }
+    unsetenv(SIMD_ENV);
+    unlink(acRir);
+
+    if (!iGrava)
+        printf("%d rodadas, %d falhas\n", iRodadas, iFalhas);
+
+    free(pfX);
+    free(pfD);
+
+    return iFalhas ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+/* EOF */
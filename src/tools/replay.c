@@ -0,0 +1,310 @@
+/* replay.c
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Reproduz uma gravacao do cancelador (veja gravador.h) em qualquer
+   descritor de uma biblioteca de plugins: os mesmos tamanhos de bloco,
+   os mesmos valores das portas de controle bloco a bloco e os mesmos
+   x(n) e d(n), tao rapido quanto o processador permitir. Depois compara
+   a saida com o e(n) gravado.
+
+   Os controles sao passados pela ordem das portas de controle de
+   entrada; se o plugin de destino tiver mais controles que a gravacao,
+   os que sobram ficam no valor padrao do descritor. A primeira entrada
+   de audio recebe d(n), a segunda x(n), e a primeira saida de audio e'
+   a comparada.
+
+   Imprime a ERLE gravada e a reproduzida, a maior diferenca por amostra,
+   o primeiro bloco diferente e quantas vezes o tempo real a reproducao
+   rodou. Com o mesmo plugin que gravou, e uma gravacao feita desde o
+   instantiate() (AEC_DUMP) sem blocos descartados, a saida deve ser
+   identica bit a bit; uma gravacao ligada no meio da sessao com
+   ladspa_dump() parte de coeficientes que nao foram gravados.
+
+   Gravacoes da versao 2 trazem as decisoes do DTD amostra a amostra;
+   o replay imprime quanto tempo o DTD declarou fala dupla (filtro
+   congelado) e uma linha do tempo com um caractere por 100 ms, de ' '
+   (nenhuma amostra congelada) a '#' (todas).
+
+   Uso: replay <gravacao.aecdump> <plugin.so> [label] [saida.f32] */
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ladspa.h"
+#include "gravador.h"
+#include "hospedeiro.h"
+
+/*****************************************************************************/
+
+#define MAX_PORTS 64
+
+/* Linha do tempo do DTD: janelas de 100 ms, 50 por linha */
+#define JANELAS_POR_SEGUNDO 10
+#define JANELAS_POR_LINHA 50
+
+static const char g_acDensidade[] = " .:-=+*%#";
+
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+
+    LADSPA_Descriptor_Function fDescritor;
+    const LADSPA_Descriptor * psDescritor;
+    LADSPA_Handle hInstancia;
+    DumpFileHeader sCabecalho;
+    DumpBlockHeader sBloco;
+    FILE * psGravacao;
+    FILE * psSaida;
+    LADSPA_Data afControles[MAX_PORTS];
+    LADSPA_Data afMedidores[MAX_PORTS];
+    LADSPA_Data afGravados[DUMP_MAX_CONTROLS];
+    LADSPA_PortDescriptor iPorta;
+    unsigned long alControles[MAX_PORTS]; /* Portas de controle de entrada, em ordem */
+    unsigned long lControles;
+    unsigned long lEntradaD;
+    unsigned long lEntradaX;
+    unsigned long lSaida;
+    unsigned long lPorta;
+    unsigned long lAmostra;
+    unsigned long lTamanho;
+    unsigned long lBlocos;
+    unsigned long lAmostras;
+    unsigned long lDescartados;
+    unsigned long lDiferentes;
+    long lPrimeiroDiferente;
+    float * pfX;
+    float * pfD;
+    float * pfE;
+    float * pfSaida;
+    unsigned char * pucDtd;
+    unsigned long lBytesDtd;
+    unsigned long lFalaDupla;
+    unsigned long * plJanelas; /* Amostras congeladas por janela */
+    unsigned long lJanelas;
+    unsigned long lJanela;
+    unsigned long lPorJanela;
+    unsigned long lTotal;
+    double dPotD;
+    double dPotE;
+    double dPotSaida;
+    double dMaiorDiferenca;
+    double dTempo;
+    double dInicio;
+
+    if (argc < 3)
+    {
+        fputs("Uso: replay <gravacao.aecdump> <plugin.so> [label] [saida.f32]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    psGravacao = fopen(argv[1], "rb");
+    if (psGravacao == NULL || fread(&sCabecalho, sizeof(sCabecalho), 1, psGravacao) != 1 || memcmp(sCabecalho.m_acMagic, DUMP_MAGIC, 8) != 0)
+    {
+        fprintf(stderr, "%s: nao e' uma gravacao do cancelador.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (sCabecalho.m_uVersion < 1 || sCabecalho.m_uVersion > DUMP_VERSION || sCabecalho.m_uControls > DUMP_MAX_CONTROLS)
+    {
+        fprintf(stderr, "%s: versao %u nao suportada.\n", argv[1], sCabecalho.m_uVersion);
+        return EXIT_FAILURE;
+    }
+
+    fDescritor = hostOpen(argv[2]);
+    psDescritor = fDescritor != NULL ? hostFind(fDescritor, argc > 3 ? argv[3] : NULL) : NULL;
+    if (psDescritor == NULL)
+        return EXIT_FAILURE;
+    psSaida = NULL;
+    if (argc > 4 && (psSaida = fopen(argv[4], "wb")) == NULL)
+    {
+        fprintf(stderr, "%s: nao foi possivel criar.\n", argv[4]);
+        return EXIT_FAILURE;
+    }
+
+    /* Classifica as portas do plugin de destino */
+    lControles = 0;
+    lEntradaD = lEntradaX = lSaida = MAX_PORTS;
+    hInstancia = psDescritor->instantiate(psDescritor, sCabecalho.m_uSampleRate);
+    for (lPorta = 0; lPorta < psDescritor->PortCount && lPorta < MAX_PORTS; lPorta++)
+    {
+        iPorta = psDescritor->PortDescriptors[lPorta];
+        if (LADSPA_IS_PORT_CONTROL(iPorta) && LADSPA_IS_PORT_INPUT(iPorta))
+        {
+            afControles[lPorta] = hostDefault(&psDescritor->PortRangeHints[lPorta], sCabecalho.m_uSampleRate);
+            alControles[lControles++] = lPorta;
+            psDescritor->connect_port(hInstancia, lPorta, afControles + lPorta);
+        }
+        else if (LADSPA_IS_PORT_CONTROL(iPorta))
+        {
+            psDescritor->connect_port(hInstancia, lPorta, afMedidores + lPorta);
+        }
+        else if (LADSPA_IS_PORT_INPUT(iPorta))
+        {
+            if (lEntradaD == MAX_PORTS)
+                lEntradaD = lPorta;
+            else if (lEntradaX == MAX_PORTS)
+                lEntradaX = lPorta;
+        }
+        else if (lSaida == MAX_PORTS)
+        {
+            lSaida = lPorta;
+        }
+    }
+    if (lEntradaD == MAX_PORTS || lEntradaX == MAX_PORTS || lSaida == MAX_PORTS)
+    {
+        fprintf(stderr, "%s: o plugin precisa de duas entradas e uma saida de audio.\n", psDescritor->Label);
+        return EXIT_FAILURE;
+    }
+    if (lControles != sCabecalho.m_uControls)
+        fprintf(stderr, "aviso: gravacao com %u controles, %s tem %lu.\n", sCabecalho.m_uControls, psDescritor->Label, lControles);
+    if (psDescritor->activate != NULL)
+        psDescritor->activate(hInstancia);
+
+    pfX = pfD = pfE = pfSaida = NULL;
+    pucDtd = NULL;
+    plJanelas = NULL;
+    lFalaDupla = lJanelas = 0;
+    lPorJanela = sCabecalho.m_uSampleRate / JANELAS_POR_SEGUNDO > 0 ? sCabecalho.m_uSampleRate / JANELAS_POR_SEGUNDO : 1;
+    lTamanho = 0;
+    lBlocos = lAmostras = lDescartados = lDiferentes = 0;
+    lPrimeiroDiferente = -1;
+    dPotD = dPotE = dPotSaida = dMaiorDiferenca = 0;
+    dTempo = 0;
+
+    while (fread(&sBloco, sizeof(sBloco), 1, psGravacao) == 1)
+    {
+        if (sBloco.m_uMagic != DUMP_BLOCK_MAGIC)
+        {
+            fprintf(stderr, "%s: registro invalido no bloco %lu.\n", argv[1], lBlocos);
+            return EXIT_FAILURE;
+        }
+
+        if (sBloco.m_uSamples > lTamanho)
+        {
+            lTamanho = sBloco.m_uSamples;
+            pfX = (float *)realloc(pfX, lTamanho * sizeof(float));
+            pfD = (float *)realloc(pfD, lTamanho * sizeof(float));
+            pfE = (float *)realloc(pfE, lTamanho * sizeof(float));
+            pfSaida = (float *)realloc(pfSaida, lTamanho * sizeof(float));
+            pucDtd = (unsigned char *)realloc(pucDtd, dumpDecisionBytes(lTamanho));
+            if (pfX == NULL || pfD == NULL || pfE == NULL || pfSaida == NULL || pucDtd == NULL)
+            {
+                fputs("Out of memory.\n", stderr);
+                return EXIT_FAILURE;
+            }
+        }
+
+        /* A versao 1 nao tem os bits do DTD */
+        lBytesDtd = sCabecalho.m_uVersion >= 2 ? dumpDecisionBytes(sBloco.m_uSamples) : 0;
+        if (fread(afGravados, sizeof(float), sCabecalho.m_uControls, psGravacao) != sCabecalho.m_uControls
+            || fread(pfX, sizeof(float), sBloco.m_uSamples, psGravacao) != sBloco.m_uSamples
+            || fread(pfD, sizeof(float), sBloco.m_uSamples, psGravacao) != sBloco.m_uSamples
+            || fread(pfE, sizeof(float), sBloco.m_uSamples, psGravacao) != sBloco.m_uSamples
+            || fread(pucDtd, 1, lBytesDtd, psGravacao) != lBytesDtd)
+        {
+            fprintf(stderr, "%s: gravacao truncada no bloco %lu.\n", argv[1], lBlocos);
+            break;
+        }
+
+        if (sBloco.m_uDropped > 0 && lDescartados == 0)
+            fprintf(stderr, "aviso: %u blocos descartados antes do bloco %lu; a comparacao deixa de ser exata.\n", sBloco.m_uDropped, lBlocos);
+        lDescartados += sBloco.m_uDropped;
+
+        for (lPorta = 0; lPorta < lControles && lPorta < sCabecalho.m_uControls; lPorta++)
+            afControles[alControles[lPorta]] = afGravados[lPorta];
+
+        psDescritor->connect_port(hInstancia, lEntradaD, pfD);
+        psDescritor->connect_port(hInstancia, lEntradaX, pfX);
+        psDescritor->connect_port(hInstancia, lSaida, pfSaida);
+
+        dInicio = hostSeconds();
+        psDescritor->run(hInstancia, sBloco.m_uSamples);
+        dTempo += hostSeconds() - dInicio;
+
+        if (memcmp(pfSaida, pfE, sBloco.m_uSamples * sizeof(float)) != 0)
+        {
+            lDiferentes++;
+            if (lPrimeiroDiferente < 0)
+                lPrimeiroDiferente = (long)lBlocos;
+        }
+        for (lAmostra = 0; lAmostra < sBloco.m_uSamples; lAmostra++)
+        {
+            dPotD += (double)pfD[lAmostra] * pfD[lAmostra];
+            dPotE += (double)pfE[lAmostra] * pfE[lAmostra];
+            dPotSaida += (double)pfSaida[lAmostra] * pfSaida[lAmostra];
+            if (fabs((double)pfSaida[lAmostra] - pfE[lAmostra]) > dMaiorDiferenca)
+                dMaiorDiferenca = fabs((double)pfSaida[lAmostra] - pfE[lAmostra]);
+        }
+        if (lBytesDtd > 0 && (lAmostras + sBloco.m_uSamples + lPorJanela - 1) / lPorJanela > lJanelas)
+        {
+            lJanela = lJanelas;
+            lJanelas = (lAmostras + sBloco.m_uSamples + lPorJanela - 1) / lPorJanela;
+            plJanelas = (unsigned long *)realloc(plJanelas, lJanelas * sizeof(unsigned long));
+            if (plJanelas == NULL)
+            {
+                fputs("Out of memory.\n", stderr);
+                return EXIT_FAILURE;
+            }
+            memset(plJanelas + lJanela, 0, (lJanelas - lJanela) * sizeof(unsigned long));
+        }
+        for (lAmostra = 0; lBytesDtd > 0 && lAmostra < sBloco.m_uSamples; lAmostra++)
+        {
+            if ((pucDtd[lAmostra / 8] >> (lAmostra & 7)) & 1)
+            {
+                lFalaDupla++;
+                plJanelas[(lAmostras + lAmostra) / lPorJanela]++;
+            }
+        }
+        if (psSaida != NULL)
+            fwrite(pfSaida, sizeof(float), sBloco.m_uSamples, psSaida);
+
+        lBlocos++;
+        lAmostras += sBloco.m_uSamples;
+    }
+
+    psDescritor->cleanup(hInstancia);
+    fclose(psGravacao);
+    if (psSaida != NULL)
+        fclose(psSaida);
+
+    printf("gravacao:   %s (%u), %lu blocos, %.1f s a %u Hz, %lu descartados\n", sCabecalho.m_acLabel, sCabecalho.m_uEngine, lBlocos, (double)lAmostras / sCabecalho.m_uSampleRate, sCabecalho.m_uSampleRate, lDescartados);
+    printf("reproducao: %s (%lu), %.0fx tempo real\n", psDescritor->Label, psDescritor->UniqueID, dTempo > 0 ? (double)lAmostras / sCabecalho.m_uSampleRate / dTempo : 0);
+    printf("ERLE gravada %.2f dB, reproduzida %.2f dB\n", 10.0 * log10((dPotD + 1e-20) / (dPotE + 1e-20)), 10.0 * log10((dPotD + 1e-20) / (dPotSaida + 1e-20)));
+    if (sCabecalho.m_uVersion >= 2)
+    {
+        printf("DTD: fala dupla em %.2f s (%.1f%%)\n", (double)lFalaDupla / sCabecalho.m_uSampleRate,
+               lAmostras > 0 ? 100.0 * lFalaDupla / lAmostras : 0);
+        for (lJanela = 0; lJanela < lJanelas; lJanela++)
+        {
+            if (lJanela % JANELAS_POR_LINHA == 0)
+                printf("%7.1f s |", (double)lJanela / JANELAS_POR_SEGUNDO);
+            lTotal = lJanela + 1 < lJanelas ? lPorJanela : lAmostras - lJanela * lPorJanela;
+            putchar(g_acDensidade[(plJanelas[lJanela] * (sizeof(g_acDensidade) - 2) + lTotal - 1) / lTotal]);
+            if (lJanela % JANELAS_POR_LINHA == JANELAS_POR_LINHA - 1 || lJanela + 1 == lJanelas)
+                printf("|\n");
+        }
+    }
+    if (lDiferentes == 0)
+        printf("saida identica bit a bit\n");
+    else
+        printf("%lu blocos diferentes, o primeiro e' o %ld; maior diferenca %.3g\n", lDiferentes, lPrimeiroDiferente, dMaiorDiferenca);
+
+    free(pfX);
+    free(pfD);
+    free(pfE);
+    free(pfSaida);
+    free(pucDtd);
+    free(plJanelas);
+
+    return lDiferentes == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*****************************************************************************/
+
+/* EOF */
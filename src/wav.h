@@ -0,0 +1,347 @@
+/* wav.h
+
+   Free software by Pedro Nariyoshi. Do with as you will. No
+   warranty.
+
+   Arquivos de audio mapeados em memoria, para as ferramentas de
+   src/tools que processam gravacoes offline:
+
+     wavMap()     mapeia um arquivo inteiro so para leitura
+     wavParse()   le o cabecalho RIFF/WAVE (PCM de 16, 24 e 32 bits ou
+                  float de 32 bits, tambem em WAVE_FORMAT_EXTENSIBLE)
+     wavParseHead() o mesmo, so com o comeco do arquivo na memoria
+     wavRaw()     trata o mapa como PCM mono sem cabecalho
+     wavDirect()  ponteiro direto para as amostras de um canal, quando o
+                  arquivo ja e' float mono alinhado (sem copia)
+     wavRead()    converte um trecho de um canal para float
+     wavCreate()  cria um arquivo de saida mono (WAV ou bruto, float ou
+                  PCM de 16 ou 24 bits) ja no tamanho final e o mapeia
+                  para escrita
+     wavClose()   desfaz o mapa de saida
+     wavHeader()  monta o cabecalho que wavCreate() grava
+
+   As conversoes de formato sao as de pcm.h, no nivel de simd.h escolhido
+   quando o arquivo e' aberto. So para maquinas little-endian, como o
+   resto do projeto. */
+
+#ifndef WAV_H
+#define WAV_H
+
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pcm.h"
+
+/*****************************************************************************/
+
+#define WAV_PCM PCM_INT
+#define WAV_FLOAT PCM_FLOAT
+#define WAV_EXTENSIBLE 0xfffe
+
+/* Cabecalho gravado por wavCreate(): RIFF, fmt de 16 bytes, fact e data;
+   56 bytes, para as amostras ficarem alinhadas em 4 */
+#define WAV_HEADER_SIZE 56
+
+/*****************************************************************************/
+
+typedef struct
+{
+
+    unsigned int m_uFormat; /* WAV_PCM ou WAV_FLOAT */
+
+    unsigned int m_uChannels;
+
+    unsigned int m_uSampleRate;
+
+    unsigned int m_uBits;
+
+    const unsigned char * m_pucData; /* Primeiro quadro */
+
+    unsigned long m_lFrames;
+
+    int m_iSimd; /* Nivel de simd.h das conversoes */
+
+} WavInfo;
+
+/* Arquivo de saida mapeado */
+typedef struct
+{
+
+    int m_iFd;
+
+    unsigned char * m_pucMap;
+
+    size_t m_lSize;
+
+    unsigned int m_uFormat;
+
+    unsigned int m_uBits;
+
+    unsigned char * m_pucData; /* Primeira amostra */
+
+    float * m_pfData; /* O mesmo, se a saida for float */
+
+} WavOutput;
+
+/*****************************************************************************/
+
+static inline unsigned int wavU16(const unsigned char * puc)
+{
+    return (unsigned int)puc[0] | ((unsigned int)puc[1] << 8);
+}
+
+static inline unsigned int wavU32(const unsigned char * puc)
+{
+    return (unsigned int)puc[0] | ((unsigned int)puc[1] << 8) | ((unsigned int)puc[2] << 16) | ((unsigned int)puc[3] << 24);
+}
+
+static inline void wavPut16(unsigned char * puc, unsigned int u)
+{
+    puc[0] = (unsigned char)u;
+    puc[1] = (unsigned char)(u >> 8);
+}
+
+static inline void wavPut32(unsigned char * puc, unsigned int u)
+{
+    puc[0] = (unsigned char)u;
+    puc[1] = (unsigned char)(u >> 8);
+    puc[2] = (unsigned char)(u >> 16);
+    puc[3] = (unsigned char)(u >> 24);
+}
+
+/*****************************************************************************/
+
+/* Mapeia pcPath para leitura; devolve NULL (com a mensagem em stderr)
+   se nao der. O kernel e' avisado de que a leitura e' sequencial. */
+static inline const void * wavMap(const char * pcPath, size_t * plSize)
+{
+
+    struct stat sStat;
+    void * pvMap;
+    int iFd;
+
+    iFd = open(pcPath, O_RDONLY);
+    if (iFd < 0 || fstat(iFd, &sStat) != 0)
+    {
+        perror(pcPath);
+        if (iFd >= 0)
+            close(iFd);
+        return NULL;
+    }
+    if (sStat.st_size == 0)
+    {
+        fprintf(stderr, "%s: arquivo vazio.\n", pcPath);
+        close(iFd);
+        return NULL;
+    }
+
+    pvMap = mmap(NULL, (size_t)sStat.st_size, PROT_READ, MAP_PRIVATE, iFd, 0);
+    close(iFd);
+    if (pvMap == MAP_FAILED)
+    {
+        perror(pcPath);
+        return NULL;
+    }
+    madvise(pvMap, (size_t)sStat.st_size, MADV_SEQUENTIAL);
+
+    *plSize = (size_t)sStat.st_size;
+    return pvMap;
+}
+
+static inline void wavUnmap(const void * pvMap, size_t lSize)
+{
+    munmap((void *)pvMap, lSize);
+}
+
+/*****************************************************************************/
+
+/* Le o cabecalho de um WAV do qual so os lHead primeiros bytes estao em
+   pvHead e que tem lFileSize bytes ao todo (para ler em fluxo, sem
+   mapear). Devolve NULL se deu certo ou a descricao do problema;
+   m_pucData aponta para dentro de pvHead, mesmo que alem de lHead. */
+static inline const char * wavParseHead(const void * pvHead, size_t lHead, unsigned long long ullFileSize, WavInfo * psInfo)
+{
+
+    const unsigned char * pucMap;
+    const unsigned char * pucChunk;
+    unsigned int uChunk;
+    unsigned int uFormat;
+    unsigned int uAlign;
+    size_t lOffset;
+    int iFmt;
+
+    pucMap = (const unsigned char *)pvHead;
+    memset(psInfo, 0, sizeof(WavInfo));
+    if (lHead < 12 || memcmp(pucMap, "RIFF", 4) != 0 || memcmp(pucMap + 8, "WAVE", 4) != 0)
+        return "nao e' um arquivo WAV";
+
+    iFmt = 0;
+    uAlign = 0;
+    for (lOffset = 12; lOffset + 8 <= lHead; lOffset += 8 + uChunk + (uChunk & 1))
+    {
+        pucChunk = pucMap + lOffset;
+        uChunk = wavU32(pucChunk + 4);
+
+        if (memcmp(pucChunk, "fmt ", 4) == 0 && uChunk >= 16 && lOffset + 8 + uChunk <= lHead)
+        {
+            uFormat = wavU16(pucChunk + 8);
+            if (uFormat == WAV_EXTENSIBLE && uChunk >= 40)
+                uFormat = wavU16(pucChunk + 8 + 24); /* Dois primeiros bytes do GUID */
+            psInfo->m_uFormat = uFormat;
+            psInfo->m_uChannels = wavU16(pucChunk + 10);
+            psInfo->m_uSampleRate = wavU32(pucChunk + 12);
+            uAlign = wavU16(pucChunk + 20);
+            psInfo->m_uBits = wavU16(pucChunk + 22);
+            iFmt = 1;
+        }
+        else if (memcmp(pucChunk, "data", 4) == 0)
+        {
+            if (!iFmt)
+                return "bloco data antes do fmt";
+            if (uChunk > ullFileSize - lOffset - 8) /* Gravacao interrompida */
+                uChunk = (unsigned int)(ullFileSize - lOffset - 8);
+            psInfo->m_pucData = pucChunk + 8;
+            psInfo->m_lFrames = uAlign ? uChunk / uAlign : 0;
+            break;
+        }
+    }
+
+    psInfo->m_iSimd = simdLevel();
+    if (psInfo->m_pucData == NULL)
+        return "sem bloco data";
+    if (psInfo->m_uChannels == 0 || uAlign != psInfo->m_uChannels * (psInfo->m_uBits / 8))
+        return "cabecalho fmt inconsistente";
+    if (!(psInfo->m_uFormat == WAV_PCM && (psInfo->m_uBits == 16 || psInfo->m_uBits == 24 || psInfo->m_uBits == 32))
+        && !(psInfo->m_uFormat == WAV_FLOAT && psInfo->m_uBits == 32))
+        return "formato nao suportado (so PCM de 16, 24 ou 32 bits e float de 32 bits)";
+    return NULL;
+}
+
+/* Le o cabecalho de um WAV mapeado. Devolve NULL se deu certo ou a
+   descricao do problema. */
+static inline const char * wavParse(const void * pvMap, size_t lSize, WavInfo * psInfo)
+{
+    return wavParseHead(pvMap, lSize, lSize, psInfo);
+}
+
+/* Arquivo bruto mono: uFormat e uBits vem de fora (da extensao, nas
+   ferramentas) */
+static inline void wavRaw(const void * pvMap, size_t lSize, unsigned int uSampleRate, unsigned int uFormat,
+                          unsigned int uBits, WavInfo * psInfo)
+{
+    psInfo->m_uFormat = uFormat;
+    psInfo->m_uChannels = 1;
+    psInfo->m_uSampleRate = uSampleRate;
+    psInfo->m_uBits = uBits;
+    psInfo->m_pucData = (const unsigned char *)pvMap;
+    psInfo->m_lFrames = lSize / (uBits / 8);
+    psInfo->m_iSimd = simdLevel();
+}
+
+/*****************************************************************************/
+
+/* As amostras do canal uChannel a partir do quadro lStart, sem copia, ou
+   NULL se o arquivo nao for float mono alinhado */
+static inline const float * wavDirect(const WavInfo * psInfo, unsigned int uChannel, unsigned long lStart)
+{
+    if (psInfo->m_uFormat != WAV_FLOAT || psInfo->m_uChannels != 1 || uChannel != 0
+        || ((size_t)psInfo->m_pucData & (sizeof(float) - 1)) != 0)
+        return NULL;
+    return (const float *)psInfo->m_pucData + lStart;
+}
+
+/* Converte lFrames quadros do canal uChannel, a partir de lStart, para
+   float em [-1, 1) */
+static inline void wavRead(const WavInfo * psInfo, unsigned int uChannel, unsigned long lStart, unsigned long lFrames, float * pfOut)
+{
+    pcmRead(psInfo->m_pucData + lStart * psInfo->m_uChannels * (psInfo->m_uBits / 8), psInfo->m_uFormat, psInfo->m_uBits,
+            psInfo->m_uChannels, uChannel, lFrames, pfOut, psInfo->m_iSimd);
+}
+
+/*****************************************************************************/
+
+/* Cabecalho de WAV_HEADER_SIZE bytes de um arquivo mono (float ou PCM) */
+static inline void wavHeader(unsigned char * pucHeader, unsigned int uSampleRate, unsigned long lFrames,
+                             unsigned int uFormat, unsigned int uBits)
+{
+
+    unsigned int uBytes;
+
+    uBytes = uBits / 8;
+    memcpy(pucHeader, "RIFF", 4);
+    wavPut32(pucHeader + 4, (unsigned int)(WAV_HEADER_SIZE - 8 + lFrames * uBytes));
+    memcpy(pucHeader + 8, "WAVEfmt ", 8);
+    wavPut32(pucHeader + 16, 16);
+    wavPut16(pucHeader + 20, uFormat);
+    wavPut16(pucHeader + 22, 1);
+    wavPut32(pucHeader + 24, uSampleRate);
+    wavPut32(pucHeader + 28, uSampleRate * uBytes);
+    wavPut16(pucHeader + 32, uBytes);
+    wavPut16(pucHeader + 34, uBits);
+    memcpy(pucHeader + 36, "fact", 4);
+    wavPut32(pucHeader + 40, 4);
+    wavPut32(pucHeader + 44, (unsigned int)lFrames);
+    memcpy(pucHeader + 48, "data", 4);
+    wavPut32(pucHeader + 52, (unsigned int)(lFrames * uBytes));
+}
+
+/* Cria pcPath com lFrames amostras mono em uFormat/uBits (iRaw: sem
+   cabecalho) e o mapeia para escrita; as amostras ficam em
+   psOutput->m_pucData (e m_pfData, se for float) */
+static inline int wavCreate(const char * pcPath, unsigned int uSampleRate, unsigned long lFrames, int iRaw,
+                            unsigned int uFormat, unsigned int uBits, WavOutput * psOutput)
+{
+
+    size_t lHeader;
+
+    lHeader = iRaw ? 0 : WAV_HEADER_SIZE;
+    psOutput->m_uFormat = uFormat;
+    psOutput->m_uBits = uBits;
+    psOutput->m_lSize = lHeader + lFrames * (uBits / 8);
+    psOutput->m_iFd = open(pcPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (psOutput->m_iFd < 0 || ftruncate(psOutput->m_iFd, (off_t)psOutput->m_lSize) != 0)
+    {
+        perror(pcPath);
+        if (psOutput->m_iFd >= 0)
+            close(psOutput->m_iFd);
+        return 0;
+    }
+
+    psOutput->m_pucMap = (unsigned char *)mmap(NULL, psOutput->m_lSize, PROT_READ | PROT_WRITE, MAP_SHARED, psOutput->m_iFd, 0);
+    if (psOutput->m_pucMap == MAP_FAILED)
+    {
+        perror(pcPath);
+        close(psOutput->m_iFd);
+        return 0;
+    }
+    psOutput->m_pucData = psOutput->m_pucMap + lHeader;
+    psOutput->m_pfData = uFormat == WAV_FLOAT ? (float *)psOutput->m_pucData : NULL;
+
+    if (!iRaw)
+        wavHeader(psOutput->m_pucMap, uSampleRate, lFrames, uFormat, uBits);
+    return 1;
+}
+
+/* Desfaz o mapa; as paginas sujas vao para o disco pelo kernel */
+static inline int wavClose(WavOutput * psOutput)
+{
+
+    int iOk;
+
+    iOk = munmap(psOutput->m_pucMap, psOutput->m_lSize) == 0;
+    iOk = close(psOutput->m_iFd) == 0 && iOk;
+    return iOk;
+}
+
+/*****************************************************************************/
+
+#endif /* WAV_H */
+
+/* EOF */